@@ -71,7 +71,7 @@
 #include <blowfish/blowfish_impl.h>
 
 static const char USAGE[] =
-	"Usage: %s [-r] [-l] -a file [ device ]\n"
+	"Usage: %s [-r] [-l] [-w cache_file] -a file [ device ]\n"
 	"       %s [-r] -c crypto_algorithm -a file [device]\n"
 	"       %s [-r] -c crypto_algorithm -k raw_key_file -a file [device]\n"
 	"       %s [-r] -c crypto_algorithm -T [token]:[manuf]:[serial]:key "
@@ -420,7 +420,10 @@ lofi_map_file(int lfd, struct lofi_ioctl *li, const char *filename)
 	(void) strlcpy(li->li_filename, filename, sizeof (li->li_filename));
 	minor = ioctl(lfd, LOFI_MAP_FILE, li);
 	if (minor == -1) {
-		if (errno == ENOTSUP)
+		if (errno == ENOTSUP && li->li_cachefile[0] != '\0')
+			warn(gettext("caching compressed files is "
+			    "unsupported"));
+		else if (errno == ENOTSUP)
 			warn(gettext("encrypting compressed files is "
 			    "unsupported"));
 		die(gettext("could not map file %s"), filename);
@@ -431,18 +434,23 @@ lofi_map_file(int lfd, struct lofi_ioctl *li, const char *filename)
 
 /*
  * Add a device association. If devicename is NULL, let the driver
- * pick a device.
+ * pick a device.  If cachefile is not NULL, it is used as a block cache
+ * in front of the file.
  */
 static void
 add_mapping(int lfd, const char *devicename, const char *filename,
-    mech_alias_t *cipher, const char *rkey, size_t rksz, boolean_t rdonly,
-    boolean_t label)
+    const char *cachefile, mech_alias_t *cipher, const char *rkey,
+    size_t rksz, boolean_t rdonly, boolean_t label)
 {
 	struct lofi_ioctl li;
 
 	bzero(&li, sizeof (li));
 	li.li_readonly = rdonly;
 	li.li_labeled = label;
+	if (cachefile != NULL) {
+		(void) strlcpy(li.li_cachefile, cachefile,
+		    sizeof (li.li_cachefile));
+	}
 
 	li.li_crypto_enabled = B_FALSE;
 	if (cipher != NULL) {
@@ -494,7 +502,10 @@ add_mapping(int lfd, const char *devicename, const char *filename,
 
 	/* if device is already in use li.li_minor won't change */
 	if (ioctl(lfd, LOFI_MAP_FILE_MINOR, &li) == -1) {
-		if (errno == ENOTSUP)
+		if (errno == ENOTSUP && li.li_cachefile[0] != '\0')
+			warn(gettext("caching compressed files is "
+			    "unsupported"));
+		else if (errno == ENOTSUP)
 			warn(gettext("encrypting compressed files is "
 			    "unsupported"));
 		die(gettext("could not map file %s to %s"), filename,
@@ -1919,6 +1930,7 @@ main(int argc, char *argv[])
 	int	c;
 	const char *devicename = NULL;
 	const char *filename = NULL;
+	const char *cachefile = NULL;
 	const char *algname = COMPRESS_ALGORITHM;
 	int	openflag;
 	int	minor;
@@ -1944,13 +1956,14 @@ main(int argc, char *argv[])
 	char	*rkey = NULL;
 	size_t	rksz = 0;
 	char realfilename[MAXPATHLEN];
+	char realcachefile[MAXPATHLEN];
 
 	pname = getpname(argv[0]);
 
 	(void) setlocale(LC_ALL, "");
 	(void) textdomain(TEXT_DOMAIN);
 
-	while ((c = getopt(argc, argv, "a:c:Cd:efk:lrs:T:U")) != EOF) {
+	while ((c = getopt(argc, argv, "a:c:Cd:efk:lrs:T:Uw:")) != EOF) {
 		switch (c) {
 		case 'a':
 			addflag = B_TRUE;
@@ -2031,6 +2044,11 @@ main(int argc, char *argv[])
 		case 'U':
 			uncompressflag = B_TRUE;
 			break;
+		case 'w':
+			if ((cachefile = realpath(optarg,
+			    realcachefile)) == NULL)
+				die("%s", optarg);
+			break;
 		case '?':
 		default:
 			errflag = B_TRUE;
@@ -2043,6 +2061,7 @@ main(int argc, char *argv[])
 	    (addflag && deleteflag) ||
 	    (labelflag && !addflag) ||
 	    (rdflag && !addflag) ||
+	    (cachefile != NULL && (!addflag || need_crypto)) ||
 	    (!addflag && need_crypto) ||
 	    (need_crypto && labelflag) ||
 	    ((compressflag || uncompressflag) &&
@@ -2092,6 +2111,12 @@ main(int argc, char *argv[])
 
 	if (addflag || compressflag || uncompressflag)
 		check_file_validity(filename);
+	if (cachefile != NULL) {
+		check_file_validity(cachefile);
+		if (strcmp(cachefile, filename) == 0)
+			die(gettext("cannot use %s as its own cache\n"),
+			    filename);
+	}
 
 	if (filename && !valid_abspath(filename))
 		exit(E_ERROR);
@@ -2162,8 +2187,8 @@ main(int argc, char *argv[])
 	 * Now to the real work.
 	 */
 	if (addflag)
-		add_mapping(lfd, devicename, filename, cipher, rkey, rksz,
-		    rdflag, labelflag);
+		add_mapping(lfd, devicename, filename, cachefile, cipher,
+		    rkey, rksz, rdflag, labelflag);
 	else if (compressflag)
 		lofi_compress(&lfd, filename, compress_index, segsize);
 	else if (uncompressflag)
@@ -2207,6 +2207,8 @@ kmastat_cache(uintptr_t addr, const kmem_cache_t *cp, kmastat_vmem_t **kvpp)
 	kmastat_vmem_t *kv;
 	datafmt_t *dfp = kmemfmt;
 	int magsize;
+	long lgrp_full;
+	uint64_t lgrp_alloc;
 
 	int avail, alloc, total;
 	size_t meminuse = (cp->cache_slab_create - cp->cache_slab_destroy) *
@@ -2218,8 +2220,10 @@ kmastat_cache(uintptr_t addr, const kmem_cache_t *cp, kmastat_vmem_t **kvpp)
 
 	magsize = kmem_get_magsize(cp);
 
-	alloc = cp->cache_slab_alloc + cp->cache_full.ml_alloc;
-	avail = cp->cache_full.ml_total * magsize;
+	lgrp_full = kmem_get_lgrp_depot_full(cp, &lgrp_alloc);
+
+	alloc = cp->cache_slab_alloc + cp->cache_full.ml_alloc + lgrp_alloc;
+	avail = (cp->cache_full.ml_total + lgrp_full) * magsize;
 	total = cp->cache_buftotal;
 
 	(void) mdb_pwalk("kmem_cpu_cache", cpu_alloc, &alloc, addr);
@@ -926,6 +926,35 @@ kmem_get_magsize(const kmem_cache_t *cp)
 	return (mt.mt_magsize);
 }
 
+/*
+ * Returns the number of full magazines in the per-lgroup depots of a
+ * cache, and optionally the number of allocations from them.
+ */
+long
+kmem_get_lgrp_depot_full(const kmem_cache_t *cp, uint64_t *allocp)
+{
+	kmem_lgrp_depot_t ld;
+	long total = 0;
+	int lgrp;
+
+	if (allocp != NULL)
+		*allocp = 0;
+
+	for (lgrp = 0; lgrp < cp->cache_lgrp_ndepot; lgrp++) {
+		if (mdb_vread(&ld, sizeof (ld),
+		    (uintptr_t)&cp->cache_lgrp_depot[lgrp]) == -1) {
+			mdb_warn("couldn't read lgroup depot at %p",
+			    &cp->cache_lgrp_depot[lgrp]);
+			break;
+		}
+		total += ld.kld_full.ml_total;
+		if (allocp != NULL)
+			*allocp += ld.kld_full.ml_alloc;
+	}
+
+	return (total);
+}
+
 /*ARGSUSED*/
 static int
 kmem_estimate_slab(uintptr_t addr, const kmem_slab_t *sp, size_t *est)
@@ -951,7 +980,8 @@ kmem_estimate_allocated(uintptr_t addr, const kmem_cache_t *cp)
 	    (mdb_walk_cb_t)kmem_estimate_slab, &cache_est, addr);
 
 	if ((magsize = kmem_get_magsize(cp)) != 0) {
-		size_t mag_est = cp->cache_full.ml_total * magsize;
+		size_t mag_est = (cp->cache_full.ml_total +
+		    kmem_get_lgrp_depot_full(cp, NULL)) * magsize;
 
 		if (cache_est >= mag_est) {
 			cache_est -= mag_est;
@@ -983,8 +1013,9 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
     void ***maglistp, size_t *magcntp, size_t *magmaxp, int alloc_flags)
 {
 	kmem_magazine_t *kmp, *mp;
+	kmem_lgrp_depot_t ld;
 	void **maglist = NULL;
-	int i, cpu;
+	int i, cpu, lgrp;
 	size_t magsize, magmax, magbsize;
 	size_t magcnt = 0;
 
@@ -1003,16 +1034,17 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
 	/*
 	 * There are several places where we need to go buffer hunting:
 	 * the per-CPU loaded magazine, the per-CPU spare full magazine,
-	 * and the full magazine list in the depot.
+	 * and the full magazine lists in the depot and the lgroup depots.
 	 *
 	 * For an upper bound on the number of buffers in the magazine
-	 * layer, we have the number of magazines on the cache_full
-	 * list plus at most two magazines per CPU (the loaded and the
+	 * layer, we have the number of magazines on the full lists
+	 * plus at most two magazines per CPU (the loaded and the
 	 * spare).  Toss in 100 magazines as a fudge factor in case this
 	 * is live (the number "100" comes from the same fudge factor in
 	 * crash(1M)).
 	 */
-	magmax = (cp->cache_full.ml_total + 2 * ncpus + 100) * magsize;
+	magmax = (cp->cache_full.ml_total + kmem_get_lgrp_depot_full(cp, NULL) +
+	    2 * ncpus + 100) * magsize;
 	magbsize = offsetof(kmem_magazine_t, mag_round[magsize]);
 
 	if (magbsize >= PAGESIZE / 2) {
@@ -1039,6 +1071,28 @@ kmem_read_magazines(kmem_cache_t *cp, uintptr_t addr, int ncpus,
 
 	dprintf(("cache_full list done\n"));
 
+	/*
+	 * Then the full magazines in the per-lgroup depots.
+	 */
+	for (lgrp = 0; lgrp < cp->cache_lgrp_ndepot; lgrp++) {
+		if (mdb_vread(&ld, sizeof (ld),
+		    (uintptr_t)&cp->cache_lgrp_depot[lgrp]) == -1) {
+			mdb_warn("couldn't read lgroup depot at %p",
+			    &cp->cache_lgrp_depot[lgrp]);
+			goto fail;
+		}
+
+		for (kmp = ld.kld_full.ml_list; kmp != NULL; ) {
+			READMAG_ROUNDS(magsize);
+			kmp = mp->mag_next;
+
+			if (kmp == ld.kld_full.ml_list)
+				break; /* kld_full list loop detected */
+		}
+	}
+
+	dprintf(("lgroup depots done\n"));
+
 	/*
 	 * Now whip through the CPUs, snagging the loaded magazines
 	 * and full spares.
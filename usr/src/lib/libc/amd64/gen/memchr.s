@@ -18,102 +18,270 @@
  *
  * CDDL HEADER END
  */
+
 /*
  * Copyright 2004 Sun Microsystems, Inc.  All rights reserved.
  * Use is subject to license terms.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
  */
 
 	.file	"memchr.s"
 
-/
-/ memchr(sptr, c1, n)
-/
-/ Returns the pointer in sptr at which the character c1 appears; 
-/ or NULL if not found in chars; doesn't stop at \0.
-/
-/ Fast assembly language version of the following C-program memchr
-/ which represents the `standard' for the C-library.
-/ 
-/	void *
-/	memchr(const void *sptr, int c1, size_t n)
-/	{
-/		if (n != 0) {
-/			unsigned char	c = (unsigned char)c1; 
-/			const unsigned char	*sp = sptr; 
-/
-/			do {
-/				if (*sp++ == c)
-/					return ((void *)--sp); 
-/			} while (--n != 0); 
-/		}
-/		return (NULL); 
-/	}
-/
+/*
+ * memchr(sptr, c1, n)
+ *
+ * Returns the pointer in sptr at which the character c1 appears;
+ * or NULL if not found in chars; doesn't stop at \0.
+ *
+ * This implementation compares 16 bytes at a time using SSE2, or 32 bytes
+ * at a time using AVX2, and 4 such blocks per loop iteration. Loads are
+ * aligned so that the blocks at either end of the buffer, which may extend
+ * beyond it, never cross a page boundary; matches found beyond the end of
+ * the buffer are ignored. The unrolled loop is only entered on a boundary
+ * of its own size, so that it never reads past a match into the next page.
+ */
 
 #include "SYS.h"
+#include "proc64_id.h"
+
+#define	LABEL(s) .memchr/**/s
+
+	ENTRY(memchr)		/* (void *s, uchar_t c, size_t n) */
+	test	%rdx, %rdx
+	jz	LABEL(notfound)
+	testl	$VEC_AVX2, .vecops_method(%rip)
+	jnz	LABEL(avx2)
+
+	movd	%esi, %xmm0
+	punpcklbw %xmm0, %xmm0
+	punpcklwd %xmm0, %xmm0
+	pshufd	$0, %xmm0, %xmm0	/* c in all 16 bytes */
+
+	mov	%rdi, %rsi
+	and	$-16, %rsi		/* round down to 16-byte boundary */
+	mov	%edi, %ecx
+	and	$15, %ecx		/* bytes preceding the buffer */
+	movdqa	(%rsi), %xmm1
+	pcmpeqb	%xmm0, %xmm1
+	pmovmskb %xmm1, %eax
+	shr	%cl, %eax		/* skip bytes preceding buffer */
+	mov	$16, %r8d
+	sub	%rcx, %r8		/* bytes of the buffer in this block */
+	test	%eax, %eax
+	jnz	LABEL(head_found)
+	cmp	%r8, %rdx
+	jbe	LABEL(notfound)
+	sub	%r8, %rdx
+	add	$16, %rsi
+
+	/*
+	 * The loop below must not cross a page boundary before it gets to a
+	 * match, so first step up to a 64-byte boundary.
+	 */
+LABEL(align):
+	test	$63, %esi
+	jz	LABEL(aligned)
+	movdqa	(%rsi), %xmm1
+	pcmpeqb	%xmm0, %xmm1
+	pmovmskb %xmm1, %eax
+	test	%eax, %eax
+	jnz	LABEL(tail_found)
+	add	$16, %rsi
+	sub	$16, %rdx
+	ja	LABEL(align)
+	jmp	LABEL(notfound)
+
+LABEL(aligned):
+	cmp	$64, %rdx
+	jbe	LABEL(tail)
+
+	.p2align 4
+LABEL(loop):				/* more than 64 bytes left */
+	movdqa	(%rsi), %xmm1
+	movdqa	16(%rsi), %xmm2
+	movdqa	32(%rsi), %xmm3
+	movdqa	48(%rsi), %xmm4
+	pcmpeqb	%xmm0, %xmm1
+	pcmpeqb	%xmm0, %xmm2
+	pcmpeqb	%xmm0, %xmm3
+	pcmpeqb	%xmm0, %xmm4
+	movdqa	%xmm1, %xmm5
+	por	%xmm2, %xmm5
+	movdqa	%xmm3, %xmm6
+	por	%xmm4, %xmm6
+	por	%xmm6, %xmm5
+	pmovmskb %xmm5, %eax
+	test	%eax, %eax
+	jnz	LABEL(loop_found)
+	add	$64, %rsi
+	sub	$64, %rdx
+	cmp	$64, %rdx
+	ja	LABEL(loop)
+
+	.p2align 4
+LABEL(tail):				/* 1 to 64 bytes left */
+	movdqa	(%rsi), %xmm1
+	pcmpeqb	%xmm0, %xmm1
+	pmovmskb %xmm1, %eax
+	test	%eax, %eax
+	jnz	LABEL(tail_found)
+	add	$16, %rsi
+	sub	$16, %rdx
+	ja	LABEL(tail)
+
+LABEL(notfound):
+	xor	%eax, %eax
+	ret
+
+	.p2align 4
+LABEL(tail_found):
+	bsf	%eax, %eax
+	cmp	%rdx, %rax		/* beyond the end of the buffer? */
+	jae	LABEL(notfound)
+	add	%rsi, %rax
+	ret
+
+	.p2align 4
+LABEL(head_found):
+	bsf	%eax, %eax
+	cmp	%rdx, %rax
+	jae	LABEL(notfound)
+	add	%rdi, %rax
+	ret
+
+	.p2align 4
+LABEL(loop_found):			/* all 64 bytes are in the buffer */
+	pmovmskb %xmm1, %eax
+	test	%eax, %eax
+	jnz	LABEL(found)
+	add	$16, %rsi
+	pmovmskb %xmm2, %eax
+	test	%eax, %eax
+	jnz	LABEL(found)
+	add	$16, %rsi
+	pmovmskb %xmm3, %eax
+	test	%eax, %eax
+	jnz	LABEL(found)
+	add	$16, %rsi
+	pmovmskb %xmm4, %eax
+
+LABEL(found):
+	bsf	%eax, %eax
+	add	%rsi, %rax
+	ret
+
+	/*
+	 * AVX2 version, same as above with 32-byte blocks.
+	 */
+	.p2align 4
+LABEL(avx2):
+	vmovd	%esi, %xmm0
+	vpbroadcastb %xmm0, %ymm0	/* c in all 32 bytes */
+
+	mov	%rdi, %rsi
+	and	$-32, %rsi		/* round down to 32-byte boundary */
+	mov	%edi, %ecx
+	and	$31, %ecx		/* bytes preceding the buffer */
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	shr	%cl, %eax		/* skip bytes preceding buffer */
+	mov	$32, %r8d
+	sub	%rcx, %r8		/* bytes of the buffer in this block */
+	test	%eax, %eax
+	jnz	LABEL(avx2_head_found)
+	cmp	%r8, %rdx
+	jbe	LABEL(avx2_notfound)
+	sub	%r8, %rdx
+	add	$32, %rsi
+
+LABEL(avx2_align):			/* step up to a 128-byte boundary */
+	test	$127, %esi
+	jz	LABEL(avx2_aligned)
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	test	%eax, %eax
+	jnz	LABEL(avx2_tail_found)
+	add	$32, %rsi
+	sub	$32, %rdx
+	ja	LABEL(avx2_align)
+	jmp	LABEL(avx2_notfound)
+
+LABEL(avx2_aligned):
+	cmp	$128, %rdx
+	jbe	LABEL(avx2_tail)
+
+	.p2align 4
+LABEL(avx2_loop):			/* more than 128 bytes left */
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpcmpeqb 32(%rsi), %ymm0, %ymm2
+	vpcmpeqb 64(%rsi), %ymm0, %ymm3
+	vpcmpeqb 96(%rsi), %ymm0, %ymm4
+	vpor	%ymm1, %ymm2, %ymm5
+	vpor	%ymm3, %ymm4, %ymm6
+	vpor	%ymm5, %ymm6, %ymm5
+	vpmovmskb %ymm5, %eax
+	test	%eax, %eax
+	jnz	LABEL(avx2_loop_found)
+	sub	$-128, %rsi
+	add	$-128, %rdx
+	cmp	$128, %rdx
+	ja	LABEL(avx2_loop)
+
+	.p2align 4
+LABEL(avx2_tail):			/* 1 to 128 bytes left */
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	test	%eax, %eax
+	jnz	LABEL(avx2_tail_found)
+	add	$32, %rsi
+	sub	$32, %rdx
+	ja	LABEL(avx2_tail)
+
+LABEL(avx2_notfound):
+	xor	%eax, %eax
+	vzeroupper
+	ret
+
+	.p2align 4
+LABEL(avx2_tail_found):
+	bsf	%eax, %eax
+	cmp	%rdx, %rax		/* beyond the end of the buffer? */
+	jae	LABEL(avx2_notfound)
+	add	%rsi, %rax
+	vzeroupper
+	ret
+
+	.p2align 4
+LABEL(avx2_head_found):
+	bsf	%eax, %eax
+	cmp	%rdx, %rax
+	jae	LABEL(avx2_notfound)
+	add	%rdi, %rax
+	vzeroupper
+	ret
+
+	.p2align 4
+LABEL(avx2_loop_found):			/* all 128 bytes are in the buffer */
+	vpmovmskb %ymm1, %eax
+	test	%eax, %eax
+	jnz	LABEL(avx2_found)
+	add	$32, %rsi
+	vpmovmskb %ymm2, %eax
+	test	%eax, %eax
+	jnz	LABEL(avx2_found)
+	add	$32, %rsi
+	vpmovmskb %ymm3, %eax
+	test	%eax, %eax
+	jnz	LABEL(avx2_found)
+	add	$32, %rsi
+	vpmovmskb %ymm4, %eax
 
-	.globl	memchr
-	.align	4
-
-	ENTRY(memchr) /* (void *s, uchar_t c, size_t n) */
-	movl	%esi, %eax	/ move "c" to %eax
-	cmpq	$4, %rdx	/ if number of bytes < 4
-	jb	.L1		/ goto .L1
-	testq	$3, %rdi	/ if %rdi not word aligned
-	jnz	.L2		/ goto .L2
-	.align	4
-.L3:
-	movl	(%rdi), %ecx	/ move 1 word from (%rdi) to %ecx
-	cmpb	%cl, %al	/ if the first byte is %al
-	je	.L4		/ goto .L4 (found)
-	cmpb	%ch, %al	/ if the second byte is %al
-	je	.L5		/ goto .L5 (found)
-	shrl	$16, %ecx	/ right shift 16-bit
-	cmpb	%cl, %al	/ if the third byte is %al
-	je	.L6		/ goto .L6 (found)
-	cmpb	%ch, %al	/ if the fourth is %al
-	je	.L7		/ goto .L7 (found)
-	subq	$4, %rdx	/ decrement number of bytes by 4
-	addq	$4, %rdi	/ next word
-	cmpq	$4, %rdx	/ if number of bytes >= 4
-	jae	.L3		/ goto .L3
-.L1:
-	cmpq	$0, %rdx	/ if number of bytes == 0
-	jz	.L8		/ goto .L8 (not found)
-	cmpb	(%rdi), %al	/ if a byte in (%rdi) is %al
-	je	.L4		/ goto .L4 (found)
-	decq	%rdx		/ decrement number of bytes by 1
-	incq	%rdi		/ next byte
-	jmp	.L1		/ goto .L1
-	.align	4
-.L8:	
-	xorl	%eax, %eax	/ not found
-	ret			/ return (0)
-	.align	4
-.L2:
-	cmpq	$0, %rdx	/ if number of bytes == 0
-	jz	.L8		/ goto .L8 (not found)
-	cmpb	(%rdi), %al	/ if a byte in (%rdi) is %al
-	je	.L4		/ goto .L4 (found)
-	incq	%rdi		/ next byte
-	decq	%rdx		/ decrement number of bytes by 1
-	testq	$3, %rdi	/ if %rdi not word aligned
-	jnz	.L2		/ goto .L2
-	cmpq	$4, %rdx	/ if number of bytes >= 4
-	jae	.L3		/ goto .L3 (word aligned)
-	jmp	.L1		/ goto .L1
-	.align	4
-.L7:
-	/ found at the fourth byte	
-	incq	%rdi
-.L6:
-	/ found at the third byte
-	incq	%rdi
-.L5:
-	/ found at the second byte	
-	incq	%rdi
-.L4:
-	/ found at the first byte	
-	movq	%rdi,%rax
-	ret			 
+LABEL(avx2_found):
+	bsf	%eax, %eax
+	add	%rsi, %rax
+	vzeroupper
+	ret
 	SET_SIZE(memchr)
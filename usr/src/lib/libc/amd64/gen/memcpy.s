@@ -936,6 +936,21 @@ L(ck_use_sse2):
 	jnz    L(ShrtAlignNew)
 
 L(now_qw_aligned):
+	/*
+	 * With enhanced rep movsb, use it for sizes from 2K up to half of
+	 * the highest level cache size. Larger moves use non-temporal stores
+	 * below.
+	 */
+	testl  $VEC_ERMS,.vecops_method(%rip)
+	jz     L(ck_memops)
+	cmp    $0x800,%r8
+	jl     L(ck_memops)
+	mov    .largest_level_cache_size(%rip),%r9d
+	shr    %r9		# take half of it
+	cmp    %r9,%r8
+	jle    L(use_erms)
+
+L(ck_memops):
 	cmpl   $NO_SSE,.memops_method(%rip) 
 	je     L(Loop8byte_pre)
 
@@ -2335,6 +2350,18 @@ L(use_rep):
 	jnz    L(byte8_end)
 	ret
 
+	/*
+	 * Use rep movsb if supported
+	 */
+	.balign	16
+L(use_erms):
+	mov    %rdx,%rsi		# %rsi = source
+	mov    %rcx,%rdi		# %rdi = destination
+	mov    %r8,%rcx			# %rcx = count
+	rep
+	  movsb
+	ret
+
 	.balign 16               
 L(byte8_nt_top):                           
 	sub    $0x40,%r8
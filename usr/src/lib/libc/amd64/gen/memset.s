@@ -86,6 +86,10 @@
  *
  *	Finish any remaining bytes via unrolled code above.
  * }
+ *
+ * If the CPU has enhanced rep movsb/stosb (VEC_ERMS), sizes between 2K and
+ * the largest level cache size are done with rep stosb after the
+ * destination has been aligned, regardless of vendor.
  */
 
 		ENTRY(memset)		# (void *, const void*, size_t)
@@ -536,6 +540,19 @@ L(A6Q0):	mov    %dx,-0x6(%rdi)
 
 		.balign 16
 L(aligned_now):
+		/*
+		 * With enhanced rep stosb, use it for sizes from 2K up to
+		 * the largest level cache size.
+		 */
+		testl  $VEC_ERMS,.vecops_method(%rip)
+		jz     L(ck_memops)
+		cmp    $0x800,%r8
+		jl     L(ck_memops)
+		mov    .largest_level_cache_size(%rip),%r9d
+		cmp    %r9,%r8
+		jle    L(use_erms)
+
+L(ck_memops):
 		/*
 		 * Check memops method
 		 */
@@ -921,6 +938,18 @@ L(use_rep):
 		jnz    1b
 		ret
 
+		/*
+		 * Use rep stosb for sizes > 2K if supported
+		 */
+		.balign 16
+L(use_erms):
+		movq   %r8,%rcx			# get size in bytes
+		xchg   %rax,%rdx
+		rep
+		  stosb
+		xchg   %rax,%rdx
+		ret
+
 		.balign 16
 L(Loop8byte_nt_move):
 		lea    -0x80(%r8),%r8		# 128
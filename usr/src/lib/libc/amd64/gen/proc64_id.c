@@ -29,6 +29,7 @@
  */
 
 #include <sys/types.h>
+#include <sys/auxv_386.h>
 #include "proc64_id.h"
 
 /*
@@ -162,6 +163,48 @@ get_amd_cache_info(void)
 	    largest_level_cache);
 }
 
+/*
+ * Vector and string instruction level, see proc64_vecops() and
+ * __proc64hwcap().
+ */
+static long vec_level = VEC_NONE;
+
+/*
+ * proc64_vecops()
+ *	Determine which vendor independent instructions can be used for memops
+ *	and strops. Only instructions that need no operating system support
+ *	are picked up here; see __proc64hwcap() for the others.
+ */
+static void
+proc64_vecops(void)
+{
+	struct cpuid_values cpuid_info;
+
+	__libc_get_cpuid(0, &cpuid_info, 0);
+	if (cpuid_info.eax < 7)
+		return;
+
+	__libc_get_cpuid(7, &cpuid_info, 0);
+	if (cpuid_info.ebx & CPUID_INTC_EBX_7_0_ENH_REP_MOV)
+		vec_level |= VEC_ERMS;
+
+	__set_vecops_method(vec_level);
+}
+
+/*
+ * __proc64hwcap()
+ *	Called with the AT_SUN_HWCAP2 aux vector entry once libc has found it.
+ *	Until then only baseline vector instructions are used.
+ */
+void
+__proc64hwcap(uint32_t hwcap2)
+{
+	if (hwcap2 & AV_386_2_AVX2)
+		vec_level |= VEC_AVX2;
+
+	__set_vecops_method(vec_level);
+}
+
 /*
  * proc64_id()
  *	Determine cache and SSE level to use for memops and strops specific to
@@ -173,6 +216,8 @@ __proc64id(void)
 	int use_sse = NO_SSE;
 	struct cpuid_values cpuid_info;
 
+	proc64_vecops();
+
 	__libc_get_cpuid(0, &cpuid_info, 0);
 
 	/*
@@ -48,6 +48,17 @@ extern "C" {
 #define	USE_SSE4_2	0x10	/* SSE 4.2 */
 #define	USE_BSF		0x20	/* USE BSF class of instructions */
 
+/*
+ * Defines to determine what vector and string instructions can be used for
+ * memops or strops, independent of the CPU vendor. These are kept apart from
+ * the memops method above, which selects code paths tuned for Intel CPUs.
+ * AVX2 requires the kernel to manage the YMM state, so it is taken from the
+ * hardware capabilities the kernel passes in the aux vector.
+ */
+#define	VEC_NONE	0x00	/* Default -- baseline instructions only */
+#define	VEC_AVX2	0x01	/* AVX2 (32-byte compares) */
+#define	VEC_ERMS	0x02	/* Enhanced rep movsb/stosb */
+
 /*
  * Cache size defaults for Core 2 Duo
  */
@@ -63,10 +74,13 @@ extern "C" {
 
 #ifdef _ASM
 	.extern .memops_method
+	.extern .vecops_method
 #else
 
 void __libc_get_cpuid(int cpuid_function, void *out_reg, int cache_index);
 void __intel_set_memops_method(long sse_level);
+void __set_vecops_method(long vec_level);
+void __proc64hwcap(uint32_t hwcap2);
 void __set_cache_sizes(long l1_cache_size, long l2_cache_size,
     long largest_level_cache);
 
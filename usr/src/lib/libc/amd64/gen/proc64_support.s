@@ -41,7 +41,7 @@
 #include <sys/asm_linkage.h>
 #include "proc64_id.h"
 
-	.global .memops_method
+	.global .memops_method, .vecops_method
 	.global .amd64cache1, .amd64cache1half, .amd64cache2, .amd64cache2half
 	.global .largest_level_cache_size
 
@@ -54,6 +54,10 @@
 .memops_method:
 	.int	NO_SSE
 
+	.balign	8
+.vecops_method:
+	.int	VEC_NONE
+
 	.balign	8
 .amd64cache1:	.quad	AMD_DFLT_L1_CACHE_SIZE
 .amd64cache1half: .quad	AMD_DFLT_L1_CACHE_SIZE/2
@@ -91,6 +95,15 @@
 	ret
 	SET_SIZE(__intel_set_memops_method)
 
+/*
+ * Set vector and string instruction level to use.
+ * void __set_vecops_method(long vec_level);
+ */
+	ENTRY(__set_vecops_method)
+	mov	%edi,.vecops_method(%rip)
+	ret
+	SET_SIZE(__set_vecops_method)
+
 /*
  * Set cache info global variables used by various libc primitives.
  * __set_cache_sizes(long l1_cache_size, long l2_cache_size,
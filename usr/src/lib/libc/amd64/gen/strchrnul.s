@@ -0,0 +1,113 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+	.file	"strchrnul.s"
+
+/*
+ * strchrnul(s, c)
+ *
+ * Returns a pointer to the first occurrence of c in s, or to the
+ * terminating null char if there is none. Unlike the portable version,
+ * which calls strchr() and then strlen(), this looks for both c and the
+ * null char in a single pass, 16 bytes at a time using SSE2 or 32 bytes
+ * at a time using AVX2. Loads are aligned so that they never cross a page
+ * boundary.
+ */
+
+#include "SYS.h"
+#include "proc64_id.h"
+
+#define	LABEL(s) .strchrnul/**/s
+
+	ENTRY(strchrnul)	/* (const char *s, int c) */
+	testl	$VEC_AVX2, .vecops_method(%rip)
+	jnz	LABEL(avx2)
+
+	movd	%esi, %xmm0
+	punpcklbw %xmm0, %xmm0
+	punpcklwd %xmm0, %xmm0
+	pshufd	$0, %xmm0, %xmm0	/* c in all 16 bytes */
+	pxor	%xmm1, %xmm1		/* 16 null chars */
+
+	mov	%rdi, %rsi
+	and	$-16, %rsi		/* round down to 16-byte boundary */
+	mov	%edi, %ecx
+	and	$15, %ecx		/* bytes preceding the string */
+	movdqa	(%rsi), %xmm2
+	movdqa	%xmm2, %xmm3
+	pcmpeqb	%xmm0, %xmm2
+	pcmpeqb	%xmm1, %xmm3
+	por	%xmm3, %xmm2
+	pmovmskb %xmm2, %eax
+	shr	%cl, %eax		/* skip bytes preceding string */
+	test	%eax, %eax
+	jz	LABEL(loop)
+	bsf	%eax, %eax
+	add	%rdi, %rax
+	ret
+
+	.p2align 4
+LABEL(loop):
+	add	$16, %rsi
+	movdqa	(%rsi), %xmm2
+	movdqa	%xmm2, %xmm3
+	pcmpeqb	%xmm0, %xmm2
+	pcmpeqb	%xmm1, %xmm3
+	por	%xmm3, %xmm2
+	pmovmskb %xmm2, %eax
+	test	%eax, %eax
+	jz	LABEL(loop)
+	bsf	%eax, %eax
+	add	%rsi, %rax
+	ret
+
+	.p2align 4
+LABEL(avx2):
+	vmovd	%esi, %xmm0
+	vpbroadcastb %xmm0, %ymm0	/* c in all 32 bytes */
+	vpxor	%xmm1, %xmm1, %xmm1	/* 32 null chars */
+
+	mov	%rdi, %rsi
+	and	$-32, %rsi		/* round down to 32-byte boundary */
+	mov	%edi, %ecx
+	and	$31, %ecx		/* bytes preceding the string */
+	vmovdqa	(%rsi), %ymm2
+	vpcmpeqb %ymm0, %ymm2, %ymm3
+	vpcmpeqb %ymm1, %ymm2, %ymm2
+	vpor	%ymm3, %ymm2, %ymm2
+	vpmovmskb %ymm2, %eax
+	shr	%cl, %eax		/* skip bytes preceding string */
+	test	%eax, %eax
+	jz	LABEL(avx2_loop)
+	bsf	%eax, %eax
+	add	%rdi, %rax
+	vzeroupper
+	ret
+
+	.p2align 4
+LABEL(avx2_loop):
+	add	$32, %rsi
+	vmovdqa	(%rsi), %ymm2
+	vpcmpeqb %ymm0, %ymm2, %ymm3
+	vpcmpeqb %ymm1, %ymm2, %ymm2
+	vpor	%ymm3, %ymm2, %ymm2
+	vpmovmskb %ymm2, %eax
+	test	%eax, %eax
+	jz	LABEL(avx2_loop)
+	bsf	%eax, %eax
+	add	%rsi, %rax
+	vzeroupper
+	ret
+	SET_SIZE(strchrnul)
@@ -35,9 +35,13 @@
 
 	/*
 	 * This implementation uses SSE instructions to compare up to 16 bytes
-	 * at a time looking for the end of string (null char).
+	 * at a time looking for the end of string (null char). With AVX2, 32
+	 * bytes are compared at a time and 128 bytes per loop iteration.
 	 */
 	ENTRY(strlen)			/* (const char *s) */
+	testl	$VEC_AVX2, .vecops_method(%rip)
+	jnz	LABEL(avx2)
+
 	mov	%rdi, %rsi		/* keep original %rdi value */
 	mov	%rsi, %rcx
 	pxor	%xmm0, %xmm0		/* 16 null chars */
@@ -196,4 +200,81 @@ LABEL(exit_tail5):
 LABEL(exit_tail6):
 	add	$6, %rax
 	ret
+
+	/*
+	 * AVX2 version. All loads are 32-byte aligned so that they never
+	 * cross a page boundary. The main loop reads 128 bytes at a time,
+	 * so first step 32 bytes at a time until we are 128-byte aligned.
+	 */
+	.p2align 4
+LABEL(avx2):
+	mov	%rdi, %rsi
+	and	$-32, %rsi		/* round down to 32-byte boundary */
+	mov	%edi, %ecx
+	and	$31, %ecx		/* bytes preceding the string */
+	vpxor	%xmm0, %xmm0, %xmm0	/* 32 null chars */
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %edx
+	shr	%cl, %edx		/* skip bytes preceding the string */
+	test	%edx, %edx
+	jz	LABEL(avx2_align)
+	bsf	%edx, %eax
+	vzeroupper
+	ret
+
+	.p2align 4
+LABEL(avx2_align):
+	add	$32, %rsi
+	test	$127, %rsi
+	jz	LABEL(avx2_loop)
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %edx
+	test	%edx, %edx
+	jz	LABEL(avx2_align)
+	jmp	LABEL(avx2_exit)
+
+	.p2align 4
+LABEL(avx2_loop):			/* 128 byte aligned */
+	vmovdqa	(%rsi), %ymm1
+	vpminub	32(%rsi), %ymm1, %ymm2	/* a null byte is the minimum */
+	vmovdqa	64(%rsi), %ymm3
+	vpminub	96(%rsi), %ymm3, %ymm4
+	vpminub	%ymm2, %ymm4, %ymm5
+	vpcmpeqb %ymm0, %ymm5, %ymm5
+	vpmovmskb %ymm5, %edx
+	test	%edx, %edx
+	jnz	LABEL(avx2_found)
+	sub	$-128, %rsi
+	jmp	LABEL(avx2_loop)
+
+	/*
+	 * There is a null char in the last 128 bytes, find the first 32-byte
+	 * block that has it.
+	 */
+	.p2align 4
+LABEL(avx2_found):
+	vpcmpeqb %ymm0, %ymm1, %ymm1
+	vpmovmskb %ymm1, %edx
+	test	%edx, %edx
+	jnz	LABEL(avx2_exit)
+	add	$32, %rsi
+	vpcmpeqb %ymm0, %ymm2, %ymm2	/* min of the first two blocks */
+	vpmovmskb %ymm2, %edx
+	test	%edx, %edx
+	jnz	LABEL(avx2_exit)
+	add	$32, %rsi
+	vpcmpeqb %ymm0, %ymm3, %ymm3
+	vpmovmskb %ymm3, %edx
+	test	%edx, %edx
+	jnz	LABEL(avx2_exit)
+	add	$32, %rsi
+	vpcmpeqb (%rsi), %ymm0, %ymm1
+	vpmovmskb %ymm1, %edx
+
+LABEL(avx2_exit):
+	bsf	%edx, %edx		/* index of null in this block */
+	sub	%rdi, %rsi
+	lea	(%rsi, %rdx), %rax
+	vzeroupper
+	ret
 	SET_SIZE(strlen)
@@ -125,6 +125,14 @@ typedef unsigned char	Uchar;
 /* minimum buffer size must be at least 8 or shared library will break */
 #define	_SMBFSZ	(((PUSHBACK + 4) < 8) ? 8 : (PUSHBACK + 4))
 
+/*
+ * Buffers for regular files and pipes are at least _LGBFSZ bytes. The
+ * _STDIO_BUFSIZE environment variable overrides the size of all buffers
+ * that are allocated for file descriptors, up to _MAXBFSZ bytes.
+ */
+#define	_LGBFSZ		(64 * 1024)
+#define	_MAXBFSZ	(16 * 1024 * 1024)
+
 #if BUFSIZ == 1024
 #define	MULTIBFSZ(SZ)	((SZ) & ~0x3ff)
 #elif BUFSIZ == 512
@@ -31,22 +31,38 @@
 
 #include "lint.h"
 #include <string.h>
+#include <limits.h>
 #include <sys/types.h>
+#include <sys/bitmap.h>
 
 /*
  * Return the number of characters in the maximum leading segment
  * of string which consists solely of characters NOT from charset.
+ *
+ * Rather than scanning charset for every character of string, the
+ * characters of charset are entered into a bitmap first. A single
+ * character charset is left to strchrnul().
  */
 size_t
 strcspn(const char *string, const char *charset)
 {
-	const char *p, *q;
-
-	for (q = string; *q != '\0'; ++q) {
-		for (p = charset; *p != '\0' && *p != *q; ++p)
-			;
-		if (*p != '\0')
-			break;
-	}
-	return (q - string);
+	const uchar_t *q = (const uchar_t *)string;
+	const uchar_t *p = (const uchar_t *)charset;
+	ulong_t map[BT_BITOUL(UCHAR_MAX + 1)] = { 0 };
+
+	if (p[0] == '\0')
+		return (strlen(string));
+
+	if (p[1] == '\0')
+		return (strchrnul(string, p[0]) - string);
+
+	for (; *p != '\0'; p++)
+		BT_SET(map, *p);
+
+	/* Always stop at the null char */
+	BT_SET(map, 0);
+	while (!BT_TEST(map, *q))
+		q++;
+
+	return (q - (const uchar_t *)string);
 }
@@ -41,14 +41,7 @@
 char *
 strpbrk(const char *string, const char *brkset)
 {
-	const char *p;
+	string += strcspn(string, brkset);
 
-	do {
-		for (p = brkset; *p != '\0' && *p != *string; ++p)
-			;
-		if (*p != '\0')
-			return ((char *)string);
-	} while (*string++);
-
-	return (NULL);
+	return (*string != '\0' ? (char *)string : NULL);
 }
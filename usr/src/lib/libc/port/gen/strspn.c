@@ -31,22 +31,39 @@
 
 #include "lint.h"
 #include <string.h>
+#include <limits.h>
 #include <sys/types.h>
+#include <sys/bitmap.h>
 
 /*
  * Return the number of characters in the maximum leading segment
  * of string which consists solely of characters from charset.
+ *
+ * Rather than scanning charset for every character of string, the
+ * characters of charset are entered into a bitmap first.
  */
 size_t
 strspn(const char *string, const char *charset)
 {
-	const char *p, *q;
+	const uchar_t *q = (const uchar_t *)string;
+	const uchar_t *p = (const uchar_t *)charset;
+	ulong_t map[BT_BITOUL(UCHAR_MAX + 1)] = { 0 };
+
+	if (p[0] == '\0')
+		return (0);
 
-	for (q = string; *q != '\0'; ++q) {
-		for (p = charset; *p != '\0' && *p != *q; ++p)
-			;
-		if (*p == '\0')
-			break;
+	if (p[1] == '\0') {
+		while (*q == p[0])
+			q++;
+		return (q - (const uchar_t *)string);
 	}
-	return (q - string);
+
+	for (; *p != '\0'; p++)
+		BT_SET(map, *p);
+
+	/* The null char is never in the map */
+	while (BT_TEST(map, *q))
+		q++;
+
+	return (q - (const uchar_t *)string);
 }
@@ -42,6 +42,33 @@
 #include <sys/stat.h>
 #include "stdiom.h"
 
+/*
+ * Buffer size requested through the environment, 0 if there is none or
+ * -1 if the environment has not been looked at yet.
+ */
+static int _bufsize_env = -1;
+
+static int
+_getbufsize_env(void)
+{
+	const char *str;
+	long size = 0;
+
+	if (_bufsize_env != -1)
+		return (_bufsize_env);
+
+	if ((str = getenv("_STDIO_BUFSIZE")) != NULL) {
+		size = strtol(str, NULL, 0);
+		if (size < BUFSIZ)
+			size = 0;
+		else if (size > _MAXBFSZ)
+			size = _MAXBFSZ;
+	}
+	_bufsize_env = (int)size;
+
+	return (_bufsize_env);
+}
+
 /*
  * If buffer space has been pre-allocated use it otherwise malloc space.
  * PUSHBACK causes the base pointer to be bumped forward. At least 4 bytes
@@ -77,12 +104,22 @@ _findbuf(FILE *iop)
 		 * The operating system can tell us the right size for a buffer;
 		 * avoid 0-size buffers as returned for some special files
 		 * (doors). Use the default buffer size for memory streams.
+		 * Regular files and pipes are mostly read and written
+		 * sequentially, so use large buffers to cut down on the number
+		 * of system calls.
 		 */
 		struct stat64 stbuf;
 
-		if (fd != -1 && fstat64(fd, &stbuf) == 0 && stbuf.st_blksize >
-		    0) {
+		if (fd != -1 && _getbufsize_env() != 0) {
+			size = _bufsize_env;
+		} else if (fd != -1 && fstat64(fd, &stbuf) == 0 &&
+		    stbuf.st_blksize > 0) {
 			size = stbuf.st_blksize;
+			if ((S_ISREG(stbuf.st_mode) ||
+			    S_ISFIFO(stbuf.st_mode)) && size < _LGBFSZ)
+				size = _LGBFSZ;
+			else if (size > _MAXBFSZ)
+				size = _MAXBFSZ;
 		}
 
 		if ((buf = (Uchar *)malloc(sizeof (Uchar)*(size+_SMBFSZ))) !=
@@ -43,6 +43,39 @@
 #include "stdiom.h"
 #include "mse.h"
 
+/*
+ * Read a request that is at least as large as the stream buffer straight
+ * into the caller's buffer, rather than copying it through the stream
+ * buffer in buffer sized chunks. The stream buffer must be empty. Returns
+ * the number of bytes read.
+ */
+static ssize_t
+_fread_direct(FILE *iop, char *dptr, ssize_t s)
+{
+	ssize_t res, n = 0;
+
+	/* As in _filbuf() */
+	if (iop->_flag & (_IONBF | _IOLBF))
+		_flushlbf();
+
+	iop->_ptr = iop->_base;
+	iop->_cnt = 0;
+
+	while (n < s) {
+		if ((res = _xread(iop, dptr + n, (size_t)(s - n))) > 0) {
+			n += res;
+			continue;
+		}
+		if (res == 0)
+			iop->_flag |= _IOEOF;
+		else if (!cancel_active())
+			iop->_flag |= _IOERR;
+		break;
+	}
+
+	return (n);
+}
+
 size_t
 fread(void *ptr, size_t size, size_t count, FILE *iop)
 {
@@ -84,6 +117,11 @@ fread(void *ptr, size_t size, size_t count, FILE *iop)
 				dptr += iop->_cnt;
 				s -= iop->_cnt;
 			}
+			if (iop->_base != NULL && (iop->_flag & _IOREAD) &&
+			    s >= _bufend(iop) - iop->_base) {
+				s -= _fread_direct(iop, dptr, s);
+				break;
+			}
 			/*
 			 * filbuf clobbers _cnt & _ptr,
 			 * so don't waste time setting them.
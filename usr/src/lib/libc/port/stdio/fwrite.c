@@ -43,6 +43,30 @@
 size_t
 _fwrite_unlocked(const void *ptr, size_t size, size_t count, FILE *iop);
 
+/*
+ * Write a request that is at least as large as the stream buffer straight
+ * from the caller's buffer, rather than copying it through the stream
+ * buffer in buffer sized chunks. The stream buffer must be empty. Returns
+ * the number of bytes written.
+ */
+static ssize_t
+_fwrite_direct(FILE *iop, const unsigned char *dptr, ssize_t s)
+{
+	ssize_t n, written = 0;
+
+	while (written < s) {
+		if ((n = _xwrite(iop, dptr + written,
+		    (size_t)(s - written))) <= 0) {
+			if (!cancel_active())
+				iop->_flag |= _IOERR;
+			break;
+		}
+		written += n;
+	}
+
+	return (written);
+}
+
 size_t
 fwrite(const void *ptr, size_t size, size_t count, FILE *iop)
 {
@@ -138,6 +162,12 @@ _fwrite_unlocked(const void *ptr, size_t size, size_t count, FILE *iop)
 		written += n;
 		return (written / size);
 	} else while (s > 0) {
+		if (s >= _bufend(iop) - iop->_base) {
+			if (iop->_ptr != iop->_base && _xflsbuf(iop) == EOF)
+				break;
+			s -= _fwrite_direct(iop, dptr, s);
+			break;
+		}
 		if (iop->_cnt < s) {
 			if (iop->_cnt > 0) {
 				(void) memcpy(iop->_ptr, (void *)dptr,
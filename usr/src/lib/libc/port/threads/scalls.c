@@ -38,6 +38,7 @@
 #include <sys/uio.h>
 #include <sys/file.h>
 #include <sys/door.h>
+#include <sys/syscall.h>
 
 /*
  * These leading-underbar symbols exist because mistakes were made
@@ -1114,6 +1115,15 @@ _so_recvmsg(int sock, struct msghdr *msg, int flags)
 	PERFORM(__so_recvmsg(sock, msg, flags))
 }
 
+int
+_so_recvmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+    struct timespec *timeout)
+{
+	int rv;
+
+	PERFORM(syscall(SYS_recvmmsg, sock, msgvec, vlen, flags, timeout))
+}
+
 int
 _so_send(int sock, const void *buf, size_t len, int flags)
 {
@@ -1132,6 +1142,14 @@ _so_sendmsg(int sock, const struct msghdr *msg, int flags)
 	PERFORM(__so_sendmsg(sock, msg, flags))
 }
 
+int
+_so_sendmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+	int rv;
+
+	PERFORM(syscall(SYS_sendmmsg, sock, msgvec, vlen, flags))
+}
+
 int
 _so_sendto(int sock, const void *buf, size_t len, int flags,
     const struct sockaddr *addr, int *addrlen)
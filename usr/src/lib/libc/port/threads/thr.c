@@ -1232,6 +1232,7 @@ extern void atfork_init(void);
 
 #ifdef __amd64
 extern void __proc64id(void);
+extern void __proc64hwcap(uint32_t);
 #endif
 
 static void
@@ -1252,6 +1253,15 @@ init_auxv_data(uberdata_t *udp)
 		case AT_SUN_COMMPAGE:
 			udp->ub_comm_page = args.dla_auxv->a_un.a_ptr;
 			break;
+#ifdef __amd64
+		case AT_SUN_HWCAP2:
+			/*
+			 * Enable the strfoo() and memfoo() variants that
+			 * need kernel support, such as AVX2.
+			 */
+			__proc64hwcap((uint32_t)args.dla_auxv->a_un.a_val);
+			break;
+#endif
 		}
 		args.dla_auxv++;
 	}
@@ -0,0 +1,209 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * brwlock, see uts/common/os/brwlock.c
+ *
+ * This follows the kernel implementation, so that consumers of these locks
+ * (e.g. in ZFS) can be exercised and benchmarked in user space. Without
+ * CPUs to speak of, each thread accounts its reads in the reader count
+ * selected by its thread ID.
+ */
+
+/* This is the API we're emulating */
+#include <sys/brwlock.h>
+
+#include <sys/debug.h>
+#include <sys/param.h>
+#include <sys/thread.h>
+#include <sys/kmem.h>
+#include <sys/atomic.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#define	BRW_CPU(l)	\
+	(&(l)->brw_cpu[(uintptr_t)_curthread() % (l)->brw_ncpu])
+
+static int64_t
+brw_readers(brwlock_t *l)
+{
+	int64_t readers = 0;
+	uint_t i;
+
+	for (i = 0; i < l->brw_ncpu; i++)
+		readers += l->brw_cpu[i].brc_readers;
+
+	return (readers);
+}
+
+static void
+brw_read_exit_cpu(brwlock_t *l)
+{
+	atomic_dec_64((uint64_t *)&BRW_CPU(l)->brc_readers);
+	membar_enter();
+
+	if (l->brw_writer != 0) {
+		mutex_enter(&l->brw_wlock);
+		cv_broadcast(&l->brw_wcv);
+		mutex_exit(&l->brw_wlock);
+	}
+}
+
+static int
+brw_enter_read(brwlock_t *l, int tryenter)
+{
+	atomic_inc_64((uint64_t *)&BRW_CPU(l)->brc_readers);
+	membar_enter();
+
+	if (l->brw_writer == 0)
+		return (1);
+
+	brw_read_exit_cpu(l);
+
+	if (tryenter) {
+		if (!rw_tryenter(&l->brw_lock, RW_READER))
+			return (0);
+	} else {
+		rw_enter(&l->brw_lock, RW_READER);
+	}
+	atomic_inc_64((uint64_t *)&BRW_CPU(l)->brc_readers);
+	rw_exit(&l->brw_lock);
+
+	return (1);
+}
+
+static int
+brw_enter_write(brwlock_t *l, int tryenter)
+{
+	if (tryenter) {
+		if (!rw_tryenter(&l->brw_lock, RW_WRITER))
+			return (0);
+	} else {
+		rw_enter(&l->brw_lock, RW_WRITER);
+	}
+
+	l->brw_writer = 1;
+	membar_enter();
+
+	mutex_enter(&l->brw_wlock);
+	while (brw_readers(l) != 0) {
+		if (tryenter) {
+			mutex_exit(&l->brw_wlock);
+			l->brw_writer = 0;
+			rw_exit(&l->brw_lock);
+			return (0);
+		}
+		cv_wait(&l->brw_wcv, &l->brw_wlock);
+	}
+	mutex_exit(&l->brw_wlock);
+
+	l->brw_owner = _curthread();
+	membar_enter();
+
+	return (1);
+}
+
+void
+brw_enter(brwlock_t *l, krw_t rw)
+{
+	if (rw == RW_WRITER) {
+		(void) brw_enter_write(l, 0);
+	} else {
+		(void) brw_enter_read(l, 0);
+	}
+}
+
+int
+brw_tryenter(brwlock_t *l, krw_t rw)
+{
+	if (rw == RW_WRITER)
+		return (brw_enter_write(l, 1));
+
+	return (brw_enter_read(l, 1));
+}
+
+void
+brw_exit(brwlock_t *l)
+{
+	if (l->brw_owner == _curthread()) {
+		l->brw_owner = NULL;
+		membar_exit();
+		l->brw_writer = 0;
+		rw_exit(&l->brw_lock);
+	} else {
+		membar_exit();
+		brw_read_exit_cpu(l);
+	}
+}
+
+int
+brw_read_held(brwlock_t *l)
+{
+	return (brw_readers(l) > 0);
+}
+
+int
+brw_write_held(brwlock_t *l)
+{
+	return (l->brw_owner == _curthread());
+}
+
+int
+brw_lock_held(brwlock_t *l)
+{
+	return (brw_write_held(l) || brw_read_held(l));
+}
+
+/*
+ * Return the kthread_t * of the lock owner
+ */
+struct _kthread *
+brw_owner(brwlock_t *l)
+{
+	return (l->brw_owner);
+}
+
+/*ARGSUSED*/
+void
+brw_init(brwlock_t *l, char *name, krw_type_t type, void *arg)
+{
+	long ncpu;
+
+	if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		ncpu = 1;
+	l->brw_ncpu = (uint_t)ncpu;
+	l->brw_size = l->brw_ncpu * sizeof (brw_cpu_t) + sizeof (brw_cpu_t);
+	l->brw_base = kmem_zalloc(l->brw_size, KM_SLEEP);
+	l->brw_cpu = (brw_cpu_t *)P2ROUNDUP((uintptr_t)l->brw_base,
+	    sizeof (brw_cpu_t));
+	l->brw_writer = 0;
+	l->brw_owner = NULL;
+	rw_init(&l->brw_lock, name, type, arg);
+	mutex_init(&l->brw_wlock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&l->brw_wcv, NULL, CV_DEFAULT, NULL);
+}
+
+void
+brw_destroy(brwlock_t *l)
+{
+	ASSERT(l->brw_owner == NULL);
+	ASSERT(brw_readers(l) == 0);
+	rw_destroy(&l->brw_lock);
+	mutex_destroy(&l->brw_wlock);
+	cv_destroy(&l->brw_wcv);
+	kmem_free(l->brw_base, l->brw_size);
+	l->brw_base = NULL;
+	l->brw_cpu = NULL;
+}
@@ -50,8 +50,10 @@
 #pragma weak recv = _recv
 #pragma weak recvfrom = _recvfrom
 #pragma weak recvmsg = _recvmsg
+#pragma weak recvmmsg = _recvmmsg
 #pragma weak send = _send
 #pragma weak sendmsg = _sendmsg
+#pragma weak sendmmsg = _sendmmsg
 #pragma weak sendto = _sendto
 #pragma weak getpeername = _getpeername
 #pragma weak getsockname = _getsockname
@@ -66,8 +68,10 @@ extern int _so_shutdown();
 extern int _so_recv();
 extern int _so_recvfrom();
 extern int _so_recvmsg();
+extern int _so_recvmmsg();
 extern int _so_send();
 extern int _so_sendmsg();
+extern int _so_sendmmsg();
 extern int _so_sendto();
 extern int _so_getpeername();
 extern int _so_getsockopt();
@@ -134,6 +138,14 @@ _recvmsg(int sock, struct msghdr *msg, int flags)
 	return (_so_recvmsg(sock, msg, flags & ~MSG_XPG4_2));
 }
 
+int
+_recvmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+    struct timespec *timeout)
+{
+	return (_so_recvmmsg(sock, msgvec, vlen, flags & ~MSG_XPG4_2,
+	    timeout));
+}
+
 ssize_t
 _send(int sock, const void *buf, size_t len, int flags)
 {
@@ -146,6 +158,12 @@ _sendmsg(int sock, const struct msghdr *msg, int flags)
 	return (_so_sendmsg(sock, msg, flags & ~MSG_XPG4_2));
 }
 
+int
+_sendmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+	return (_so_sendmmsg(sock, msgvec, vlen, flags & ~MSG_XPG4_2));
+}
+
 ssize_t
 _sendto(int sock, const void *buf, size_t len, int flags,
     const struct sockaddr *addr, socklen_t addrlen)
@@ -242,12 +260,27 @@ __xnet_recvmsg(int sock, struct msghdr *msg, int flags)
 	return (_so_recvmsg(sock, msg, flags | MSG_XPG4_2));
 }
 
+int
+__xnet_recvmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen,
+    int flags, struct timespec *timeout)
+{
+	return (_so_recvmmsg(sock, msgvec, vlen, flags | MSG_XPG4_2,
+	    timeout));
+}
+
 int
 __xnet_sendmsg(int sock, const struct msghdr *msg, int flags)
 {
 	return (_so_sendmsg(sock, msg, flags | MSG_XPG4_2));
 }
 
+int
+__xnet_sendmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen,
+    int flags)
+{
+	return (_so_sendmmsg(sock, msgvec, vlen, flags | MSG_XPG4_2));
+}
+
 int
 __xnet_sendto(int sock, const void *buf, size_t len, int flags,
     const struct sockaddr *addr, socklen_t addrlen)
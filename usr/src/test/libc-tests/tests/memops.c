@@ -0,0 +1,403 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Test the string and memory routines that have optimized, machine specific
+ * implementations against simple reference versions, for a range of sizes
+ * and alignments. Buffers are placed right in front of an unmapped page, so
+ * that reading beyond the end of a string or buffer is caught.
+ *
+ * With -b, this instead benchmarks the routines and prints the time per
+ * call and the throughput for each size and alignment.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define	MAXLEN		512	/* lengths tested exhaustively */
+#define	MAXALIGN	64	/* alignments tested exhaustively */
+#define	BUFSIZE		(4 * 1024 * 1024)
+
+static size_t pagesize;
+static uint_t failures;
+
+static const size_t large_sizes[] = {
+	1000, 2047, 2048, 4095, 4096, 10000, 65536, 100003, 1024 * 1024
+};
+
+static const size_t bench_sizes[] = {
+	8, 16, 32, 64, 128, 256, 512, 1024, 4096, 16384, 65536,
+	256 * 1024, 1024 * 1024, 4 * 1024 * 1024
+};
+
+static const size_t bench_aligns[] = { 0, 1, 15, 31 };
+
+/*
+ * Allocate a buffer of the given size that is directly followed by an
+ * unmapped page.
+ */
+static uchar_t *
+guarded_alloc(size_t size)
+{
+	size_t len = P2ROUNDUP(size, pagesize);
+	uchar_t *buf;
+
+	buf = mmap(NULL, len + pagesize, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (buf == MAP_FAILED)
+		err(EXIT_FAILURE, "failed to map buffer");
+	if (mprotect(buf + len, pagesize, PROT_NONE) != 0)
+		err(EXIT_FAILURE, "failed to protect guard page");
+
+	return (buf + len - size);
+}
+
+static void
+fill(uchar_t *buf, size_t len)
+{
+	size_t i;
+
+	/* Never a null char, so callers control where strings end */
+	for (i = 0; i < len; i++)
+		buf[i] = 1 + arc4random_uniform(255);
+}
+
+static void
+fail(const char *func, size_t len, size_t align, const char *what)
+{
+	warnx("TEST FAILED: %s: len %zu align %zu: %s", func, len, align,
+	    what);
+	failures++;
+}
+
+static size_t
+ref_strspn(const uchar_t *s, const uchar_t *set, boolean_t in)
+{
+	size_t len;
+
+	for (len = 0; s[len] != '\0'; len++) {
+		boolean_t found = B_FALSE;
+		const uchar_t *p;
+
+		for (p = set; *p != '\0'; p++) {
+			if (*p == s[len])
+				found = B_TRUE;
+		}
+		if (found != in)
+			break;
+	}
+	return (len);
+}
+
+/*
+ * Strings of each length and alignment, ending right before the guard page.
+ */
+static void
+test_str(uchar_t *end)
+{
+	size_t len, align, n;
+	uchar_t set[5];
+
+	for (len = 0; len < MAXLEN; len++) {
+		for (align = 0; align < MAXALIGN; align++) {
+			uchar_t *s = end - len - 1 - align;
+			uchar_t c[2] = { 'x', '\0' };
+			char *exp;
+
+			fill(s, len);
+			s[len] = '\0';
+			if (len > 0)
+				c[0] = s[len / 2];
+			exp = (char *)s + ref_strspn(s, c, B_FALSE);
+
+			if (strlen((char *)s) != len)
+				fail("strlen", len, align, "wrong length");
+
+			if (strchrnul((char *)s, '\0') != (char *)s + len)
+				fail("strchrnul", len, align, "missed null");
+			if (strchrnul((char *)s, c[0]) != exp)
+				fail("strchrnul", len, align, "missed char");
+			if (strchr((char *)s, c[0]) !=
+			    (*exp != '\0' ? exp : NULL))
+				fail("strchr", len, align, "wrong result");
+
+			/* Sets of 0 to 4 chars taken from the string */
+			n = MIN(len, 4);
+			if (len % 3 == 0 && n > 1)
+				n = 1;
+			(void) memcpy(set, s + (len - n) / 2, n);
+			set[n] = '\0';
+			if (strspn((char *)s, (char *)set) !=
+			    ref_strspn(s, set, B_TRUE))
+				fail("strspn", len, align, "wrong result");
+			if (strcspn((char *)s, (char *)set) !=
+			    ref_strspn(s, set, B_FALSE))
+				fail("strcspn", len, align, "wrong result");
+		}
+	}
+}
+
+static void
+test_memchr(uchar_t *end)
+{
+	size_t len, align, pos;
+
+	for (len = 0; len < MAXLEN; len++) {
+		for (align = 0; align < MAXALIGN; align++) {
+			uchar_t *s = end - len - align;
+
+			fill(s, len + align);
+			(void) memset(s, 'a', len);
+
+			/* Matches beyond the end must be ignored */
+			if (align > 0)
+				s[len] = 'b';
+			if (memchr(s, 'b', len) != NULL)
+				fail("memchr", len, align, "false match");
+
+			for (pos = 0; pos < len; pos += 1 + pos / 8) {
+				s[pos] = 'b';
+				if (memchr(s, 'b', len) != s + pos)
+					fail("memchr", len, align, "missed");
+				if (memchr(s, 'b', SIZE_MAX) != s + pos)
+					fail("memchr", len, align,
+					    "missed, unbounded");
+				s[pos] = 'a';
+			}
+		}
+	}
+}
+
+static void
+check_memset(uchar_t *buf, size_t len, size_t align)
+{
+	uchar_t *d = buf + align;
+	size_t i;
+
+	(void) memset(buf, 0xa5, len + 2 * MAXALIGN);
+	if (memset(d, 0x5a, len) != d)
+		fail("memset", len, align, "wrong return value");
+
+	for (i = 0; i < len + 2 * MAXALIGN; i++) {
+		uchar_t expect = (i >= align && i < align + len) ? 0x5a : 0xa5;
+
+		if (buf[i] != expect) {
+			fail("memset", len, align, "wrong contents");
+			break;
+		}
+	}
+}
+
+static void
+check_memcpy(uchar_t *src, uchar_t *dst, size_t len, size_t salign,
+    size_t dalign)
+{
+	uchar_t *s = src + salign, *d = dst + dalign;
+
+	fill(src, len + 2 * MAXALIGN);
+	(void) memset(dst, 0, len + 2 * MAXALIGN);
+	if (memcpy(d, s, len) != d)
+		fail("memcpy", len, dalign, "wrong return value");
+	if (memcmp(d, s, len) != 0 || (dalign > 0 && d[-1] != 0) ||
+	    d[len] != 0)
+		fail("memcpy", len, dalign, "wrong contents");
+}
+
+static void
+check_memmove(uchar_t *buf, uchar_t *ref, size_t len, size_t salign,
+    size_t dalign)
+{
+	size_t i;
+
+	fill(buf, len + 2 * MAXALIGN);
+	(void) memcpy(ref, buf, len + 2 * MAXALIGN);
+	if (memmove(buf + dalign, buf + salign, len) != buf + dalign)
+		fail("memmove", len, dalign, "wrong return value");
+
+	/* Overlapping reference copy */
+	if (dalign < salign) {
+		for (i = 0; i < len; i++)
+			ref[dalign + i] = ref[salign + i];
+	} else {
+		for (i = len; i > 0; i--)
+			ref[dalign + i - 1] = ref[salign + i - 1];
+	}
+
+	if (memcmp(buf, ref, len + 2 * MAXALIGN) != 0)
+		fail("memmove", len, dalign, "wrong contents");
+}
+
+static void
+test_mem(uchar_t *buf1, uchar_t *buf2)
+{
+	size_t len, align, i;
+
+	for (len = 0; len < MAXLEN; len++) {
+		for (align = 0; align < MAXALIGN; align++) {
+			check_memset(buf1, len, align);
+			check_memcpy(buf1, buf2, len, align,
+			    (align * 7) % MAXALIGN);
+			check_memmove(buf1, buf2, len, align,
+			    (align * 5) % MAXALIGN);
+		}
+	}
+
+	for (i = 0; i < sizeof (large_sizes) / sizeof (large_sizes[0]); i++) {
+		len = large_sizes[i];
+		for (align = 0; align < 32; align += 7) {
+			check_memset(buf1, len, align);
+			check_memcpy(buf1, buf2, len, align, 31 - align);
+			check_memmove(buf1, buf2, len, align, 2 * align);
+			check_memmove(buf1, buf2, len, 2 * align, align);
+		}
+	}
+}
+
+/*
+ * Benchmarks. Each one is run for about a tenth of a second.
+ */
+typedef enum {
+	B_STRLEN,
+	B_STRCHRNUL,
+	B_STRSPN,
+	B_MEMCHR,
+	B_MEMSET,
+	B_MEMCPY,
+	B_MEMMOVE
+} bench_t;
+
+static const char *bench_names[] = {
+	"strlen", "strchrnul", "strspn", "memchr", "memset", "memcpy",
+	"memmove"
+};
+
+static volatile size_t bench_sink;
+
+static void
+bench_one(bench_t b, uchar_t *buf1, uchar_t *buf2, size_t len, size_t align)
+{
+	uchar_t *s = buf1 + align, *d = buf2 + align;
+	hrtime_t start, elapsed;
+	ulong_t i, iters = 16;
+
+	fill(buf1, len + align + 1);
+	(void) memset(s, 'a', len);
+	s[len] = '\0';
+
+	for (;;) {
+		start = gethrtime();
+		for (i = 0; i < iters; i++) {
+			switch (b) {
+			case B_STRLEN:
+				bench_sink += strlen((char *)s);
+				break;
+			case B_STRCHRNUL:
+				bench_sink +=
+				    (uintptr_t)strchrnul((char *)s, 'b');
+				break;
+			case B_STRSPN:
+				bench_sink += strspn((char *)s, "abc");
+				break;
+			case B_MEMCHR:
+				bench_sink += (uintptr_t)memchr(s, 'b', len);
+				break;
+			case B_MEMSET:
+				bench_sink += (uintptr_t)memset(d, i, len);
+				break;
+			case B_MEMCPY:
+				bench_sink += (uintptr_t)memcpy(d, s, len);
+				break;
+			case B_MEMMOVE:
+				bench_sink += (uintptr_t)memmove(s + 1, s, len);
+				break;
+			}
+		}
+		elapsed = gethrtime() - start;
+		if (elapsed > NANOSEC / 10)
+			break;
+		iters *= 2;
+	}
+
+	(void) printf("%-10s %8zu %5zu %12.1f %10.1f\n", bench_names[b], len,
+	    align, (double)elapsed / iters,
+	    (double)len * iters * NANOSEC / elapsed / (1024 * 1024));
+}
+
+static void
+bench(uchar_t *buf1, uchar_t *buf2)
+{
+	size_t s, a;
+	bench_t b;
+
+	(void) printf("%-10s %8s %5s %12s %10s\n", "FUNCTION", "SIZE",
+	    "ALIGN", "NS/CALL", "MB/S");
+
+	for (b = B_STRLEN; b <= B_MEMMOVE; b++) {
+		for (s = 0; s < sizeof (bench_sizes) / sizeof (size_t); s++) {
+			for (a = 0; a < sizeof (bench_aligns) /
+			    sizeof (size_t); a++) {
+				bench_one(b, buf1, buf2, bench_sizes[s],
+				    bench_aligns[a]);
+			}
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	uchar_t *buf1, *buf2;
+	boolean_t do_bench = B_FALSE;
+	int c;
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			do_bench = B_TRUE;
+			break;
+		default:
+			(void) fprintf(stderr, "Usage: %s [-b]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	pagesize = sysconf(_SC_PAGESIZE);
+
+	buf1 = guarded_alloc(BUFSIZE + 2 * MAXALIGN + 1);
+	buf2 = guarded_alloc(BUFSIZE + 2 * MAXALIGN + 1);
+
+	if (do_bench) {
+		bench(buf1, buf2);
+		return (EXIT_SUCCESS);
+	}
+
+	test_str(buf1 + BUFSIZE + 2 * MAXALIGN + 1);
+	test_memchr(buf1 + BUFSIZE + 2 * MAXALIGN + 1);
+	test_mem(buf1, buf2);
+
+	if (failures != 0)
+		errx(EXIT_FAILURE, "%u tests failed", failures);
+
+	(void) printf("TEST PASSED: string and memory routines\n");
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,285 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Test stdio with a mix of character, small and large (larger than the
+ * stream buffer) reads and writes, in each buffering mode. Large requests
+ * bypass the stream buffer, which must not change the data or the stream
+ * position.
+ *
+ * With -b, this instead measures the throughput of the various ways of
+ * reading and writing a file through stdio.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define	PATTERN(off)	((uint8_t)((off) * 7 + ((off) >> 12)))
+
+static const size_t chunks[] = {
+	1, 100, 1023, 1024, 4096, 65535, 65536, 65537, 200000, 3, 1048576
+};
+#define	NCHUNKS	(sizeof (chunks) / sizeof (chunks[0]))
+
+static uint8_t *buf;
+static size_t total;
+
+const char *
+_umem_debug_init(void)
+{
+	return ("default,verbose");
+}
+
+const char *
+_umem_logging_init(void)
+{
+	return ("fail,contents");
+}
+
+static void
+check_pos(FILE *f, off_t pos, const char *what)
+{
+	off_t off = ftello(f);
+
+	if (off != pos) {
+		errx(EXIT_FAILURE, "TEST FAILED: %s: ftello is %lld, "
+		    "expected %lld", what, (longlong_t)off, (longlong_t)pos);
+	}
+}
+
+static void
+write_file(FILE *f)
+{
+	size_t i, j;
+	off_t pos = 0;
+
+	for (i = 0; i < NCHUNKS; i++) {
+		for (j = 0; j < chunks[i]; j++)
+			buf[j] = PATTERN(pos + j);
+
+		if (i % 3 == 0) {
+			for (j = 0; j < chunks[i]; j++) {
+				if (putc(buf[j], f) == EOF)
+					err(EXIT_FAILURE, "putc failed");
+			}
+		} else if (fwrite(buf, 1, chunks[i], f) != chunks[i]) {
+			err(EXIT_FAILURE, "fwrite of %zu bytes failed",
+			    chunks[i]);
+		}
+		pos += chunks[i];
+		check_pos(f, pos, "write");
+	}
+
+	if (fflush(f) != 0)
+		err(EXIT_FAILURE, "fflush failed");
+}
+
+static void
+read_file(FILE *f)
+{
+	size_t i, j, n;
+	off_t pos = 0;
+	int c;
+
+	for (i = 0; i < NCHUNKS; i++) {
+		(void) memset(buf, 0, chunks[i]);
+
+		if (i % 4 == 1) {
+			for (j = 0; j < chunks[i]; j++) {
+				if ((c = getc(f)) == EOF)
+					errx(EXIT_FAILURE, "unexpected EOF");
+				buf[j] = c;
+			}
+		} else if (i % 4 == 2) {
+			/* Push back a character and read it again */
+			if ((c = getc(f)) == EOF || ungetc(c, f) != c)
+				errx(EXIT_FAILURE, "getc/ungetc failed");
+			if (fread(buf, 1, chunks[i], f) != chunks[i])
+				errx(EXIT_FAILURE, "short fread");
+		} else if ((n = fread(buf, 1, chunks[i], f)) != chunks[i]) {
+			errx(EXIT_FAILURE, "fread of %zu bytes returned %zu",
+			    chunks[i], n);
+		}
+
+		for (j = 0; j < chunks[i]; j++) {
+			if (buf[j] != PATTERN(pos + j)) {
+				errx(EXIT_FAILURE, "TEST FAILED: wrong data "
+				    "at offset %lld", (longlong_t)(pos + j));
+			}
+		}
+		pos += chunks[i];
+		check_pos(f, pos, "read");
+	}
+
+	/* A large read at the end of the file is short and sets EOF */
+	if ((n = fread(buf, 1, 1024 * 1024, f)) != 0 || !feof(f))
+		errx(EXIT_FAILURE, "TEST FAILED: read beyond end of file");
+}
+
+static void
+test_mode(int mode, size_t bufsize, const char *desc)
+{
+	FILE *f;
+
+	if ((f = tmpfile()) == NULL)
+		err(EXIT_FAILURE, "failed to create temporary file");
+	if (mode != -1 && setvbuf(f, NULL, mode, bufsize) != 0)
+		err(EXIT_FAILURE, "setvbuf failed");
+
+	write_file(f);
+	rewind(f);
+	read_file(f);
+
+	/* A short read at the end of a large request */
+	if (fseeko(f, total - 10, SEEK_SET) != 0)
+		err(EXIT_FAILURE, "fseeko failed");
+	clearerr(f);
+	if (fread(buf, 1, 1024 * 1024, f) != 10 || !feof(f) ||
+	    buf[9] != PATTERN(total - 1))
+		errx(EXIT_FAILURE, "TEST FAILED: short read at end of file");
+
+	(void) fclose(f);
+	(void) printf("TEST PASSED: %s\n", desc);
+}
+
+static void
+test_bufsize(void)
+{
+	FILE *f;
+
+	if ((f = tmpfile()) == NULL)
+		err(EXIT_FAILURE, "failed to create temporary file");
+	if (putc('a', f) == EOF)
+		err(EXIT_FAILURE, "putc failed");
+	if (__fbufsize(f) < 64 * 1024) {
+		errx(EXIT_FAILURE, "TEST FAILED: buffer of regular file is "
+		    "only %zu bytes", __fbufsize(f));
+	}
+	(void) fclose(f);
+	(void) printf("TEST PASSED: large buffer for regular file\n");
+}
+
+/*
+ * Benchmarks, each reading or writing a 256 MiB file.
+ */
+#define	BENCH_SIZE	(256 * 1024 * 1024)
+
+static void
+bench_report(const char *what, hrtime_t start)
+{
+	hrtime_t elapsed = gethrtime() - start;
+
+	(void) printf("%-24s %10.1f MB/s\n", what,
+	    (double)BENCH_SIZE * NANOSEC / elapsed / (1024 * 1024));
+}
+
+static void
+bench_write(FILE *f, size_t chunk, const char *what)
+{
+	hrtime_t start;
+	size_t i, j;
+
+	rewind(f);
+	start = gethrtime();
+	for (i = 0; i < BENCH_SIZE; i += chunk) {
+		if (chunk == 1) {
+			(void) putc(i, f);
+		} else if (chunk < 64) {
+			for (j = 0; j < chunk; j++)
+				(void) putc(buf[j], f);
+		} else {
+			(void) fwrite(buf, 1, chunk, f);
+		}
+	}
+	(void) fflush(f);
+	bench_report(what, start);
+}
+
+static void
+bench_read(FILE *f, size_t chunk, const char *what)
+{
+	volatile int sink = 0;
+	hrtime_t start;
+	size_t i;
+
+	rewind(f);
+	start = gethrtime();
+	for (i = 0; i < BENCH_SIZE; i += chunk) {
+		if (chunk == 1)
+			sink += getc(f);
+		else
+			(void) fread(buf, 1, chunk, f);
+	}
+	bench_report(what, start);
+}
+
+static void
+bench(void)
+{
+	FILE *f;
+
+	if ((f = tmpfile()) == NULL)
+		err(EXIT_FAILURE, "failed to create temporary file");
+	(void) memset(buf, 'a', 1024 * 1024);
+
+	bench_write(f, 1, "putc");
+	bench_read(f, 1, "getc");
+	bench_write(f, 128, "fwrite 128");
+	bench_read(f, 128, "fread 128");
+	bench_write(f, 4096, "fwrite 4k");
+	bench_read(f, 4096, "fread 4k");
+	bench_write(f, 1024 * 1024, "fwrite 1m");
+	bench_read(f, 1024 * 1024, "fread 1m");
+
+	(void) fclose(f);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t i;
+	int c;
+
+	for (i = 0; i < NCHUNKS; i++)
+		total += chunks[i];
+	if ((buf = malloc(1024 * 1024)) == NULL)
+		err(EXIT_FAILURE, "failed to allocate buffer");
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			bench();
+			return (EXIT_SUCCESS);
+		default:
+			(void) fprintf(stderr, "Usage: %s [-b]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	test_bufsize();
+	test_mode(-1, 0, "default buffering");
+	test_mode(_IOFBF, 512, "small full buffer");
+	test_mode(_IOFBF, 1024 * 1024, "large full buffer");
+	test_mode(_IOLBF, 4096, "line buffering");
+	test_mode(_IONBF, 0, "no buffering");
+
+	return (EXIT_SUCCESS);
+}
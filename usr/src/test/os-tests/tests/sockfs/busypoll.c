@@ -0,0 +1,200 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Test the SO_BUSY_POLL socket option: the value set is the value
+ * returned, negative values are refused, and a busy polling socket still
+ * receives data, whether it arrives while polling or after the poll has
+ * given up and the receiver has gone to sleep.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <err.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define	BUSY_USEC	50
+#define	NMSGS		100
+
+static int failures;
+
+static void
+fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fprintf(stderr, "FAIL: ");
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fprintf(stderr, "\n");
+	va_end(ap);
+	failures++;
+}
+
+static void
+check_opt(int sock, const char *name)
+{
+	int val = BUSY_USEC, neg = -1;
+	socklen_t optlen = sizeof (val);
+
+	if (setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &val,
+	    sizeof (val)) == -1) {
+		fail("%s: setsockopt: %s", name, strerror(errno));
+		return;
+	}
+	val = 0;
+	if (getsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &val, &optlen) == -1)
+		fail("%s: getsockopt: %s", name, strerror(errno));
+	else if (val != BUSY_USEC)
+		fail("%s: SO_BUSY_POLL read back as %d", name, val);
+
+	if (setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &neg,
+	    sizeof (neg)) != -1 || errno != EINVAL)
+		fail("%s: negative SO_BUSY_POLL not refused", name);
+}
+
+/*
+ * Send NMSGS messages, every other one after a pause long enough for the
+ * receiver's busy poll to have given up.
+ */
+static void *
+sender(void *arg)
+{
+	int sock = (int)(uintptr_t)arg;
+	uint32_t i;
+
+	for (i = 0; i < NMSGS; i++) {
+		if (i % 2 != 0)
+			(void) usleep(BUSY_USEC * 20);
+		if (send(sock, &i, sizeof (i), 0) != sizeof (i))
+			fail("send %u: %s", i, strerror(errno));
+	}
+	return (NULL);
+}
+
+static void
+receive(int snd, int rcv, const char *name)
+{
+	pthread_t tid;
+	uint32_t i, val;
+
+	if (pthread_create(&tid, NULL, sender, (void *)(uintptr_t)snd) != 0)
+		err(EXIT_FAILURE, "pthread_create");
+	for (i = 0; i < NMSGS; i++) {
+		if (recv(rcv, &val, sizeof (val), MSG_WAITALL) !=
+		    sizeof (val)) {
+			fail("%s: recv %u: %s", name, i, strerror(errno));
+			break;
+		}
+		if (val != i) {
+			fail("%s: received %u, expected %u", name, val, i);
+			break;
+		}
+	}
+	(void) pthread_join(tid, NULL);
+}
+
+static void
+test_tcp(void)
+{
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof (sin);
+	int lsock, snd, rcv, val = BUSY_USEC;
+
+	if ((lsock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	bzero(&sin, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(lsock, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "bind");
+	if (getsockname(lsock, (struct sockaddr *)&sin, &sinlen) == -1)
+		err(EXIT_FAILURE, "getsockname");
+	if (listen(lsock, 1) == -1)
+		err(EXIT_FAILURE, "listen");
+	if ((snd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	if (connect(snd, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "connect");
+	if ((rcv = accept(lsock, NULL, NULL)) == -1)
+		err(EXIT_FAILURE, "accept");
+
+	check_opt(rcv, "TCP");
+	if (setsockopt(rcv, SOL_SOCKET, SO_BUSY_POLL, &val,
+	    sizeof (val)) == -1) {
+		err(EXIT_FAILURE, "setsockopt SO_BUSY_POLL");
+	}
+	receive(snd, rcv, "TCP");
+
+	(void) close(snd);
+	(void) close(rcv);
+	(void) close(lsock);
+}
+
+static void
+test_udp(void)
+{
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof (sin);
+	int snd, rcv, val = BUSY_USEC;
+
+	if ((rcv = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	if ((snd = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	bzero(&sin, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(rcv, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "bind");
+	if (getsockname(rcv, (struct sockaddr *)&sin, &sinlen) == -1)
+		err(EXIT_FAILURE, "getsockname");
+	if (connect(snd, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "connect");
+
+	check_opt(rcv, "UDP");
+	if (setsockopt(rcv, SOL_SOCKET, SO_BUSY_POLL, &val,
+	    sizeof (val)) == -1) {
+		err(EXIT_FAILURE, "setsockopt SO_BUSY_POLL");
+	}
+	receive(snd, rcv, "UDP");
+
+	(void) close(snd);
+	(void) close(rcv);
+}
+
+int
+main(void)
+{
+	test_tcp();
+	test_udp();
+
+	if (failures != 0) {
+		(void) printf("%d failures\n", failures);
+		return (EXIT_FAILURE);
+	}
+	(void) printf("PASS\n");
+	return (EXIT_SUCCESS);
+}
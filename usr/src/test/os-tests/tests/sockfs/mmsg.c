@@ -0,0 +1,231 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Test batched datagram I/O via recvmmsg()/sendmmsg() and send-side
+ * segmentation via the UDP_SEGMENT socket option.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <err.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+
+#define	NMSG		8
+#define	MAXMSG		2048
+
+static int failures;
+
+static void
+fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fprintf(stderr, "FAIL: ");
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fprintf(stderr, "\n");
+	va_end(ap);
+	failures++;
+}
+
+static void
+setup(int *sndp, int *rcvp)
+{
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof (sin);
+	int snd, rcv;
+
+	if ((rcv = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	if ((snd = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+
+	bzero(&sin, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(rcv, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "bind");
+	if (getsockname(rcv, (struct sockaddr *)&sin, &sinlen) == -1)
+		err(EXIT_FAILURE, "getsockname");
+	if (connect(snd, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "connect");
+
+	*sndp = snd;
+	*rcvp = rcv;
+}
+
+/*
+ * Receive whatever is queued on rcv, up to NMSG * 2 datagrams, and return
+ * the number received.  lens[] is filled in with the size of each.
+ */
+static int
+drain(int rcv, uint8_t bufs[][MAXMSG], unsigned int *lens, int flags)
+{
+	struct mmsghdr msgs[NMSG * 2];
+	struct iovec iovs[NMSG * 2];
+	int i, n;
+
+	bzero(msgs, sizeof (msgs));
+	for (i = 0; i < NMSG * 2; i++) {
+		iovs[i].iov_base = bufs[i];
+		iovs[i].iov_len = MAXMSG;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	n = recvmmsg(rcv, msgs, NMSG * 2, flags, NULL);
+	for (i = 0; i < n; i++)
+		lens[i] = msgs[i].msg_len;
+	return (n);
+}
+
+static void
+test_mmsg(void)
+{
+	static uint8_t sbufs[NMSG][MAXMSG];
+	static uint8_t rbufs[NMSG * 2][MAXMSG];
+	struct mmsghdr msgs[NMSG];
+	struct iovec iovs[NMSG];
+	unsigned int lens[NMSG * 2];
+	int snd, rcv, i, n;
+
+	setup(&snd, &rcv);
+
+	bzero(msgs, sizeof (msgs));
+	for (i = 0; i < NMSG; i++) {
+		(void) memset(sbufs[i], 'a' + i, MAXMSG);
+		iovs[i].iov_base = sbufs[i];
+		iovs[i].iov_len = 100 * (i + 1);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	if ((n = sendmmsg(snd, msgs, NMSG, 0)) != NMSG)
+		fail("sendmmsg returned %d, expected %d (%s)", n, NMSG,
+		    n == -1 ? strerror(errno) : "short");
+	for (i = 0; i < n; i++) {
+		if (msgs[i].msg_len != iovs[i].iov_len) {
+			fail("sendmmsg msg %d len %u, expected %zu", i,
+			    msgs[i].msg_len, iovs[i].iov_len);
+		}
+	}
+
+	if ((n = drain(rcv, rbufs, lens, MSG_WAITFORONE)) != NMSG)
+		fail("recvmmsg returned %d, expected %d", n, NMSG);
+	for (i = 0; i < n; i++) {
+		if (lens[i] != 100 * (i + 1))
+			fail("recvmmsg msg %d len %u", i, lens[i]);
+		else if (memcmp(rbufs[i], sbufs[i], lens[i]) != 0)
+			fail("recvmmsg msg %d data mismatch", i);
+	}
+
+	if ((n = drain(rcv, rbufs, lens, MSG_DONTWAIT)) != -1 ||
+	    errno != EAGAIN) {
+		fail("recvmmsg on empty socket returned %d (%s)", n,
+		    strerror(errno));
+	}
+
+	if ((n = sendmmsg(snd, msgs, 0, 0)) != 0)
+		fail("sendmmsg with vlen 0 returned %d", n);
+
+	(void) close(snd);
+	(void) close(rcv);
+}
+
+static void
+test_segment(void)
+{
+	static uint8_t sbuf[MAXMSG];
+	static uint8_t rbufs[NMSG * 2][MAXMSG];
+	unsigned int lens[NMSG * 2];
+	socklen_t optlen;
+	int snd, rcv, i, n, val;
+
+	setup(&snd, &rcv);
+
+	for (i = 0; i < (int)sizeof (sbuf); i++)
+		sbuf[i] = i & 0xff;
+
+	val = -1;
+	if (setsockopt(snd, IPPROTO_UDP, UDP_SEGMENT, &val,
+	    sizeof (val)) != -1 || errno != EINVAL) {
+		fail("UDP_SEGMENT of -1 was not rejected");
+	}
+
+	val = 200;
+	if (setsockopt(snd, IPPROTO_UDP, UDP_SEGMENT, &val,
+	    sizeof (val)) == -1) {
+		fail("setsockopt UDP_SEGMENT: %s", strerror(errno));
+		goto out;
+	}
+	val = 0;
+	optlen = sizeof (val);
+	if (getsockopt(snd, IPPROTO_UDP, UDP_SEGMENT, &val, &optlen) == -1 ||
+	    val != 200) {
+		fail("getsockopt UDP_SEGMENT returned %d", val);
+	}
+
+	/* 1050 bytes should arrive as five 200 byte datagrams and one 50 */
+	if (send(snd, sbuf, 1050, 0) != 1050)
+		fail("segmented send: %s", strerror(errno));
+
+	if ((n = drain(rcv, rbufs, lens, MSG_WAITFORONE)) != 6)
+		fail("received %d segments, expected 6", n);
+	for (i = 0; i < n; i++) {
+		unsigned int exp = i == 5 ? 50 : 200;
+
+		if (lens[i] != exp)
+			fail("segment %d len %u, expected %u", i, lens[i], exp);
+		else if (memcmp(rbufs[i], sbuf + i * 200, exp) != 0)
+			fail("segment %d data mismatch", i);
+	}
+
+	/* A send no larger than the segment size is a single datagram */
+	if (send(snd, sbuf, 200, 0) != 200)
+		fail("unsegmented send: %s", strerror(errno));
+	if ((n = drain(rcv, rbufs, lens, MSG_WAITFORONE)) != 1 ||
+	    lens[0] != 200) {
+		fail("unsegmented send produced %d datagrams", n);
+	}
+
+out:
+	(void) close(snd);
+	(void) close(rcv);
+}
+
+int
+main(void)
+{
+	test_mmsg();
+	test_segment();
+
+	if (failures != 0) {
+		(void) printf("%d failures\n", failures);
+		return (EXIT_FAILURE);
+	}
+	(void) printf("PASS\n");
+	return (EXIT_SUCCESS);
+}
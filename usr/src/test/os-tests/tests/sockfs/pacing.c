@@ -0,0 +1,142 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Test the SO_MAX_PACING_RATE socket option: the rate set is the rate
+ * returned, ~0 means no limit, and a paced socket still passes data.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <err.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static int failures;
+
+static void
+fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fprintf(stderr, "FAIL: ");
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fprintf(stderr, "\n");
+	va_end(ap);
+	failures++;
+}
+
+static void
+check_rate(int sock, const char *name, unsigned int set, unsigned int exp)
+{
+	unsigned int val;
+	socklen_t optlen = sizeof (val);
+
+	if (setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, &set,
+	    sizeof (set)) == -1) {
+		fail("%s: setsockopt %u: %s", name, set, strerror(errno));
+		return;
+	}
+	if (getsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, &val,
+	    &optlen) == -1) {
+		fail("%s: getsockopt: %s", name, strerror(errno));
+		return;
+	}
+	if (val != exp)
+		fail("%s: rate %u read back as %u, expected %u", name, set,
+		    val, exp);
+}
+
+static void
+test_type(int type)
+{
+	const char *name = type == SOCK_STREAM ? "TCP" : "UDP";
+	int sock;
+
+	if ((sock = socket(AF_INET, type, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+
+	check_rate(sock, name, 0, 0);
+	check_rate(sock, name, 125000, 125000);
+	check_rate(sock, name, ~0U, 0);
+
+	(void) close(sock);
+}
+
+static void
+test_udp_send(void)
+{
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof (sin);
+	unsigned int rate = 1000000;
+	char buf[512];
+	int snd, rcv, i;
+
+	if ((rcv = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	if ((snd = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+
+	bzero(&sin, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(rcv, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "bind");
+	if (getsockname(rcv, (struct sockaddr *)&sin, &sinlen) == -1)
+		err(EXIT_FAILURE, "getsockname");
+	if (connect(snd, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "connect");
+	if (setsockopt(snd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate,
+	    sizeof (rate)) == -1) {
+		err(EXIT_FAILURE, "setsockopt SO_MAX_PACING_RATE");
+	}
+
+	(void) memset(buf, 'p', sizeof (buf));
+	for (i = 0; i < 4; i++) {
+		if (send(snd, buf, sizeof (buf), 0) != sizeof (buf))
+			fail("paced send %d: %s", i, strerror(errno));
+	}
+	for (i = 0; i < 4; i++) {
+		if (recv(rcv, buf, sizeof (buf), 0) != sizeof (buf))
+			fail("paced recv %d: %s", i, strerror(errno));
+	}
+
+	(void) close(snd);
+	(void) close(rcv);
+}
+
+int
+main(void)
+{
+	test_type(SOCK_STREAM);
+	test_type(SOCK_DGRAM);
+	test_udp_send();
+
+	if (failures != 0) {
+		(void) printf("%d failures\n", failures);
+		return (EXIT_FAILURE);
+	}
+	(void) printf("PASS\n");
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,189 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Test SO_REUSEPORT groups for UDP: several sockets may bind the same
+ * address and port, each flow is delivered to exactly one of them, and
+ * different flows are spread across the group.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <err.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define	NMEMBERS	4
+#define	NFLOWS		64
+#define	NPERFLOW	3
+
+static int failures;
+
+static void
+fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fprintf(stderr, "FAIL: ");
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fprintf(stderr, "\n");
+	va_end(ap);
+	failures++;
+}
+
+static int
+member(int family, struct sockaddr *sa, socklen_t salen, boolean_t reuse)
+{
+	int sock, on = 1;
+
+	if ((sock = socket(family, SOCK_DGRAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	if (reuse && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on,
+	    sizeof (on)) == -1) {
+		err(EXIT_FAILURE, "setsockopt SO_REUSEPORT");
+	}
+	if (bind(sock, sa, salen) == -1) {
+		int e = errno;
+
+		(void) close(sock);
+		errno = e;
+		return (-1);
+	}
+	return (sock);
+}
+
+static void
+test_family(int family)
+{
+	struct sockaddr_storage ss;
+	struct sockaddr *sa = (struct sockaddr *)&ss;
+	socklen_t salen;
+	int members[NMEMBERS];
+	int counts[NMEMBERS];
+	int i, j, sock, used;
+	const char *name = family == AF_INET ? "IPv4" : "IPv6";
+
+	bzero(&ss, sizeof (ss));
+	if (family == AF_INET) {
+		struct sockaddr_in *sin = (struct sockaddr_in *)&ss;
+
+		sin->sin_family = AF_INET;
+		sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		salen = sizeof (*sin);
+	} else {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&ss;
+
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_addr = in6addr_loopback;
+		salen = sizeof (*sin6);
+	}
+
+	/* The first member picks the port, the rest join it */
+	if ((members[0] = member(family, sa, salen, _B_TRUE)) == -1)
+		err(EXIT_FAILURE, "%s: bind first member", name);
+	if (getsockname(members[0], sa, &salen) == -1)
+		err(EXIT_FAILURE, "getsockname");
+	for (i = 1; i < NMEMBERS; i++) {
+		if ((members[i] = member(family, sa, salen, _B_TRUE)) == -1)
+			err(EXIT_FAILURE, "%s: bind member %d", name, i);
+	}
+
+	/* Without SO_REUSEPORT the port is still in use */
+	if ((sock = member(family, sa, salen, _B_FALSE)) != -1) {
+		fail("%s: bind without SO_REUSEPORT succeeded", name);
+		(void) close(sock);
+	} else if (errno != EADDRINUSE) {
+		fail("%s: bind without SO_REUSEPORT: %s", name,
+		    strerror(errno));
+	}
+
+	/*
+	 * Send a few datagrams from each of a number of source ports, each
+	 * carrying the flow number, then check that every flow arrived in
+	 * full at a single member.
+	 */
+	bzero(counts, sizeof (counts));
+	for (i = 0; i < NFLOWS; i++) {
+		int owner = -1, got = 0;
+
+		if ((sock = socket(family, SOCK_DGRAM, 0)) == -1)
+			err(EXIT_FAILURE, "socket");
+		for (j = 0; j < NPERFLOW; j++) {
+			if (sendto(sock, &i, sizeof (i), 0, sa, salen) !=
+			    sizeof (i)) {
+				err(EXIT_FAILURE, "sendto");
+			}
+		}
+		(void) close(sock);
+
+		for (j = 0; j < NMEMBERS; j++) {
+			int flow;
+
+			while (recv(members[j], &flow, sizeof (flow),
+			    MSG_DONTWAIT) == sizeof (flow)) {
+				if (flow != i) {
+					fail("%s: member %d got flow %d while "
+					    "expecting %d", name, j, flow, i);
+				}
+				if (owner != -1 && owner != j) {
+					fail("%s: flow %d split between "
+					    "members %d and %d", name, i,
+					    owner, j);
+				}
+				owner = j;
+				got++;
+			}
+		}
+		if (got != NPERFLOW) {
+			fail("%s: flow %d: received %d of %d datagrams",
+			    name, i, got, NPERFLOW);
+		}
+		if (owner != -1)
+			counts[owner]++;
+	}
+
+	for (i = used = 0; i < NMEMBERS; i++) {
+		if (counts[i] != 0)
+			used++;
+		(void) close(members[i]);
+	}
+	if (used < 2) {
+		fail("%s: %d flows were not spread across the group", name,
+		    NFLOWS);
+	}
+}
+
+int
+main(void)
+{
+	test_family(AF_INET);
+	test_family(AF_INET6);
+
+	if (failures != 0) {
+		(void) printf("%d failures\n", failures);
+		return (EXIT_FAILURE);
+	}
+	(void) printf("PASS\n");
+	return (EXIT_SUCCESS);
+}
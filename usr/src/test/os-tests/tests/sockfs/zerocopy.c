@@ -0,0 +1,363 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Test SO_ZEROCOPY and MSG_ZEROCOPY over a loopback TCP connection: the
+ * option reads back as set, the data sent arrives intact, and every send
+ * is reported exactly once through MSG_ERRQUEUE, with POLLERR raised while
+ * completions are pending.  Loopback connections never loan pages, so the
+ * sends are expected to be reported as copied.
+ *
+ * The pages are only locked down and loaned to TCP on a path through a NIC
+ * with checksum offload, which a loopback connection cannot exercise.  For
+ * that, run "zerocopy -s" on another host, or in a zone reached through
+ * such a NIC, and "zerocopy -c <addr>" here.  The sink checks the data and
+ * reports back; the sender expects its sends not to be reported as copied.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <err.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define	NSENDS	8
+#define	SENDSZ	(256 * 1024)
+#define	DEF_PORT	5801
+
+static int failures;
+
+static void
+fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fprintf(stderr, "FAIL: ");
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fprintf(stderr, "\n");
+	va_end(ap);
+	failures++;
+}
+
+/*
+ * Receive and check everything the sender sends.  Returns true if it all
+ * arrived intact.
+ */
+static boolean_t
+receive_all(int sock)
+{
+	size_t total = 0;
+	char *buf;
+	ssize_t n, i;
+
+	if ((buf = malloc(SENDSZ)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+	while (total < (size_t)NSENDS * SENDSZ) {
+		if ((n = recv(sock, buf, SENDSZ, MSG_WAITALL)) <= 0) {
+			fail("recv after %zu bytes: %s", total,
+			    n == 0 ? "EOF" : strerror(errno));
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			if (buf[i] != (char)((total + i) / SENDSZ + 'a')) {
+				fail("byte %zu is wrong", total + i);
+				free(buf);
+				return (_B_FALSE);
+			}
+		}
+		total += n;
+	}
+	free(buf);
+	return (total == (size_t)NSENDS * SENDSZ);
+}
+
+static void *
+reader(void *arg)
+{
+	(void) receive_all((int)(uintptr_t)arg);
+	return (NULL);
+}
+
+static void
+check_opt(int sock, int exp)
+{
+	int val;
+	socklen_t optlen = sizeof (val);
+
+	if (getsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &val, &optlen) == -1)
+		fail("getsockopt SO_ZEROCOPY: %s", strerror(errno));
+	else if (val != exp)
+		fail("SO_ZEROCOPY is %d, expected %d", val, exp);
+}
+
+/*
+ * Collect completions until all NSENDS sends have been seen.  Each must be
+ * reported as copied or not, as given.
+ */
+static void
+collect(int sock, boolean_t copied)
+{
+	char cbuf[CMSG_SPACE(sizeof (struct so_zc_done))];
+	struct so_zc_done done;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct pollfd pfd;
+	uint32_t next = 0;
+
+	while (next < NSENDS) {
+		pfd.fd = sock;
+		pfd.events = 0;
+		if (poll(&pfd, 1, 10000) != 1) {
+			fail("no POLLERR with %u sends outstanding",
+			    NSENDS - next);
+			return;
+		}
+		if ((pfd.revents & POLLERR) == 0) {
+			fail("poll returned %x", pfd.revents);
+			return;
+		}
+
+		bzero(&msg, sizeof (msg));
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof (cbuf);
+		if (recvmsg(sock, &msg, MSG_ERRQUEUE) == -1) {
+			fail("recvmsg MSG_ERRQUEUE: %s", strerror(errno));
+			return;
+		}
+		if ((msg.msg_flags & MSG_ERRQUEUE) == 0)
+			fail("MSG_ERRQUEUE not set in msg_flags");
+		if ((cmsg = CMSG_FIRSTHDR(&msg)) == NULL ||
+		    cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_ZEROCOPY) {
+			fail("no SCM_ZEROCOPY control message");
+			return;
+		}
+		bcopy(CMSG_DATA(cmsg), &done, sizeof (done));
+		if (done.szc_lo != next || done.szc_hi < done.szc_lo ||
+		    done.szc_hi >= NSENDS) {
+			fail("completion %u-%u, expected %u onwards",
+			    done.szc_lo, done.szc_hi, next);
+			return;
+		}
+		if (((done.szc_flags & SO_ZC_COPIED) != 0) != copied) {
+			fail("completion %u-%u was%s copied", done.szc_lo,
+			    done.szc_hi, copied ? " not" : "");
+		}
+		next = done.szc_hi + 1;
+	}
+
+	bzero(&msg, sizeof (msg));
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof (cbuf);
+	if (recvmsg(sock, &msg, MSG_ERRQUEUE) != -1 || errno != EAGAIN)
+		fail("empty error queue did not return EAGAIN");
+}
+
+/*
+ * Send NSENDS buffers with MSG_ZEROCOPY.  Each send has its own buffer, as
+ * the pages of a zero-copy send must not be changed until it has completed.
+ */
+static void
+send_all(int snd, char **bufs)
+{
+	int i;
+
+	for (i = 0; i < NSENDS; i++) {
+		if ((bufs[i] = malloc(SENDSZ)) == NULL)
+			err(EXIT_FAILURE, "malloc");
+		(void) memset(bufs[i], 'a' + i, SENDSZ);
+		if (send(snd, bufs[i], SENDSZ, MSG_ZEROCOPY) != SENDSZ)
+			fail("send %d: %s", i, strerror(errno));
+	}
+}
+
+static int
+zc_socket(void)
+{
+	int snd, on = 1, off = 0;
+
+	if ((snd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	check_opt(snd, 0);
+	if (setsockopt(snd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof (on)) == -1)
+		err(EXIT_FAILURE, "setsockopt SO_ZEROCOPY");
+	check_opt(snd, 1);
+	if (setsockopt(snd, SOL_SOCKET, SO_ZEROCOPY, &off, sizeof (off)) == -1)
+		err(EXIT_FAILURE, "setsockopt SO_ZEROCOPY");
+	check_opt(snd, 0);
+	if (setsockopt(snd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof (on)) == -1)
+		err(EXIT_FAILURE, "setsockopt SO_ZEROCOPY");
+	return (snd);
+}
+
+static int
+listen_on(in_addr_t addr, in_port_t port, struct sockaddr_in *sin)
+{
+	socklen_t sinlen = sizeof (*sin);
+	int lsock, on = 1;
+
+	if ((lsock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	(void) setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+	bzero(sin, sizeof (*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = addr;
+	sin->sin_port = htons(port);
+	if (bind(lsock, (struct sockaddr *)sin, sizeof (*sin)) == -1)
+		err(EXIT_FAILURE, "bind");
+	if (getsockname(lsock, (struct sockaddr *)sin, &sinlen) == -1)
+		err(EXIT_FAILURE, "getsockname");
+	if (listen(lsock, 1) == -1)
+		err(EXIT_FAILURE, "listen");
+	return (lsock);
+}
+
+/*
+ * The sink for a remote sender: check what arrives and answer with a
+ * single byte, 1 if it was all intact.
+ */
+static void
+sink(in_port_t port)
+{
+	struct sockaddr_in sin;
+	int lsock, rcv;
+	char ok;
+
+	lsock = listen_on(htonl(INADDR_ANY), port, &sin);
+	if ((rcv = accept(lsock, NULL, NULL)) == -1)
+		err(EXIT_FAILURE, "accept");
+	ok = receive_all(rcv);
+	if (send(rcv, &ok, 1, 0) != 1)
+		fail("send result: %s", strerror(errno));
+	(void) close(rcv);
+	(void) close(lsock);
+}
+
+/*
+ * Send to a sink on another host.  The path should loan the pages, so no
+ * send may be reported as copied.
+ */
+static void
+remote(const char *host, in_port_t port)
+{
+	struct sockaddr_in sin;
+	char *bufs[NSENDS];
+	char ok = 0;
+	int snd, i;
+
+	bzero(&sin, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	if (inet_pton(AF_INET, host, &sin.sin_addr) != 1)
+		errx(EXIT_FAILURE, "bad address %s", host);
+
+	snd = zc_socket();
+	if (connect(snd, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "connect %s", host);
+	send_all(snd, bufs);
+	collect(snd, _B_FALSE);
+	if (recv(snd, &ok, 1, MSG_WAITALL) != 1 || !ok)
+		fail("sink did not receive the data intact");
+	for (i = 0; i < NSENDS; i++)
+		free(bufs[i]);
+	(void) close(snd);
+}
+
+static void
+loopback(void)
+{
+	struct sockaddr_in sin;
+	int lsock, snd, rcv, i;
+	pthread_t tid;
+	char *bufs[NSENDS];
+
+	lsock = listen_on(htonl(INADDR_LOOPBACK), 0, &sin);
+	snd = zc_socket();
+	if (connect(snd, (struct sockaddr *)&sin, sizeof (sin)) == -1)
+		err(EXIT_FAILURE, "connect");
+	if ((rcv = accept(lsock, NULL, NULL)) == -1)
+		err(EXIT_FAILURE, "accept");
+	if (pthread_create(&tid, NULL, reader, (void *)(uintptr_t)rcv) != 0)
+		err(EXIT_FAILURE, "pthread_create");
+
+	send_all(snd, bufs);
+	(void) pthread_join(tid, NULL);
+	collect(snd, _B_TRUE);
+	for (i = 0; i < NSENDS; i++)
+		free(bufs[i]);
+
+	(void) close(snd);
+	(void) close(rcv);
+	(void) close(lsock);
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: zerocopy [-s | -c addr] [-p port]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *host = NULL;
+	boolean_t server = _B_FALSE;
+	in_port_t port = DEF_PORT;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:p:s")) != -1) {
+		switch (c) {
+		case 'c':
+			host = optarg;
+			break;
+		case 'p':
+			port = (in_port_t)strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			server = _B_TRUE;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (server && host != NULL)
+		usage();
+
+	if (server)
+		sink(port);
+	else if (host != NULL)
+		remote(host, port);
+	else
+		loopback();
+
+	if (failures != 0) {
+		(void) printf("%d failures\n", failures);
+		return (EXIT_FAILURE);
+	}
+	(void) printf("PASS\n");
+	return (EXIT_SUCCESS);
+}
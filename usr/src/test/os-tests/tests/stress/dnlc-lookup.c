@@ -0,0 +1,164 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Stress path lookup through the directory name lookup cache.  A tree of
+ * directories and files is created under a scratch directory, then a
+ * number of threads stat() paths in it as fast as they can: mostly names
+ * that exist, and some that do not, so that both positive and negative
+ * cache entries are looked up on many CPUs at once.  Every result is
+ * checked, and the lookup rate is printed at the end.
+ *
+ * The scratch directory should be on a file system that uses the dnlc,
+ * such as ZFS or UFS; tmpfs does its own name lookups.  With -f larger
+ * than the name cache, the cache has to grow or churn; watch
+ * "kstat -n dnlcstats" while this runs.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <err.h>
+#include <atomic.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "stress.h"
+
+#define	DEF_THREADS	16
+#define	DEF_SECONDS	10
+#define	DEF_FILES	10000
+#define	DEF_BASE	"/var/tmp"
+#define	NDIRS		16
+/* One lookup in NEG_EVERY is for a name that does not exist */
+#define	NEG_EVERY	4
+
+static char root[PATH_MAX];
+static uint_t nfiles = DEF_FILES;
+static uint64_t nlookups;
+
+static void
+mkpath(char *buf, size_t len, uint_t file, boolean_t missing)
+{
+	(void) snprintf(buf, len, "%s/d%02u/%s%u", root, file % NDIRS,
+	    missing ? "nofile" : "file", file);
+}
+
+static void
+create_tree(void)
+{
+	char path[PATH_MAX];
+	uint_t i;
+	int fd;
+
+	for (i = 0; i < NDIRS; i++) {
+		(void) snprintf(path, sizeof (path), "%s/d%02u", root, i);
+		if (mkdir(path, 0755) == -1)
+			err(EXIT_FAILURE, "mkdir %s", path);
+	}
+	for (i = 0; i < nfiles; i++) {
+		mkpath(path, sizeof (path), i, B_FALSE);
+		if ((fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0644)) == -1)
+			err(EXIT_FAILURE, "create %s", path);
+		(void) close(fd);
+	}
+}
+
+static void
+remove_tree(void)
+{
+	char path[PATH_MAX];
+	uint_t i;
+
+	for (i = 0; i < nfiles; i++) {
+		mkpath(path, sizeof (path), i, B_FALSE);
+		if (unlink(path) == -1)
+			warn("unlink %s", path);
+	}
+	for (i = 0; i < NDIRS; i++) {
+		(void) snprintf(path, sizeof (path), "%s/d%02u", root, i);
+		if (rmdir(path) == -1)
+			warn("rmdir %s", path);
+	}
+	if (rmdir(root) == -1)
+		warn("rmdir %s", root);
+}
+
+static void *
+looker(void *arg)
+{
+	uint_t seed = (uint_t)(uintptr_t)arg + 1;
+	uint64_t n = 0;
+	char path[PATH_MAX];
+	struct stat st;
+	boolean_t missing;
+	uint_t file;
+
+	while (!stress_stop) {
+		file = rand_r(&seed) % nfiles;
+		missing = (rand_r(&seed) % NEG_EVERY) == 0;
+		mkpath(path, sizeof (path), file, missing);
+		if (stat(path, &st) == 0) {
+			if (missing)
+				stress_fail("%s exists", path);
+			else if (!S_ISREG(st.st_mode))
+				stress_fail("%s is not a regular file", path);
+		} else if (!missing || errno != ENOENT) {
+			stress_fail("stat %s: %s", path, strerror(errno));
+		}
+		n++;
+	}
+	atomic_add_64(&nlookups, n);
+	return (NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *base = DEF_BASE;
+	int c;
+
+	stress_init("[-p dir] [-f files]", DEF_THREADS, DEF_SECONDS);
+	while ((c = stress_getopt(argc, argv, "f:p:")) != -1) {
+		switch (c) {
+		case 'f':
+			nfiles = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			base = optarg;
+			break;
+		default:
+			stress_usage();
+		}
+	}
+	if (nfiles == 0)
+		stress_usage();
+
+	(void) snprintf(root, sizeof (root), "%s/dnlc-lookup.XXXXXX", base);
+	if (mkdtemp(root) == NULL)
+		err(EXIT_FAILURE, "mkdtemp %s", root);
+	create_tree();
+
+	stress_run(looker, stress_seconds);
+	remove_tree();
+
+	return (stress_report(nlookups, "lookups",
+	    "by %u threads over %u files", stress_threads, nfiles));
+}
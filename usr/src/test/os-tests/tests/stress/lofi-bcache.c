@@ -0,0 +1,255 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Stress the lofi block cache tier.  A backing file and a smaller cache
+ * file are created in a scratch directory and mapped together.  A number
+ * of threads then read and write the raw device at random: whole cache
+ * blocks, and runs of sectors that start and end inside one.  Each thread
+ * owns its own stretch of the device and keeps a copy of what it should
+ * hold, and every read is checked against that copy.  The cache is much
+ * smaller than the device, so blocks are evicted and written back all the
+ * time.  After that, one sequential read of the whole device exercises
+ * the sequential bypass, and the device is unmapped, which writes back
+ * whatever is still dirty.  The backing file must then match the copy.
+ *
+ * Watch "kstat -m lofi -n bcache" while this runs.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <err.h>
+#include <atomic.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <sys/lofi.h>
+
+#include "stress.h"
+
+#define	DEF_THREADS	8
+#define	DEF_SECONDS	10
+#define	DEF_SIZE_MB	64
+#define	DEF_CACHE_MB	8
+#define	DEF_BASE	"/var/tmp"
+/* lofi_bcache_blksz */
+#define	CACHE_BLKSZ	(32 * 1024)
+#define	MAX_SECTORS	(2 * CACHE_BLKSZ / DEV_BSIZE)
+
+static char backing[PATH_MAX];
+static char cache[PATH_MAX];
+static char *shadow;
+static size_t devsize;
+static size_t span;
+static int devfd;
+static uint64_t nios;
+
+/* Create a file of size bytes holding data, or zeros if data is NULL */
+static void
+create_file(const char *path, const char *data, size_t size)
+{
+	char buf[CACHE_BLKSZ];
+	size_t off;
+	int fd;
+
+	if ((fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0600)) == -1)
+		err(EXIT_FAILURE, "create %s", path);
+	for (off = 0; off < size; off += sizeof (buf)) {
+		if (data != NULL)
+			bcopy(data + off, buf, sizeof (buf));
+		else
+			bzero(buf, sizeof (buf));
+		if (write(fd, buf, sizeof (buf)) != sizeof (buf))
+			err(EXIT_FAILURE, "write %s", path);
+	}
+	(void) close(fd);
+}
+
+/*
+ * Each thread gets span bytes of the device starting at id * span.  The
+ * spans are whole cache blocks, so threads never share a block.
+ */
+static void *
+worker(void *arg)
+{
+	uint_t id = (uint_t)(uintptr_t)arg;
+	uint_t seed = id + 1;
+	size_t base = id * span;
+	char buf[MAX_SECTORS * DEV_BSIZE];
+	uint64_t n = 0;
+	size_t off, len, i;
+	ssize_t rv;
+
+	while (!stress_stop) {
+		if (rand_r(&seed) % 2 == 0) {
+			/* a whole cache block */
+			off = (rand_r(&seed) % (span / CACHE_BLKSZ)) *
+			    CACHE_BLKSZ;
+			len = CACHE_BLKSZ;
+		} else {
+			/* a run of sectors, possibly spanning blocks */
+			len = (1 + rand_r(&seed) % MAX_SECTORS) * DEV_BSIZE;
+			off = (rand_r(&seed) % ((span - len) / DEV_BSIZE + 1)) *
+			    DEV_BSIZE;
+		}
+		off += base;
+
+		if (rand_r(&seed) % 3 == 0) {
+			for (i = 0; i < len; i++)
+				buf[i] = (char)rand_r(&seed);
+			rv = pwrite(devfd, buf, len, off);
+			if (rv != (ssize_t)len) {
+				stress_fail("write %zu at %zu: %s", len, off,
+				    rv == -1 ? strerror(errno) : "short");
+			} else {
+				bcopy(buf, shadow + off, len);
+			}
+		} else {
+			rv = pread(devfd, buf, len, off);
+			if (rv != (ssize_t)len) {
+				stress_fail("read %zu at %zu: %s", len, off,
+				    rv == -1 ? strerror(errno) : "short");
+			} else if (bcmp(buf, shadow + off, len) != 0) {
+				stress_fail("read %zu at %zu: data mismatch",
+				    len, off);
+			}
+		}
+		n++;
+	}
+	atomic_add_64(&nios, n);
+	return (NULL);
+}
+
+static void
+check_all(int fd, const char *what)
+{
+	char buf[CACHE_BLKSZ * 4];
+	size_t off;
+	ssize_t rv;
+
+	for (off = 0; off < devsize; off += sizeof (buf)) {
+		if ((rv = pread(fd, buf, sizeof (buf), off)) != sizeof (buf)) {
+			stress_fail("%s: read at %zu: %s", what, off,
+			    rv == -1 ? strerror(errno) : "short");
+			return;
+		}
+		if (bcmp(buf, shadow + off, sizeof (buf)) != 0) {
+			stress_fail("%s: data mismatch at %zu", what, off);
+			return;
+		}
+	}
+}
+
+static int
+map_file(int ctlfd, struct lofi_ioctl *li)
+{
+	uint_t i;
+	int fd;
+
+	bzero(li, sizeof (*li));
+	(void) strlcpy(li->li_filename, backing, sizeof (li->li_filename));
+	(void) strlcpy(li->li_cachefile, cache, sizeof (li->li_cachefile));
+	if (ioctl(ctlfd, LOFI_MAP_FILE, li) == -1)
+		err(EXIT_FAILURE, "map %s with cache %s", backing, cache);
+
+	/* The /dev links are made asynchronously. */
+	for (i = 0; i < 100; i++) {
+		if ((fd = open(li->li_devpath, O_RDWR)) != -1)
+			return (fd);
+		(void) usleep(100000);
+	}
+	err(EXIT_FAILURE, "open %s", li->li_devpath);
+	/* NOTREACHED */
+	return (-1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t sizemb = DEF_SIZE_MB, cachemb = DEF_CACHE_MB, i;
+	const char *base = DEF_BASE;
+	struct lofi_ioctl li;
+	int c, ctlfd, fd;
+
+	stress_init("[-p dir] [-s size_mb] [-c cache_mb]", DEF_THREADS,
+	    DEF_SECONDS);
+	while ((c = stress_getopt(argc, argv, "c:p:s:")) != -1) {
+		switch (c) {
+		case 'c':
+			cachemb = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			base = optarg;
+			break;
+		case 's':
+			sizemb = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			stress_usage();
+		}
+	}
+	if (sizemb == 0 || cachemb == 0)
+		stress_usage();
+
+	devsize = sizemb * 1024 * 1024;
+	span = devsize / stress_threads / (2 * CACHE_BLKSZ) * (2 * CACHE_BLKSZ);
+	if (span == 0)
+		stress_usage();
+
+	(void) snprintf(backing, sizeof (backing), "%s/lofi-bcache.%d.img",
+	    base, (int)getpid());
+	(void) snprintf(cache, sizeof (cache), "%s/lofi-bcache.%d.cache",
+	    base, (int)getpid());
+
+	if ((shadow = malloc(devsize)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+	for (i = 0; i < devsize / sizeof (uint32_t); i++)
+		((uint32_t *)shadow)[i] = i;
+	create_file(backing, shadow, devsize);
+	create_file(cache, NULL, cachemb * 1024 * 1024);
+
+	if ((ctlfd = open("/dev/" LOFI_CTL_NAME, O_RDWR | O_EXCL)) == -1)
+		err(EXIT_FAILURE, "open /dev/%s", LOFI_CTL_NAME);
+	devfd = map_file(ctlfd, &li);
+
+	stress_run(worker, stress_seconds);
+	check_all(devfd, "sequential read");
+	(void) close(devfd);
+
+	if (ioctl(ctlfd, LOFI_UNMAP_FILE_MINOR, &li) == -1)
+		err(EXIT_FAILURE, "unmap %s", li.li_devpath);
+	(void) close(ctlfd);
+
+	if ((fd = open(backing, O_RDONLY)) == -1)
+		err(EXIT_FAILURE, "open %s", backing);
+	check_all(fd, "backing file after unmap");
+	(void) close(fd);
+
+	if (unlink(backing) == -1)
+		warn("unlink %s", backing);
+	if (unlink(cache) == -1)
+		warn("unlink %s", cache);
+
+	return (stress_report(nios, "I/Os",
+	    "by %u threads, %zuMB device, %zuMB cache", stress_threads,
+	    sizemb, cachemb));
+}
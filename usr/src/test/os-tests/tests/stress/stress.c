@@ -0,0 +1,217 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Common parts of the stress tests.  A test calls stress_init() with the
+ * usage of its own options and its defaults for -n and -d, then takes its
+ * options from stress_getopt(), which deals with -n and -d itself.  Worker
+ * threads are started by stress_run(), get their index as argument, and
+ * run until stress_stop is set.  Failures are counted by stress_fail(),
+ * and stress_report() prints the summary and returns the exit status.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <err.h>
+#include <pthread.h>
+#include <atomic.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "stress.h"
+
+uint_t stress_threads;
+uint_t stress_seconds;
+volatile boolean_t stress_stop;
+
+static const char *stress_opts;
+static uint_t stress_failures;
+
+void
+stress_init(const char *opts, uint_t threads, uint_t seconds)
+{
+	stress_opts = opts;
+	stress_threads = threads;
+	stress_seconds = seconds;
+}
+
+void
+stress_usage(void)
+{
+	(void) fprintf(stderr, "usage: %s %s%s[-n threads] [-d seconds]\n",
+	    getprogname(), stress_opts, *stress_opts != '\0' ? " " : "");
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Like getopt(3C), but handle -n and -d, which are not to be in opts.
+ * Returns -1 once the options are done and valid.
+ */
+int
+stress_getopt(int argc, char *argv[], const char *opts)
+{
+	char optstr[64];
+	int c;
+
+	(void) snprintf(optstr, sizeof (optstr), "d:n:%s", opts);
+	while ((c = getopt(argc, argv, optstr)) != -1) {
+		switch (c) {
+		case 'd':
+			stress_seconds = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			stress_threads = strtoul(optarg, NULL, 10);
+			break;
+		case '?':
+			stress_usage();
+			break;
+		default:
+			return (c);
+		}
+	}
+	if (stress_threads == 0 || optind != argc)
+		stress_usage();
+	if (stress_seconds == 0)
+		stress_seconds = 1;
+	return (-1);
+}
+
+void
+stress_fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fprintf(stderr, "FAIL: ");
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fprintf(stderr, "\n");
+	va_end(ap);
+	atomic_inc_uint(&stress_failures);
+}
+
+/*
+ * Run func in stress_threads threads.  With seconds set, stress_stop is
+ * set after that long; otherwise the threads are left to finish.
+ */
+void
+stress_run(void *(*func)(void *), uint_t seconds)
+{
+	pthread_t *tids;
+	uint_t i;
+
+	if ((tids = calloc(stress_threads, sizeof (pthread_t))) == NULL)
+		err(EXIT_FAILURE, "calloc");
+	stress_stop = B_FALSE;
+	for (i = 0; i < stress_threads; i++) {
+		if (pthread_create(&tids[i], NULL, func,
+		    (void *)(uintptr_t)i) != 0) {
+			err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+	if (seconds != 0) {
+		(void) sleep(seconds);
+		stress_stop = B_TRUE;
+	}
+	for (i = 0; i < stress_threads; i++)
+		(void) pthread_join(tids[i], NULL);
+	free(tids);
+}
+
+/*
+ * Print "n what in d seconds (rate/s)" followed by the details in fmt, and
+ * whether the test passed.  Returns the exit status.
+ */
+int
+stress_report(uint64_t n, const char *what, const char *fmt, ...)
+{
+	va_list ap;
+
+	(void) printf("%llu %s in %u seconds (%llu/s)", (u_longlong_t)n, what,
+	    stress_seconds, (u_longlong_t)(n / stress_seconds));
+	if (fmt != NULL) {
+		va_start(ap, fmt);
+		(void) printf(", ");
+		(void) vprintf(fmt, ap);
+		va_end(ap);
+	}
+	(void) printf("\n");
+
+	if (stress_failures != 0) {
+		(void) printf("%u failures\n", stress_failures);
+		return (EXIT_FAILURE);
+	}
+	(void) printf("PASS\n");
+	return (EXIT_SUCCESS);
+}
+
+void
+stress_inet_addr(struct sockaddr_in *sin, in_port_t port)
+{
+	bzero(sin, sizeof (*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin->sin_port = htons(port);
+}
+
+int
+stress_listen(const struct sockaddr_in *sin)
+{
+	int sock, one = 1;
+
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one,
+	    sizeof (one)) == -1) {
+		err(EXIT_FAILURE, "setsockopt SO_REUSEADDR");
+	}
+	if (bind(sock, (struct sockaddr *)sin, sizeof (*sin)) == -1)
+		err(EXIT_FAILURE, "bind");
+	if (listen(sock, 1024) == -1)
+		err(EXIT_FAILURE, "listen");
+	return (sock);
+}
+
+/*
+ * Accept connections on lsock for ever, each handed to func in a thread
+ * of its own with the socket as argument.
+ */
+void
+stress_serve(int lsock, void *(*func)(void *))
+{
+	pthread_attr_t attr;
+	pthread_t tid;
+	int sock;
+
+	(void) pthread_attr_init(&attr);
+	(void) pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for (;;) {
+		if ((sock = accept(lsock, NULL, NULL)) == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			err(EXIT_FAILURE, "accept");
+		}
+		if (pthread_create(&tid, &attr, func,
+		    (void *)(uintptr_t)sock) != 0) {
+			err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+}
@@ -0,0 +1,50 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+#ifndef _STRESS_H
+#define	_STRESS_H
+
+/*
+ * Common parts of the stress tests: the -n threads and -d seconds options,
+ * failure counting, running worker threads for a while, and the summary.
+ */
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint_t stress_threads;
+extern uint_t stress_seconds;
+extern volatile boolean_t stress_stop;
+
+extern void stress_init(const char *, uint_t, uint_t);
+extern int stress_getopt(int, char *[], const char *);
+extern void stress_usage(void);
+extern void stress_fail(const char *, ...);
+extern void stress_run(void *(*)(void *), uint_t);
+extern int stress_report(uint64_t, const char *, const char *, ...);
+
+extern void stress_inet_addr(struct sockaddr_in *, in_port_t);
+extern int stress_listen(const struct sockaddr_in *);
+extern void stress_serve(int, void *(*)(void *));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STRESS_H */
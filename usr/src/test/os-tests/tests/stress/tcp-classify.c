@@ -0,0 +1,176 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Stress the classification of established TCP connections.  A number of
+ * client threads open connections to an echo server as fast as they can,
+ * exchange a few segments over each one and close it, so that the
+ * connected fanout is looked up, inserted into and removed from on many
+ * CPUs at once.  Every reply is checked, and the connection rate is
+ * printed at the end.
+ *
+ * By default the server runs in this process on the loopback address.
+ * Loopback TCP is normally fused, which skips the classifier for data, so
+ * for a real workout run the two halves on either side of a simnet pair:
+ *
+ *	# dladm create-simnet sim0
+ *	# dladm create-simnet sim1
+ *	# dladm modify-simnet -p sim1 sim0
+ *
+ * then give sim1 to an exclusive-IP zone, plumb an address on each link,
+ * and run "tcp-classify -s -a <addr>" in the zone and
+ * "tcp-classify -c -a <addr>" in the global zone.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <pthread.h>
+#include <atomic.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "stress.h"
+
+#define	DEF_CLIENTS	16
+#define	DEF_SECONDS	10
+#define	DEF_PORT	5577
+#define	NROUNDS		4
+
+static struct sockaddr_in srv_addr;
+static uint64_t nconns;
+
+static void *
+echo(void *arg)
+{
+	int sock = (int)(uintptr_t)arg;
+	uint32_t buf;
+
+	while (recv(sock, &buf, sizeof (buf), MSG_WAITALL) == sizeof (buf)) {
+		if (send(sock, &buf, sizeof (buf), 0) != sizeof (buf))
+			break;
+	}
+	(void) close(sock);
+	return (NULL);
+}
+
+static void *
+server(void *arg)
+{
+	stress_serve((int)(uintptr_t)arg, echo);
+	return (NULL);
+}
+
+static void *
+client(void *arg)
+{
+	uint32_t id = (uint32_t)(uintptr_t)arg << 16;
+	uint32_t seq = 0, buf;
+	int sock, i, one = 1;
+
+	while (!stress_stop) {
+		if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+			err(EXIT_FAILURE, "socket");
+		(void) setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one,
+		    sizeof (one));
+		if (connect(sock, (struct sockaddr *)&srv_addr,
+		    sizeof (srv_addr)) == -1) {
+			stress_fail("connect: %s", strerror(errno));
+			(void) close(sock);
+			continue;
+		}
+		for (i = 0; i < NROUNDS; i++) {
+			uint32_t val = id | (seq++ & 0xffff);
+
+			if (send(sock, &val, sizeof (val), 0) != sizeof (val)) {
+				stress_fail("send: %s", strerror(errno));
+				break;
+			}
+			if (recv(sock, &buf, sizeof (buf), MSG_WAITALL) !=
+			    sizeof (buf)) {
+				stress_fail("recv: %s", strerror(errno));
+				break;
+			}
+			if (buf != val) {
+				stress_fail("sent %x but %x came back", val,
+				    buf);
+				break;
+			}
+		}
+		(void) close(sock);
+		atomic_inc_64(&nconns);
+	}
+	return (NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	boolean_t run_server = B_TRUE, run_clients = B_TRUE;
+	pthread_t stid;
+	int c, lsock;
+
+	stress_inet_addr(&srv_addr, DEF_PORT);
+
+	stress_init("[-s | -c] [-a addr] [-p port]", DEF_CLIENTS,
+	    DEF_SECONDS);
+	while ((c = stress_getopt(argc, argv, "a:cp:s")) != -1) {
+		switch (c) {
+		case 'a':
+			if (inet_pton(AF_INET, optarg,
+			    &srv_addr.sin_addr) != 1) {
+				errx(EXIT_FAILURE, "bad address: %s", optarg);
+			}
+			break;
+		case 'c':
+			run_server = B_FALSE;
+			break;
+		case 'p':
+			srv_addr.sin_port = htons(strtoul(optarg, NULL, 10));
+			break;
+		case 's':
+			run_clients = B_FALSE;
+			break;
+		default:
+			stress_usage();
+		}
+	}
+	if (!run_server && !run_clients)
+		stress_usage();
+
+	if (run_server) {
+		lsock = stress_listen(&srv_addr);
+		if (!run_clients) {
+			stress_serve(lsock, echo);
+			return (EXIT_SUCCESS);
+		}
+		if (pthread_create(&stid, NULL, server,
+		    (void *)(uintptr_t)lsock) != 0) {
+			err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+
+	stress_run(client, stress_seconds);
+
+	return (stress_report(nconns, "connections", "by %u clients",
+	    stress_threads));
+}
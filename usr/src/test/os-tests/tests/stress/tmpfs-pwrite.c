@@ -0,0 +1,301 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Stress parallel writes to one tmpfs file.  The file is cut into
+ * records of several pages.  Writer threads pwrite() whole records at
+ * random, each filled with a single 32-bit word that names the writer,
+ * and reader threads pread() records at random.  Writes that stay within
+ * the file may run in parallel, but a record must never be seen torn:
+ * every record read must hold one word throughout.  The write rate is
+ * printed at the end.
+ *
+ * Then the file is grown by the same threads with O_APPEND writes,
+ * which have to extend it one record at a time, and each record in the
+ * grown file is checked the same way.
+ *
+ * Last, a sparse file is filled with short records that do not line up
+ * with pages.  The n threads walk the file together, each writing every
+ * n'th record, so several of them write different bytes of the same page
+ * while the page is still a hole.  No write may disturb the bytes of
+ * another, so every record must then hold what was written.
+ *
+ * The scratch directory must be on tmpfs.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <err.h>
+#include <atomic.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include "stress.h"
+
+#define	DEF_THREADS	16
+#define	DEF_SECONDS	10
+#define	DEF_SIZE_MB	256
+#define	DEF_BASE	"/tmp"
+#define	RECSZ		(64 * 1024)
+#define	RECWORDS	(RECSZ / sizeof (uint32_t))
+/* One thread in READ_EVERY only reads */
+#define	READ_EVERY	4
+#define	APPEND_RECS	64
+/* Sparse phase: short unaligned records in a small file */
+#define	SPARSE_RECSZ	100
+#define	SPARSE_SIZE	(4 * 1024 * 1024)
+#define	SPARSE_RECS	(SPARSE_SIZE / SPARSE_RECSZ)
+#define	SPARSE_ROUNDS	8
+
+static char path[PATH_MAX];
+static int fd;
+static uint_t nrecs;
+static uint64_t nwrites;
+static uint64_t nreads;
+
+static void
+fill(uint32_t *buf, uint32_t word)
+{
+	uint_t i;
+
+	for (i = 0; i < RECWORDS; i++)
+		buf[i] = word;
+}
+
+static void
+check(const uint32_t *buf, off_t off)
+{
+	uint_t i;
+
+	for (i = 1; i < RECWORDS; i++) {
+		if (buf[i] != buf[0]) {
+			stress_fail("record at %lld torn: word %u is %x, "
+			    "not %x", (longlong_t)off, i, buf[i], buf[0]);
+			return;
+		}
+	}
+}
+
+static void *
+worker(void *arg)
+{
+	uint_t id = (uint_t)(uintptr_t)arg;
+	uint_t seed = id + 1;
+	boolean_t reader = (id % READ_EVERY) == 0;
+	uint32_t *buf;
+	uint32_t gen = 0;
+	uint64_t n = 0;
+	off_t off;
+	ssize_t rv;
+
+	if ((buf = malloc(RECSZ)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	while (!stress_stop) {
+		off = (off_t)(rand_r(&seed) % nrecs) * RECSZ;
+		if (reader) {
+			if ((rv = pread(fd, buf, RECSZ, off)) != RECSZ) {
+				stress_fail("read at %lld: %s", (longlong_t)off,
+				    rv == -1 ? strerror(errno) : "short");
+			} else {
+				check(buf, off);
+			}
+		} else {
+			fill(buf, (id << 24) | (gen++ & 0xffffff));
+			if ((rv = pwrite(fd, buf, RECSZ, off)) != RECSZ) {
+				stress_fail("write at %lld: %s",
+				    (longlong_t)off,
+				    rv == -1 ? strerror(errno) : "short");
+			}
+		}
+		n++;
+	}
+	atomic_add_64(reader ? &nreads : &nwrites, n);
+	free(buf);
+	return (NULL);
+}
+
+static void *
+appender(void *arg)
+{
+	uint_t id = (uint_t)(uintptr_t)arg;
+	uint32_t *buf;
+	ssize_t rv;
+	uint_t i;
+
+	if ((buf = malloc(RECSZ)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+
+	for (i = 0; i < APPEND_RECS; i++) {
+		fill(buf, (id << 24) | i);
+		if ((rv = write(fd, buf, RECSZ)) != RECSZ) {
+			stress_fail("append: %s",
+			    rv == -1 ? strerror(errno) : "short");
+		}
+	}
+	free(buf);
+	return (NULL);
+}
+
+static uchar_t
+sparse_byte(uint_t rec)
+{
+	return (1 + rec % 255);
+}
+
+static void *
+sparse_writer(void *arg)
+{
+	uint_t id = (uint_t)(uintptr_t)arg;
+	char buf[SPARSE_RECSZ];
+	off_t off;
+	ssize_t rv;
+	uint_t rec;
+
+	for (rec = id; rec < SPARSE_RECS; rec += stress_threads) {
+		(void) memset(buf, sparse_byte(rec), sizeof (buf));
+		off = (off_t)rec * SPARSE_RECSZ;
+		if ((rv = pwrite(fd, buf, sizeof (buf), off)) != sizeof (buf)) {
+			stress_fail("sparse write at %lld: %s", (longlong_t)off,
+			    rv == -1 ? strerror(errno) : "short");
+		}
+	}
+	return (NULL);
+}
+
+static void
+sparse_check(uint_t round)
+{
+	char buf[SPARSE_RECSZ];
+	off_t off;
+	uint_t rec, i;
+
+	for (rec = 0; rec < SPARSE_RECS; rec++) {
+		off = (off_t)rec * SPARSE_RECSZ;
+		if (pread(fd, buf, sizeof (buf), off) != sizeof (buf)) {
+			stress_fail("sparse read at %lld: %s", (longlong_t)off,
+			    strerror(errno));
+			return;
+		}
+		for (i = 0; i < sizeof (buf); i++) {
+			if ((uchar_t)buf[i] != sparse_byte(rec)) {
+				stress_fail("round %u: byte %lld is %x, "
+				    "not %x", round, (longlong_t)off + i,
+				    (uchar_t)buf[i], sparse_byte(rec));
+				break;
+			}
+		}
+	}
+}
+
+static void
+check_file(off_t size)
+{
+	uint32_t *buf;
+	struct stat st;
+	off_t off;
+
+	if (fstat(fd, &st) == -1)
+		err(EXIT_FAILURE, "fstat %s", path);
+	if (st.st_size != size) {
+		stress_fail("%s is %lld bytes, not %lld", path,
+		    (longlong_t)st.st_size, (longlong_t)size);
+	}
+
+	if ((buf = malloc(RECSZ)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+	for (off = 0; off < st.st_size; off += RECSZ) {
+		if (pread(fd, buf, RECSZ, off) != RECSZ) {
+			stress_fail("read at %lld: %s", (longlong_t)off,
+			    strerror(errno));
+			break;
+		}
+		check(buf, off);
+	}
+	free(buf);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t sizemb = DEF_SIZE_MB;
+	const char *base = DEF_BASE;
+	struct statvfs sv;
+	uint_t round;
+	off_t size;
+	int c;
+
+	stress_init("[-p dir] [-s size_mb]", DEF_THREADS, DEF_SECONDS);
+	while ((c = stress_getopt(argc, argv, "p:s:")) != -1) {
+		switch (c) {
+		case 'p':
+			base = optarg;
+			break;
+		case 's':
+			sizemb = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			stress_usage();
+		}
+	}
+	/* The writer's id goes in the top byte of each word */
+	if (stress_threads > 255 || sizemb == 0)
+		stress_usage();
+
+	if (statvfs(base, &sv) == -1)
+		err(EXIT_FAILURE, "statvfs %s", base);
+	if (strcmp(sv.f_basetype, "tmpfs") != 0)
+		errx(EXIT_FAILURE, "%s is not on tmpfs", base);
+
+	size = (off_t)sizemb * 1024 * 1024;
+	nrecs = size / RECSZ;
+	(void) snprintf(path, sizeof (path), "%s/tmpfs-pwrite.%d", base,
+	    (int)getpid());
+	if ((fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0600)) == -1)
+		err(EXIT_FAILURE, "create %s", path);
+	if (ftruncate(fd, size) == -1)
+		err(EXIT_FAILURE, "ftruncate %s", path);
+
+	stress_run(worker, stress_seconds);
+	check_file(size);
+
+	(void) close(fd);
+	if ((fd = open(path, O_RDWR | O_APPEND)) == -1)
+		err(EXIT_FAILURE, "open %s", path);
+	stress_run(appender, 0);
+	check_file(size + (off_t)stress_threads * APPEND_RECS * RECSZ);
+
+	(void) close(fd);
+	if ((fd = open(path, O_RDWR)) == -1)
+		err(EXIT_FAILURE, "open %s", path);
+	for (round = 0; round < SPARSE_ROUNDS; round++) {
+		if (ftruncate(fd, 0) == -1 || ftruncate(fd, SPARSE_SIZE) == -1)
+			err(EXIT_FAILURE, "ftruncate %s", path);
+		stress_run(sparse_writer, 0);
+		sparse_check(round);
+	}
+
+	(void) close(fd);
+	if (unlink(path) == -1)
+		warn("unlink %s", path);
+
+	return (stress_report(nwrites, "writes",
+	    "%lluMB/s, and %llu reads by %u threads over %zuMB",
+	    (u_longlong_t)(nwrites * RECSZ / 1024 / 1024 / stress_seconds),
+	    (u_longlong_t)nreads, stress_threads, sizemb));
+}
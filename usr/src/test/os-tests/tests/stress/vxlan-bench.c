@@ -0,0 +1,186 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * Measure bulk TCP throughput across an overlay (VXLAN) link.  A number of
+ * client threads each open one connection to a sink server and write to it
+ * as fast as they can; the number of bytes the server takes in is printed
+ * at the end.  With several connections, the flows hash to different rx
+ * workers in the overlay driver, so this shows how far the receive side
+ * fans out.
+ *
+ * The overlay needs an underlay.  Create a simnet pair:
+ *
+ *	# dladm create-simnet sim0
+ *	# dladm create-simnet sim1
+ *	# dladm modify-simnet -p sim1 sim0
+ *
+ * give sim1 to an exclusive-IP zone, plumb an underlay address on each link
+ * (say 10.0.0.1 and 10.0.0.2), then on each side create a static overlay
+ * pointing at the other:
+ *
+ *	# dladm create-overlay -e vxlan -s direct -v 100 \
+ *	    -p vxlan/listen_ip=10.0.0.1 -p direct/dest_ip=10.0.0.2 \
+ *	    -p direct/dest_port=4789 ovl0
+ *
+ * Plumb an address on each overlay, and run "vxlan-bench -s -a <addr>" in
+ * the zone and "vxlan-bench -c -a <addr>" in the global zone.  Run without
+ * -s or -c, the server and clients share this process on loopback, which
+ * only measures the benchmark itself.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <pthread.h>
+#include <atomic.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "stress.h"
+
+#define	DEF_CLIENTS	8
+#define	DEF_SECONDS	10
+#define	DEF_PORT	5578
+#define	BUFSZ		(64 * 1024)
+
+static struct sockaddr_in srv_addr;
+/* Bytes taken in by the server, and handed to TCP by the clients */
+static uint64_t nbytes;
+static uint64_t nsent;
+
+static void *
+sink(void *arg)
+{
+	int sock = (int)(uintptr_t)arg;
+	char *buf;
+	ssize_t n;
+
+	if ((buf = malloc(BUFSZ)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+	while ((n = recv(sock, buf, BUFSZ, 0)) > 0)
+		atomic_add_64(&nbytes, n);
+	free(buf);
+	(void) close(sock);
+	return (NULL);
+}
+
+static void *
+server(void *arg)
+{
+	stress_serve((int)(uintptr_t)arg, sink);
+	return (NULL);
+}
+
+static void *
+client(void *arg)
+{
+	uint64_t sent = 0;
+	char *buf;
+	ssize_t n;
+	int sock;
+
+	if ((buf = malloc(BUFSZ)) == NULL)
+		err(EXIT_FAILURE, "malloc");
+	(void) memset(buf, 'v', BUFSZ);
+
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		err(EXIT_FAILURE, "socket");
+	if (connect(sock, (struct sockaddr *)&srv_addr,
+	    sizeof (srv_addr)) == -1) {
+		stress_fail("connect: %s", strerror(errno));
+		goto out;
+	}
+	while (!stress_stop) {
+		if ((n = send(sock, buf, BUFSZ, 0)) == -1) {
+			if (errno == EINTR)
+				continue;
+			stress_fail("send: %s", strerror(errno));
+			break;
+		}
+		sent += n;
+	}
+out:
+	(void) close(sock);
+	free(buf);
+	atomic_add_64(&nsent, sent);
+	return (NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	boolean_t run_server = B_TRUE, run_clients = B_TRUE;
+	uint64_t total;
+	pthread_t stid;
+	int c, lsock;
+
+	stress_inet_addr(&srv_addr, DEF_PORT);
+
+	stress_init("[-s | -c] [-a addr] [-p port]", DEF_CLIENTS,
+	    DEF_SECONDS);
+	while ((c = stress_getopt(argc, argv, "a:cp:s")) != -1) {
+		switch (c) {
+		case 'a':
+			if (inet_pton(AF_INET, optarg,
+			    &srv_addr.sin_addr) != 1) {
+				errx(EXIT_FAILURE, "bad address: %s", optarg);
+			}
+			break;
+		case 'c':
+			run_server = B_FALSE;
+			break;
+		case 'p':
+			srv_addr.sin_port = htons(strtoul(optarg, NULL, 10));
+			break;
+		case 's':
+			run_clients = B_FALSE;
+			break;
+		default:
+			stress_usage();
+		}
+	}
+	if (!run_server && !run_clients)
+		stress_usage();
+
+	if (run_server) {
+		lsock = stress_listen(&srv_addr);
+		if (!run_clients) {
+			stress_serve(lsock, sink);
+			return (EXIT_SUCCESS);
+		}
+		if (pthread_create(&stid, NULL, server,
+		    (void *)(uintptr_t)lsock) != 0) {
+			err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+
+	stress_run(client, stress_seconds);
+
+	/*
+	 * On its own the client only knows what it handed to TCP; when the
+	 * server is here too, report what actually arrived.
+	 */
+	total = run_server ? nbytes : nsent;
+	return (stress_report(total, "bytes", "%llu Mbit/s over %u connections",
+	    (u_longlong_t)(total * 8 / stress_seconds / 1000000),
+	    stress_threads));
+}
@@ -499,7 +499,7 @@ aui_null,	AUE_SETEUID,	aus_seteuid,	/* 141 seteuid */
 		auf_null,	0,
 aui_forksys,	AUE_NULL,	aus_null,	/* 142 forksys */
 		auf_null,	0,
-aui_null,	AUE_NULL,	aus_null,	/* 143 (loadable) was fork1 */
+aui_null,	AUE_NULL,	aus_null,	/* 143 recvmmsg */
 		auf_null,	0,
 aui_null,	AUE_NULL,	aus_null,	/* 144 sigwait */
 		auf_null,	0,
@@ -507,8 +507,7 @@ aui_null,	AUE_NULL,	aus_null,	/* 145 lwp_info */
 		auf_null,	0,
 aui_null,	AUE_NULL,	aus_null,	/* 146 yield */
 		auf_null,	0,
-aui_null,	AUE_NULL,	aus_null,	/* 147 (loadable) */
-						/*	was lwp_sema_wait */
+aui_null,	AUE_NULL,	aus_null,	/* 147 sendmmsg */
 		auf_null,	0,
 aui_null,	AUE_NULL,	aus_null,	/* 148 lwp_sema_post */
 		auf_null,	0,
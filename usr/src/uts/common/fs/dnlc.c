@@ -54,6 +54,11 @@
 #include <sys/kstat.h>
 #include <sys/atomic.h>
 #include <sys/taskq.h>
+#include <sys/taskq_impl.h>
+#include <sys/cpuvar.h>
+#include <sys/vmsystm.h>
+#include <sys/zone.h>
+#include <sys/errno.h>
 
 /*
  * Directory name lookup cache.
@@ -90,7 +95,7 @@
 
 /*
  * Tunable nc_hashavelen is the average length desired for this chain, from
- * which the size of the nc_hash table is derived at create time.
+ * which the size of the nc_hash table is derived whenever ncsize changes.
  */
 #define	NC_HASHAVELEN_DEFAULT	4
 int nc_hashavelen = NC_HASHAVELEN_DEFAULT;
@@ -127,15 +132,30 @@ int nc_hashavelen = NC_HASHAVELEN_DEFAULT;
 
 /*
  * Hash table of name cache entries for fast lookup, dynamically
- * allocated at startup.
+ * allocated at startup and replaced by dnlc_resize() when ncsize
+ * changes.  nc_hash and nc_hashsz mirror the current table for mdb.
  */
+typedef struct nc_table {
+	int		nt_mask;	/* number of buckets minus 1 */
+	nc_hash_t	nt_hash[1];	/* the buckets */
+} nc_table_t;
+
+static nc_table_t * volatile nc_table;
 nc_hash_t *nc_hash;
 
+/*
+ * Bumped each time nc_table is replaced.  Purges that drop out of their
+ * epoch read section to release vnodes use it to notice that the table
+ * they were walking has gone away.
+ */
+static volatile uint_t dnlc_resize_gen;
+static kmutex_t dnlc_resize_lock;
+
 /*
  * Rotors. Used to select entries on a round-robin basis.
  */
-static nc_hash_t *dnlc_purge_fs1_rotor;
-static nc_hash_t *dnlc_free_rotor;
+static uint_t dnlc_purge_fs1_rotor;
+static uint_t dnlc_free_rotor;
 
 /*
  * # of dnlc entries (uninitialized)
@@ -147,7 +167,6 @@ static nc_hash_t *dnlc_free_rotor;
 int ncsize = -1;
 volatile uint32_t dnlc_nentries = 0;	/* current num of name cache entries */
 static int nc_hashsz;			/* size of hash table */
-static int nc_hashmask;			/* size of hash table minus 1 */
 
 /*
  * The dnlc_reduce_cache() taskq queue is activated when there are
@@ -183,6 +202,44 @@ uint64_t dnlc_max_nentries_cnt = 0; /* statistic on times we failed */
 #define	DNLC_LONG_CHAIN 8
 uint_t dnlc_long_chain = DNLC_LONG_CHAIN;
 
+/*
+ * ncsize is no longer fixed at boot.  When the cache is full and the last
+ * reduce scan found more than half of the entries it passed had been
+ * looked up since the scan before, the working set does not fit: rather
+ * than evict, the reduce taskq doubles ncsize (and grows the hash table
+ * to match), as long as memory is plentiful and ncsize stays below
+ * dnlc_ncsize_max.  Each call of dnlc_reduce_cache() with a percentage,
+ * which is how the ARC and others signal memory pressure, takes that
+ * percentage off ncsize again, down to the size chosen at boot.
+ *
+ * dnlc_ncsize_max defaults to DNLC_GROW_MAX_DEFAULT times the boot size,
+ * or to ncsize itself when that was set in /etc/system.
+ */
+#define	DNLC_GROW_MAX_DEFAULT	4
+int dnlc_ncsize_max = 0;
+static int dnlc_ncsize_min;
+static uint_t dnlc_scan_cnt;	/* entries passed by the last reduce scan */
+static uint_t dnlc_scan_refs;	/* ... of which had been looked up */
+
+/*
+ * Negative entries (DNLC_NO_VNODE) are cheap to keep, since they hold no
+ * vnode, but a workload probing for many names that do not exist can
+ * fill the cache with them.  Up to dnlc_neg_percent of ncsize they get
+ * the same second chance as other entries when recently looked up;
+ * beyond that the reduce taskq evicts them first.
+ */
+uint_t dnlc_neg_percent = 50;
+static volatile uint32_t dnlc_neg_nentries;
+
+/*
+ * Lookups walk the hash chain without hash_lock (see dnlc_lookup()).
+ * Setting dnlc_lockless to 0 sends every lookup down the locked path.
+ */
+boolean_t dnlc_lockless = B_TRUE;
+
+/* Longest chain a lockless walk follows before giving up on the walk */
+#define	DNLC_LOCKLESS_MAXWALK	32
+
 /*
  * ncstats has been deprecated, due to the integer size of the counters
  * which can easily overflow in the dnlc.
@@ -223,6 +280,17 @@ struct nc_stats ncs = {
 	{ "dir_fini_purge",		KSTAT_DATA_UINT64 },
 	{ "dir_reclaim_last",		KSTAT_DATA_UINT64 },
 	{ "dir_reclaim_any",		KSTAT_DATA_UINT64 },
+
+	/* name cache sizing and lockless lookup stats */
+
+	{ "entries",			KSTAT_DATA_UINT64 },
+	{ "negative_entries",		KSTAT_DATA_UINT64 },
+	{ "ncsize",			KSTAT_DATA_UINT64 },
+	{ "hash_size",			KSTAT_DATA_UINT64 },
+	{ "resizes",			KSTAT_DATA_UINT64 },
+	{ "lockless_hits",		KSTAT_DATA_UINT64 },
+	{ "lockless_misses",		KSTAT_DATA_UINT64 },
+	{ "lockless_retries",		KSTAT_DATA_UINT64 },
 };
 
 static int doingcache = 1;
@@ -230,34 +298,81 @@ static int doingcache = 1;
 vnode_t negative_cache_vnode;
 
 /*
- * Insert entry at the front of the queue
+ * Lookups walk the hash chains inside an epoch read section instead of
+ * under hash_lock, so removed entries and replaced hash tables are only
+ * freed once every read section that might still see them has ended.
+ * Each CPU counts its readers in the slot selected by the low bit of
+ * dnlc_epoch_idx; a grace period flips that bit and waits for the old
+ * slot of every CPU to drain, twice.
+ */
+#define	DNLC_EPOCH_ALIGN	64
+
+typedef union dnlc_epoch_u {
+	volatile uint_t	de_readers[2];
+	char		de_filler[DNLC_EPOCH_ALIGN];
+} dnlc_epoch_t;
+
+static dnlc_epoch_t	*dnlc_epoch;
+static volatile uint_t	dnlc_epoch_idx;
+static kmutex_t		dnlc_epoch_lock;	/* one grace period at a time */
+
+/*
+ * Entries waiting for a grace period before going back to kmem, chained
+ * through hash_prev.
+ */
+static kmutex_t		dnlc_reap_lock;
+static ncache_t		*dnlc_reap_list;
+static boolean_t	dnlc_reap_scheduled;
+static taskq_t		*dnlc_reap_taskq;
+static taskq_ent_t	dnlc_reap_ent;
+
+static zone_key_t	dnlc_zone_key;
+
+#define	NC_SIZE(ncp)	(sizeof (ncache_t) + (ncp)->namlen)
+
+/*
+ * Writers keep hash_gen odd while they change a chain, with barriers on
+ * either side so that a lockless walk which saw any part of the change
+ * also sees hash_gen differ from the value it started with.
+ */
+#define	NC_GEN_BEGIN(hp) \
+{ \
+	(hp)->hash_gen++; \
+	membar_producer(); \
+}
+
+#define	NC_GEN_END(hp) \
+{ \
+	membar_producer(); \
+	(hp)->hash_gen++; \
+}
+
+/*
+ * Insert entry at the front of the queue.  The entry must be fully
+ * initialised before it is linked in, as lockless lookups may find it
+ * straight away.
  */
 #define	nc_inshash(ncp, hp) \
 { \
+	NC_GEN_BEGIN(hp); \
 	(ncp)->hash_next = (hp)->hash_next; \
 	(ncp)->hash_prev = (ncache_t *)(hp); \
 	(hp)->hash_next->hash_prev = (ncp); \
 	(hp)->hash_next = (ncp); \
+	NC_GEN_END(hp); \
 }
 
 /*
  * Remove entry from hash queue
  */
-#define	nc_rmhash(ncp) \
+#define	nc_rmhash(ncp, hp) \
 { \
+	NC_GEN_BEGIN(hp); \
 	(ncp)->hash_prev->hash_next = (ncp)->hash_next; \
 	(ncp)->hash_next->hash_prev = (ncp)->hash_prev; \
 	(ncp)->hash_prev = NULL; \
 	(ncp)->hash_next = NULL; \
-}
-
-/*
- * Free an entry.
- */
-#define	dnlc_free(ncp) \
-{ \
-	kmem_free((ncp), sizeof (ncache_t) + (ncp)->namlen); \
-	atomic_dec_32(&dnlc_nentries); \
+	NC_GEN_END(hp); \
 }
 
 
@@ -325,8 +440,10 @@ static dchead_t dc_head; /* anchor of cached directories */
 
 /* Prototypes */
 static ncache_t *dnlc_get(uchar_t namlen);
-static ncache_t *dnlc_search(vnode_t *dp, const char *name, uchar_t namlen,
-    int hash);
+static ncache_t *dnlc_search(nc_hash_t *hp, vnode_t *dp, const char *name,
+    uchar_t namlen, int hash);
+static int dnlc_purge_common(boolean_t (*)(ncache_t *, void *),
+    boolean_t (*)(void *), void *, int);
 static void dnlc_dir_reclaim(void *unused);
 static void dnlc_dir_abort(dircache_t *dcp);
 static void dnlc_dir_adjust_fhash(dircache_t *dcp);
@@ -334,15 +451,328 @@ static void dnlc_dir_adjust_nhash(dircache_t *dcp);
 static void do_dnlc_reduce_cache(void *);
 
 
+/*
+ * Enter an epoch read section.  The returned pointer must be passed to
+ * dnlc_epoch_exit().  The section may block; being migrated to another CPU
+ * in the meantime only costs the locality of the counter.
+ */
+static volatile uint_t *
+dnlc_epoch_enter(void)
+{
+	volatile uint_t *cntp;
+
+	cntp = &dnlc_epoch[CPU->cpu_seqid].de_readers[dnlc_epoch_idx & 1];
+	atomic_inc_uint(cntp);
+	/* Pairs with the membar_enter() in dnlc_epoch_sync() */
+	membar_enter();
+	return (cntp);
+}
+
+static void
+dnlc_epoch_exit(volatile uint_t *cntp)
+{
+	membar_exit();
+	atomic_dec_uint(cntp);
+}
+
+static boolean_t
+dnlc_epoch_busy(uint_t idx)
+{
+	int i;
+
+	for (i = 0; i < max_ncpus; i++) {
+		if (dnlc_epoch[i].de_readers[idx] != 0)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Wait until every epoch read section that was active on entry has ended.
+ * Used by the reaper and by dnlc_resize(), one at a time.
+ */
+static void
+dnlc_epoch_sync(void)
+{
+	uint_t idx;
+	int i;
+
+	mutex_enter(&dnlc_epoch_lock);
+	for (i = 0; i < 2; i++) {
+		idx = dnlc_epoch_idx & 1;
+		dnlc_epoch_idx++;
+		membar_enter();
+		while (dnlc_epoch_busy(idx))
+			delay(1);
+	}
+	mutex_exit(&dnlc_epoch_lock);
+}
+
+/* ARGSUSED */
+static void
+dnlc_reap(void *arg)
+{
+	ncache_t *ncp, *next;
+
+	mutex_enter(&dnlc_reap_lock);
+	while ((ncp = dnlc_reap_list) != NULL) {
+		dnlc_reap_list = NULL;
+		mutex_exit(&dnlc_reap_lock);
+
+		dnlc_epoch_sync();
+		for (; ncp != NULL; ncp = next) {
+			next = ncp->hash_prev;
+			kmem_free(ncp, NC_SIZE(ncp));
+		}
+
+		mutex_enter(&dnlc_reap_lock);
+	}
+	dnlc_reap_scheduled = B_FALSE;
+	mutex_exit(&dnlc_reap_lock);
+}
+
+/*
+ * Undo the accounting done by dnlc_get().
+ */
+static void
+dnlc_uncharge(ncache_t *ncp)
+{
+	atomic_add_64(&ncp->zone->zone_dnlc_entries, -1);
+	atomic_add_64(&ncp->zone->zone_dnlc_bytes, -(int64_t)NC_SIZE(ncp));
+	atomic_dec_32(&dnlc_nentries);
+}
+
+/*
+ * Free an entry that has been removed from its hash chain.  Lockless
+ * lookups may still be looking at it, so it only goes back to kmem after
+ * a grace period; the frees are batched so one grace period covers all
+ * the entries removed while the previous one was running.
+ */
+static void
+dnlc_free(ncache_t *ncp)
+{
+	ASSERT(ncp->hash_next == NULL);
+
+	if (ncp->vp == DNLC_NO_VNODE)
+		atomic_dec_32(&dnlc_neg_nentries);
+	dnlc_uncharge(ncp);
+
+	mutex_enter(&dnlc_reap_lock);
+	ncp->hash_prev = dnlc_reap_list;
+	dnlc_reap_list = ncp;
+	if (!dnlc_reap_scheduled) {
+		dnlc_reap_scheduled = B_TRUE;
+		taskq_dispatch_ent(dnlc_reap_taskq, dnlc_reap, NULL, 0,
+		    &dnlc_reap_ent);
+	}
+	mutex_exit(&dnlc_reap_lock);
+}
+
+/*
+ * Free an entry that never made it onto a hash chain.
+ */
+static void
+dnlc_discard(ncache_t *ncp)
+{
+	dnlc_uncharge(ncp);
+	kmem_free(ncp, NC_SIZE(ncp));
+}
+
+#define	NC_TABLE_SIZE(size) \
+	(sizeof (nc_table_t) + ((size) - 1) * sizeof (nc_hash_t))
+
+static nc_table_t *
+dnlc_table_alloc(int size)
+{
+	nc_table_t *tbl;
+	nc_hash_t *hp;
+	int i;
+
+	ASSERT(ISP2(size));
+	tbl = kmem_zalloc(NC_TABLE_SIZE(size), KM_SLEEP);
+	tbl->nt_mask = size - 1;
+	for (i = 0; i < size; i++) {
+		hp = &tbl->nt_hash[i];
+		mutex_init(&hp->hash_lock, NULL, MUTEX_DEFAULT, NULL);
+		hp->hash_next = (ncache_t *)hp;
+		hp->hash_prev = (ncache_t *)hp;
+	}
+	return (tbl);
+}
+
+static void
+dnlc_table_free(nc_table_t *tbl)
+{
+	int i;
+
+	for (i = 0; i <= tbl->nt_mask; i++)
+		mutex_destroy(&tbl->nt_hash[i].hash_lock);
+	kmem_free(tbl, NC_TABLE_SIZE(tbl->nt_mask + 1));
+}
+
+/*
+ * Return the bucket of the current hash table for `hash', locked.  The
+ * table may be replaced while we wait for the lock; dnlc_resize() holds
+ * every bucket lock of the old table while it moves the entries, so once
+ * we have the lock and the table is still current it stays current until
+ * we let go.
+ */
+static nc_hash_t *
+dnlc_hash_lock(int hash)
+{
+	volatile uint_t *epoch;
+	nc_table_t *tbl;
+	nc_hash_t *hp;
+
+	epoch = dnlc_epoch_enter();
+	for (;;) {
+		tbl = nc_table;
+		hp = &tbl->nt_hash[hash & tbl->nt_mask];
+		mutex_enter(&hp->hash_lock);
+		if (tbl == nc_table)
+			break;
+		mutex_exit(&hp->hash_lock);
+	}
+	dnlc_epoch_exit(epoch);
+	return (hp);
+}
+
+/*
+ * Move all the entries over to a new hash table of `size' buckets.  The
+ * old table is locked throughout, with every hash_gen left odd, so
+ * lockless lookups on it fall back to dnlc_hash_lock() and end up on the
+ * new one.  It is freed once no lookup can still be walking it.
+ */
+static void
+dnlc_resize(int size)
+{
+	nc_table_t *otbl, *ntbl;
+	nc_hash_t *ohp, *nhp;
+	ncache_t *ncp;
+	int i;
+
+	ntbl = dnlc_table_alloc(size);
+
+	mutex_enter(&dnlc_resize_lock);
+	otbl = nc_table;
+	if (otbl->nt_mask == ntbl->nt_mask) {
+		mutex_exit(&dnlc_resize_lock);
+		dnlc_table_free(ntbl);
+		return;
+	}
+
+	for (i = 0; i <= otbl->nt_mask; i++) {
+		ohp = &otbl->nt_hash[i];
+		mutex_enter(&ohp->hash_lock);
+		NC_GEN_BEGIN(ohp);
+	}
+
+	/*
+	 * Take the entries from the tail and insert them at the head, so
+	 * that each chain keeps its LRU order.  The new table is not
+	 * visible yet, so it needs no barriers.
+	 */
+	for (i = 0; i <= otbl->nt_mask; i++) {
+		ohp = &otbl->nt_hash[i];
+		while ((ncp = ohp->hash_prev) != (ncache_t *)ohp) {
+			ncp->hash_prev->hash_next = ncp->hash_next;
+			ohp->hash_prev = ncp->hash_prev;
+
+			nhp = &ntbl->nt_hash[ncp->hash & ntbl->nt_mask];
+			ncp->hash_next = nhp->hash_next;
+			ncp->hash_prev = (ncache_t *)nhp;
+			nhp->hash_next->hash_prev = ncp;
+			nhp->hash_next = ncp;
+		}
+	}
+
+	membar_producer();
+	nc_table = ntbl;
+	nc_hash = ntbl->nt_hash;
+	nc_hashsz = size;
+	membar_producer();
+	dnlc_resize_gen++;
+	ncs.ncs_resizes.value.ui64++;
+
+	for (i = 0; i <= otbl->nt_mask; i++)
+		mutex_exit(&otbl->nt_hash[i].hash_lock);
+	mutex_exit(&dnlc_resize_lock);
+
+	dnlc_epoch_sync();
+	dnlc_table_free(otbl);
+}
+
+/*
+ * Set the limits that are derived from ncsize.
+ */
+static void
+dnlc_set_limits(void)
+{
+	dnlc_max_nentries = ncsize * 2;
+	ncsize_onepercent = ncsize / 100;
+	ncsize_min_percent = ncsize_onepercent * 3;
+}
+
+/*
+ * Change ncsize, resizing the hash table when its average chain length
+ * drifts too far from nc_hashavelen.  Shrinking waits until the table is
+ * four times too big, so the size does not flap.  Only called from the
+ * reduce taskq.
+ */
+static void
+dnlc_set_size(int size)
+{
+	int hashsz;
+
+	ncsize = size;
+	dnlc_nentries_low_water = size - (size / dnlc_low_water_divisor);
+	dnlc_set_limits();
+
+	hashsz = 1 << highbit(size / nc_hashavelen);
+	if (hashsz > nc_hashsz || hashsz <= nc_hashsz / 4)
+		dnlc_resize(hashsz);
+}
+
+/* ARGSUSED */
+static int
+dnlc_kstat_update(kstat_t *ksp, int rw)
+{
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	ncs.ncs_entries.value.ui64 = dnlc_nentries;
+	ncs.ncs_neg_entries.value.ui64 = dnlc_neg_nentries;
+	ncs.ncs_size.value.ui64 = ncsize;
+	ncs.ncs_hash_size.value.ui64 = nc_hashsz;
+	return (0);
+}
+
+static boolean_t
+dnlc_match_zone(ncache_t *ncp, void *arg)
+{
+	return (ncp->zone->zone_id == (zoneid_t)(uintptr_t)arg);
+}
+
+/*
+ * Entries are charged to the zone that entered them and point back at its
+ * zone_t, so they have to go before the zone does.
+ */
+/* ARGSUSED */
+static void
+dnlc_zone_destroy(zoneid_t zoneid, void *arg)
+{
+	(void) dnlc_purge_common(dnlc_match_zone, NULL,
+	    (void *)(uintptr_t)zoneid, 0);
+}
+
 /*
  * Initialize the directory cache.
  */
 void
 dnlc_init()
 {
-	nc_hash_t *hp;
+	boolean_t fixed = (ncsize != -1);
 	kstat_t *ksp;
-	int i;
 
 	/*
 	 * Set up the size of the dnlc (ncsize) and its low water mark.
@@ -364,29 +794,33 @@ dnlc_init()
 		cmn_err(CE_NOTE, "name cache (dnlc) disabled");
 		return;
 	}
-	dnlc_max_nentries = ncsize * 2;
-	ncsize_onepercent = ncsize / 100;
-	ncsize_min_percent = ncsize_onepercent * 3;
+	dnlc_set_limits();
 
 	/*
-	 * Initialise the hash table.
-	 * Compute hash size rounding to the next power of two.
+	 * The cache may grow from here under load and shrink back to here
+	 * under memory pressure.  A user specified ncsize is taken as
+	 * fixed, unless dnlc_ncsize_max was given as well.
 	 */
-	nc_hashsz = ncsize / nc_hashavelen;
-	nc_hashsz = 1 << highbit(nc_hashsz);
-	nc_hashmask = nc_hashsz - 1;
-	nc_hash = kmem_zalloc(nc_hashsz * sizeof (*nc_hash), KM_SLEEP);
-	for (i = 0; i < nc_hashsz; i++) {
-		hp = (nc_hash_t *)&nc_hash[i];
-		mutex_init(&hp->hash_lock, NULL, MUTEX_DEFAULT, NULL);
-		hp->hash_next = (ncache_t *)hp;
-		hp->hash_prev = (ncache_t *)hp;
-	}
+	if (dnlc_ncsize_max == 0)
+		dnlc_ncsize_max = fixed ? ncsize :
+		    ncsize * DNLC_GROW_MAX_DEFAULT;
+	dnlc_ncsize_max = MAX(dnlc_ncsize_max, ncsize);
+	dnlc_ncsize_min = ncsize;
+
+	mutex_init(&dnlc_resize_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&dnlc_epoch_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&dnlc_reap_lock, NULL, MUTEX_DEFAULT, NULL);
+	dnlc_epoch = kmem_zalloc(max_ncpus * sizeof (dnlc_epoch_t), KM_SLEEP);
+	dnlc_reap_taskq = taskq_create("dnlc_reap", 1, minclsyspri, 1, 1,
+	    TASKQ_PREPOPULATE);
 
 	/*
-	 * Initialize rotors
+	 * Initialise the hash table.
+	 * Compute hash size rounding to the next power of two.
 	 */
-	dnlc_free_rotor = dnlc_purge_fs1_rotor = &nc_hash[0];
+	nc_table = dnlc_table_alloc(1 << highbit(ncsize / nc_hashavelen));
+	nc_hash = nc_table->nt_hash;
+	nc_hashsz = nc_table->nt_mask + 1;
 
 	/*
 	 * Set up the directory caching to use kmem_cache_alloc
@@ -412,6 +846,8 @@ dnlc_init()
 	 */
 	vn_reinit(&negative_cache_vnode);
 
+	zone_key_create(&dnlc_zone_key, NULL, NULL, dnlc_zone_destroy);
+
 	/*
 	 * Initialise kstats - both the old compatability raw kind and
 	 * the more extensive named stats.
@@ -426,6 +862,7 @@ dnlc_init()
 	    sizeof (ncs) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
 	if (ksp) {
 		ksp->ks_data = (void *) &ncs;
+		ksp->ks_update = dnlc_kstat_update;
 		kstat_install(ksp);
 	}
 }
@@ -462,16 +899,16 @@ dnlc_enter(vnode_t *dp, const char *name, vnode_t *vp)
 	VN_HOLD_DNLC(vp);
 	bcopy(name, ncp->name, namlen + 1); /* name and null */
 	ncp->hash = hash;
-	hp = &nc_hash[hash & nc_hashmask];
+	ncp->referenced = 0;
 
-	mutex_enter(&hp->hash_lock);
-	if (dnlc_search(dp, name, namlen, hash) != NULL) {
+	hp = dnlc_hash_lock(hash);
+	if (dnlc_search(hp, dp, name, namlen, hash) != NULL) {
 		mutex_exit(&hp->hash_lock);
 		ncstats.dbl_enters++;
 		ncs.ncs_dbl_enters.value.ui64++;
 		VN_RELE_DNLC(dp);
 		VN_RELE_DNLC(vp);
-		dnlc_free(ncp);		/* crfree done here */
+		dnlc_discard(ncp);	/* crfree done here */
 		TRACE_2(TR_FAC_NFS, TR_DNLC_ENTER_END,
 		    "dnlc_enter_end:(%S) %d", "dbl enter", ncstats.dbl_enters);
 		return;
@@ -479,6 +916,8 @@ dnlc_enter(vnode_t *dp, const char *name, vnode_t *vp)
 	/*
 	 * Insert back into the hash chain.
 	 */
+	if (vp == DNLC_NO_VNODE)
+		atomic_inc_32(&dnlc_neg_nentries);
 	nc_inshash(ncp, hp);
 	mutex_exit(&hp->hash_lock);
 	ncstats.enters++;
@@ -536,14 +975,21 @@ dnlc_update(vnode_t *dp, const char *name, vnode_t *vp)
 	VN_HOLD_DNLC(vp);
 	bcopy(name, ncp->name, namlen + 1); /* name and null */
 	ncp->hash = hash;
-	hp = &nc_hash[hash & nc_hashmask];
+	ncp->referenced = 0;
 
-	mutex_enter(&hp->hash_lock);
-	if ((tcp = dnlc_search(dp, name, namlen, hash)) != NULL) {
+	hp = dnlc_hash_lock(hash);
+	if ((tcp = dnlc_search(hp, dp, name, namlen, hash)) != NULL) {
 		if (tcp->vp != vp) {
 			tvp = tcp->vp;
+			/* Let lockless lookups know the entry changed */
+			NC_GEN_BEGIN(hp);
 			tcp->vp = vp;
+			NC_GEN_END(hp);
 			mutex_exit(&hp->hash_lock);
+			if (tvp == DNLC_NO_VNODE)
+				atomic_dec_32(&dnlc_neg_nentries);
+			else if (vp == DNLC_NO_VNODE)
+				atomic_inc_32(&dnlc_neg_nentries);
 			VN_RELE_DNLC(tvp);
 			ncstats.enters++;
 			ncs.ncs_enters.value.ui64++;
@@ -559,12 +1005,14 @@ dnlc_update(vnode_t *dp, const char *name, vnode_t *vp)
 			    "dbl enter", ncstats.dbl_enters);
 		}
 		VN_RELE_DNLC(dp);
-		dnlc_free(ncp);		/* crfree done here */
+		dnlc_discard(ncp);	/* crfree done here */
 		return;
 	}
 	/*
 	 * insert the new entry, since it is not in dnlc yet
 	 */
+	if (vp == DNLC_NO_VNODE)
+		atomic_inc_32(&dnlc_neg_nentries);
 	nc_inshash(ncp, hp);
 	mutex_exit(&hp->hash_lock);
 	ncstats.enters++;
@@ -580,13 +1028,27 @@ dnlc_update(vnode_t *dp, const char *name, vnode_t *vp)
  * remain in the cache for other users, the other hold so that
  * the cache is not re-cycled and the identity of the vnode is
  * lost before the caller can use the vnode.
+ *
+ * The chain is first walked without hash_lock, inside an epoch read
+ * section which keeps the entries and the table from being freed under
+ * us.  A next pointer is only followed once hash_gen has been seen
+ * unchanged after loading it, so the walk never strays off the chain; a
+ * miss on a chain that did not change while we walked it is final.  A
+ * negative entry is returned without the lock too, as the negative cache
+ * vnode never goes away, but any other hit has to be confirmed under
+ * hash_lock, which is what keeps the vnode from being released before we
+ * have our hold on it.  Whenever the chain changed under us, the lookup
+ * is done again the old way.
  */
 vnode_t *
 dnlc_lookup(vnode_t *dp, const char *name)
 {
+	volatile uint_t *epoch;
+	nc_table_t *tbl;
 	ncache_t *ncp;
 	nc_hash_t *hp;
 	vnode_t *vp;
+	uint_t gen;
 	int hash, depth;
 	uchar_t namlen;
 
@@ -601,9 +1063,59 @@ dnlc_lookup(vnode_t *dp, const char *name)
 	}
 
 	DNLCHASH(name, dp, hash, namlen);
-	depth = 1;
-	hp = &nc_hash[hash & nc_hashmask];
+
+	if (!dnlc_lockless)
+		goto locked;
+
+	epoch = dnlc_epoch_enter();
+	tbl = nc_table;
+	hp = &tbl->nt_hash[hash & tbl->nt_mask];
+	gen = hp->hash_gen;
+	membar_consumer();
+	if (gen & 1)
+		goto retry;
+
+	for (depth = 0, ncp = hp->hash_next; ; ncp = ncp->hash_next) {
+		membar_consumer();
+		if (hp->hash_gen != gen || ++depth > DNLC_LOCKLESS_MAXWALK)
+			goto retry;
+		if (ncp == (ncache_t *)hp) {
+			dnlc_epoch_exit(epoch);
+			ncs.ncs_ll_misses.value.ui64++;
+			goto miss;
+		}
+		if (ncp->hash == hash &&	/* fast signature check */
+		    ncp->dp == dp &&
+		    ncp->namlen == namlen &&
+		    bcmp(ncp->name, name, namlen) == 0)
+			break;
+	}
+
+	if (ncp->referenced == 0)
+		ncp->referenced = 1;
+	vp = ncp->vp;
+	if (vp == DNLC_NO_VNODE) {
+		VN_HOLD_CALLER(vp);
+		dnlc_epoch_exit(epoch);
+		ncs.ncs_ll_hits.value.ui64++;
+		goto hit;
+	}
 	mutex_enter(&hp->hash_lock);
+	if (hp->hash_gen == gen) {
+		VN_HOLD_CALLER(vp);
+		mutex_exit(&hp->hash_lock);
+		dnlc_epoch_exit(epoch);
+		ncs.ncs_ll_hits.value.ui64++;
+		goto hit;
+	}
+	mutex_exit(&hp->hash_lock);
+retry:
+	dnlc_epoch_exit(epoch);
+	ncs.ncs_ll_retries.value.ui64++;
+
+locked:
+	depth = 1;
+	hp = dnlc_hash_lock(hash);
 
 	for (ncp = hp->hash_next; ncp != (ncache_t *)hp;
 	    ncp = ncp->hash_next) {
@@ -619,15 +1131,18 @@ dnlc_lookup(vnode_t *dp, const char *name)
 				ncache_t *next = ncp->hash_next;
 				ncache_t *prev = ncp->hash_prev;
 
+				NC_GEN_BEGIN(hp);
 				prev->hash_next = next;
 				next->hash_prev = prev;
 				ncp->hash_next = next = hp->hash_next;
 				ncp->hash_prev = (ncache_t *)hp;
 				next->hash_prev = ncp;
 				hp->hash_next = ncp;
+				NC_GEN_END(hp);
 
 				ncstats.move_to_front++;
 			}
+			ncp->referenced = 1;
 
 			/*
 			 * Put a hold on the vnode now so its identity
@@ -637,26 +1152,30 @@ dnlc_lookup(vnode_t *dp, const char *name)
 			vp = ncp->vp;
 			VN_HOLD_CALLER(vp);
 			mutex_exit(&hp->hash_lock);
-			ncstats.hits++;
-			ncs.ncs_hits.value.ui64++;
-			if (vp == DNLC_NO_VNODE) {
-				ncs.ncs_neg_hits.value.ui64++;
-			}
-			TRACE_4(TR_FAC_NFS, TR_DNLC_LOOKUP_END,
-			    "dnlc_lookup_end:%S %d vp %x name %s", "hit",
-			    ncstats.hits, vp, name);
-			return (vp);
+			goto hit;
 		}
 		depth++;
 	}
 
 	mutex_exit(&hp->hash_lock);
+miss:
 	ncstats.misses++;
 	ncs.ncs_misses.value.ui64++;
 	TRACE_4(TR_FAC_NFS, TR_DNLC_LOOKUP_END,
 	    "dnlc_lookup_end:%S %d vp %x name %s", "miss", ncstats.misses,
 	    NULL, name);
 	return (NULL);
+
+hit:
+	ncstats.hits++;
+	ncs.ncs_hits.value.ui64++;
+	if (vp == DNLC_NO_VNODE) {
+		ncs.ncs_neg_hits.value.ui64++;
+	}
+	TRACE_4(TR_FAC_NFS, TR_DNLC_LOOKUP_END,
+	    "dnlc_lookup_end:%S %d vp %x name %s", "hit",
+	    ncstats.hits, vp, name);
+	return (vp);
 }
 
 /*
@@ -673,14 +1192,13 @@ dnlc_remove(vnode_t *dp, const char *name)
 	if (!doingcache)
 		return;
 	DNLCHASH(name, dp, hash, namlen);
-	hp = &nc_hash[hash & nc_hashmask];
+	hp = dnlc_hash_lock(hash);
 
-	mutex_enter(&hp->hash_lock);
-	if (ncp = dnlc_search(dp, name, namlen, hash)) {
+	if (ncp = dnlc_search(hp, dp, name, namlen, hash)) {
 		/*
 		 * Free up the entry
 		 */
-		nc_rmhash(ncp);
+		nc_rmhash(ncp, hp);
 		mutex_exit(&hp->hash_lock);
 		VN_RELE_DNLC(ncp->vp);
 		VN_RELE_DNLC(ncp->dp);
@@ -691,51 +1209,122 @@ dnlc_remove(vnode_t *dp, const char *name)
 }
 
 /*
- * Purge the entire cache.
+ * Remove the entries for which match() returns true, or only the first
+ * `count' of them if count is not zero, and return the number removed.
+ * If done() is given, stop as soon as it returns true.
+ *
+ * The table is walked inside an epoch read section, which is left while
+ * the vnode holds are released; if the table was replaced in the
+ * meantime, start over on the new one.
  */
-void
-dnlc_purge()
+static int
+dnlc_purge_common(boolean_t (*match)(ncache_t *, void *),
+    boolean_t (*done)(void *), void *arg, int count)
 {
+	volatile uint_t *epoch;
+	nc_table_t *tbl;
 	nc_hash_t *nch;
 	ncache_t *ncp;
+	uint_t rgen;
+	int n = 0;
 	int index;
 	int i;
 	vnode_t *nc_rele[DNLC_MAX_RELE];
 
-	if (!doingcache)
-		return;
+	epoch = dnlc_epoch_enter();
+restart:
+	rgen = dnlc_resize_gen;
+	membar_consumer();
+	tbl = nc_table;
 
-	ncstats.purges++;
-	ncs.ncs_purge_all.value.ui64++;
-
-	for (nch = nc_hash; nch < &nc_hash[nc_hashsz]; nch++) {
+	for (i = 0; i <= tbl->nt_mask; i++) {
+		nch = &tbl->nt_hash[i];
 		index = 0;
 		mutex_enter(&nch->hash_lock);
+		if (rgen != dnlc_resize_gen) {
+			mutex_exit(&nch->hash_lock);
+			goto restart;
+		}
 		ncp = nch->hash_next;
 		while (ncp != (ncache_t *)nch) {
 			ncache_t *np;
 
 			np = ncp->hash_next;
-			nc_rele[index++] = ncp->vp;
-			nc_rele[index++] = ncp->dp;
-
-			nc_rmhash(ncp);
-			dnlc_free(ncp);
+			ASSERT(ncp->dp != NULL);
+			ASSERT(ncp->vp != NULL);
+			if (match(ncp, arg)) {
+				n++;
+				nc_rele[index++] = ncp->vp;
+				nc_rele[index++] = ncp->dp;
+				nc_rmhash(ncp, nch);
+				dnlc_free(ncp);
+				ncs.ncs_purge_total.value.ui64++;
+				if (index == DNLC_MAX_RELE) {
+					ncp = np;
+					break;
+				}
+				if (count != 0 && n >= count) {
+					break;
+				}
+			}
 			ncp = np;
-			ncs.ncs_purge_total.value.ui64++;
-			if (index == DNLC_MAX_RELE)
-				break;
 		}
 		mutex_exit(&nch->hash_lock);
 
 		/* Release holds on all the vnodes now that we have no locks */
-		for (i = 0; i < index; i++) {
-			VN_RELE_DNLC(nc_rele[i]);
+		if (index != 0) {
+			dnlc_epoch_exit(epoch);
+			while (index) {
+				VN_RELE_DNLC(nc_rele[--index]);
+			}
+			epoch = dnlc_epoch_enter();
+		}
+		if ((count != 0 && n >= count) ||
+		    (done != NULL && done(arg))) {
+			break;
 		}
+		if (rgen != dnlc_resize_gen)
+			goto restart;
 		if (ncp != (ncache_t *)nch) {
-			nch--; /* Do current hash chain again */
+			i--; /* Do current hash chain again */
 		}
 	}
+	dnlc_epoch_exit(epoch);
+	return (n);
+}
+
+/* ARGSUSED */
+static boolean_t
+dnlc_match_all(ncache_t *ncp, void *arg)
+{
+	return (B_TRUE);
+}
+
+/*
+ * Purge the entire cache.
+ */
+void
+dnlc_purge()
+{
+	if (!doingcache)
+		return;
+
+	ncstats.purges++;
+	ncs.ncs_purge_all.value.ui64++;
+
+	(void) dnlc_purge_common(dnlc_match_all, NULL, NULL, 0);
+}
+
+static boolean_t
+dnlc_match_vp(ncache_t *ncp, void *arg)
+{
+	return (ncp->dp == arg || ncp->vp == arg);
+}
+
+static boolean_t
+dnlc_done_vp(void *arg)
+{
+	return (((vnode_t *)arg)->v_count_dnlc == 0);
 }
 
 /*
@@ -745,11 +1334,6 @@ dnlc_purge()
 void
 dnlc_purge_vp(vnode_t *vp)
 {
-	nc_hash_t *nch;
-	ncache_t *ncp;
-	int index;
-	vnode_t *nc_rele[DNLC_MAX_RELE];
-
 	ASSERT(vp->v_count > 0);
 	if (vp->v_count_dnlc == 0) {
 		return;
@@ -761,42 +1345,13 @@ dnlc_purge_vp(vnode_t *vp)
 	ncstats.purges++;
 	ncs.ncs_purge_vp.value.ui64++;
 
-	for (nch = nc_hash; nch < &nc_hash[nc_hashsz]; nch++) {
-		index = 0;
-		mutex_enter(&nch->hash_lock);
-		ncp = nch->hash_next;
-		while (ncp != (ncache_t *)nch) {
-			ncache_t *np;
-
-			np = ncp->hash_next;
-			if (ncp->dp == vp || ncp->vp == vp) {
-				nc_rele[index++] = ncp->vp;
-				nc_rele[index++] = ncp->dp;
-				nc_rmhash(ncp);
-				dnlc_free(ncp);
-				ncs.ncs_purge_total.value.ui64++;
-				if (index == DNLC_MAX_RELE) {
-					ncp = np;
-					break;
-				}
-			}
-			ncp = np;
-		}
-		mutex_exit(&nch->hash_lock);
-
-		/* Release holds on all the vnodes now that we have no locks */
-		while (index) {
-			VN_RELE_DNLC(nc_rele[--index]);
-		}
-
-		if (vp->v_count_dnlc == 0) {
-			return;
-		}
+	(void) dnlc_purge_common(dnlc_match_vp, dnlc_done_vp, vp, 0);
+}
 
-		if (ncp != (ncache_t *)nch) {
-			nch--; /* Do current hash chain again */
-		}
-	}
+static boolean_t
+dnlc_match_vfsp(ncache_t *ncp, void *arg)
+{
+	return (ncp->dp->v_vfsp == arg || ncp->vp->v_vfsp == arg);
 }
 
 /*
@@ -808,60 +1363,13 @@ dnlc_purge_vp(vnode_t *vp)
 int
 dnlc_purge_vfsp(vfs_t *vfsp, int count)
 {
-	nc_hash_t *nch;
-	ncache_t *ncp;
-	int n = 0;
-	int index;
-	int i;
-	vnode_t *nc_rele[DNLC_MAX_RELE];
-
 	if (!doingcache)
 		return (0);
 
 	ncstats.purges++;
 	ncs.ncs_purge_vfs.value.ui64++;
 
-	for (nch = nc_hash; nch < &nc_hash[nc_hashsz]; nch++) {
-		index = 0;
-		mutex_enter(&nch->hash_lock);
-		ncp = nch->hash_next;
-		while (ncp != (ncache_t *)nch) {
-			ncache_t *np;
-
-			np = ncp->hash_next;
-			ASSERT(ncp->dp != NULL);
-			ASSERT(ncp->vp != NULL);
-			if ((ncp->dp->v_vfsp == vfsp) ||
-			    (ncp->vp->v_vfsp == vfsp)) {
-				n++;
-				nc_rele[index++] = ncp->vp;
-				nc_rele[index++] = ncp->dp;
-				nc_rmhash(ncp);
-				dnlc_free(ncp);
-				ncs.ncs_purge_total.value.ui64++;
-				if (index == DNLC_MAX_RELE) {
-					ncp = np;
-					break;
-				}
-				if (count != 0 && n >= count) {
-					break;
-				}
-			}
-			ncp = np;
-		}
-		mutex_exit(&nch->hash_lock);
-		/* Release holds on all the vnodes now that we have no locks */
-		for (i = 0; i < index; i++) {
-			VN_RELE_DNLC(nc_rele[i]);
-		}
-		if (count != 0 && n >= count) {
-			return (n);
-		}
-		if (ncp != (ncache_t *)nch) {
-			nch--; /* Do current hash chain again */
-		}
-	}
-	return (n);
+	return (dnlc_purge_common(dnlc_match_vfsp, NULL, vfsp, count));
 }
 
 /*
@@ -878,10 +1386,12 @@ dnlc_purge_vfsp(vfs_t *vfsp, int count)
 int
 dnlc_fs_purge1(vnodeops_t *vop)
 {
-	nc_hash_t *end;
+	volatile uint_t *epoch;
+	nc_table_t *tbl;
 	nc_hash_t *hp;
 	ncache_t *ncp;
 	vnode_t *vp;
+	uint_t i, end;
 
 	if (!doingcache)
 		return (0);
@@ -891,15 +1401,22 @@ dnlc_fs_purge1(vnodeops_t *vop)
 	/*
 	 * Scan the dnlc entries looking for a likely candidate.
 	 */
-	hp = end = dnlc_purge_fs1_rotor;
+	epoch = dnlc_epoch_enter();
+	tbl = nc_table;
+	i = end = dnlc_purge_fs1_rotor & tbl->nt_mask;
 
 	do {
-		if (++hp == &nc_hash[nc_hashsz])
-			hp = nc_hash;
-		dnlc_purge_fs1_rotor = hp;
+		i = (i + 1) & tbl->nt_mask;
+		dnlc_purge_fs1_rotor = i;
+		hp = &tbl->nt_hash[i];
 		if (hp->hash_next == (ncache_t *)hp)
 			continue;
 		mutex_enter(&hp->hash_lock);
+		if (tbl != nc_table) {
+			/* resized under us; leave it to the next call */
+			mutex_exit(&hp->hash_lock);
+			break;
+		}
 		for (ncp = hp->hash_prev;
 		    ncp != (ncache_t *)hp;
 		    ncp = ncp->hash_prev) {
@@ -909,8 +1426,9 @@ dnlc_fs_purge1(vnodeops_t *vop)
 				break;
 		}
 		if (ncp != (ncache_t *)hp) {
-			nc_rmhash(ncp);
+			nc_rmhash(ncp, hp);
 			mutex_exit(&hp->hash_lock);
+			dnlc_epoch_exit(epoch);
 			VN_RELE_DNLC(ncp->dp);
 			VN_RELE_DNLC(vp)
 			dnlc_free(ncp);
@@ -918,21 +1436,22 @@ dnlc_fs_purge1(vnodeops_t *vop)
 			return (1);
 		}
 		mutex_exit(&hp->hash_lock);
-	} while (hp != end);
+	} while (i != end);
+	dnlc_epoch_exit(epoch);
 	return (0);
 }
 
 /*
- * Utility routine to search for a cache entry. Return the
- * ncache entry if found, NULL otherwise.
+ * Utility routine to search a locked hash chain for a cache entry.
+ * Return the ncache entry if found, NULL otherwise.
  */
 static ncache_t *
-dnlc_search(vnode_t *dp, const char *name, uchar_t namlen, int hash)
+dnlc_search(nc_hash_t *hp, vnode_t *dp, const char *name, uchar_t namlen,
+    int hash)
 {
-	nc_hash_t *hp;
 	ncache_t *ncp;
 
-	hp = &nc_hash[hash & nc_hashmask];
+	ASSERT(MUTEX_HELD(&hp->hash_lock));
 
 	for (ncp = hp->hash_next; ncp != (ncache_t *)hp; ncp = ncp->hash_next) {
 		if (ncp->hash == hash &&
@@ -964,7 +1483,7 @@ dnlc_reduce_cache(void *reduce_percent)
  * If the dnlc_reduce_cache() taskq isn't keeping up with demand, or memory
  * is short then just return NULL. If we're over ncsize then kick off a
  * thread to free some in use entries down to dnlc_nentries_low_water.
- * Caller must initialise all fields except namlen.
+ * Caller must initialise all fields except namlen and zone.
  * Component names are defined to be less than MAXNAMELEN
  * which includes a null.
  */
@@ -982,29 +1501,61 @@ dnlc_get(uchar_t namlen)
 		return (NULL);
 	}
 	ncp->namlen = namlen;
+	ncp->zone = curzone;
+	atomic_add_64(&ncp->zone->zone_dnlc_entries, 1);
+	atomic_add_64(&ncp->zone->zone_dnlc_bytes, NC_SIZE(ncp));
 	atomic_inc_32(&dnlc_nentries);
 	dnlc_reduce_cache(NULL);
 	return (ncp);
 }
 
+/*
+ * Should the cache grow rather than be reduced?  Only if the last reduce
+ * scan had to pass over mostly entries in active use, there is room to
+ * grow and memory is not getting short.
+ */
+static boolean_t
+dnlc_want_grow(void)
+{
+	return (ncsize < dnlc_ncsize_max && dnlc_scan_cnt != 0 &&
+	    dnlc_scan_refs > dnlc_scan_cnt / 2 &&
+	    freemem > lotsfree + desfree);
+}
+
 /*
  * Taskq routine to free up name cache entries to reduce the
  * cache size to the low water mark if "reduce_percent" is not provided.
  * If "reduce_percent" is provided, reduce cache size by
- * (ncsize_onepercent * reduce_percent).
+ * (ncsize_onepercent * reduce_percent), and shrink ncsize by as much
+ * if it has grown.
+ *
+ * Entries that have been looked up since the last pass get a second
+ * chance: the scan clears their referenced bit and passes over them,
+ * unless they are negative entries and those are over their share.
  */
 /*ARGSUSED*/
 static void
 do_dnlc_reduce_cache(void *reduce_percent)
 {
-	nc_hash_t *hp = dnlc_free_rotor, *start_hp = hp;
+	volatile uint_t *epoch;
+	nc_table_t *tbl;
+	nc_hash_t *hp;
 	vnode_t *vp;
 	ncache_t *ncp;
 	int cnt;
-	uint_t low_water = dnlc_nentries_low_water;
+	uint_t i, start;
+	uint_t low_water;
+	uint_t neg_max;
 
 	if (reduce_percent) {
 		uint_t reduce_cnt;
+		int size;
+
+		if (ncsize > dnlc_ncsize_min) {
+			size = ncsize - ncsize / 100 *
+			    (uint_t)(uintptr_t)reduce_percent;
+			dnlc_set_size(MAX(size, dnlc_ncsize_min));
+		}
 
 		/*
 		 * Never try to reduce the current number
@@ -1022,7 +1573,20 @@ do_dnlc_reduce_cache(void *reduce_percent)
 			low_water = ncsize_min_percent;
 		else
 			low_water = dnlc_nentries - reduce_cnt;
+	} else if (dnlc_want_grow()) {
+		dnlc_set_size(MIN(ncsize * 2, dnlc_ncsize_max));
+		dnlc_scan_cnt = dnlc_scan_refs = 0;
+		dnlc_reduce_idle = 1;
+		return;
+	} else {
+		low_water = dnlc_nentries_low_water;
 	}
+	neg_max = ncsize / 100 * dnlc_neg_percent;
+	dnlc_scan_cnt = dnlc_scan_refs = 0;
+
+	epoch = dnlc_epoch_enter();
+	tbl = nc_table;
+	i = start = dnlc_free_rotor & tbl->nt_mask;
 
 	do {
 		/*
@@ -1030,30 +1594,42 @@ do_dnlc_reduce_cache(void *reduce_percent)
 		 * Only look at each hash queue once to avoid an infinite loop.
 		 */
 		do {
-			if (++hp == &nc_hash[nc_hashsz])
-				hp = nc_hash;
-		} while (hp->hash_next == (ncache_t *)hp && hp != start_hp);
+			i = (i + 1) & tbl->nt_mask;
+			hp = &tbl->nt_hash[i];
+		} while (hp->hash_next == (ncache_t *)hp && i != start);
 
-		/* return if all hash queues are empty. */
-		if (hp->hash_next == (ncache_t *)hp) {
-			dnlc_reduce_idle = 1;
-			return;
-		}
+		/* stop if all hash queues are empty. */
+		if (hp->hash_next == (ncache_t *)hp)
+			break;
 
 		mutex_enter(&hp->hash_lock);
+		if (tbl != nc_table) {
+			mutex_exit(&hp->hash_lock);
+			tbl = nc_table;
+			i = start = i & tbl->nt_mask;
+			continue;
+		}
 		for (cnt = 0, ncp = hp->hash_prev; ncp != (ncache_t *)hp;
 		    ncp = ncp->hash_prev, cnt++) {
 			vp = ncp->vp;
 			/*
 			 * A name cache entry with a reference count
 			 * of one is only referenced by the dnlc.
-			 * Also negative cache entries are purged first.
+			 * Negative cache entries are purged first
+			 * when there are too many of them.
 			 */
-			if (!vn_has_cached_data(vp) &&
-			    ((vp->v_count == 1) || (vp == DNLC_NO_VNODE))) {
+			if (vp == DNLC_NO_VNODE ?
+			    (dnlc_neg_nentries > neg_max || !ncp->referenced) :
+			    (!ncp->referenced && !vn_has_cached_data(vp) &&
+			    vp->v_count == 1)) {
 				ncs.ncs_pick_heur.value.ui64++;
 				goto found;
 			}
+			dnlc_scan_cnt++;
+			if (ncp->referenced) {
+				ncp->referenced = 0;
+				dnlc_scan_refs++;
+			}
 			/*
 			 * Remove from the end of the chain if the
 			 * chain is too long
@@ -1078,14 +1654,25 @@ found:
 		/*
 		 * Remove from hash chain.
 		 */
-		nc_rmhash(ncp);
+		nc_rmhash(ncp, hp);
 		mutex_exit(&hp->hash_lock);
+		dnlc_epoch_exit(epoch);
 		VN_RELE_DNLC(vp);
 		VN_RELE_DNLC(ncp->dp);
 		dnlc_free(ncp);
+
+		/*
+		 * The table may have been replaced while we were outside
+		 * the read section, possibly by one at the same address.
+		 */
+		epoch = dnlc_epoch_enter();
+		tbl = nc_table;
+		i &= tbl->nt_mask;
+		start &= tbl->nt_mask;
 	} while (dnlc_nentries > low_water);
 
-	dnlc_free_rotor = hp;
+	dnlc_epoch_exit(epoch);
+	dnlc_free_rotor = i;
 	dnlc_reduce_idle = 1;
 }
 
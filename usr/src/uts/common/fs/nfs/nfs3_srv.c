@@ -1129,7 +1129,8 @@ rfs3_read(READ3args *args, READ3res *resp, struct exportinfo *exi,
 	if (args->count > rfs3_tsize(req))
 		args->count = rfs3_tsize(req);
 
-	if (loaned_buffers) {
+	if (loaned_buffers &&
+	    rfs_zcopy_aligned(&va, args->offset, args->count)) {
 		uiop = (uio_t *)rfs_setup_xuio(vp);
 		ASSERT(uiop != NULL);
 		uiop->uio_segflg = UIO_SYSSPACE;
@@ -1152,8 +1153,8 @@ rfs3_read(READ3args *args, READ3res *resp, struct exportinfo *exi,
 		uiop->uio_extflg = 0;
 		/* failure to setup for zero copy */
 		rfs_free_xuio((void *)uiop);
-		loaned_buffers = 0;
 	}
+	loaned_buffers = 0;
 
 	/*
 	 * If returning data via RDMA Write, then grab the chunk list.
@@ -1189,6 +1190,8 @@ doio_read:
 	if (error) {
 		if (mp)
 			freemsg(mp);
+		if (loaned_buffers)
+			rfs_free_xuio((void *)uiop);
 		/* check if a monitor detected a delegation conflict */
 		if (error == EAGAIN && (ct.cc_flags & CC_WOULDBLOCK)) {
 			resp->status = NFS3ERR_JUKEBOX;
@@ -1202,6 +1205,8 @@ doio_read:
 		mp = uio_to_mblk(uiop);
 		ASSERT(mp != NULL);
 	}
+	rfs_zcopy_count(NFS_V3, loaned_buffers ? NFS_READ_ZCOPY :
+	    NFS_READ_COPIED, args->count - uiop->uio_resid);
 
 	va.va_mask = AT_ALL;
 	error = VOP_GETATTR(vp, &va, 0, cr, &ct);
@@ -1315,12 +1320,13 @@ rfs3_write(WRITE3args *args, WRITE3res *resp, struct exportinfo *exi,
 	struct vattr *avap = NULL;
 	struct vattr ava;
 	u_offset_t rlimit;
-	struct uio uio;
+	struct uio uio, *uiop;
 	struct iovec iov[MAX_IOVECS];
 	mblk_t *m;
 	struct iovec *iovp;
 	int iovcnt;
 	int ioflag;
+	ssize_t resid;
 	cred_t *savecred;
 	int in_crit = 0;
 	int rwlock_ret = -1;
@@ -1485,6 +1491,15 @@ rfs3_write(WRITE3args *args, WRITE3res *resp, struct exportinfo *exi,
 		goto err1;
 	}
 
+	/*
+	 * Data that arrived over TCP may be copied into buffers lent by
+	 * the file system, which then takes them over without copying
+	 * them again.
+	 */
+	uiop = &uio;
+	if (args->mblk != NULL)
+		uiop = rfs_write_xuio(vp, &uio, cr, &ct);
+
 	/*
 	 * We're changing creds because VM may fault and we need
 	 * the cred of the current thread to be used if quota
@@ -1492,12 +1507,18 @@ rfs3_write(WRITE3args *args, WRITE3res *resp, struct exportinfo *exi,
 	 */
 	savecred = curthread->t_cred;
 	curthread->t_cred = cr;
-	error = VOP_WRITE(vp, &uio, ioflag, cr, &ct);
+	error = VOP_WRITE(vp, uiop, ioflag, cr, &ct);
 	curthread->t_cred = savecred;
 
 	if (iovp != iov)
 		kmem_free(iovp, sizeof (*iovp) * iovcnt);
 
+	resid = uiop->uio_resid;
+	rfs_zcopy_count(NFS_V3, uiop != &uio ? NFS_WRITE_LOANED :
+	    NFS_WRITE_COPIED, args->count - resid);
+	if (uiop != &uio)
+		rfs_free_xuio((void *)uiop);
+
 	/* check if a monitor detected a delegation conflict */
 	if (error == EAGAIN && (ct.cc_flags & CC_WOULDBLOCK)) {
 		resp->status = NFS3ERR_JUKEBOX;
@@ -1527,7 +1548,7 @@ rfs3_write(WRITE3args *args, WRITE3res *resp, struct exportinfo *exi,
 
 	resp->status = NFS3_OK;
 	vattr_to_wcc_data(bvap, avap, &resp->resok.file_wcc);
-	resp->resok.count = args->count - uio.uio_resid;
+	resp->resok.count = args->count - resid;
 	resp->resok.committed = args->stable;
 	resp->resok.verf = ns->write3verf;
 	goto out;
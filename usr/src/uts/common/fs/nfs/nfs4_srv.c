@@ -3287,7 +3287,7 @@ rfs4_op_read(nfs_argop4 *argop, nfs_resop4 *resop, struct svc_req *req,
 	/* use loaned buffers for TCP */
 	loaned_buffers = (nfs_loaned_buffers && !rdma_used) ? 1 : 0;
 
-	va.va_mask = AT_MODE|AT_SIZE|AT_UID;
+	va.va_mask = AT_MODE|AT_SIZE|AT_UID|AT_BLKSIZE;
 	verror = VOP_GETATTR(vp, &va, 0, cs->cr, &ct);
 
 	/*
@@ -3354,7 +3354,8 @@ rfs4_op_read(nfs_argop4 *argop, nfs_resop4 *resop, struct svc_req *req,
 	if (args->count > rfs4_tsize(req))
 		args->count = rfs4_tsize(req);
 
-	if (loaned_buffers) {
+	if (loaned_buffers &&
+	    rfs_zcopy_aligned(&va, args->offset, args->count)) {
 		uiop = (uio_t *)rfs_setup_xuio(vp);
 		ASSERT(uiop != NULL);
 		uiop->uio_segflg = UIO_SYSSPACE;
@@ -3378,8 +3379,8 @@ rfs4_op_read(nfs_argop4 *argop, nfs_resop4 *resop, struct svc_req *req,
 
 		/* failure to setup for zero copy */
 		rfs_free_xuio((void *)uiop);
-		loaned_buffers = 0;
 	}
+	loaned_buffers = 0;
 
 	/*
 	 * If returning data via RDMA Write, then grab the chunk list. If we
@@ -3417,6 +3418,8 @@ doio_read:
 	if (error) {
 		if (mp)
 			freemsg(mp);
+		if (loaned_buffers)
+			rfs_free_xuio((void *)uiop);
 		*cs->statusp = resp->status = puterrno4(error);
 		goto out;
 	}
@@ -3426,6 +3429,8 @@ doio_read:
 		mp = uio_to_mblk(uiop);
 		ASSERT(mp != NULL);
 	}
+	rfs_zcopy_count(NFS_V4, loaned_buffers ? NFS_READ_ZCOPY :
+	    NFS_READ_COPIED, args->count - uiop->uio_resid);
 
 	*cs->statusp = resp->status = NFS4_OK;
 
@@ -5594,11 +5599,12 @@ rfs4_op_write(nfs_argop4 *argop, nfs_resop4 *resop, struct svc_req *req,
 	vnode_t *vp;
 	struct vattr bva;
 	u_offset_t rlimit;
-	struct uio uio;
+	struct uio uio, *uiop;
 	struct iovec iov[MAX_IOVECS];
 	struct iovec *iovp;
 	int iovcnt;
 	int ioflag;
+	ssize_t resid;
 	cred_t *savecred, *cr;
 	bool_t *deleg = &cs->deleg;
 	nfsstat4 stat;
@@ -5750,6 +5756,15 @@ rfs4_op_write(nfs_argop4 *argop, nfs_resop4 *resop, struct svc_req *req,
 		goto out;
 	}
 
+	/*
+	 * Data that arrived over TCP may be copied into buffers lent by
+	 * the file system, which then takes them over without copying
+	 * them again.
+	 */
+	uiop = &uio;
+	if (args->mblk != NULL)
+		uiop = rfs_write_xuio(vp, &uio, cr, &ct);
+
 	/*
 	 * We're changing creds because VM may fault and we need
 	 * the cred of the current thread to be used if quota
@@ -5757,19 +5772,25 @@ rfs4_op_write(nfs_argop4 *argop, nfs_resop4 *resop, struct svc_req *req,
 	 */
 	savecred = curthread->t_cred;
 	curthread->t_cred = cr;
-	error = do_io(FWRITE, vp, &uio, ioflag, cr, &ct);
+	error = do_io(FWRITE, vp, uiop, ioflag, cr, &ct);
 	curthread->t_cred = savecred;
 
 	if (iovp != iov)
 		kmem_free(iovp, sizeof (*iovp) * iovcnt);
 
+	resid = uiop->uio_resid;
+	rfs_zcopy_count(NFS_V4, uiop != &uio ? NFS_WRITE_LOANED :
+	    NFS_WRITE_COPIED, args->data_len - resid);
+	if (uiop != &uio)
+		rfs_free_xuio((void *)uiop);
+
 	if (error) {
 		*cs->statusp = resp->status = puterrno4(error);
 		goto out;
 	}
 
 	*cs->statusp = resp->status = NFS4_OK;
-	resp->count = args->data_len - uio.uio_resid;
+	resp->count = args->data_len - resid;
 
 	if (ioflag == 0)
 		resp->committed = UNSTABLE4;
@@ -113,7 +113,12 @@ list_t		nfssrv_globals_list;
 krwlock_t	nfssrv_globals_rwl;
 
 kmem_cache_t *nfs_xuio_cache;
-int nfs_loaned_buffers = 0;
+
+/*
+ * Use buffers lent by the file system (VOP_REQZCBUF) for READ and WRITE
+ * data of block aligned transfers of at least a block.
+ */
+int nfs_loaned_buffers = 1;
 
 /* array of paths passed-in from nfsd command-line; stored in nvlist */
 char		**rfs4_dss_newpaths;
@@ -3276,6 +3281,75 @@ rfs_setup_xuio(vnode_t *vp)
 	return (&nfsuiop->nu_uio);
 }
 
+/*
+ * Whether a transfer of `count' bytes at `offset' is worth doing through
+ * loaned buffers: it must start on a block boundary of the file and cover
+ * at least a whole block.
+ */
+boolean_t
+rfs_zcopy_aligned(vattr_t *vap, offset_t offset, size_t count)
+{
+	u_longlong_t blksize = vap->va_blksize;
+
+	return (nfs_loaned_buffers && blksize != 0 && count >= blksize &&
+	    P2PHASE(offset, blksize) == 0);
+}
+
+/*
+ * Copy the data of a WRITE into buffers lent by the file system, if it
+ * lends any for this range.  The data is still copied once out of the
+ * request, but the file system then takes the buffers over whole rather
+ * than copying them again into its own.  Returns the uio to write from:
+ * either an xuio of loaned buffers, to be released with rfs_free_xuio()
+ * after the write, or uiop itself.
+ */
+uio_t *
+rfs_write_xuio(vnode_t *vp, uio_t *uiop, cred_t *cr, caller_context_t *ct)
+{
+	uio_t *xuiop;
+	int i;
+
+	if (!nfs_loaned_buffers)
+		return (uiop);
+
+	xuiop = (uio_t *)rfs_setup_xuio(vp);
+	xuiop->uio_segflg = UIO_SYSSPACE;
+	xuiop->uio_loffset = uiop->uio_loffset;
+	xuiop->uio_resid = uiop->uio_resid;
+	xuiop->uio_llimit = uiop->uio_llimit;
+
+	if (VOP_REQZCBUF(vp, UIO_WRITE, (xuio_t *)xuiop, cr, ct) != 0) {
+		xuiop->uio_extflg = 0;
+		rfs_free_xuio((void *)xuiop);
+		return (uiop);
+	}
+
+	/* Need to hold the vnode until after VOP_RETZCBUF() is called. */
+	VN_HOLD(vp);
+
+	for (i = 0; i < xuiop->uio_iovcnt; i++) {
+		iovec_t *iovp = &xuiop->uio_iov[i];
+
+		(void) uiomove(iovp->iov_base, iovp->iov_len, UIO_WRITE, uiop);
+	}
+	ASSERT(uiop->uio_resid == 0);
+
+	return (xuiop);
+}
+
+/*
+ * Account NFSv3 or NFSv4 READ or WRITE data as moved through loaned
+ * buffers or not.
+ */
+void
+rfs_zcopy_count(int vers, enum nfs_svzccounts which, size_t bytes)
+{
+	kstat_named_t *svzcstat = nfs_srv_getzg()->svzcstat[vers];
+
+	ASSERT(vers == NFS_V3 || vers == NFS_V4);
+	atomic_add_64(&svzcstat[which].value.ui64, bytes);
+}
+
 mblk_t *
 uio_to_mblk(uio_t *uiop)
 {
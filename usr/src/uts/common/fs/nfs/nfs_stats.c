@@ -89,6 +89,20 @@ static const kstat_named_t svstat_tmpl[] = {
 	{ "referlinks",	KSTAT_DATA_UINT64 },
 };
 
+/*
+ * READ and WRITE data of the NFSv3 and NFSv4 servers, by whether it went
+ * through buffers lent by the file system.  Loaned READ buffers are sent
+ * as they are; loaned WRITE buffers still take one copy out of the RPC
+ * mblks, but are then taken over by the file system without another.
+ * Kept apart from nfs_server, which nfsstat -s prints whole.
+ */
+static const kstat_named_t svzcstat_tmpl[] = {
+	{ "read_zcopy_bytes",	KSTAT_DATA_UINT64 },
+	{ "read_copied_bytes",	KSTAT_DATA_UINT64 },
+	{ "write_loaned_bytes",	KSTAT_DATA_UINT64 },
+	{ "write_copied_bytes",	KSTAT_DATA_UINT64 },
+};
+
 static void
 nfsstat_zone_init_server(zoneid_t zoneid, kstat_named_t *svstatp[])
 {
@@ -100,6 +114,29 @@ nfsstat_zone_init_server(zoneid_t zoneid, kstat_named_t *svstatp[])
 	}
 }
 
+static void
+nfsstat_zone_init_server_zcopy(zoneid_t zoneid, kstat_named_t *svzcstatp[])
+{
+	int vers;
+
+	for (vers = NFS_V3; vers <= NFS_V4; vers++) {
+		svzcstatp[vers] = nfsstat_zone_init_common(zoneid, "nfs", vers,
+		    "nfs_server_zcopy", svzcstat_tmpl, sizeof (svzcstat_tmpl));
+	}
+}
+
+static void
+nfsstat_zone_fini_server_zcopy(zoneid_t zoneid, kstat_named_t *svzcstatp[])
+{
+	int vers;
+
+	for (vers = NFS_V3; vers <= NFS_V4; vers++) {
+		nfsstat_zone_fini_common(zoneid, "nfs", vers,
+		    "nfs_server_zcopy");
+		kmem_free(svzcstatp[vers], sizeof (svzcstat_tmpl));
+	}
+}
+
 static void
 nfsstat_zone_fini_server(zoneid_t zoneid, kstat_named_t *svstatp[])
 {
@@ -506,6 +543,7 @@ rfs_stat_zone_init(nfs_globals_t *ng)
 
 	/* Initialize all versions of the nfs_server */
 	nfsstat_zone_init_server(zoneid, ng->svstat);
+	nfsstat_zone_init_server_zcopy(zoneid, ng->svzcstat);
 
 	/* NFS proc */
 	ng->rfsproccnt[NFS_V2] = nfsstat_zone_init_common(zoneid, "nfs", 0,
@@ -533,6 +571,7 @@ rfs_stat_zone_fini(nfs_globals_t *ng)
 
 	/* Free nfs:x:nfs_server stats */
 	nfsstat_zone_fini_server(zoneid, ng->svstat);
+	nfsstat_zone_fini_server_zcopy(zoneid, ng->svzcstat);
 
 	/* NFS */
 	nfsstat_zone_fini_common(zoneid, "nfs", 0, "rfsproccnt_v2");
@@ -580,6 +580,7 @@ sonode_init(struct sonode *so, struct sockparams *sp, int family,
 	so->so_sndbuf	= 0;
 	so->so_error	= 0;
 	so->so_rcvtimeo	= 0;
+	so->so_busy_poll = 0;
 	so->so_sndtimeo = 0;
 	so->so_xpg_rcvbuf = 0;
 
@@ -625,6 +626,7 @@ sonode_init(struct sonode *so, struct sockparams *sp, int family,
 	so->so_max_addr_len = sizeof (struct sockaddr_storage);
 
 	so->so_direct = NULL;
+	so->so_zc = NULL;
 
 	vn_exists(vp);
 }
@@ -642,6 +644,10 @@ sonode_fini(struct sonode *so)
 		so->so_rcv_timer_tid = 0;
 	}
 
+	/* Must come first, completions may still be waking up pollers */
+	if (so->so_zc != NULL)
+		sod_zc_sock_fini(so);
+
 	if (so->so_poll_list.ph_list != NULL) {
 		pollwakeup(&so->so_poll_list, POLLERR);
 		pollhead_clean(&so->so_poll_list);
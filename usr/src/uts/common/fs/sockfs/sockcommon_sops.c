@@ -373,6 +373,7 @@ so_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 	boolean_t dontblock;
 	ssize_t orig_resid;
 	mblk_t  *mp;
+	sod_zc_buf_t *zb = NULL;
 
 	SO_BLOCK_FALLBACK(so, SOP_SENDMSG(so, msg, uiop, cr));
 
@@ -396,6 +397,10 @@ so_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 		return (EMSGSIZE);
 	}
 
+	if ((flags & MSG_ZEROCOPY) && so->so_zc != NULL &&
+	    so->so_downcalls->sd_send_uio == NULL)
+		zb = sod_zc_start(so, uiop, cr);
+
 	/*
 	 * For atomic sends we will only do one iteration.
 	 */
@@ -445,7 +450,15 @@ so_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 			/* save the resid in case of failure */
 			orig_resid = uiop->uio_resid;
 
-			if ((mp = socopyinuio(uiop,
+			if (zb != NULL && zb->szb_locked != 0) {
+				mp = sod_zc_uio(zb, uiop,
+				    so->so_proto_props.sopp_maxpsz,
+				    so->so_proto_props.sopp_maxblk, &error);
+				if (error != 0) {
+					freemsg(mp);
+					break;
+				}
+			} else if ((mp = socopyinuio(uiop,
 			    so->so_proto_props.sopp_maxpsz,
 			    so->so_proto_props.sopp_wroff,
 			    so->so_proto_props.sopp_maxblk,
@@ -476,6 +489,9 @@ so_sendmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 		}
 	} while (uiop->uio_resid > 0);
 
+	if (zb != NULL)
+		sod_zc_end(zb);
+
 	SO_UNBLOCK_FALLBACK(so);
 
 	return (error);
@@ -851,6 +867,23 @@ so_setsockopt(struct sonode *so, int level, int option_name,
 			 */
 			so->so_xpg_rcvbuf = *(int32_t *)optval;
 			break;
+		case SO_ZEROCOPY:
+			/* Handled entirely by sockfs */
+			if (optlen != sizeof (int32_t)) {
+				error = EINVAL;
+				goto done;
+			}
+			error = sod_zc_setopt(so, *(int32_t *)optval != 0);
+			goto done;
+		case SO_BUSY_POLL:
+			/* Handled entirely by sockfs */
+			if (optlen != sizeof (int32_t) ||
+			    *(int32_t *)optval < 0) {
+				error = EINVAL;
+				goto done;
+			}
+			so->so_busy_poll = *(int32_t *)optval;
+			goto done;
 		}
 	}
 	error = (*so->so_downcalls->sd_setsockopt)
@@ -956,6 +989,13 @@ so_poll(struct sonode *so, short events, int anyyet, short *reventsp,
 	if ((events & POLLRDHUP) && (state & SS_SENTLASTREADSIG))
 		*reventsp |= POLLRDHUP;
 
+	/*
+	 * Completed zero-copy sends waiting to be collected with
+	 * MSG_ERRQUEUE.  Like POLLHUP, POLLERR need not be asked for.
+	 */
+	if (sod_zc_pending(so))
+		*reventsp |= POLLERR;
+
 	/* Data */
 	/* so_downcalls is null for sctp */
 	if (so->so_downcalls != NULL && so->so_downcalls->sd_poll != NULL) {
@@ -1539,6 +1579,9 @@ so_close(struct sonode *so, int flag, struct cred *cr)
 		so_acceptq_flush(so, B_TRUE);
 	}
 
+	if (so->so_zc != NULL)
+		sod_zc_sock_close(so);
+
 	error = (*so->so_downcalls->sd_close)(so->so_proto_handle, flag, cr);
 	switch (error) {
 	default:
@@ -1629,6 +1672,13 @@ so_recvmsg(struct sonode *so, struct nmsghdr *msg, struct uio *uiop,
 
 	SO_BLOCK_FALLBACK(so, SOP_RECVMSG(so, msg, uiop, cr));
 
+	/* Zero-copy send completions */
+	if (msg->msg_flags & MSG_ERRQUEUE) {
+		error = sod_zc_recv(so, msg);
+		SO_UNBLOCK_FALLBACK(so);
+		return (error);
+	}
+
 	if ((so->so_state & (SS_ISCONNECTED|SS_CANTRCVMORE)) == 0 &&
 	    (so->so_mode & SM_CONNREQUIRED)) {
 		SO_UNBLOCK_FALLBACK(so);
@@ -40,6 +40,10 @@
 #include <sys/strsun.h>
 #include <sys/atomic.h>
 #include <sys/tihdr.h>
+#include <sys/kstat.h>
+#include <sys/cpuvar.h>
+#include <sys/cpu.h>
+#include <sys/proc.h>
 
 #include <fs/sockfs/sockcommon.h>
 #include <fs/sockfs/sockfilter_impl.h>
@@ -63,6 +67,29 @@ boolean_t so_debug_length = B_FALSE;
 static boolean_t so_check_length(sonode_t *so);
 #endif
 
+/*
+ * SO_BUSY_POLL budget.  No socket busy polls for more than
+ * so_busy_poll_max_usec at a time, and no more than so_busy_poll_max_threads
+ * threads busy poll at once (half the CPUs if left at 0).
+ */
+uint_t so_busy_poll_max_usec = 1000;
+uint_t so_busy_poll_max_threads = 0;
+static volatile uint_t so_busy_pollers;
+
+typedef struct so_busy_poll_stats {
+	kstat_named_t	sbps_polls;		/* busy polls started */
+	kstat_named_t	sbps_hits;		/* ... that found data */
+	kstat_named_t	sbps_misses;		/* ... that timed out */
+	kstat_named_t	sbps_over_budget;	/* too many threads polling */
+	kstat_named_t	sbps_ring_polls;	/* protocol polls that found */
+	kstat_named_t	sbps_spin_usec;		/* time spent polling */
+} so_busy_poll_stats_t;
+
+static so_busy_poll_stats_t so_bp_stats;
+static kstat_t *so_bp_kstat;
+
+#define	SO_BP_BUMP(x, n)	atomic_add_64(&so_bp_stats.x.value.ui64, (n))
+
 static int
 so_acceptq_dequeue_locked(struct sonode *so, boolean_t dontblock,
     struct sonode **nsop)
@@ -657,6 +684,92 @@ so_check_flow_control(struct sonode *so)
 	}
 }
 
+void
+so_busy_poll_init(void)
+{
+	if (so_busy_poll_max_threads == 0)
+		so_busy_poll_max_threads = MAX(ncpus / 2, 1);
+
+	kstat_named_init(&so_bp_stats.sbps_polls, "polls", KSTAT_DATA_UINT64);
+	kstat_named_init(&so_bp_stats.sbps_hits, "hits", KSTAT_DATA_UINT64);
+	kstat_named_init(&so_bp_stats.sbps_misses, "misses",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&so_bp_stats.sbps_over_budget, "over_budget",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&so_bp_stats.sbps_ring_polls, "ring_polls",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&so_bp_stats.sbps_spin_usec, "spin_usec",
+	    KSTAT_DATA_UINT64);
+
+	so_bp_kstat = kstat_create("sockfs", 0, "busy_poll", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (so_bp_stats) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (so_bp_kstat == NULL)
+		return;
+
+	so_bp_kstat->ks_data = &so_bp_stats;
+
+	kstat_install(so_bp_kstat);
+}
+
+/*
+ * Instead of going to sleep waiting for data, spin for up to so_busy_poll
+ * microseconds waiting for it, having the protocol poll its receive path
+ * meanwhile if it knows how.  That saves the wakeup of the receiving
+ * thread, and if the protocol polls, the soft ring and squeue handoffs.
+ *
+ * Called and returns with so_lock held, which is dropped while spinning.
+ * Returns B_TRUE if the caller should look at the socket again.
+ */
+static boolean_t
+so_rcv_busy_poll(struct sonode *so)
+{
+	boolean_t (*busy_poll)(sock_lower_handle_t);
+	hrtime_t start, now, end;
+	boolean_t found = B_FALSE;
+
+	ASSERT(MUTEX_HELD(&so->so_lock));
+
+	if (atomic_inc_uint_nv(&so_busy_pollers) > so_busy_poll_max_threads) {
+		atomic_dec_uint(&so_busy_pollers);
+		SO_BP_BUMP(sbps_over_budget, 1);
+		return (B_FALSE);
+	}
+	mutex_exit(&so->so_lock);
+
+	busy_poll = so->so_downcalls->sd_busy_poll;
+	start = now = gethrtime();
+	end = start + (hrtime_t)MIN(so->so_busy_poll, so_busy_poll_max_usec) *
+	    (NANOSEC / MICROSEC);
+	for (;;) {
+		if (busy_poll != NULL && busy_poll(so->so_proto_handle))
+			SO_BP_BUMP(sbps_ring_polls, 1);
+		if (so->so_rcv_head != NULL || so->so_error != 0 ||
+		    (so->so_state & (SS_CANTRCVMORE | SS_CLOSING |
+		    SS_FALLBACK_PENDING)) != 0) {
+			found = B_TRUE;
+			break;
+		}
+		/* Leave signals to the sleep that follows */
+		if (now >= end || issig(JUSTLOOKING))
+			break;
+		SMT_PAUSE();
+		now = gethrtime();
+	}
+
+	atomic_dec_uint(&so_busy_pollers);
+	SO_BP_BUMP(sbps_polls, 1);
+	if (found)
+		SO_BP_BUMP(sbps_hits, 1);
+	else
+		SO_BP_BUMP(sbps_misses, 1);
+	SO_BP_BUMP(sbps_spin_usec,
+	    (gethrtime() - start) / (NANOSEC / MICROSEC));
+
+	mutex_enter(&so->so_lock);
+	return (found);
+}
+
 int
 so_dequeue_msg(struct sonode *so, mblk_t **mctlp, struct uio *uiop,
     rval_t *rvalp, int flags)
@@ -959,6 +1072,9 @@ try_again:
 				if (so->so_rcv_head != NULL) {
 					goto again1;
 				}
+				if (so->so_busy_poll != 0 &&
+				    so_rcv_busy_poll(so))
+					goto again1;
 				so->so_rcv_wakeup = B_TRUE;
 				so->so_rcv_wanted = uiop->uio_resid;
 				if (so->so_rcvtimeo == 0) {
@@ -1699,7 +1815,9 @@ socket_getopt_common(struct sonode *so, int level, int option_name,
 	case SO_ERROR:
 	case SO_DOMAIN:
 	case SO_TYPE:
-	case SO_ACCEPTCONN: {
+	case SO_ACCEPTCONN:
+	case SO_ZEROCOPY:
+	case SO_BUSY_POLL: {
 		int32_t value;
 		socklen_t optlen = *optlenp;
 
@@ -1725,6 +1843,12 @@ socket_getopt_common(struct sonode *so, int level, int option_name,
 			else
 				value = 0;
 			break;
+		case SO_ZEROCOPY:
+			value = so->so_zc != NULL && so->so_zc->szc_enabled;
+			break;
+		case SO_BUSY_POLL:
+			value = so->so_busy_poll;
+			break;
 		}
 
 		bcopy(&value, optval, sizeof (value));
@@ -292,6 +292,8 @@ sockinit(int fstype, char *name)
 	/* Initialize socket filters */
 	sof_init();
 
+	so_busy_poll_init();
+
 	return (0);
 
 failure:
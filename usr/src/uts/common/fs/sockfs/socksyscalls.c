@@ -41,6 +41,7 @@
 #include <sys/debug.h>
 #include <sys/errno.h>
 #include <sys/time.h>
+#include <sys/timer.h>
 #include <sys/file.h>
 #include <sys/user.h>
 #include <sys/stream.h>
@@ -849,7 +850,7 @@ recvit(int sock, struct nmsghdr *msg, struct uio *uiop, int flags,
 	controllen = msg->msg_controllen;
 
 	msg->msg_flags = flags & (MSG_OOB | MSG_PEEK | MSG_WAITALL |
-	    MSG_DONTWAIT | MSG_XPG4_2);
+	    MSG_DONTWAIT | MSG_ERRQUEUE | MSG_XPG4_2);
 
 	error = socket_recvmsg(so, msg, uiop, CRED());
 	if (error) {
@@ -1465,6 +1466,172 @@ sendmsg(int sock, struct nmsghdr *msg, int flags)
 	return (rval);
 }
 
+/*
+ * The vectors passed to recvmmsg() and sendmmsg() are arrays of either
+ * struct ommsghdr or struct nmmsghdr, again selected by MSG_XPG4_2.
+ * Return the address of element i and of its msg_len field.
+ */
+static struct nmsghdr *
+mmsghdr_elem(struct nmmsghdr *msgvec, uint_t i, int flags, model_t model,
+    uint_t **lenp)
+{
+	caddr_t elem;
+
+	if (flags & MSG_XPG4_2) {
+		STRUCT_HANDLE(nmmsghdr, umh);
+
+		elem = (caddr_t)msgvec + i * SIZEOF_STRUCT(nmmsghdr, model);
+		STRUCT_SET_HANDLE(umh, model, (struct nmmsghdr *)elem);
+		*lenp = STRUCT_FADDR(umh, msg_len);
+	} else {
+		STRUCT_HANDLE(ommsghdr, umh);
+
+		elem = (caddr_t)msgvec + i * SIZEOF_STRUCT(ommsghdr, model);
+		STRUCT_SET_HANDLE(umh, model, (struct ommsghdr *)elem);
+		*lenp = STRUCT_FADDR(umh, msg_len);
+	}
+
+	return ((struct nmsghdr *)elem);
+}
+
+/*
+ * Receive up to vlen messages in one system call.  Each element is
+ * handled exactly as recvmsg() would handle it and the number of bytes
+ * received is stored in its msg_len.  If at least one message was
+ * received, any error from a later element is discarded and the number
+ * of messages received is returned; the caller sees the error on its
+ * next call.
+ */
+int
+recvmmsg(int sock, struct nmmsghdr *msgvec, uint_t vlen, int flags,
+    timespec_t *timeout)
+{
+	hrtime_t deadline = 0;
+	boolean_t waitforone;
+	model_t model;
+	uint_t rcvd;
+
+	dprint(1, ("recvmmsg(%d, %p, %u, %d, %p)\n",
+	    sock, (void *)msgvec, vlen, flags, (void *)timeout));
+
+	waitforone = (flags & MSG_WAITFORONE) != 0;
+	flags &= ~MSG_WAITFORONE;
+
+	/*
+	 * Limit the number of messages handled per call so that a thread
+	 * cannot stay in the kernel indefinitely.  A caller that asked for
+	 * more simply sees a short count and calls again.
+	 */
+	if (vlen > IOV_MAX)
+		vlen = IOV_MAX;
+
+	model = get_udatamodel();
+
+	if (timeout != NULL) {
+		timespec_t ts;
+
+		if (model == DATAMODEL_NATIVE) {
+			if (copyin(timeout, &ts, sizeof (ts)))
+				return (set_errno(EFAULT));
+		}
+#ifdef _SYSCALL32_IMPL
+		else {
+			timespec32_t ts32;
+
+			if (copyin(timeout, &ts32, sizeof (ts32)))
+				return (set_errno(EFAULT));
+			TIMESPEC32_TO_TIMESPEC(&ts, &ts32);
+		}
+#endif /* _SYSCALL32_IMPL */
+
+		if (itimerspecfix(&ts) || ts.tv_sec >= HRTIME_MAX / NANOSEC)
+			return (set_errno(EINVAL));
+		deadline = gethrtime() + ts2hrt(&ts);
+	}
+
+	for (rcvd = 0; rcvd < vlen; rcvd++) {
+		struct nmsghdr *msg;
+		uint_t *lenp;
+		uint_t len;
+
+		msg = mmsghdr_elem(msgvec, rcvd, flags, model, &lenp);
+		len = (uint_t)recvmsg(sock, msg, flags);
+		if (ttolwp(curthread)->lwp_errno != 0)
+			break;
+		/*
+		 * The message has been taken off the socket, so it counts
+		 * even if its length cannot be stored, as in sendmmsg().
+		 */
+		if (copyout(&len, lenp, sizeof (len)) != 0) {
+			(void) set_errno(EFAULT);
+			rcvd++;
+			break;
+		}
+
+		/*
+		 * With MSG_WAITFORONE only the first message may block.
+		 * The timeout is checked after each message is received,
+		 * it does not bound the wait for the first one.
+		 */
+		if (waitforone) {
+			flags |= MSG_DONTWAIT;
+			waitforone = B_FALSE;
+		}
+		if (deadline != 0 && gethrtime() >= deadline) {
+			rcvd++;
+			break;
+		}
+	}
+
+	if (rcvd > 0)
+		ttolwp(curthread)->lwp_errno = 0;
+
+	return (rcvd);
+}
+
+/*
+ * Send up to vlen messages in one system call.  Each element is handled
+ * exactly as sendmsg() would handle it and the number of bytes sent is
+ * stored in its msg_len.  Returns the number of messages sent; an error
+ * is only reported if the first message could not be sent.
+ */
+int
+sendmmsg(int sock, struct nmmsghdr *msgvec, uint_t vlen, int flags)
+{
+	model_t model;
+	uint_t sent;
+
+	dprint(1, ("sendmmsg(%d, %p, %u, %d)\n",
+	    sock, (void *)msgvec, vlen, flags));
+
+	/* See recvmmsg() */
+	if (vlen > IOV_MAX)
+		vlen = IOV_MAX;
+
+	model = get_udatamodel();
+
+	for (sent = 0; sent < vlen; sent++) {
+		struct nmsghdr *msg;
+		uint_t *lenp;
+		uint_t len;
+
+		msg = mmsghdr_elem(msgvec, sent, flags, model, &lenp);
+		len = (uint_t)sendmsg(sock, msg, flags);
+		if (ttolwp(curthread)->lwp_errno != 0)
+			break;
+		if (copyout(&len, lenp, sizeof (len)) != 0) {
+			(void) set_errno(EFAULT);
+			sent++;
+			break;
+		}
+	}
+
+	if (sent > 0)
+		ttolwp(curthread)->lwp_errno = 0;
+
+	return (sent);
+}
+
 ssize_t
 sendto(int sock, void *buffer, size_t len, int flags,
     struct sockaddr *name, socklen_t namelen)
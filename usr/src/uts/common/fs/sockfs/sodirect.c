@@ -29,8 +29,24 @@
 #include <sys/uio.h>
 #include <sys/stropts.h>
 #include <sys/strsun.h>
+#include <sys/strsubr.h>
 #include <sys/systm.h>
+#include <sys/sysmacros.h>
+#include <sys/disp.h>
+#include <sys/vmsystm.h>
+#include <sys/proc.h>
+#include <sys/atomic.h>
+#include <sys/project.h>
+#include <sys/rctl.h>
+#include <sys/task.h>
+#include <sys/socket.h>
 #include <sys/socketvar.h>
+#include <sys/poll.h>
+#include <sys/kmem.h>
+#include <vm/as.h>
+#include <vm/hat.h>
+#include <vm/page.h>
+#include <vm/seg_kpm.h>
 #include <fs/sockfs/sodirect.h>
 
 /*
@@ -54,6 +70,32 @@
 
 static struct kmem_cache *sock_sod_cache;
 
+/*
+ * Zero-copy sends smaller than this are copied instead: locking the pages
+ * down and waiting for them to come back costs more than the copy.
+ */
+size_t	sod_zc_min = 16 * 1024;
+
+/* Most user memory a socket may have locked down for zero-copy sends */
+size_t	sod_zc_max_locked = 16 * 1024 * 1024;
+
+/*
+ * Most user memory all sockets together may have locked down for zero-copy
+ * sends; 0 means a sixteenth of physical memory.  The memory is also charged
+ * to the sender's project and zone, so that project.max-locked-memory and
+ * zone.max-locked-memory apply to it.
+ */
+size_t	sod_zc_max_locked_total = 0;
+static ulong_t	sod_zc_locked_total;
+
+/* Unlocks the pages of completed zero-copy sends */
+static taskq_t	*sock_zc_taskq;
+
+static void	sod_zc_done(sod_zc_buf_t *);
+
+#define	SOD_ZC_BUF_SIZE(niov)	\
+	(sizeof (sod_zc_buf_t) + ((niov) - 1) * sizeof (sod_zc_iov_t))
+
 /*
  * This function is called at the beginning of recvmsg().
  *
@@ -396,6 +438,11 @@ sod_init()
 	sock_sod_cache = kmem_cache_create("sock_sod_cache",
 	    sizeof (sodirect_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 
+	sock_zc_taskq = taskq_create("sock_zc_taskq", 4, minclsyspri, 4, 4,
+	    TASKQ_PREPOPULATE);
+	if (sod_zc_max_locked_total == 0)
+		sod_zc_max_locked_total = ptob(physmem) / 16;
+
 	return (0);
 }
 
@@ -462,3 +509,595 @@ sod_uioa_mblk(struct sonode *so, mblk_t *mp)
 #endif
 	return (sodp->sod_uioa.uioa_mbytes);
 }
+
+/*
+ * SO_ZEROCOPY.  Only stream sockets whose protocol takes mblks are
+ * supported, as those are the only ones that can be handed user pages.
+ */
+int
+sod_zc_setopt(struct sonode *so, boolean_t on)
+{
+	sod_zc_t *zc, *nzc = NULL;
+
+	if (so->so_type != SOCK_STREAM || so->so_downcalls->sd_send == NULL ||
+	    so->so_downcalls->sd_send_uio != NULL)
+		return (EOPNOTSUPP);
+
+	if (on && so->so_zc == NULL) {
+		nzc = kmem_zalloc(sizeof (*nzc), KM_SLEEP);
+		mutex_init(&nzc->szc_lock, NULL, MUTEX_DEFAULT, NULL);
+		cv_init(&nzc->szc_cv, NULL, CV_DEFAULT, NULL);
+		list_create(&nzc->szc_done, sizeof (sod_zc_buf_t),
+		    offsetof(sod_zc_buf_t, szb_node));
+		nzc->szc_so = so;
+		nzc->szc_ref = 1;
+	}
+
+	mutex_enter(&so->so_lock);
+	if ((zc = so->so_zc) == NULL && nzc != NULL) {
+		so->so_zc = zc = nzc;
+		nzc = NULL;
+	}
+	mutex_exit(&so->so_lock);
+
+	if (nzc != NULL) {
+		list_destroy(&nzc->szc_done);
+		cv_destroy(&nzc->szc_cv);
+		mutex_destroy(&nzc->szc_lock);
+		kmem_free(nzc, sizeof (*nzc));
+	}
+
+	if (zc != NULL) {
+		mutex_enter(&zc->szc_lock);
+		zc->szc_enabled = on;
+		mutex_exit(&zc->szc_lock);
+	}
+	return (0);
+}
+
+static void
+sod_zc_rele_locked(sod_zc_t *zc)
+{
+	ASSERT(MUTEX_HELD(&zc->szc_lock));
+
+	if (--zc->szc_ref > 0) {
+		mutex_exit(&zc->szc_lock);
+		return;
+	}
+	ASSERT(zc->szc_so == NULL);
+	ASSERT(list_is_empty(&zc->szc_done));
+	mutex_exit(&zc->szc_lock);
+
+	list_destroy(&zc->szc_done);
+	cv_destroy(&zc->szc_cv);
+	mutex_destroy(&zc->szc_lock);
+	kmem_free(zc, sizeof (*zc));
+}
+
+static void
+sod_zc_buf_free(sod_zc_buf_t *zb)
+{
+	kmem_free(zb, SOD_ZC_BUF_SIZE(zb->szb_niov));
+}
+
+/*
+ * Have the protocol copy what it still holds of the pages it was loaned,
+ * so that the sends holding them complete without waiting for the peer.
+ * The protocol also stops taking loaned pages, which sod_zc_start() sees
+ * through sopp_zcopyflag.
+ */
+static void
+sod_zc_proto_copy(struct sonode *so)
+{
+	int off = 0;
+
+	if (so->so_downcalls->sd_setsockopt != NULL) {
+		(void) (*so->so_downcalls->sd_setsockopt)(so->so_proto_handle,
+		    SOL_SOCKET, SO_SND_COPYAVOID, &off, sizeof (off), kcred);
+	}
+}
+
+/*
+ * sod_zc_proto_copy() on behalf of a thread that holds no reference on
+ * the socket.  Once the socket is closing, so_close() has done it and the
+ * protocol may no longer be called.
+ */
+static void
+sod_zc_copy(sod_zc_t *zc)
+{
+	struct sonode *so;
+
+	mutex_enter(&zc->szc_lock);
+	if ((so = zc->szc_so) == NULL || zc->szc_closing) {
+		mutex_exit(&zc->szc_lock);
+		return;
+	}
+	zc->szc_copying++;
+	mutex_exit(&zc->szc_lock);
+
+	sod_zc_proto_copy(so);
+
+	mutex_enter(&zc->szc_lock);
+	if (--zc->szc_copying == 0)
+		cv_broadcast(&zc->szc_cv);
+	mutex_exit(&zc->szc_lock);
+}
+
+/*
+ * Address space callback: as_unmap(), as_setprot() or as_free() is waiting
+ * for a range a send has locked down.  The callback is deleted, and the
+ * waiter goes on, once sod_zc_unlock() has the pages back.
+ */
+/* ARGSUSED */
+static void
+sod_zc_as_callback(struct as *as, void *arg, uint_t events)
+{
+	sod_zc_iov_t *zi = arg;
+	sod_zc_t *zc = zi->szi_zb->szb_zc;
+
+	sod_zc_copy(zc);
+
+	mutex_enter(&zc->szc_lock);
+	zi->szi_called = B_TRUE;
+	cv_broadcast(&zc->szc_cv);
+	mutex_exit(&zc->szc_lock);
+}
+
+/*
+ * Undo sod_zc_lock(), for whatever part of it was done.
+ */
+static void
+sod_zc_unlock(sod_zc_buf_t *zb)
+{
+	sod_zc_t *zc = zb->szb_zc;
+	sod_zc_iov_t *zi;
+	uint_t i, j;
+
+	for (i = 0; i < zb->szb_niov; i++) {
+		zi = &zb->szb_iov[i];
+		if (zi->szi_len == 0)
+			continue;
+		/*
+		 * A callback that has been called cannot be deleted yet, and
+		 * may still be using zi.  The pages keep the as around until
+		 * they are unlocked.
+		 */
+		if (zi->szi_cb && as_delete_callback(zb->szb_as, zi) ==
+		    AS_CALLBACK_DELETE_DEFERRED) {
+			mutex_enter(&zc->szc_lock);
+			while (!zi->szi_called)
+				cv_wait(&zc->szc_cv, &zc->szc_lock);
+			mutex_exit(&zc->szc_lock);
+		}
+		zi->szi_cb = B_FALSE;
+		for (j = 0; j < zi->szi_npages; j++) {
+			if (zi->szi_pfns[j].szp_kva != NULL)
+				hat_kpm_mapout_pfn(zi->szi_pfns[j].szp_pfn);
+		}
+		kmem_free(zi->szi_pfns, zi->szi_npages *
+		    sizeof (sod_zc_page_t));
+		as_pageunlock(zb->szb_as, zi->szi_pages, zi->szi_base,
+		    zi->szi_len, S_READ);
+		zi->szi_len = 0;
+	}
+}
+
+/*
+ * Charge the bytes a send is about to lock down to the global total and to
+ * the current process's project and zone.  The project is held until
+ * sod_zc_uncharge(), as the process may have moved to another by then.
+ */
+static boolean_t
+sod_zc_charge(sod_zc_buf_t *zb)
+{
+	proc_t *p = curproc;
+	kproject_t *proj;
+	size_t len = zb->szb_locked;
+
+	if (atomic_add_long_nv(&sod_zc_locked_total, len) >
+	    sod_zc_max_locked_total) {
+		atomic_add_long(&sod_zc_locked_total, -(long)len);
+		return (B_FALSE);
+	}
+
+	mutex_enter(&p->p_lock);
+	proj = p->p_task->tk_proj;
+	if (rctl_incr_locked_mem(p, proj, len, 0) != 0) {
+		mutex_exit(&p->p_lock);
+		atomic_add_long(&sod_zc_locked_total, -(long)len);
+		return (B_FALSE);
+	}
+	zb->szb_proj = project_hold(proj);
+	mutex_exit(&p->p_lock);
+	return (B_TRUE);
+}
+
+static void
+sod_zc_uncharge(sod_zc_buf_t *zb)
+{
+	rctl_decr_locked_mem(NULL, zb->szb_proj, zb->szb_locked, 0);
+	project_rele(zb->szb_proj);
+	zb->szb_proj = NULL;
+	atomic_add_long(&sod_zc_locked_total, -(long)zb->szb_locked);
+}
+
+/*
+ * Lock down the user pages behind each iovec_t of the send, and map them
+ * in through segkpm; much like uioainit() does for the receive side.  A
+ * callback on each range lets an unmap or exit have the pages back early.
+ */
+static int
+sod_zc_lock(sod_zc_buf_t *zb, struct uio *uiop)
+{
+	struct as *as = zb->szb_as;
+	sod_zc_iov_t *zi;
+	iovec_t *iov;
+	caddr_t addr;
+	pfn_t pfn;
+	uint_t i, j;
+	int error;
+
+	for (i = 0; i < zb->szb_niov; i++) {
+		iov = &uiop->uio_iov[i];
+		zi = &zb->szb_iov[i];
+		if (iov->iov_len == 0)
+			continue;
+
+		if ((error = as_pagelock(as, &zi->szi_pages, iov->iov_base,
+		    iov->iov_len, S_READ)) != 0) {
+			sod_zc_unlock(zb);
+			return (error);
+		}
+		zi->szi_base = iov->iov_base;
+		zi->szi_len = iov->iov_len;
+
+		addr = (caddr_t)((uintptr_t)zi->szi_base & PAGEMASK);
+		zi->szi_npages = btopr(zi->szi_base + zi->szi_len - addr);
+		zi->szi_pfns = kmem_zalloc(zi->szi_npages *
+		    sizeof (sod_zc_page_t), KM_SLEEP);
+
+		zi->szi_zb = zb;
+		if ((error = as_add_callback(as, sod_zc_as_callback, zi,
+		    AS_ALL_EVENT, zi->szi_base, zi->szi_len, KM_SLEEP)) != 0) {
+			sod_zc_unlock(zb);
+			return (error);
+		}
+		zi->szi_cb = B_TRUE;
+
+		if (zi->szi_pages == NULL)
+			AS_LOCK_ENTER(as, RW_READER);
+		for (j = 0; j < zi->szi_npages; j++, addr += PAGESIZE) {
+			if (zi->szi_pages != NULL)
+				pfn = page_pptonum(zi->szi_pages[j]);
+			else
+				pfn = hat_getpfnum(as->a_hat, addr);
+			/* Device memory has no segkpm mapping */
+			if (pfn == PFN_INVALID || !pf_is_memory(pfn))
+				break;
+			zi->szi_pfns[j].szp_pfn = pfn;
+			zi->szi_pfns[j].szp_kva = hat_kpm_mapin_pfn(pfn);
+		}
+		if (zi->szi_pages == NULL)
+			AS_LOCK_EXIT(as);
+
+		if (j < zi->szi_npages) {
+			sod_zc_unlock(zb);
+			return (EFAULT);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Called from the free routine of the last mblk of a send, in whatever
+ * context that happens to be, so the rest is left to sock_zc_taskq.
+ */
+static void
+sod_zc_free(caddr_t arg)
+{
+	sod_zc_buf_t *zb = (sod_zc_buf_t *)arg;
+
+	if (atomic_dec_uint_nv(&zb->szb_ref) == 0) {
+		taskq_dispatch_ent(sock_zc_taskq, (task_func_t *)sod_zc_done,
+		    zb, 0, &zb->szb_tqent);
+	}
+}
+
+/*
+ * Pages are unlocked and the send is queued as complete.  Consecutive
+ * sends are merged into one completion where they can be.
+ */
+static void
+sod_zc_done(sod_zc_buf_t *zb)
+{
+	sod_zc_t *zc = zb->szb_zc;
+	sod_zc_buf_t *last;
+	struct sonode *so;
+
+	if (zb->szb_locked != 0) {
+		sod_zc_unlock(zb);
+		sod_zc_uncharge(zb);
+	}
+
+	mutex_enter(&zc->szc_lock);
+	zc->szc_locked -= zb->szb_locked;
+	if ((so = zc->szc_so) != NULL) {
+		/*
+		 * If the protocol has since stopped taking loaned pages, it
+		 * copied whatever of this send it still held.
+		 */
+		if (zb->szb_locked != 0 &&
+		    (so->so_proto_props.sopp_zcopyflag & STZCVMUNSAFE))
+			zb->szb_flags |= SO_ZC_COPIED;
+		last = list_tail(&zc->szc_done);
+		if (last != NULL && last->szb_hi + 1 == zb->szb_lo &&
+		    last->szb_flags == zb->szb_flags) {
+			last->szb_hi = zb->szb_hi;
+			sod_zc_buf_free(zb);
+		} else {
+			list_insert_tail(&zc->szc_done, zb);
+		}
+		/* Still under szc_lock, which sod_zc_sock_fini() needs */
+		pollwakeup(&so->so_poll_list, POLLERR);
+	} else {
+		sod_zc_buf_free(zb);
+	}
+	sod_zc_rele_locked(zc);
+}
+
+/*
+ * Called by so_sendmsg() for a MSG_ZEROCOPY send, to number it and to lock
+ * down its pages if it is worth sending them without a copy.  Returns NULL
+ * if SO_ZEROCOPY is not set, in which case MSG_ZEROCOPY is ignored.
+ */
+sod_zc_buf_t *
+sod_zc_start(struct sonode *so, struct uio *uiop, struct cred *cr)
+{
+	sod_zc_t *zc = so->so_zc;
+	sod_zc_buf_t *zb;
+	ssize_t resid = uiop->uio_resid;
+	uint_t niov = uiop->uio_iovcnt;
+	int on = 1;
+
+	if (zc == NULL || !zc->szc_enabled || niov == 0)
+		return (NULL);
+
+	/*
+	 * Ask the protocol whether it can take loaned pages, the same way
+	 * sendfile does.  Loopback connections and paths without hardware
+	 * checksum offload are turned down.  Once asked, the protocol tells
+	 * us through sopp_zcopyflag when the path changes and it backs off,
+	 * so that is checked on every send.
+	 */
+	if (so->so_state & SS_ISCONNECTED) {
+		uint_t copyflag = so->so_proto_props.sopp_zcopyflag;
+
+		if ((copyflag & (STZCVMSAFE|STZCVMUNSAFE)) != 0) {
+			zc->szc_copyavoid = (copyflag & STZCVMSAFE) ?
+			    SOD_ZC_ON : SOD_ZC_OFF;
+		} else if (zc->szc_copyavoid == SOD_ZC_UNKNOWN) {
+			zc->szc_copyavoid = SOD_ZC_OFF;
+			if (so->so_filter_active == 0 &&
+			    so->so_downcalls->sd_setsockopt != NULL &&
+			    (*so->so_downcalls->sd_setsockopt)(
+			    so->so_proto_handle, SOL_SOCKET, SO_SND_COPYAVOID,
+			    &on, sizeof (on), cr) == 0)
+				zc->szc_copyavoid = SOD_ZC_ON;
+		}
+	}
+
+	zb = kmem_zalloc(SOD_ZC_BUF_SIZE(niov), KM_SLEEP);
+	zb->szb_frtn.free_func = sod_zc_free;
+	zb->szb_frtn.free_arg = (caddr_t)zb;
+	zb->szb_ref = 1;
+	zb->szb_zc = zc;
+	zb->szb_as = curproc->p_as;
+	zb->szb_uiov = uiop->uio_iov;
+	zb->szb_niov = niov;
+
+	mutex_enter(&zc->szc_lock);
+	zb->szb_lo = zb->szb_hi = zc->szc_next++;
+	zc->szc_ref++;
+	if (zc->szc_copyavoid != SOD_ZC_ON || !kpm_enable ||
+	    resid < sod_zc_min || uiop->uio_segflg != UIO_USERSPACE ||
+	    so->so_filter_active > 0 ||
+	    zc->szc_locked + resid > sod_zc_max_locked) {
+		zb->szb_flags = SO_ZC_COPIED;
+	} else {
+		zb->szb_locked = resid;
+		zc->szc_locked += resid;
+	}
+	mutex_exit(&zc->szc_lock);
+
+	if (zb->szb_locked != 0 && !sod_zc_charge(zb)) {
+		mutex_enter(&zc->szc_lock);
+		zc->szc_locked -= zb->szb_locked;
+		mutex_exit(&zc->szc_lock);
+		zb->szb_locked = 0;
+		zb->szb_flags = SO_ZC_COPIED;
+	}
+	if (zb->szb_locked != 0 && sod_zc_lock(zb, uiop) != 0) {
+		sod_zc_uncharge(zb);
+		mutex_enter(&zc->szc_lock);
+		zc->szc_locked -= zb->szb_locked;
+		mutex_exit(&zc->szc_lock);
+		zb->szb_locked = 0;
+		zb->szb_flags = SO_ZC_COPIED;
+	}
+	return (zb);
+}
+
+/*
+ * The zero-copy version of socopyinuio(): build a chain of up to iosize
+ * bytes of mblks that point at the locked down user pages, and advance
+ * the uio past them.  An mblk never crosses a page boundary.
+ */
+mblk_t *
+sod_zc_uio(sod_zc_buf_t *zb, struct uio *uiop, ssize_t iosize,
+    ssize_t maxblk, int *errorp)
+{
+	mblk_t	*head = NULL, **tail = &head;
+	sod_zc_iov_t *zi;
+	caddr_t base;
+	size_t off;
+	uint_t pg;
+
+	ASSERT(zb->szb_locked != 0);
+
+	if (iosize == INFPSZ || iosize > uiop->uio_resid)
+		iosize = uiop->uio_resid;
+	if (maxblk == INFPSZ || maxblk > PAGESIZE)
+		maxblk = PAGESIZE;
+
+	*errorp = 0;
+	while (iosize > 0) {
+		ssize_t blocksize;
+		mblk_t	*mp;
+
+		if (uiop->uio_iov->iov_len == 0) {
+			uiop->uio_iov++;
+			uiop->uio_iovcnt--;
+			continue;
+		}
+		ASSERT(uiop->uio_iov >= zb->szb_uiov &&
+		    uiop->uio_iov < zb->szb_uiov + zb->szb_niov);
+		zi = &zb->szb_iov[uiop->uio_iov - zb->szb_uiov];
+
+		base = uiop->uio_iov->iov_base;
+		pg = btop((uintptr_t)base) -
+		    btop((uintptr_t)zi->szi_base & PAGEMASK);
+		off = (uintptr_t)base & PAGEOFFSET;
+		ASSERT(pg < zi->szi_npages);
+
+		blocksize = MIN(iosize, maxblk);
+		blocksize = MIN(blocksize, PAGESIZE - off);
+		blocksize = MIN(blocksize, uiop->uio_iov->iov_len);
+
+		mp = desballoca((uchar_t *)zi->szi_pfns[pg].szp_kva + off,
+		    blocksize, BPRI_HI, &zb->szb_frtn);
+		if (mp == NULL) {
+			*errorp = ENOMEM;
+			return (head);
+		}
+		atomic_inc_uint(&zb->szb_ref);
+		mp->b_wptr += blocksize;
+		mp->b_datap->db_struioflag |= STRUIO_ZC;
+
+		*tail = mp;
+		tail = &mp->b_cont;
+
+		uioskip(uiop, blocksize);
+		iosize -= blocksize;
+	}
+	return (head);
+}
+
+/*
+ * Called by so_sendmsg() when it is done with the send.  Once the protocol
+ * has freed the last of its mblks too, the send is complete.
+ */
+void
+sod_zc_end(sod_zc_buf_t *zb)
+{
+	sod_zc_free((caddr_t)zb);
+}
+
+/*
+ * recvmsg(MSG_ERRQUEUE): hand the oldest pending completion to the
+ * application as a SCM_ZEROCOPY control message.
+ */
+int
+sod_zc_recv(struct sonode *so, struct nmsghdr *msg)
+{
+	sod_zc_t *zc = so->so_zc;
+	sod_zc_buf_t *zb;
+	struct cmsghdr *cmsg;
+	struct so_zc_done *done;
+	t_uscalar_t len;
+
+	if (!(msg->msg_flags & MSG_XPG4_2))
+		return (EOPNOTSUPP);
+	if (zc == NULL)
+		return (EAGAIN);
+
+	mutex_enter(&zc->szc_lock);
+	zb = list_remove_head(&zc->szc_done);
+	mutex_exit(&zc->szc_lock);
+	if (zb == NULL)
+		return (EAGAIN);
+
+	len = sizeof (struct cmsghdr) + sizeof (struct so_zc_done);
+	cmsg = kmem_zalloc(len, KM_SLEEP);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_ZEROCOPY;
+	cmsg->cmsg_len = len;
+	done = (struct so_zc_done *)CMSG_CONTENT(cmsg);
+	done->szc_lo = zb->szb_lo;
+	done->szc_hi = zb->szb_hi;
+	done->szc_flags = zb->szb_flags;
+	sod_zc_buf_free(zb);
+
+	msg->msg_control = cmsg;
+	msg->msg_controllen = len;
+	msg->msg_namelen = 0;
+	msg->msg_flags = MSG_ERRQUEUE;
+	return (0);
+}
+
+/*
+ * Whether there are completions to collect; used by so_poll().
+ */
+boolean_t
+sod_zc_pending(struct sonode *so)
+{
+	sod_zc_t *zc = so->so_zc;
+
+	return (zc != NULL && !list_is_empty(&zc->szc_done));
+}
+
+/*
+ * Called by so_close() before the protocol is closed.  A closed TCP
+ * connection may keep its unacknowledged data for minutes, and the process
+ * exiting would wait for the pages in as_free(), so the protocol copies
+ * what it still holds of them now.
+ */
+void
+sod_zc_sock_close(struct sonode *so)
+{
+	sod_zc_t *zc = so->so_zc;
+	size_t locked;
+
+	if (zc == NULL)
+		return;
+
+	mutex_enter(&zc->szc_lock);
+	zc->szc_closing = B_TRUE;
+	while (zc->szc_copying > 0)
+		cv_wait(&zc->szc_cv, &zc->szc_lock);
+	locked = zc->szc_locked;
+	mutex_exit(&zc->szc_lock);
+
+	if (locked != 0)
+		sod_zc_proto_copy(so);
+}
+
+/*
+ * The socket is going away.  Sends still in flight hold on to the
+ * sod_zc_t, and free their records when they complete.
+ */
+void
+sod_zc_sock_fini(struct sonode *so)
+{
+	sod_zc_t *zc = so->so_zc;
+	sod_zc_buf_t *zb;
+
+	if (zc == NULL)
+		return;
+	so->so_zc = NULL;
+
+	mutex_enter(&zc->szc_lock);
+	zc->szc_so = NULL;
+	while ((zb = list_remove_head(&zc->szc_done)) != NULL)
+		sod_zc_buf_free(zb);
+	sod_zc_rele_locked(zc);
+}
@@ -40,6 +40,10 @@
 #ifndef _SOCKFS_SODIRECT_H
 #define	_SOCKFS_SODIRECT_H
 
+#include <sys/stream.h>
+#include <sys/list.h>
+#include <sys/taskq_impl.h>
+
 /*
  * Sodirect; used to support asynchronous DMA hardware
  * (e.g. Intel's I/OAT).
@@ -72,6 +76,73 @@ typedef struct sodirect_s {
 	}								\
 }
 
+/*
+ * Zero-copy transmit (SO_ZEROCOPY and MSG_ZEROCOPY).
+ *
+ * The user pages of a zero-copy send are locked down and handed to the
+ * protocol as desballoca'ed mblks, one per page or part of a page.  When
+ * the last of those mblks is freed, the pages are unlocked and the send is
+ * queued as complete; the application collects the completions with
+ * recvmsg(MSG_ERRQUEUE).  Sends that are too small, or that the protocol
+ * cannot take without copying, are copied as before but still reported.
+ *
+ * While the pages are locked, as_unmap() and as_free() of the sender's
+ * address space wait for them.  So that munmap() and exit do not wait on
+ * the peer, an address space callback on each locked range, and the close
+ * of the socket, have the protocol copy what it still holds of the pages.
+ */
+typedef struct sod_zc_page_s {
+	pfn_t		szp_pfn;
+	caddr_t		szp_kva;	/* segkpm mapping of the page */
+} sod_zc_page_t;
+
+typedef struct sod_zc_iov_s {
+	caddr_t		szi_base;	/* user range locked down */
+	size_t		szi_len;
+	struct page	**szi_pages;	/* as_pagelock() page list or NULL */
+	sod_zc_page_t	*szi_pfns;
+	uint_t		szi_npages;
+	struct sod_zc_buf_s *szi_zb;
+	boolean_t	szi_cb;		/* as callback registered */
+	boolean_t	szi_called;	/* as callback has run */
+} sod_zc_iov_t;
+
+typedef struct sod_zc_buf_s {
+	frtn_t		szb_frtn;	/* shared by all the mblks */
+	uint_t		szb_ref;	/* mblks out, plus one while sending */
+	struct sod_zc_s	*szb_zc;
+	struct as	*szb_as;
+	uint32_t	szb_lo;		/* first and last send, once complete */
+	uint32_t	szb_hi;
+	uint32_t	szb_flags;	/* SO_ZC_COPIED */
+	size_t		szb_locked;	/* bytes locked down */
+	struct kproject	*szb_proj;	/* charged for szb_locked */
+	list_node_t	szb_node;	/* on szc_done once complete */
+	taskq_ent_t	szb_tqent;
+	iovec_t		*szb_uiov;	/* the uio_iov that szb_iov[] mirrors */
+	uint_t		szb_niov;
+	sod_zc_iov_t	szb_iov[1];	/* actually szb_niov */
+} sod_zc_buf_t;
+
+typedef struct sod_zc_s {
+	kmutex_t	szc_lock;
+	kcondvar_t	szc_cv;
+	struct sonode	*szc_so;	/* NULL once the socket is gone */
+	boolean_t	szc_closing;	/* no more copy requests */
+	uint_t		szc_copying;	/* copy requests in progress */
+	uint_t		szc_ref;	/* socket plus incomplete sends */
+	boolean_t	szc_enabled;	/* SO_ZEROCOPY set */
+	int		szc_copyavoid;	/* protocol takes loaned pages */
+	uint32_t	szc_next;	/* number of the next send */
+	size_t		szc_locked;	/* bytes locked down */
+	list_t		szc_done;	/* completions not yet collected */
+} sod_zc_t;
+
+/* szc_copyavoid */
+#define	SOD_ZC_UNKNOWN	0
+#define	SOD_ZC_ON	1
+#define	SOD_ZC_OFF	2
+
 struct sonode;
 struct sodirect_s;
 
@@ -88,6 +159,17 @@ extern int	sod_init(void);
 extern void	sod_sock_init(struct sonode *);
 extern void	sod_sock_fini(struct sonode *);
 
+extern int	sod_zc_setopt(struct sonode *, boolean_t);
+extern sod_zc_buf_t *sod_zc_start(struct sonode *, struct uio *,
+    struct cred *);
+extern mblk_t	*sod_zc_uio(sod_zc_buf_t *, struct uio *, ssize_t, ssize_t,
+    int *);
+extern void	sod_zc_end(sod_zc_buf_t *);
+extern int	sod_zc_recv(struct sonode *, struct nmsghdr *);
+extern boolean_t sod_zc_pending(struct sonode *);
+extern void	sod_zc_sock_close(struct sonode *);
+extern void	sod_zc_sock_fini(struct sonode *);
+
 #ifdef	__cplusplus
 }
 #endif
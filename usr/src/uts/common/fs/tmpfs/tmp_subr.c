@@ -285,3 +285,53 @@ tmp_convmode(char *str, mode_t *mode)
 	*mode = VALIDMODEBITS & num;
 	return (0);
 }
+
+/*
+ * Lock the byte range [off, off + len) of a regular file for a read
+ * (RW_READER) or a write (RW_WRITER), waiting for any overlapping range
+ * that conflicts.  Only writes that run with tn_rwlock held as reader
+ * need this to exclude each other and reads; see tmp_write().  Few
+ * ranges are locked at once, so a list does.
+ *
+ * A write range is widened to whole pages.  wrtmp() creates, zeroes and
+ * on error invalidates whole pages, so two writers to different bytes of
+ * one page must not run together.
+ */
+void
+tmp_range_enter(struct tmpnode *tp, tmp_range_t *tr, offset_t off,
+    ssize_t len, krw_t type)
+{
+	tmp_range_t *o;
+
+	tr->tr_off = off;
+	tr->tr_end = (off >= 0 && len > MAXOFFSET_T - off) ?
+	    MAXOFFSET_T : off + len;
+	tr->tr_type = type;
+	if (type == RW_WRITER) {
+		tr->tr_off = P2ALIGN(tr->tr_off, (offset_t)PAGESIZE);
+		tr->tr_end = (tr->tr_end > MAXOFFSET_T - PAGESIZE) ?
+		    MAXOFFSET_T : P2ROUNDUP(tr->tr_end, (offset_t)PAGESIZE);
+	}
+
+	mutex_enter(&tp->tn_rlock);
+again:
+	for (o = list_head(&tp->tn_ranges); o != NULL;
+	    o = list_next(&tp->tn_ranges, o)) {
+		if (o->tr_off < tr->tr_end && tr->tr_off < o->tr_end &&
+		    (type == RW_WRITER || o->tr_type == RW_WRITER)) {
+			cv_wait(&tp->tn_rlcv, &tp->tn_rlock);
+			goto again;
+		}
+	}
+	list_insert_tail(&tp->tn_ranges, tr);
+	mutex_exit(&tp->tn_rlock);
+}
+
+void
+tmp_range_exit(struct tmpnode *tp, tmp_range_t *tr)
+{
+	mutex_enter(&tp->tn_rlock);
+	list_remove(&tp->tn_ranges, tr);
+	cv_broadcast(&tp->tn_rlcv);
+	mutex_exit(&tp->tn_rlock);
+}
@@ -77,34 +77,43 @@ tmp_resv(
 	 *
 	 * Deny if trying to reserve more than tmpfs can allocate
 	 */
+	if (!pagecreate)
+		return (0);
+
+	/*
+	 * Charge the mount before reserving swap, under the same hold of
+	 * tm_contents as the size check, so that writers extending
+	 * different files cannot together overrun the size= limit.
+	 */
 	zone = tm->tm_vfsp->vfs_zone;
-	if (pagecreate && ((tm->tm_anonmem + pages > tm->tm_anonmax) ||
-	    (!anon_checkspace(ptob(pages + tmpfs_minfree), zone)) ||
-	    (anon_try_resv_zone(delta, zone) == 0))) {
+	mutex_enter(&tm->tm_contents);
+	if (tm->tm_anonmem + pages > tm->tm_anonmax) {
+		mutex_exit(&tm->tm_contents);
 		return (1);
 	}
+	tm->tm_anonmem += pages;
+	mutex_exit(&tm->tm_contents);
 
-	/*
-	 * update statistics
-	 */
-	if (pagecreate) {
+	if (!anon_checkspace(ptob(pages + tmpfs_minfree), zone) ||
+	    anon_try_resv_zone(delta, zone) == 0) {
 		mutex_enter(&tm->tm_contents);
-		tm->tm_anonmem += pages;
+		tm->tm_anonmem -= pages;
 		mutex_exit(&tm->tm_contents);
-
-		TRACE_2(TR_FAC_VM, TR_ANON_TMPFS, "anon tmpfs:%p %lu",
-		    tp, delta);
+		return (1);
 	}
 
+	TRACE_2(TR_FAC_VM, TR_ANON_TMPFS, "anon tmpfs:%p %lu", tp, delta);
+
 	return (0);
 }
 
 /*
- * tmp_unresv - called when truncating a file
+ * tmp_unresv - called when truncating a file, or by wrtmp() to give back
+ * what it reserved ahead and did not use.
  * Only called if we're freeing at least pagesize bytes
  * because anon_unresv does a btopr(delta)
  */
-static void
+void
 tmp_unresv(
 	struct tmount *tm,
 	struct tmpnode *tp,
@@ -166,6 +175,10 @@ tmpnode_init(struct tmount *tm, struct tmpnode *t, vattr_t *vap, cred_t *cred)
 
 	rw_init(&t->tn_rwlock, NULL, RW_DEFAULT, NULL);
 	mutex_init(&t->tn_tlock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&t->tn_rlock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&t->tn_rlcv, NULL, CV_DEFAULT, NULL);
+	list_create(&t->tn_ranges, sizeof (tmp_range_t),
+	    offsetof(tmp_range_t, tr_link));
 	t->tn_mode = MAKEIMODE(vap->va_type, vap->va_mode);
 	t->tn_mask = 0;
 	t->tn_type = vap->va_type;
@@ -105,6 +105,20 @@ tmp_close(
 	return (0);
 }
 
+/*
+ * Give back swap that wrtmp() reserved ahead, up to *resv_end, beyond
+ * what the file now covers.
+ */
+static void
+tmp_resv_trim(struct tmount *tm, struct tmpnode *tp, u_offset_t *resv_end)
+{
+	u_offset_t cur = P2ROUNDUP_TYPED(tp->tn_size, PAGESIZE, u_offset_t);
+
+	if (*resv_end > cur)
+		tmp_unresv(tm, tp, (size_t)(*resv_end - cur));
+	*resv_end = 0;
+}
+
 /*
  * wrtmp does the real work of write requests for tmpfs.
  */
@@ -132,6 +146,7 @@ wrtmp(
 	long tn_size_changed = 0;
 	long old_tn_size;
 	long new_tn_size;
+	u_offset_t resv_end = 0;	/* swap reserved ahead up to here */
 
 	vp = TNTOV(tp);
 	ASSERT(vp->v_type == VREG);
@@ -140,7 +155,11 @@ wrtmp(
 	    "tmp_wrtmp_start:vp %p", vp);
 
 	ASSERT(RW_WRITE_HELD(&tp->tn_contents));
-	ASSERT(RW_WRITE_HELD(&tp->tn_rwlock));
+	ASSERT(RW_LOCK_HELD(&tp->tn_rwlock));
+	/* Only tmp_write() with tn_rwlock as writer may grow the file */
+	ASSERT(RW_WRITE_HELD(&tp->tn_rwlock) ||
+	    (uio->uio_loffset <= tp->tn_size &&
+	    uio->uio_resid <= tp->tn_size - uio->uio_loffset));
 
 	if (MANDLOCK(vp, tp->tn_mode)) {
 		rw_exit(&tp->tn_contents);
@@ -188,6 +207,26 @@ wrtmp(
 	if (limit > MAXOFF_T)
 		limit = MAXOFF_T;
 
+	/*
+	 * A write that extends the file over more than a page reserves swap
+	 * for all of it here, rather than a page at a time in the loop
+	 * below, and sizes the anon array once.  If the reservation fails,
+	 * the loop reserves page by page and writes as much as fits.  What
+	 * is reserved but not used is given back at the end.
+	 */
+	if (uio->uio_resid > PAGESIZE) {
+		u_offset_t cur, end;
+
+		cur = P2ROUNDUP_TYPED(tp->tn_size, PAGESIZE, u_offset_t);
+		end = MIN(uio->uio_loffset + uio->uio_resid, limit);
+		end = P2ROUNDUP_TYPED(end, PAGESIZE, u_offset_t);
+		if (end > cur + PAGESIZE &&
+		    tmp_resv(tm, tp, (size_t)(end - cur), 1) == 0) {
+			tmpnode_growmap(tp, (ulong_t)end);
+			resv_end = end;
+		}
+	}
+
 	do {
 		long	offset;
 		long	delta;
@@ -214,10 +253,12 @@ wrtmp(
 		 * to reserve for the file.
 		 * We always reserve in pagesize increments so
 		 * unless we're extending the file into a new page,
-		 * we don't need to call tmp_resv.
+		 * or past what was reserved ahead, we don't need to
+		 * call tmp_resv.
 		 */
 		delta = offset + bytes -
-		    P2ROUNDUP_TYPED(tp->tn_size, PAGESIZE, u_offset_t);
+		    MAX(P2ROUNDUP_TYPED(tp->tn_size, PAGESIZE, u_offset_t),
+		    resv_end);
 		if (delta > 0) {
 			pagecreate = 1;
 			if (tmp_resv(tm, tp, delta, pagecreate)) {
@@ -397,6 +438,12 @@ wrtmp(
 		 * If the uiomove failed, fix up tn_size.
 		 */
 		if (error) {
+			/*
+			 * tmpnode_trunc() only knows about the space
+			 * reserved for tn_size, so give back the rest
+			 * first.
+			 */
+			tmp_resv_trim(tm, tp, &resv_end);
 			if (tn_size_changed) {
 				/*
 				 * The uiomove failed, and we
@@ -431,6 +478,8 @@ wrtmp(
 	} while (error == 0 && uio->uio_resid > 0 && bytes != 0);
 
 out:
+	tmp_resv_trim(tm, tp, &resv_end);
+
 	/*
 	 * If we've already done a partial-write, terminate
 	 * the write but return no error.
@@ -584,6 +633,7 @@ tmp_read(struct vnode *vp, struct uio *uiop, int ioflag, cred_t *cred,
 {
 	struct tmpnode *tp = (struct tmpnode *)VTOTN(vp);
 	struct tmount *tm = (struct tmount *)VTOTM(vp);
+	tmp_range_t tr;
 	int error;
 
 	/*
@@ -598,11 +648,18 @@ tmp_read(struct vnode *vp, struct uio *uiop, int ioflag, cred_t *cred,
 	 */
 	ASSERT(RW_READ_HELD(&tp->tn_rwlock));
 
+	/*
+	 * Writes within the file may be running alongside us (see
+	 * tmp_write()); don't see half of one.
+	 */
+	tmp_range_enter(tp, &tr, uiop->uio_loffset, uiop->uio_resid,
+	    RW_READER);
 	rw_enter(&tp->tn_contents, RW_READER);
 
 	error = rdtmp(tm, tp, uiop, ct);
 
 	rw_exit(&tp->tn_contents);
+	tmp_range_exit(tp, &tr);
 
 	return (error);
 }
@@ -613,6 +670,8 @@ tmp_write(struct vnode *vp, struct uio *uiop, int ioflag, struct cred *cred,
 {
 	struct tmpnode *tp = (struct tmpnode *)VTOTN(vp);
 	struct tmount *tm = (struct tmount *)VTOTM(vp);
+	boolean_t shared = B_FALSE;
+	tmp_range_t tr;
 	int error;
 
 	/*
@@ -622,10 +681,33 @@ tmp_write(struct vnode *vp, struct uio *uiop, int ioflag, struct cred *cred,
 		return (EINVAL);	/* XXX EISDIR? */
 
 	/*
-	 * tmp_rwlock should have already been called from layers above
+	 * tmp_rwlock should have already been called from layers above.
+	 * It may have taken tn_rwlock as reader.  That is enough for a
+	 * write that lies within the file, since nothing can change the
+	 * size of the file while we hold it: such a write only has to
+	 * exclude overlapping reads and writes, with a range lock, and
+	 * writes to different parts of the file can copy their data in
+	 * parallel.  Anything else needs tn_rwlock as writer.
 	 */
-	ASSERT(RW_WRITE_HELD(&tp->tn_rwlock));
+	ASSERT(RW_LOCK_HELD(&tp->tn_rwlock));
+	if (!rw_write_held(&tp->tn_rwlock)) {
+		rw_enter(&tp->tn_contents, RW_READER);
+		shared = !(ioflag & FAPPEND) &&
+		    uiop->uio_loffset >= 0 &&
+		    uiop->uio_loffset <= tp->tn_size &&
+		    uiop->uio_resid <= tp->tn_size - uiop->uio_loffset;
+		rw_exit(&tp->tn_contents);
 
+		if (!shared && !rw_tryupgrade(&tp->tn_rwlock)) {
+			rw_exit(&tp->tn_rwlock);
+			rw_enter(&tp->tn_rwlock, RW_WRITER);
+		}
+	}
+
+	if (shared) {
+		tmp_range_enter(tp, &tr, uiop->uio_loffset, uiop->uio_resid,
+		    RW_WRITER);
+	}
 	rw_enter(&tp->tn_contents, RW_WRITER);
 
 	if (ioflag & FAPPEND) {
@@ -638,6 +720,8 @@ tmp_write(struct vnode *vp, struct uio *uiop, int ioflag, struct cred *cred,
 	error = wrtmp(tm, tp, uiop, cred, ct);
 
 	rw_exit(&tp->tn_contents);
+	if (shared)
+		tmp_range_exit(tp, &tr);
 
 	return (error);
 }
@@ -1741,6 +1825,10 @@ top:
 	rw_exit(&tp->tn_rwlock);
 	rw_destroy(&tp->tn_rwlock);
 	mutex_destroy(&tp->tn_tlock);
+	ASSERT(list_is_empty(&tp->tn_ranges));
+	list_destroy(&tp->tn_ranges);
+	cv_destroy(&tp->tn_rlcv);
+	mutex_destroy(&tp->tn_rlock);
 	vn_free(TNTOV(tp));
 	tmp_memfree(tp, sizeof (struct tmpnode));
 }
@@ -2367,18 +2455,44 @@ tmp_seek(
 	return ((*noffp < 0 || *noffp > MAXOFFSET_T) ? EINVAL : 0);
 }
 
+/*
+ * Writers used to get tn_rwlock exclusively, which serializes all writes
+ * to a file however large it is.  For regular files we now hand out the
+ * lock shared and leave it to tmp_write() to upgrade it when a write
+ * extends the file.  As in ufs_rwlock(), mandatory locking always gets
+ * the lock exclusively.  Set tmp_shared_writes to 0 to go back to
+ * exclusive writers.
+ */
+int tmp_shared_writes = 1;
+
 /* ARGSUSED2 */
 static int
 tmp_rwlock(struct vnode *vp, int write_lock, caller_context_t *ctp)
 {
 	struct tmpnode *tp = VTOTN(vp);
 
-	if (write_lock) {
-		rw_enter(&tp->tn_rwlock, RW_WRITER);
-	} else {
+	if (!write_lock) {
 		rw_enter(&tp->tn_rwlock, RW_READER);
+		return (V_WRITELOCK_FALSE);
+	}
+
+	if (vp->v_type != VREG || !tmp_shared_writes ||
+	    MANDLOCK(vp, tp->tn_mode)) {
+		rw_enter(&tp->tn_rwlock, RW_WRITER);
+		return (V_WRITELOCK_TRUE);
+	}
+
+	/*
+	 * Mandatory locking could have been enabled before we got the
+	 * lock.  Re-check and upgrade if needed.
+	 */
+	rw_enter(&tp->tn_rwlock, RW_READER);
+	if (MANDLOCK(vp, tp->tn_mode)) {
+		rw_exit(&tp->tn_rwlock);
+		rw_enter(&tp->tn_rwlock, RW_WRITER);
+		return (V_WRITELOCK_TRUE);
 	}
-	return (write_lock);
+	return (V_WRITELOCK_FALSE);
 }
 
 /* ARGSUSED1 */
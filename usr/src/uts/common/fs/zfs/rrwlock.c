@@ -110,6 +110,24 @@ rrn_add(rrwlock_t *rrl, void *tag)
 	VERIFY(tsd_set(rrw_tsd_key, rn) == 0);
 }
 
+/*
+ * Like rrn_find(), but only match a node that was added with 'tag'.
+ */
+static rrw_node_t *
+rrn_find_tag(rrwlock_t *rrl, void *tag)
+{
+	rrw_node_t *rn;
+
+	if (zfs_refcount_count(&rrl->rr_linked_rcount) == 0)
+		return (NULL);
+
+	for (rn = tsd_get(rrw_tsd_key); rn != NULL; rn = rn->rn_next) {
+		if (rn->rn_rrl == rrl && rn->rn_tag == tag)
+			return (rn);
+	}
+	return (NULL);
+}
+
 /*
  * If a node is found for 'rrl', then remove the node from this
  * thread's list and return TRUE; otherwise return FALSE.
@@ -394,3 +412,159 @@ rrm_held(rrmlock_t *rrl, krw_t rw)
 		return (rrw_held(&rrl->locks[RRM_TD_LOCK()], rw));
 	}
 }
+
+/*
+ * A re-entrant read lock with per-CPU anonymous read counts.
+ *
+ * The anonymous read count of a rrwlock_t is protected by rr_lock, so
+ * every reader takes and drops a mutex that is shared by all CPUs. The
+ * rrplock_t instead keeps one anonymous read count per CPU, each on its
+ * own cache line. A reader bumps the count of its CPU and then checks
+ * rp_writer_wanted. If no writer is around, it has the lock.
+ *
+ * A writer sets rp_writer_wanted and then waits for the sum of the per-CPU
+ * counts to drain to zero. Both sides issue a membar between their store
+ * and load, so either the reader sees the writer or the writer sees the
+ * reader. Once drained, the writer acquires the embedded rrwlock_t for
+ * write.
+ *
+ * A reader that finds rp_writer_wanted set backs out its per-CPU count and
+ * takes a read lock on the embedded rrwlock_t instead. That lock is always
+ * created with track_all, so every read lock on it is linked to the thread
+ * and rrp_exit() can tell which of the two a reader is holding. This also
+ * keeps the re-entrancy guarantees of rrwlock_t: a thread that holds a
+ * per-CPU read lock and re-enters while a writer is draining gets a read
+ * lock on the embedded rrwlock_t, which no writer holds or waits for yet,
+ * and a thread that holds a read lock on the embedded rrwlock_t is let
+ * through by rrw_enter_read() because it is linked.
+ *
+ * If the lock itself is created with track_all, per-CPU reads are not used
+ * at all, so that rrp_held() is exact.
+ */
+static int64_t
+rrp_count(rrplock_t *rrp)
+{
+	int64_t count = 0;
+	int i;
+
+	for (i = 0; i < max_ncpus; i++)
+		count += rrp->rp_cpu[i].rpc_count;
+	return (count);
+}
+
+static void
+rrp_cpu_exit(rrplock_t *rrp)
+{
+	atomic_dec_64((uint64_t *)&rrp->rp_cpu[CPU_SEQID].rpc_count);
+	membar_enter();
+
+	if (rrp->rp_writer_wanted) {
+		mutex_enter(&rrp->rp_lock);
+		cv_broadcast(&rrp->rp_cv);
+		mutex_exit(&rrp->rp_lock);
+	}
+}
+
+void
+rrp_init(rrplock_t *rrp, boolean_t track_all)
+{
+	rrp->rp_cpu = kmem_zalloc(max_ncpus * sizeof (rrp_cpu_t), KM_SLEEP);
+	rrp->rp_writer_wanted = B_FALSE;
+	rrp->rp_track_all = track_all;
+	mutex_init(&rrp->rp_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&rrp->rp_cv, NULL, CV_DEFAULT, NULL);
+	rrw_init(&rrp->rp_rrl, B_TRUE);
+}
+
+void
+rrp_destroy(rrplock_t *rrp)
+{
+	ASSERT0(rrp_count(rrp));
+	ASSERT(!rrp->rp_writer_wanted);
+	rrw_destroy(&rrp->rp_rrl);
+	mutex_destroy(&rrp->rp_lock);
+	cv_destroy(&rrp->rp_cv);
+	kmem_free(rrp->rp_cpu, max_ncpus * sizeof (rrp_cpu_t));
+}
+
+static void
+rrp_enter_read_impl(rrplock_t *rrp, boolean_t prio, void *tag)
+{
+	if (!rrp->rp_track_all) {
+		atomic_inc_64((uint64_t *)&rrp->rp_cpu[CPU_SEQID].rpc_count);
+		membar_enter();
+		if (!rrp->rp_writer_wanted)
+			return;
+		rrp_cpu_exit(rrp);
+		DTRACE_PROBE(zfs__rrpfastpath__rdmiss);
+	}
+	rrw_enter_read_impl(&rrp->rp_rrl, prio, tag);
+}
+
+void
+rrp_enter_read(rrplock_t *rrp, void *tag)
+{
+	rrp_enter_read_impl(rrp, B_FALSE, tag);
+}
+
+void
+rrp_enter_read_prio(rrplock_t *rrp, void *tag)
+{
+	rrp_enter_read_impl(rrp, B_TRUE, tag);
+}
+
+void
+rrp_enter_write(rrplock_t *rrp)
+{
+	mutex_enter(&rrp->rp_lock);
+	while (rrp->rp_writer_wanted)
+		cv_wait(&rrp->rp_cv, &rrp->rp_lock);
+	rrp->rp_writer_wanted = B_TRUE;
+	membar_enter();
+
+	while (rrp_count(rrp) != 0)
+		cv_wait(&rrp->rp_cv, &rrp->rp_lock);
+	mutex_exit(&rrp->rp_lock);
+
+	rrw_enter_write(&rrp->rp_rrl);
+}
+
+void
+rrp_enter(rrplock_t *rrp, krw_t rw, void *tag)
+{
+	if (rw == RW_READER)
+		rrp_enter_read(rrp, tag);
+	else
+		rrp_enter_write(rrp);
+}
+
+void
+rrp_exit(rrplock_t *rrp, void *tag)
+{
+	if (rrp->rp_rrl.rr_writer == curthread) {
+		rrw_exit(&rrp->rp_rrl, tag);
+		mutex_enter(&rrp->rp_lock);
+		rrp->rp_writer_wanted = B_FALSE;
+		cv_broadcast(&rrp->rp_cv);
+		mutex_exit(&rrp->rp_lock);
+	} else if (rrn_find_tag(&rrp->rp_rrl, tag) != NULL) {
+		rrw_exit(&rrp->rp_rrl, tag);
+	} else {
+		ASSERT(!rrp->rp_track_all);
+		membar_exit();
+		rrp_cpu_exit(rrp);
+	}
+}
+
+/*
+ * Without track_all, rrp_held(RW_READER) may return B_TRUE if any thread
+ * has the lock for reader, just like rrw_held().
+ */
+boolean_t
+rrp_held(rrplock_t *rrp, krw_t rw)
+{
+	if (rw == RW_WRITER)
+		return (rrw_held(&rrp->rp_rrl, rw));
+
+	return (rrp_count(rrp) > 0 || rrw_held(&rrp->rp_rrl, rw));
+}
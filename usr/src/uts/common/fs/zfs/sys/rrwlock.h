@@ -106,6 +106,41 @@ boolean_t rrm_held(rrmlock_t *rrl, krw_t rw);
 #define	RRM_LOCK_HELD(x) \
 	(rrm_held(x, RW_WRITER) || rrm_held(x, RW_READER))
 
+/*
+ * A re-entrant read lock with per-CPU anonymous read counts. Readers that
+ * find no writer around only bump the count of their CPU, so they neither
+ * take rr_lock nor touch a shared cache line. Writers have to drain the
+ * per-CPU counts first, and readers that find a writer around fall back to
+ * the embedded rrwlock_t, which deals with re-entrancy.
+ */
+typedef struct rrp_cpu {
+	volatile int64_t rpc_count;		/* anonymous readers */
+	char		rpc_pad[64 - sizeof (int64_t)];	/* cache line */
+} rrp_cpu_t;
+
+typedef struct rrplock {
+	rrp_cpu_t	*rp_cpu;	/* per-CPU anonymous read counts */
+	volatile boolean_t rp_writer_wanted; /* writer draining or holding */
+	boolean_t	rp_track_all;	/* no anonymous reads at all */
+	kmutex_t	rp_lock;	/* protects rp_cv */
+	kcondvar_t	rp_cv;		/* writers wait for drain here */
+	rrwlock_t	rp_rrl;		/* writers and tracked readers */
+} rrplock_t;
+
+void rrp_init(rrplock_t *rrp, boolean_t track_all);
+void rrp_destroy(rrplock_t *rrp);
+void rrp_enter(rrplock_t *rrp, krw_t rw, void *tag);
+void rrp_enter_read(rrplock_t *rrp, void *tag);
+void rrp_enter_read_prio(rrplock_t *rrp, void *tag);
+void rrp_enter_write(rrplock_t *rrp);
+void rrp_exit(rrplock_t *rrp, void *tag);
+boolean_t rrp_held(rrplock_t *rrp, krw_t rw);
+
+#define	RRP_READ_HELD(x)	rrp_held(x, RW_READER)
+#define	RRP_WRITE_HELD(x)	rrp_held(x, RW_WRITER)
+#define	RRP_LOCK_HELD(x) \
+	(rrp_held(x, RW_WRITER) || rrp_held(x, RW_READER))
+
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,571 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+/*
+ * BBR ("Bottleneck Bandwidth and Round-trip propagation time") congestion
+ * control, version 1.
+ *
+ * Rather than reacting to loss, BBR builds an explicit model of the path from
+ * two estimates:
+ *
+ *  - the bottleneck bandwidth (btlbw), the windowed maximum of the delivery
+ *    rate samples taken by TCP over the last BBR_BW_ROUNDS round trips
+ *    (see tcp_rate_sample()), and
+ *  - the round-trip propagation time (min_rtt), the minimum RTT seen over the
+ *    last BBR_MIN_RTT_WIN.
+ *
+ * It then paces transmissions at pacing_gain * btlbw and caps the amount of
+ * data in flight at cwnd_gain * btlbw * min_rtt (the bandwidth-delay product).
+ * The gains depend on the state the connection is in:
+ *
+ *  STARTUP	Grow the sending rate exponentially, like slow start, until
+ *		btlbw stops growing by at least 25% for three rounds.
+ *  DRAIN	Drain the queue created during STARTUP.
+ *  PROBE_BW	Cruise at btlbw, periodically probing for more bandwidth with
+ *		a gain of 5/4 followed by a round at 3/4 to drain what the
+ *		probe may have queued.
+ *  PROBE_RTT	If min_rtt has not been refreshed for BBR_MIN_RTT_WIN, reduce
+ *		the window to BBR_MIN_CWND segments for a short while so that
+ *		queues drain and a new min_rtt can be measured.
+ *
+ * Pacing is carried out by tcp_wput_data() using the rate this module stores
+ * in tcp_pacing_rate.
+ */
+
+#include <sys/errno.h>
+#include <sys/kmem.h>
+#include <sys/kstat.h>
+#include <sys/atomic.h>
+#include <inet/tcp.h>
+#include <inet/tcp_impl.h>
+#include <inet/cc.h>
+#include <inet/cc/cc_module.h>
+
+/* Gains are fixed point with BBR_UNIT representing 1.0. */
+#define	BBR_UNIT		256
+#define	BBR_HIGH_GAIN		739	/* 2/ln(2) */
+#define	BBR_DRAIN_GAIN		88	/* 1/BBR_HIGH_GAIN */
+#define	BBR_CWND_GAIN		(2 * BBR_UNIT)
+#define	BBR_CYCLE_LEN		8
+
+/* Round trips over which the maximum delivery rate is kept. */
+#define	BBR_BW_ROUNDS		10
+/* How long a min_rtt sample remains valid. */
+#define	BBR_MIN_RTT_WIN		(10 * NANOSEC)
+/* Time spent in PROBE_RTT. */
+#define	BBR_PROBE_RTT_TIME	MSEC2NSEC(200)
+/* Minimum congestion window, in segments. */
+#define	BBR_MIN_CWND		4
+/* STARTUP ends after this many rounds without 25% btlbw growth. */
+#define	BBR_FULL_BW_ROUNDS	3
+
+typedef enum bbr_mode {
+	BBR_STARTUP,
+	BBR_DRAIN,
+	BBR_PROBE_BW,
+	BBR_PROBE_RTT
+} bbr_mode_t;
+
+static const uint32_t bbr_pacing_gain[BBR_CYCLE_LEN] = {
+	BBR_UNIT * 5 / 4, BBR_UNIT * 3 / 4,
+	BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT, BBR_UNIT
+};
+
+struct bbr {
+	bbr_mode_t	mode;
+	uint32_t	pacing_gain;
+	uint32_t	cwnd_gain;
+
+	/* Round trip counting. */
+	uint64_t	round_count;
+	uint32_t	next_round_seq;
+	boolean_t	round_start;
+
+	/* Bottleneck bandwidth, max filter indexed by round. */
+	uint64_t	bw[BBR_BW_ROUNDS];
+	uint64_t	btlbw;
+	hrtime_t	rs_start;	/* Last rate sample consumed. */
+
+	/* Round trip propagation time. */
+	hrtime_t	min_rtt;
+	hrtime_t	min_rtt_stamp;
+
+	/* STARTUP exit detection. */
+	uint64_t	full_bw;
+	uint32_t	full_bw_cnt;
+	boolean_t	full_bw_reached;
+
+	/* PROBE_BW gain cycling. */
+	uint32_t	cycle_idx;
+	hrtime_t	cycle_stamp;
+
+	/* PROBE_RTT. */
+	hrtime_t	probe_rtt_done;
+	boolean_t	probe_rtt_round_done;
+	uint32_t	prior_cwnd;
+};
+
+typedef struct bbr_stat {
+	kstat_named_t	bbr_bw_samples;
+	kstat_named_t	bbr_bw_app_limited;
+	kstat_named_t	bbr_startup_exit;
+	kstat_named_t	bbr_probe_rtt;
+	kstat_named_t	bbr_recovery;
+	kstat_named_t	bbr_rto;
+} bbr_stat_t;
+
+static bbr_stat_t bbr_stats = {
+	{ "bw_samples",		KSTAT_DATA_UINT64 },
+	{ "bw_app_limited",	KSTAT_DATA_UINT64 },
+	{ "startup_exit",	KSTAT_DATA_UINT64 },
+	{ "probe_rtt",		KSTAT_DATA_UINT64 },
+	{ "recovery",		KSTAT_DATA_UINT64 },
+	{ "rto",		KSTAT_DATA_UINT64 },
+};
+
+static kstat_t *bbr_ksp;
+
+#define	BBR_STAT(x)	atomic_inc_64(&bbr_stats.x.value.ui64)
+
+static void	bbr_ack_received(struct cc_var *ccv, uint16_t type);
+static void	bbr_after_idle(struct cc_var *ccv);
+static void	bbr_cb_destroy(struct cc_var *ccv);
+static int	bbr_cb_init(struct cc_var *ccv);
+static void	bbr_cong_signal(struct cc_var *ccv, uint32_t type);
+static void	bbr_conn_init(struct cc_var *ccv);
+static void	bbr_post_recovery(struct cc_var *ccv);
+
+static struct modlmisc cc_bbr_modlmisc = {
+	&mod_miscops,
+	"BBR Congestion Control"
+};
+
+static struct modlinkage cc_bbr_modlinkage = {
+	MODREV_1,
+	&cc_bbr_modlmisc,
+	NULL
+};
+
+struct cc_algo bbr_cc_algo = {
+	.name = "bbr",
+	.ack_received = bbr_ack_received,
+	.cb_destroy = bbr_cb_destroy,
+	.cb_init = bbr_cb_init,
+	.cong_signal = bbr_cong_signal,
+	.conn_init = bbr_conn_init,
+	.post_recovery = bbr_post_recovery,
+	.after_idle = bbr_after_idle,
+};
+
+int
+_init(void)
+{
+	int err;
+
+	if ((err = cc_register_algo(&bbr_cc_algo)) != 0)
+		return (err);
+	if ((err = mod_install(&cc_bbr_modlinkage)) != 0) {
+		(void) cc_deregister_algo(&bbr_cc_algo);
+		return (err);
+	}
+
+	bbr_ksp = kstat_create("cc_bbr", 0, "statistics", "net",
+	    KSTAT_TYPE_NAMED, sizeof (bbr_stats) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+	if (bbr_ksp != NULL) {
+		bbr_ksp->ks_data = &bbr_stats;
+		kstat_install(bbr_ksp);
+	}
+
+	return (0);
+}
+
+int
+_fini(void)
+{
+	/* XXX Not unloadable for now */
+	return (EBUSY);
+}
+
+int
+_info(struct modinfo *modinfop)
+{
+	return (mod_info(&cc_bbr_modlinkage, modinfop));
+}
+
+static uint32_t
+bbr_inflight(struct cc_var *ccv)
+{
+	return (CCV(ccv, tcp_snxt) - CCV(ccv, tcp_suna));
+}
+
+/*
+ * The bandwidth-delay product scaled by gain, in bytes.
+ */
+static uint64_t
+bbr_bdp(struct bbr *bbr, uint32_t gain)
+{
+	if (bbr->btlbw == 0 || bbr->min_rtt == 0)
+		return (0);
+	return (bbr->btlbw * bbr->min_rtt / NANOSEC * gain / BBR_UNIT);
+}
+
+static void
+bbr_update_btlbw(struct bbr *bbr)
+{
+	uint_t i;
+
+	bbr->btlbw = 0;
+	for (i = 0; i < BBR_BW_ROUNDS; i++)
+		bbr->btlbw = MAX(bbr->btlbw, bbr->bw[i]);
+}
+
+/*
+ * A round trip ends when the data that was outstanding at its start has been
+ * acknowledged.  Each new round expires the oldest slot of the max filter.
+ */
+static void
+bbr_update_round(struct cc_var *ccv, struct bbr *bbr)
+{
+	bbr->round_start = B_FALSE;
+	if (SEQ_GEQ(ccv->curack, bbr->next_round_seq)) {
+		bbr->round_count++;
+		bbr->next_round_seq = CCV(ccv, tcp_snxt);
+		bbr->round_start = B_TRUE;
+		bbr->bw[bbr->round_count % BBR_BW_ROUNDS] = 0;
+		bbr_update_btlbw(bbr);
+	}
+}
+
+/*
+ * Fold a new delivery rate sample, if TCP took one on this ACK, into the
+ * bottleneck bandwidth max filter.  Application limited samples are only
+ * used if they raise the estimate.
+ */
+static void
+bbr_update_bw(struct cc_var *ccv, struct bbr *bbr)
+{
+	uint64_t rate = CCV(ccv, tcp_delivery_rate);
+	uint_t slot = bbr->round_count % BBR_BW_ROUNDS;
+
+	if (CCV(ccv, tcp_rs_start) == bbr->rs_start || rate == 0)
+		return;
+	bbr->rs_start = CCV(ccv, tcp_rs_start);
+
+	BBR_STAT(bbr_bw_samples);
+	if (CCV(ccv, tcp_rs_app_limited) && rate < bbr->btlbw) {
+		BBR_STAT(bbr_bw_app_limited);
+		return;
+	}
+
+	bbr->bw[slot] = MAX(bbr->bw[slot], rate);
+	bbr->btlbw = MAX(bbr->btlbw, rate);
+}
+
+static void
+bbr_update_min_rtt(struct cc_var *ccv, struct bbr *bbr, hrtime_t now)
+{
+	hrtime_t rtt = CCV(ccv, tcp_rtt_last);
+	boolean_t expired;
+
+	expired = now - bbr->min_rtt_stamp > BBR_MIN_RTT_WIN;
+	if (rtt > 0 && (bbr->min_rtt == 0 || rtt <= bbr->min_rtt ||
+	    expired)) {
+		bbr->min_rtt = rtt;
+		bbr->min_rtt_stamp = now;
+	}
+
+	if (expired && bbr->mode != BBR_PROBE_RTT) {
+		BBR_STAT(bbr_probe_rtt);
+		bbr->mode = BBR_PROBE_RTT;
+		bbr->pacing_gain = BBR_UNIT;
+		bbr->cwnd_gain = BBR_UNIT;
+		bbr->prior_cwnd = MAX(bbr->prior_cwnd, CCV(ccv, tcp_cwnd));
+		bbr->probe_rtt_done = 0;
+	}
+}
+
+static void
+bbr_enter_probe_bw(struct bbr *bbr, hrtime_t now)
+{
+	bbr->mode = BBR_PROBE_BW;
+	bbr->cwnd_gain = BBR_CWND_GAIN;
+	/* Start at a random phase, but never in the drain phase. */
+	bbr->cycle_idx = BBR_CYCLE_LEN - 1 -
+	    (uint32_t)((now >> 10) % (BBR_CYCLE_LEN - 1));
+	bbr->cycle_idx = (bbr->cycle_idx + 1) % BBR_CYCLE_LEN;
+	bbr->pacing_gain = bbr_pacing_gain[bbr->cycle_idx];
+	bbr->cycle_stamp = now;
+}
+
+static void
+bbr_enter_startup(struct bbr *bbr)
+{
+	bbr->mode = BBR_STARTUP;
+	bbr->pacing_gain = BBR_HIGH_GAIN;
+	bbr->cwnd_gain = BBR_HIGH_GAIN;
+}
+
+static void
+bbr_update_state(struct cc_var *ccv, struct bbr *bbr, hrtime_t now)
+{
+	uint32_t inflight = bbr_inflight(ccv);
+	uint32_t mss = CCV(ccv, tcp_mss);
+
+	switch (bbr->mode) {
+	case BBR_STARTUP:
+		if (!bbr->round_start || bbr->full_bw_reached)
+			break;
+		if (bbr->btlbw >= bbr->full_bw * 5 / 4) {
+			bbr->full_bw = bbr->btlbw;
+			bbr->full_bw_cnt = 0;
+			break;
+		}
+		if (++bbr->full_bw_cnt < BBR_FULL_BW_ROUNDS)
+			break;
+		bbr->full_bw_reached = B_TRUE;
+		BBR_STAT(bbr_startup_exit);
+		bbr->mode = BBR_DRAIN;
+		bbr->pacing_gain = BBR_DRAIN_GAIN;
+		bbr->cwnd_gain = BBR_HIGH_GAIN;
+		/* FALLTHRU */
+	case BBR_DRAIN:
+		if (inflight <= bbr_bdp(bbr, BBR_UNIT))
+			bbr_enter_probe_bw(bbr, now);
+		break;
+
+	case BBR_PROBE_BW: {
+		boolean_t advance;
+
+		advance = now - bbr->cycle_stamp > bbr->min_rtt;
+		if (bbr->pacing_gain > BBR_UNIT) {
+			/* Probe until the extra data is actually in flight. */
+			advance = advance && (IN_RECOVERY(ccv->flags) ||
+			    inflight >= bbr_bdp(bbr, bbr->pacing_gain));
+		} else if (bbr->pacing_gain < BBR_UNIT) {
+			/* Drain early once the queue is gone. */
+			advance = advance ||
+			    inflight <= bbr_bdp(bbr, BBR_UNIT);
+		}
+		if (advance) {
+			bbr->cycle_idx = (bbr->cycle_idx + 1) % BBR_CYCLE_LEN;
+			bbr->pacing_gain = bbr_pacing_gain[bbr->cycle_idx];
+			bbr->cycle_stamp = now;
+		}
+		break;
+	}
+
+	case BBR_PROBE_RTT:
+		if (bbr->probe_rtt_done == 0) {
+			if (inflight <= BBR_MIN_CWND * mss) {
+				bbr->probe_rtt_done = now + BBR_PROBE_RTT_TIME;
+				bbr->probe_rtt_round_done = B_FALSE;
+				bbr->next_round_seq = CCV(ccv, tcp_snxt);
+			}
+			break;
+		}
+		if (bbr->round_start)
+			bbr->probe_rtt_round_done = B_TRUE;
+		if (bbr->probe_rtt_round_done && now >= bbr->probe_rtt_done) {
+			bbr->min_rtt_stamp = now;
+			CCV(ccv, tcp_cwnd) = MAX(CCV(ccv, tcp_cwnd),
+			    bbr->prior_cwnd);
+			bbr->prior_cwnd = 0;
+			if (bbr->full_bw_reached)
+				bbr_enter_probe_bw(bbr, now);
+			else
+				bbr_enter_startup(bbr);
+		}
+		break;
+	}
+}
+
+/*
+ * Set the pacing rate from the model.  Before the first bandwidth sample the
+ * rate is derived from the initial window and the smoothed RTT.
+ */
+static void
+bbr_set_pacing_rate(struct cc_var *ccv, struct bbr *bbr)
+{
+	uint64_t rate;
+
+	if (bbr->btlbw != 0) {
+		rate = bbr->btlbw;
+	} else {
+		hrtime_t srtt = CCV(ccv, tcp_rtt_sa) >> 3;
+
+		if (srtt <= 0)
+			srtt = MSEC2NSEC(1);
+		rate = (uint64_t)CCV(ccv, tcp_cwnd) * NANOSEC / srtt;
+	}
+	/* Pace slightly below the estimate to keep the bottleneck queue low */
+	rate = rate * bbr->pacing_gain / BBR_UNIT * 99 / 100;
+
+	/*
+	 * Don't lower the rate until STARTUP has found the bottleneck, a low
+	 * early sample would otherwise hold back the exponential growth.
+	 */
+	if (!bbr->full_bw_reached && rate < CCV(ccv, tcp_pacing_rate))
+		return;
+	CCV(ccv, tcp_pacing_rate) = MAX(rate, 1);
+}
+
+static void
+bbr_set_cwnd(struct cc_var *ccv, struct bbr *bbr)
+{
+	uint32_t mss = CCV(ccv, tcp_mss);
+	uint32_t cwnd = CCV(ccv, tcp_cwnd);
+	uint64_t target;
+
+	if (IN_RECOVERY(ccv->flags))
+		return;
+
+	target = bbr_bdp(bbr, bbr->cwnd_gain);
+	if (target != 0) {
+		/* Allow for delayed and stretched ACKs. */
+		target += 3 * mss;
+	}
+
+	if (bbr->full_bw_reached && target != 0)
+		cwnd = MIN(cwnd + ccv->bytes_this_ack, target);
+	else if (target == 0 || cwnd < target)
+		cwnd += ccv->bytes_this_ack;
+	cwnd = MAX(cwnd, BBR_MIN_CWND * mss);
+
+	if (bbr->mode == BBR_PROBE_RTT)
+		cwnd = MIN(cwnd, BBR_MIN_CWND * mss);
+
+	CCV(ccv, tcp_cwnd) = MIN(cwnd, TCP_MAXWIN << CCV(ccv, tcp_snd_ws));
+}
+
+static void
+bbr_ack_received(struct cc_var *ccv, uint16_t type)
+{
+	struct bbr *bbr = ccv->cc_data;
+	hrtime_t now = gethrtime();
+
+	if (type != CC_ACK)
+		return;
+
+	bbr_update_round(ccv, bbr);
+	bbr_update_bw(ccv, bbr);
+	bbr_update_min_rtt(ccv, bbr, now);
+	bbr_update_state(ccv, bbr, now);
+	bbr_set_pacing_rate(ccv, bbr);
+	bbr_set_cwnd(ccv, bbr);
+
+	DTRACE_PROBE4(cc__bbr__ack, tcp_t *, CCV_PROTO(ccv), int, bbr->mode,
+	    uint64_t, bbr->btlbw, hrtime_t, bbr->min_rtt);
+}
+
+static void
+bbr_after_idle(struct cc_var *ccv)
+{
+	struct bbr *bbr = ccv->cc_data;
+
+	/*
+	 * The model is still valid after an idle period so the window is
+	 * kept, but don't restart with a bandwidth probe: pace at the
+	 * estimated bottleneck rate instead.
+	 */
+	if (bbr->mode == BBR_PROBE_BW && bbr->pacing_gain > BBR_UNIT) {
+		bbr->pacing_gain = BBR_UNIT;
+		bbr_set_pacing_rate(ccv, bbr);
+	}
+}
+
+static void
+bbr_cb_destroy(struct cc_var *ccv)
+{
+	CCV(ccv, tcp_pacing_rate) = 0;
+	if (ccv->cc_data != NULL)
+		kmem_free(ccv->cc_data, sizeof (struct bbr));
+}
+
+static int
+bbr_cb_init(struct cc_var *ccv)
+{
+	struct bbr *bbr;
+
+	bbr = kmem_zalloc(sizeof (struct bbr), KM_NOSLEEP);
+	if (bbr == NULL)
+		return (ENOMEM);
+
+	bbr_enter_startup(bbr);
+	bbr->min_rtt_stamp = gethrtime();
+	ccv->cc_data = bbr;
+
+	return (0);
+}
+
+/*
+ * BBR does not treat loss as a sign of congestion; on entering recovery it
+ * only limits the window to what is in flight (packet conservation) and
+ * restores it once recovery is over.
+ */
+static void
+bbr_cong_signal(struct cc_var *ccv, uint32_t type)
+{
+	struct bbr *bbr = ccv->cc_data;
+	uint32_t mss = CCV(ccv, tcp_mss);
+	uint32_t inflight;
+
+	/* Catch algos which mistakenly leak private signal types. */
+	ASSERT((type & CC_SIGPRIVMASK) == 0);
+
+	switch (type) {
+	case CC_NDUPACK:
+		if (!IN_FASTRECOVERY(ccv->flags)) {
+			BBR_STAT(bbr_recovery);
+			bbr->prior_cwnd = MAX(bbr->prior_cwnd,
+			    CCV(ccv, tcp_cwnd));
+			inflight = MAX(bbr_inflight(ccv), 2 * mss);
+			CCV(ccv, tcp_cwnd_ssthresh) = inflight;
+			CCV(ccv, tcp_cwnd) = inflight;
+			ENTER_RECOVERY(ccv->flags);
+		}
+		break;
+	case CC_ECN:
+		/* Version 1 of BBR does not respond to ECN. */
+		break;
+	case CC_RTO:
+		BBR_STAT(bbr_rto);
+		bbr->prior_cwnd = MAX(bbr->prior_cwnd, CCV(ccv, tcp_cwnd));
+		CCV(ccv, tcp_cwnd_ssthresh) = MAX(bbr->prior_cwnd, 2 * mss);
+		CCV(ccv, tcp_cwnd) = mss;
+		break;
+	}
+}
+
+static void
+bbr_conn_init(struct cc_var *ccv)
+{
+	struct bbr *bbr = ccv->cc_data;
+
+	bbr->next_round_seq = CCV(ccv, tcp_snxt);
+	bbr_set_pacing_rate(ccv, bbr);
+}
+
+static void
+bbr_post_recovery(struct cc_var *ccv)
+{
+	struct bbr *bbr = ccv->cc_data;
+
+	if (bbr->mode != BBR_PROBE_RTT) {
+		CCV(ccv, tcp_cwnd) = MAX(CCV(ccv, tcp_cwnd), bbr->prior_cwnd);
+		bbr->prior_cwnd = 0;
+	}
+	CCV(ccv, tcp_cwnd_ssthresh) = TCP_MAX_LARGEWIN;
+}
@@ -2196,6 +2196,15 @@ struct ip_xmit_attr_s {
 	squeue_t	*ixa_sqp;	/* Set from conn_sqp as a hint */
 	uintptr_t	ixa_cookie;	/* cookie to use for tx flow control */
 
+	/*
+	 * Pacing rate (bytes per second) set by the ULP, and what was last
+	 * passed down to the MAC layer for this flow by ip_xmit_pace().
+	 */
+	uint64_t	ixa_pacing_rate;
+	uint64_t	ixa_pacing_set;
+	ill_t		*ixa_pacing_ill;	/* Only compared, not held */
+	clock_t		ixa_pacing_lbolt;
+
 	/*
 	 * Must be set by ULP if any of IXAF_VERIFY_LSO, IXAF_VERIFY_PMTU,
 	 * or IXAF_VERIFY_ZCOPY is set.
@@ -3579,6 +3588,7 @@ typedef	void			(*ip_flow_enable_t)(void *, ip_mac_tx_cookie_t);
 typedef void			*(*ip_dld_callb_t)(void *,
     ip_flow_enable_t, void *);
 typedef boolean_t		(*ip_dld_fctl_t)(void *, ip_mac_tx_cookie_t);
+typedef void			(*ip_dld_pace_t)(void *, uintptr_t, uint64_t);
 typedef int			(*ip_capab_func_t)(void *, uint_t,
     void *, uint_t);
 
@@ -3629,6 +3639,8 @@ typedef struct ill_dld_direct_s {		/* DLD provided driver Tx */
 	void			*idd_tx_cb_dh;	/* mac_client_handle_t *mch */
 	ip_dld_fctl_t		idd_tx_fctl_df;	/* mac_tx_is_flow_blocked */
 	void			*idd_tx_fctl_dh;	/* mac_client_handle */
+	ip_dld_pace_t		idd_tx_pace_df;	/* mac_tx_pace */
+	void			*idd_tx_pace_dh;	/* mac_client_handle */
 } ill_dld_direct_t;
 
 /* IP - DLD polling capability */
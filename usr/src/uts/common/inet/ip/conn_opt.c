@@ -648,6 +648,9 @@ conn_opt_get(conn_opt_arg_t *coa, t_scalar_t level, t_scalar_t name,
 		case SO_REUSEPORT:
 			*i1 = connp->conn_reuseport;
 			break;	/* goto sizeof (int) option return */
+		case SO_MAX_PACING_RATE:
+			*i1 = connp->conn_max_pacing_rate;
+			break;	/* goto sizeof (int) option return */
 		case SO_TYPE:
 			*i1 = connp->conn_so_type;
 			break;	/* goto sizeof (int) option return */
@@ -1196,6 +1199,12 @@ conn_opt_set_socket(conn_opt_arg_t *coa, t_scalar_t name, uint_t inlen,
 	case SO_EXCLBIND:
 		connp->conn_exclbind = onoff;
 		break;
+	case SO_MAX_PACING_RATE:
+		/* Both 0 and ~0 mean no limit */
+		connp->conn_max_pacing_rate = (*(uint_t *)invalp == UINT_MAX) ?
+		    0 : *(uint_t *)invalp;
+		ixa->ixa_pacing_rate = connp->conn_max_pacing_rate;
+		break;
 	}
 	mutex_exit(&connp->conn_lock);
 	return (0);
@@ -963,6 +963,9 @@ ire_send_wire_v6(ire_t *ire, mblk_t *mp, void *iph_arg,
 	ASSERT(ixa->ixa_nce != NULL);
 	ill = ixa->ixa_nce->nce_ill;
 
+	if (ixa->ixa_pacing_rate != 0 || ixa->ixa_pacing_set != 0)
+		ip_xmit_pace(ixa, ill);
+
 	/*
 	 * Update output mib stats. Note that we can't move into the icmp
 	 * sender (icmp_output etc) since they don't know the ill and the
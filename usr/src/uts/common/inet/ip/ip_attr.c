@@ -1105,6 +1105,11 @@ ixa_cleanup(ip_xmit_attr_t *ixa)
 	ixa->ixa_ifindex = 0;
 	ixa->ixa_multicast_ifindex = 0;
 	ixa->ixa_multicast_ifaddr = INADDR_ANY;
+	/*
+	 * Leave ixa_pacing_set alone so that the next user of this ixa
+	 * clears any rate still installed for the flow below us.
+	 */
+	ixa->ixa_pacing_rate = 0;
 }
 
 /*
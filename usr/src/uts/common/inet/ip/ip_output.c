@@ -1823,6 +1823,40 @@ ip_output_cksum_v4(iaflags_t ixaflags, mblk_t *mp, ipha_t *ipha,
 	return (ip_output_sw_cksum_v4(mp, ipha, ixa));
 }
 
+/*
+ * Pass the pacing rate of a flow down to the MAC layer, keyed by the same
+ * transmit hint as its packets. This is called only for flows that have,
+ * or had, a rate. Changes of less than 1/16th are not passed on, and the
+ * rate is refreshed once a second since MAC forgets idle flows.
+ */
+void
+ip_xmit_pace(ip_xmit_attr_t *ixa, ill_t *ill)
+{
+	ill_dld_direct_t *idd;
+	uint64_t	rate = ixa->ixa_pacing_rate;
+	uint64_t	delta;
+	clock_t		now = ddi_get_lbolt();
+
+	delta = (rate > ixa->ixa_pacing_set) ? rate - ixa->ixa_pacing_set :
+	    ixa->ixa_pacing_set - rate;
+	if (ill == ixa->ixa_pacing_ill && now - ixa->ixa_pacing_lbolt < hz &&
+	    (rate == 0) == (ixa->ixa_pacing_set == 0) &&
+	    delta <= (ixa->ixa_pacing_set >> 4))
+		return;
+
+	ixa->ixa_pacing_set = rate;
+	ixa->ixa_pacing_ill = ill;
+	ixa->ixa_pacing_lbolt = now;
+
+	if (!(ill->ill_capabilities & ILL_CAPAB_DLD_DIRECT))
+		return;
+	idd = &ill->ill_dld_capab->idc_direct;
+	if (idd->idd_tx_pace_df != NULL) {
+		idd->idd_tx_pace_df(idd->idd_tx_pace_dh,
+		    (uintptr_t)ixa->ixa_xmit_hint, rate);
+	}
+}
+
 /*
  * ire_sendfn for offlink and onlink destinations.
  * Also called from the multicast, broadcast, multirt send functions.
@@ -1848,6 +1882,9 @@ ire_send_wire_v4(ire_t *ire, mblk_t *mp, void *iph_arg,
 	if (ixaflags & IXAF_DONTROUTE)
 		ipha->ipha_ttl = 1;
 
+	if (ixa->ixa_pacing_rate != 0 || ixa->ixa_pacing_set != 0)
+		ip_xmit_pace(ixa, ill);
+
 	/*
 	 * Assign an ident value for this packet. There could be other
 	 * threads targeting the same destination, so we have to arrange
@@ -82,6 +82,31 @@
  * counter on the connection found (if any). This reference should be dropped
  * when the caller has finished processing the connection.
  *
+ * The one exception to the locking rule is the lookup of an established TCP
+ * connection by ipcl_classify_v4() and ipcl_classify_v6(), which is done for
+ * nearly every inbound TCP segment.  Unless ipcl_conn_lockless is cleared,
+ * that lookup walks the ipcl_conn_fanout bucket without connf_lock:
+ *
+ *	o The walk is done inside an epoch read section (ipcl_epoch_enter()/
+ *	  ipcl_epoch_exit()).  A read section only bumps a per-CPU counter,
+ *	  so it costs no shared cache line.  The memory of a TCP conn_t is not
+ *	  returned to tcp_conn_cache until every read section that might have
+ *	  seen it has ended (ipcl_conn_free_deferred()), so a walker never
+ *	  touches freed memory.  A conn_t may still be recycled through the
+ *	  TCP free list while a walker looks at it.
+ *
+ *	o Writers bump connf_gen around every linkage change.  A walk which
+ *	  finds no match is only trusted if connf_gen was even and did not
+ *	  change while walking; otherwise the lookup is redone under the lock.
+ *
+ *	o A match is confirmed under the conn_lock of the conn found: it must
+ *	  still be hashed in the same bucket, not be condemned and have a
+ *	  non-zero reference count, and it must still match the packet once
+ *	  the reference is taken.  Anything else sends the lookup to the
+ *	  locked path.  As conn_lock is also held when the TIME_WAIT reclaim
+ *	  fast path checks conn_ref and removes a conn_t, that fast path is
+ *	  not affected.
+ *
  *
  * INTERFACES:
  * ===========
@@ -122,6 +147,8 @@
  *	remote port} lookup is done on ipcl_udp_fanout. Note that,
  *	these interfaces do not handle cases where a packets belongs
  *	to multiple UDP clients, which is handled in IP itself.
+ *	If the matching conn_t is part of an SO_REUSEPORT group, one member
+ *	of the group is chosen by ipcl_udp_reuseport_select().
  *
  * If the destination IRE is ALL_ZONES (indicated by zoneid), then we must
  * determine which actual zone gets the segment.  This is used only in a
@@ -248,6 +275,7 @@
 #include <sys/systm.h>
 #include <sys/param.h>
 #include <sys/kmem.h>
+#include <sys/taskq_impl.h>
 #include <sys/isa_defs.h>
 #include <inet/common.h>
 #include <netinet/ip6.h>
@@ -290,6 +318,50 @@ uint_t ipcl_udp_fanout_size = 16384;
 /* Raw socket fanout size.  Must be a power of 2. */
 uint_t ipcl_raw_fanout_size = 256;
 
+/*
+ * By default a UDP SO_REUSEPORT group member is chosen from a hash of the
+ * remote address and port, so each flow sticks to one member.  If this is
+ * set, the member is chosen by the CPU classifying the packet instead,
+ * which is the CPU of the soft ring that received it, so that servers
+ * with one thread bound to each CPU keep their traffic local.
+ */
+boolean_t ipcl_udp_reuseport_cpu = B_FALSE;
+
+/*
+ * Look up established TCP connections without the fanout lock; see the
+ * block comment at the top of this file.  Setable in /etc/system.
+ */
+boolean_t ipcl_conn_lockless = B_TRUE;
+
+/* Longest chain a lockless walk follows before giving up on the walk */
+#define	IPCL_LOCKLESS_MAXWALK	64
+
+/*
+ * Per-CPU reader counts of the epoch read sections.  A reader counts itself
+ * in the slot selected by the low bit of ipcl_epoch_idx.  A grace period
+ * flips that bit and waits for the old slot of every CPU to drain, twice,
+ * so that readers which sampled the index just before a flip are waited for
+ * as well.
+ */
+typedef union ipcl_epoch_u {
+	volatile uint_t	ie_readers[2];
+	char		ie_filler[CACHE_ALIGN_SIZE];
+} ipcl_epoch_t;
+
+static ipcl_epoch_t	*ipcl_epoch;
+static volatile uint_t	ipcl_epoch_idx;
+
+/*
+ * TCP conn_ts waiting for a grace period before going back to the cache.
+ * They are chained through conn_g_next, which is no longer used once the
+ * conn_t has left the global hash.
+ */
+static kmutex_t		ipcl_conn_reap_lock;
+static conn_t		*ipcl_conn_reap_list;
+static boolean_t	ipcl_conn_reap_scheduled;
+static taskq_t		*ipcl_conn_reap_taskq;
+static taskq_ent_t	ipcl_conn_reap_ent;
+
 /*
  * The IPCL_IPTUN_HASH() function works best with a prime table size.  We
  * expect that most large deployments would have hundreds of tunnels, and
@@ -341,6 +413,8 @@ static void	rawip_conn_destructor(void *, void *);
 static int	rts_conn_constructor(void *, void *, int);
 static void	rts_conn_destructor(void *, void *);
 
+static void	ipcl_conn_reap(void *);
+
 /*
  * Global (for all stack instances) init routine
  */
@@ -371,6 +445,11 @@ ipcl_g_init(void)
 	    sizeof (itc_t) + sizeof (rts_t), CACHE_ALIGN_SIZE,
 	    rts_conn_constructor, rts_conn_destructor,
 	    NULL, NULL, NULL, 0);
+
+	ipcl_epoch = kmem_zalloc(max_ncpus * sizeof (ipcl_epoch_t), KM_SLEEP);
+	mutex_init(&ipcl_conn_reap_lock, NULL, MUTEX_DEFAULT, NULL);
+	ipcl_conn_reap_taskq = taskq_create("ipcl_conn_reap", 1, minclsyspri,
+	    1, 1, TASKQ_PREPOPULATE);
 }
 
 /*
@@ -485,6 +564,13 @@ ipcl_init(ip_stack_t *ipst)
 void
 ipcl_g_destroy(void)
 {
+	/* Waits for the reaper, which empties the deferred free list */
+	taskq_destroy(ipcl_conn_reap_taskq);
+	ASSERT(ipcl_conn_reap_list == NULL);
+	mutex_destroy(&ipcl_conn_reap_lock);
+	kmem_free(ipcl_epoch, max_ncpus * sizeof (ipcl_epoch_t));
+	ipcl_epoch = NULL;
+
 	kmem_cache_destroy(ip_conn_cache);
 	kmem_cache_destroy(tcp_conn_cache);
 	kmem_cache_destroy(udp_conn_cache);
@@ -631,6 +717,106 @@ ipcl_conn_create(uint32_t type, int sleep, netstack_t *ns)
 	return (connp);
 }
 
+/*
+ * Enter an epoch read section.  The returned pointer must be passed to
+ * ipcl_epoch_exit().  The section may block; being migrated to another CPU
+ * in the meantime only costs the locality of the counter.
+ */
+static volatile uint_t *
+ipcl_epoch_enter(void)
+{
+	volatile uint_t *cntp;
+
+	cntp = &ipcl_epoch[CPU->cpu_seqid].ie_readers[ipcl_epoch_idx & 1];
+	atomic_inc_uint(cntp);
+	/* Pairs with the membar_enter() in ipcl_epoch_sync() */
+	membar_enter();
+	return (cntp);
+}
+
+static void
+ipcl_epoch_exit(volatile uint_t *cntp)
+{
+	membar_exit();
+	atomic_dec_uint(cntp);
+}
+
+static boolean_t
+ipcl_epoch_busy(uint_t idx)
+{
+	int i;
+
+	for (i = 0; i < max_ncpus; i++) {
+		if (ipcl_epoch[i].ie_readers[idx] != 0)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Wait until every epoch read section that was active on entry has ended.
+ * Only called from the single reaper thread.
+ */
+static void
+ipcl_epoch_sync(void)
+{
+	uint_t idx;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		idx = ipcl_epoch_idx & 1;
+		ipcl_epoch_idx++;
+		membar_enter();
+		while (ipcl_epoch_busy(idx))
+			delay(1);
+	}
+}
+
+/* ARGSUSED */
+static void
+ipcl_conn_reap(void *arg)
+{
+	conn_t *connp, *next;
+
+	mutex_enter(&ipcl_conn_reap_lock);
+	while ((connp = ipcl_conn_reap_list) != NULL) {
+		ipcl_conn_reap_list = NULL;
+		mutex_exit(&ipcl_conn_reap_lock);
+
+		ipcl_epoch_sync();
+		for (; connp != NULL; connp = next) {
+			next = connp->conn_g_next;
+			connp->conn_g_next = NULL;
+			kmem_cache_free(tcp_conn_cache, connp);
+		}
+
+		mutex_enter(&ipcl_conn_reap_lock);
+	}
+	ipcl_conn_reap_scheduled = B_FALSE;
+	mutex_exit(&ipcl_conn_reap_lock);
+}
+
+/*
+ * Return a TCP conn_t to tcp_conn_cache once no lockless lookup can still
+ * be looking at it.  The frees are batched so one grace period covers all
+ * the conn_ts destroyed while the previous one was running.
+ */
+static void
+ipcl_conn_free_deferred(conn_t *connp)
+{
+	ASSERT(connp->conn_g_fanout == NULL);
+
+	mutex_enter(&ipcl_conn_reap_lock);
+	connp->conn_g_next = ipcl_conn_reap_list;
+	ipcl_conn_reap_list = connp;
+	if (!ipcl_conn_reap_scheduled) {
+		ipcl_conn_reap_scheduled = B_TRUE;
+		taskq_dispatch_ent(ipcl_conn_reap_taskq, ipcl_conn_reap, NULL,
+		    0, &ipcl_conn_reap_ent);
+	}
+	mutex_exit(&ipcl_conn_reap_lock);
+}
+
 void
 ipcl_conn_destroy(conn_t *connp)
 {
@@ -714,7 +900,7 @@ ipcl_conn_destroy(conn_t *connp)
 
 		tcp->tcp_timercache = mp;
 		tcp->tcp_connp = connp;
-		kmem_cache_free(tcp_conn_cache, connp);
+		ipcl_conn_free_deferred(connp);
 		return;
 	}
 
@@ -777,6 +963,40 @@ ipcl_conn_unlisten(conn_t *connp)
 	connp->conn_flags &= ~IPCL_CL_LISTENER;
 }
 
+/*
+ * Bracket a change to the linkage of a bucket for the benefit of lockless
+ * walkers; see connf_gen.  Called with connf_lock held.
+ */
+#define	CONNF_GEN_BEGIN(connfp)	{					\
+	ASSERT(MUTEX_HELD(&(connfp)->connf_lock));			\
+	(connfp)->connf_gen++;						\
+	membar_producer();						\
+}
+
+#define	CONNF_GEN_END(connfp)	{					\
+	membar_producer();						\
+	(connfp)->connf_gen++;						\
+}
+
+/*
+ * Keep connf_reuseport in step with the entries bound with SO_REUSEPORT.
+ * Called with the bucket lock held.
+ */
+#define	IPCL_REUSEPORT_JOIN(connfp, connp) {				\
+	if ((connp)->conn_reuseport) {					\
+		(connp)->conn_flags |= IPCL_REUSEPORT_MEMBER;		\
+		(connfp)->connf_reuseport++;				\
+	}								\
+}
+
+#define	IPCL_REUSEPORT_LEAVE(connfp, connp) {				\
+	if ((connp)->conn_flags & IPCL_REUSEPORT_MEMBER) {		\
+		(connp)->conn_flags &= ~IPCL_REUSEPORT_MEMBER;		\
+		ASSERT((connfp)->connf_reuseport != 0);			\
+		(connfp)->connf_reuseport--;				\
+	}								\
+}
+
 /*
  * We set the IPCL_REMOVED flag (instead of clearing the flag indicating
  * which table the conn belonged to). So for debugging we can see which hash
@@ -787,6 +1007,7 @@ ipcl_conn_unlisten(conn_t *connp)
 	ASSERT(!MUTEX_HELD(&((connp)->conn_lock)));			\
 	if (connfp != NULL) {						\
 		mutex_enter(&connfp->connf_lock);			\
+		CONNF_GEN_BEGIN(connfp);				\
 		if ((connp)->conn_next != NULL)				\
 			(connp)->conn_next->conn_prev =			\
 			    (connp)->conn_prev;				\
@@ -798,6 +1019,8 @@ ipcl_conn_unlisten(conn_t *connp)
 		(connp)->conn_fanout = NULL;				\
 		(connp)->conn_next = NULL;				\
 		(connp)->conn_prev = NULL;				\
+		CONNF_GEN_END(connfp);					\
+		IPCL_REUSEPORT_LEAVE(connfp, connp);			\
 		(connp)->conn_flags |= IPCL_REMOVED;			\
 		if (((connp)->conn_flags & IPCL_CL_LISTENER) != 0)	\
 			ipcl_conn_unlisten((connp));			\
@@ -825,7 +1048,8 @@ ipcl_hash_remove(conn_t *connp)
  * TCP and one for the classifier hash list. If ref count
  * is indeed 2, we can just remove the conn under lock and
  * avoid cleaning up the conn under squeue. This gives us
- * improved performance.
+ * improved performance. Lockless lookups only take their reference
+ * under conn_lock, which the collector also holds here.
  */
 void
 ipcl_hash_remove_locked(conn_t *connp, connf_t	*connfp)
@@ -834,6 +1058,7 @@ ipcl_hash_remove_locked(conn_t *connp, connf_t	*connfp)
 	ASSERT(MUTEX_HELD(&connp->conn_lock));
 	ASSERT((connp->conn_flags & IPCL_CL_LISTENER) == 0);
 
+	CONNF_GEN_BEGIN(connfp);
 	if ((connp)->conn_next != NULL) {
 		(connp)->conn_next->conn_prev = (connp)->conn_prev;
 	}
@@ -845,6 +1070,8 @@ ipcl_hash_remove_locked(conn_t *connp, connf_t	*connfp)
 	(connp)->conn_fanout = NULL;
 	(connp)->conn_next = NULL;
 	(connp)->conn_prev = NULL;
+	CONNF_GEN_END(connfp);
+	IPCL_REUSEPORT_LEAVE(connfp, connp);
 	(connp)->conn_flags |= IPCL_REMOVED;
 	ASSERT((connp)->conn_ref == 2);
 	(connp)->conn_ref--;
@@ -854,15 +1081,19 @@ ipcl_hash_remove_locked(conn_t *connp, connf_t	*connfp)
 	ASSERT((connp)->conn_fanout == NULL);				\
 	ASSERT((connp)->conn_next == NULL);				\
 	ASSERT((connp)->conn_prev == NULL);				\
+	CONNF_GEN_BEGIN(connfp);					\
 	if ((connfp)->connf_head != NULL) {				\
 		(connfp)->connf_head->conn_prev = (connp);		\
 		(connp)->conn_next = (connfp)->connf_head;		\
 	}								\
 	(connp)->conn_fanout = (connfp);				\
-	(connfp)->connf_head = (connp);					\
 	(connp)->conn_flags = ((connp)->conn_flags & ~IPCL_REMOVED) |	\
 	    IPCL_CONNECTED;						\
 	CONN_INC_REF(connp);						\
+	/* The conn_t must be complete before walkers can reach it */	\
+	membar_producer();						\
+	(connfp)->connf_head = (connp);					\
+	CONNF_GEN_END(connfp);						\
 }
 
 #define	IPCL_HASH_INSERT_CONNECTED(connfp, connp) {			\
@@ -916,6 +1147,7 @@ ipcl_hash_insert_bound(connf_t *connfp, conn_t *connp)
 	}
 	connp->conn_fanout = connfp;
 	connp->conn_flags = (connp->conn_flags & ~IPCL_REMOVED) | IPCL_BOUND;
+	IPCL_REUSEPORT_JOIN(connfp, connp);
 	CONN_INC_REF(connp);
 	mutex_exit(&connfp->connf_lock);
 }
@@ -954,6 +1186,7 @@ ipcl_hash_insert_wildcard(connf_t *connfp, conn_t *connp)
 	}
 	connp->conn_fanout = connfp;
 	connp->conn_flags = (connp->conn_flags & ~IPCL_REMOVED) | IPCL_BOUND;
+	IPCL_REUSEPORT_JOIN(connfp, connp);
 	CONN_INC_REF(connp);
 	mutex_exit(&connfp->connf_lock);
 }
@@ -1541,6 +1774,207 @@ ipcl_conn_insert_v6(conn_t *connp)
 	return (ret);
 }
 
+/*
+ * Members of a UDP SO_REUSEPORT group share the local address and port and
+ * are bound rather than connected.  udp_do_bind() only lets endpoints of
+ * the same user form a group.  A member that has since cleared
+ * SO_REUSEPORT is passed over, as is one that the classifier would not
+ * have matched for this datagram: an IPv6-only member for IPv4, or one
+ * bound by IP_BOUND_IF to an interface other than the one it came in on.
+ */
+#define	IPCL_UDP_REUSEPORT_PEER(connp, c, ira)				\
+	((c)->conn_reuseport &&						\
+	(c)->conn_lport == (connp)->conn_lport &&			\
+	(c)->conn_zoneid == (connp)->conn_zoneid &&			\
+	IN6_ARE_ADDR_EQUAL(&(c)->conn_laddr_v6, &(connp)->conn_laddr_v6) && \
+	IN6_IS_ADDR_UNSPECIFIED(&(c)->conn_faddr_v6) &&			\
+	(!((ira)->ira_flags & IRAF_IS_IPV4) || !(c)->conn_ipv6_v6only) && \
+	((c)->conn_incoming_ifindex == 0 ||				\
+	(c)->conn_incoming_ifindex == (ira)->ira_ruifindex))
+
+/*
+ * Pick the member of connp's SO_REUSEPORT group that should receive a
+ * datagram.  connp is the first match in the UDP fanout bucket, which
+ * need not itself be a member that can be picked; the rest of the group
+ * follows it in the bucket.  The same hash always selects the same member
+ * while the group is unchanged.  connp is returned if no member can take
+ * the datagram.  Called with the bucket lock held.
+ */
+static conn_t *
+ipcl_udp_reuseport_select(conn_t *connp, uint32_t hash, ip_recv_attr_t *ira)
+{
+	conn_t	*c;
+	uint_t	n = 0;
+	uint_t	idx;
+
+	ASSERT(MUTEX_HELD(&connp->conn_fanout->connf_lock));
+
+	/*
+	 * Nothing to pick from if nothing in the bucket was bound with
+	 * SO_REUSEPORT; connected endpoints only ever get their own traffic.
+	 */
+	if (connp->conn_fanout->connf_reuseport == 0 ||
+	    !IN6_IS_ADDR_UNSPECIFIED(&connp->conn_faddr_v6))
+		return (connp);
+
+	for (c = connp; c != NULL; c = c->conn_next) {
+		if (IPCL_UDP_REUSEPORT_PEER(connp, c, ira))
+			n++;
+	}
+	if (n == 0)
+		return (connp);
+
+	if (ipcl_udp_reuseport_cpu)
+		idx = CPU->cpu_seqid % n;
+	else
+		idx = ((hash * 0x9E3779B1U) >> 16) % n;
+
+	for (c = connp; c != NULL; c = c->conn_next) {
+		if (IPCL_UDP_REUSEPORT_PEER(connp, c, ira) && idx-- == 0)
+			break;
+	}
+	ASSERT(c != NULL);
+	return (c);
+}
+
+/*
+ * Take a reference on a conn_t found by a lockless walk of connfp, provided
+ * it is still hashed there and not on its way out.
+ */
+static boolean_t
+ipcl_conn_hold_lockless(conn_t *connp, connf_t *connfp)
+{
+	mutex_enter(&connp->conn_lock);
+	if (connp->conn_fanout != connfp || connp->conn_ref == 0 ||
+	    (connp->conn_state_flags & CONN_CONDEMNED)) {
+		mutex_exit(&connp->conn_lock);
+		return (B_FALSE);
+	}
+	CONN_INC_REF_LOCKED(connp);
+	mutex_exit(&connp->conn_lock);
+	return (B_TRUE);
+}
+
+/*
+ * Lockless lookup of an established TCP connection, see the block comment
+ * at the top of this file.  Returns B_TRUE if the answer is final, in which
+ * case *connpp is the conn_t with a reference held or NULL if there is no
+ * such connection, and B_FALSE if the lookup must be redone under
+ * connf_lock.
+ */
+static boolean_t
+ipcl_classify_tcp_lockless_v4(connf_t *connfp, ipha_t *ipha, uint32_t ports,
+    ip_recv_attr_t *ira, conn_t **connpp)
+{
+	volatile uint_t *epoch;
+	conn_t	*connp;
+	uint_t	gen;
+	int	walk = 0;
+	zoneid_t zoneid = ira->ira_zoneid;
+
+#define	TCP_LOCKLESS_MATCH_V4(connp)					\
+	(IPCL_CONN_MATCH((connp), IPPROTO_TCP, ipha->ipha_src,		\
+	    ipha->ipha_dst, ports) &&					\
+	    ((connp)->conn_zoneid == zoneid ||				\
+	    (connp)->conn_allzones ||					\
+	    (((connp)->conn_mac_mode != CONN_MAC_DEFAULT) &&		\
+	    (ira->ira_flags & IRAF_TX_MAC_EXEMPTABLE) &&		\
+	    (ira->ira_flags & IRAF_TX_SHARED_ADDR))))
+
+	gen = connfp->connf_gen;
+	if (gen & 1)
+		return (B_FALSE);
+	epoch = ipcl_epoch_enter();
+	for (connp = connfp->connf_head; connp != NULL;
+	    connp = connp->conn_next) {
+		if (++walk > IPCL_LOCKLESS_MAXWALK) {
+			ipcl_epoch_exit(epoch);
+			return (B_FALSE);
+		}
+		if (TCP_LOCKLESS_MATCH_V4(connp))
+			break;
+	}
+
+	if (connp == NULL) {
+		membar_consumer();
+		ipcl_epoch_exit(epoch);
+		*connpp = NULL;
+		return (connfp->connf_gen == gen);
+	}
+
+	if (!ipcl_conn_hold_lockless(connp, connfp)) {
+		ipcl_epoch_exit(epoch);
+		return (B_FALSE);
+	}
+	ipcl_epoch_exit(epoch);
+
+	/* The conn_t may have been recycled before we got our reference */
+	if (!TCP_LOCKLESS_MATCH_V4(connp)) {
+		CONN_DEC_REF(connp);
+		return (B_FALSE);
+	}
+#undef	TCP_LOCKLESS_MATCH_V4
+
+	*connpp = connp;
+	return (B_TRUE);
+}
+
+static boolean_t
+ipcl_classify_tcp_lockless_v6(connf_t *connfp, ip6_t *ip6h, uint32_t ports,
+    ip_recv_attr_t *ira, conn_t **connpp)
+{
+	volatile uint_t *epoch;
+	conn_t	*connp;
+	uint_t	gen;
+	int	walk = 0;
+	zoneid_t zoneid = ira->ira_zoneid;
+
+#define	TCP_LOCKLESS_MATCH_V6(connp)					\
+	(IPCL_CONN_MATCH_V6((connp), IPPROTO_TCP, ip6h->ip6_src,	\
+	    ip6h->ip6_dst, ports) &&					\
+	    ((connp)->conn_zoneid == zoneid ||				\
+	    (connp)->conn_allzones ||					\
+	    (((connp)->conn_mac_mode != CONN_MAC_DEFAULT) &&		\
+	    (ira->ira_flags & IRAF_TX_MAC_EXEMPTABLE) &&		\
+	    (ira->ira_flags & IRAF_TX_SHARED_ADDR))))
+
+	gen = connfp->connf_gen;
+	if (gen & 1)
+		return (B_FALSE);
+	epoch = ipcl_epoch_enter();
+	for (connp = connfp->connf_head; connp != NULL;
+	    connp = connp->conn_next) {
+		if (++walk > IPCL_LOCKLESS_MAXWALK) {
+			ipcl_epoch_exit(epoch);
+			return (B_FALSE);
+		}
+		if (TCP_LOCKLESS_MATCH_V6(connp))
+			break;
+	}
+
+	if (connp == NULL) {
+		membar_consumer();
+		ipcl_epoch_exit(epoch);
+		*connpp = NULL;
+		return (connfp->connf_gen == gen);
+	}
+
+	if (!ipcl_conn_hold_lockless(connp, connfp)) {
+		ipcl_epoch_exit(epoch);
+		return (B_FALSE);
+	}
+	ipcl_epoch_exit(epoch);
+
+	if (!TCP_LOCKLESS_MATCH_V6(connp)) {
+		CONN_DEC_REF(connp);
+		return (B_FALSE);
+	}
+#undef	TCP_LOCKLESS_MATCH_V6
+
+	*connpp = connp;
+	return (B_TRUE);
+}
+
 /*
  * v4 packet classifying function. looks up the fanout table to
  * find the conn, the packet belongs to. returns the conn with
@@ -1573,6 +2007,13 @@ ipcl_classify_v4(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 		connfp =
 		    &ipst->ips_ipcl_conn_fanout[IPCL_CONN_HASH(ipha->ipha_src,
 		    ports, ipst)];
+		if (ipcl_conn_lockless &&
+		    ipcl_classify_tcp_lockless_v4(connfp, ipha, ports, ira,
+		    &connp)) {
+			if (connp != NULL)
+				return (connp);
+			goto tcp_bind_lookup_v4;
+		}
 		mutex_enter(&connfp->connf_lock);
 		for (connp = connfp->connf_head; connp != NULL;
 		    connp = connp->conn_next) {
@@ -1600,6 +2041,7 @@ ipcl_classify_v4(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 		}
 
 		mutex_exit(&connfp->connf_lock);
+tcp_bind_lookup_v4:
 		lport = up[1];
 		bind_connfp =
 		    &ipst->ips_ipcl_bind_fanout[IPCL_BIND_HASH(lport, ipst)];
@@ -1660,6 +2102,11 @@ ipcl_classify_v4(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 				break;
 		}
 
+		if (connp != NULL) {
+			connp = ipcl_udp_reuseport_select(connp,
+			    ipha->ipha_src ^ fport, ira);
+		}
+
 		if (connp != NULL && (ira->ira_flags & IRAF_SYSTEM_LABELED) &&
 		    !tsol_receive_local(mp, &ipha->ipha_dst, IPV4_VERSION,
 		    ira, connp)) {
@@ -1716,6 +2163,13 @@ ipcl_classify_v6(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 		connfp =
 		    &ipst->ips_ipcl_conn_fanout[IPCL_CONN_HASH_V6(ip6h->ip6_src,
 		    ports, ipst)];
+		if (ipcl_conn_lockless &&
+		    ipcl_classify_tcp_lockless_v6(connfp, ip6h, ports, ira,
+		    &connp)) {
+			if (connp != NULL)
+				return (connp);
+			goto tcp_bind_lookup_v6;
+		}
 		mutex_enter(&connfp->connf_lock);
 		for (connp = connfp->connf_head; connp != NULL;
 		    connp = connp->conn_next) {
@@ -1743,7 +2197,7 @@ ipcl_classify_v6(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 		}
 
 		mutex_exit(&connfp->connf_lock);
-
+tcp_bind_lookup_v6:
 		lport = up[1];
 		bind_connfp =
 		    &ipst->ips_ipcl_bind_fanout[IPCL_BIND_HASH(lport, ipst)];
@@ -1797,6 +2251,14 @@ ipcl_classify_v6(mblk_t *mp, uint8_t protocol, uint_t hdr_len,
 				break;
 		}
 
+		if (connp != NULL) {
+			connp = ipcl_udp_reuseport_select(connp,
+			    ip6h->ip6_src.s6_addr32[0] ^
+			    ip6h->ip6_src.s6_addr32[1] ^
+			    ip6h->ip6_src.s6_addr32[2] ^
+			    ip6h->ip6_src.s6_addr32[3] ^ fport, ira);
+		}
+
 		if (connp != NULL && (ira->ira_flags & IRAF_SYSTEM_LABELED) &&
 		    !tsol_receive_local(mp, &ip6h->ip6_dst, IPV6_VERSION,
 		    ira, connp)) {
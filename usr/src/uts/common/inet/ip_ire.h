@@ -297,6 +297,7 @@ extern int	ire_send_multicast_v6(ire_t *, mblk_t *, void *,
     ip_xmit_attr_t *, uint32_t *);
 extern int	ire_send_wire_v6(ire_t *, mblk_t *, void *,
     ip_xmit_attr_t *, uint32_t *);
+extern void	ip_xmit_pace(ip_xmit_attr_t *, ill_t *);
 
 extern nce_t	*ire_to_nce_pkt(ire_t *, mblk_t *);
 extern nce_t	*ire_to_nce(ire_t *, ipaddr_t, const in6_addr_t *);
@@ -73,7 +73,7 @@ typedef boolean_t (*edesc_vpf)(conn_t *, void *, struct icmph_s *,
 /* Unused			0x00020000 */
 /* Unused			0x00040000 */
 #define	IPCL_FULLY_BOUND	0x00080000	/* Bound to correct squeue */
-/* Unused			0x00100000 */
+#define	IPCL_REUSEPORT_MEMBER	0x00100000	/* In connf_reuseport */
 /* Unused			0x00200000 */
 /* Unused			0x00400000 */
 #define	IPCL_CL_LISTENER	0x00800000	/* Cluster listener */
@@ -409,6 +409,8 @@ struct conn_s {
 	uint_t		conn_sndlowat;		/* Send buffer low water mark */
 	uint_t		conn_rcvlowat;		/* Recv buffer low water mark */
 
+	uint_t		conn_max_pacing_rate;	/* SO_MAX_PACING_RATE state */
+
 	uint8_t		conn_default_ttl;	/* Default TTL/hoplimit */
 
 	uint32_t	conn_flowinfo;	/* Connected flow id and tclass */
@@ -469,10 +471,19 @@ struct conn_s {
  * The hash tables and their linkage (conn_t.{hashnextp, hashprevp} are
  * protected by the per-bucket lock. Each conn_t inserted in the list
  * points back at the connf_t that heads the bucket.
+ *
+ * connf_gen is bumped to an odd value before, and back to an even value
+ * after, every change to the linkage so that lockless readers of the
+ * connected fanout can tell whether their walk raced with an update.
+ *
+ * connf_reuseport counts the entries that were bound with SO_REUSEPORT set,
+ * so that UDP buckets without such groups skip looking for one.
  */
 struct connf_s {
 	struct conn_s	*connf_head;
 	kmutex_t	connf_lock;
+	volatile uint_t	connf_gen;
+	uint_t		connf_reuseport;
 };
 
 #define	CONN_INC_REF(connp)	{				\
@@ -1486,3 +1486,64 @@ squeue_synch_exit(conn_t *connp, int flag)
 	}
 	mutex_exit(&sqp->sq_lock);
 }
+
+/*
+ * Busy poll on behalf of an application thread waiting for data on a
+ * connection bound to this squeue (SO_BUSY_POLL).  If no one else owns the
+ * squeue and it can control its receive ring, take the squeue, blank the
+ * ring, pick up whatever the ring has queued and drain it right here, much
+ * as the poll thread would.  The drain turns the ring back on when it is
+ * done.  Returns B_TRUE if any packets were picked up.
+ */
+boolean_t
+squeue_busy_poll(squeue_t *sqp)
+{
+	ill_rx_ring_t *rx_ring;
+	mblk_t *head, *tail, *mp = NULL;
+	uint_t cnt;
+
+	mutex_enter(&sqp->sq_lock);
+	if ((sqp->sq_state & (SQS_PROC | SQS_POLL_CAPAB | SQS_PAUSE |
+	    SQS_WORKER_THR_CONTROL | SQS_POLL_THR_CONTROL |
+	    SQS_POLL_THR_QUIESCED | SQS_POLL_QUIESCE_DONE)) !=
+	    SQS_POLL_CAPAB) {
+		mutex_exit(&sqp->sq_lock);
+		return (B_FALSE);
+	}
+
+	/*
+	 * Only pick up from the ring once it is blanked, or the soft ring
+	 * could be delivering packets of the same flow behind our back.
+	 */
+	rx_ring = sqp->sq_rx_ring;
+	sqp->sq_state |= SQS_PROC | SQS_USER;
+	SQS_POLLING_ON(sqp, B_TRUE, rx_ring);
+	if (sqp->sq_state & SQS_POLLING) {
+		ip_mac_rx_t get_pkts = rx_ring->rr_rx;
+		void *mac_handle = rx_ring->rr_rx_handle;
+		ip_accept_t ip_accept = rx_ring->rr_ip_accept;
+		ill_t *ill = rx_ring->rr_ill;
+
+		mutex_exit(&sqp->sq_lock);
+		head = get_pkts(mac_handle, MAX_BYTES_TO_PICKUP);
+		if (head != NULL)
+			mp = ip_accept(ill, rx_ring, sqp, head, &tail, &cnt);
+		mutex_enter(&sqp->sq_lock);
+		if (mp != NULL)
+			ENQUEUE_CHAIN(sqp, mp, tail, cnt);
+	}
+
+	sqp->sq_run = curthread;
+	sqp->sq_drain(sqp, SQS_USER, gethrtime() + squeue_drain_ns);
+	sqp->sq_run = NULL;
+	/* The drain dropped SQS_PROC and SQS_USER unless it bailed early */
+	if ((sqp->sq_state & (SQS_PROC | SQS_USER)) == (SQS_PROC | SQS_USER)) {
+		SQS_POLLING_OFF(sqp, B_TRUE, rx_ring);
+		sqp->sq_state &= ~(SQS_PROC | SQS_USER);
+		if (sqp->sq_first != NULL)
+			squeue_worker_wakeup(sqp);
+	}
+	mutex_exit(&sqp->sq_lock);
+
+	return (mp != NULL);
+}
@@ -286,8 +286,22 @@ typedef struct tcp_s {
 	hrtime_t tcp_rtt_sa;		/* Round trip smoothed average */
 	hrtime_t tcp_rtt_sd;		/* Round trip smoothed deviation */
 	uint32_t tcp_rtt_update;	/* Round trip update(s) */
+	hrtime_t tcp_rtt_last;		/* Most recent round trip sample */
 	clock_t tcp_ms_we_have_waited;	/* Total retrans time */
 
+	/* Delivery rate estimation, see tcp_rate_sample() */
+	uint64_t tcp_delivered;		/* Total bytes delivered to peer */
+	uint64_t tcp_delivery_rate;	/* Latest rate sample, bytes/sec */
+	hrtime_t tcp_rs_start;		/* Start time of current sample */
+	uint64_t tcp_rs_delivered;	/* tcp_delivered at tcp_rs_start */
+	uint32_t tcp_rs_end_seq;	/* Sample ends when this is ACKed */
+	boolean_t tcp_rs_app_limited;	/* Latest sample was app-limited */
+
+	/* Transmit pacing, see tcp_wput_data() */
+	uint64_t tcp_pacing_rate;	/* Bytes/sec, 0 when not pacing */
+	hrtime_t tcp_pacing_next;	/* Earliest time of next burst */
+	timeout_id_t	tcp_pacing_tid;	/* Pacing timer ID */
+
 	uint32_t tcp_swl1;		/* These help us avoid using stale */
 	uint32_t tcp_swl2;		/*  packets to update state */
 
@@ -1663,6 +1663,13 @@ tcp_connect_ipv4(tcp_t *tcp, ipaddr_t *dstaddrp, in_port_t dstport,
 	    connp->conn_fport == connp->conn_lport)
 		return (-TBADADDR);
 
+	/*
+	 * The 4-tuple may still be in TIME_WAIT without a conn_t for
+	 * ipcl_conn_insert() to find.
+	 */
+	if (tcp_time_wait_compact_inuse(tcp))
+		return (EADDRINUSE);
+
 	tcp->tcp_state = TCPS_SYN_SENT;
 
 	return (ipcl_conn_insert_v4(connp));
@@ -1759,6 +1766,13 @@ tcp_connect_ipv6(tcp_t *tcp, in6_addr_t *dstaddrp, in_port_t dstport,
 	    connp->conn_fport == connp->conn_lport)
 		return (-TBADADDR);
 
+	/*
+	 * The 4-tuple may still be in TIME_WAIT without a conn_t for
+	 * ipcl_conn_insert() to find.
+	 */
+	if (tcp_time_wait_compact_inuse(tcp))
+		return (EADDRINUSE);
+
 	tcp->tcp_state = TCPS_SYN_SENT;
 
 	return (ipcl_conn_insert_v6(connp));
@@ -2209,6 +2223,18 @@ tcp_reinit_values(tcp_t *tcp)
 	tcp->tcp_rtt_update = 0;
 	tcp->tcp_rtt_sum = 0;
 	tcp->tcp_rtt_cnt = 0;
+	tcp->tcp_rtt_last = 0;
+
+	tcp->tcp_delivered = 0;
+	tcp->tcp_delivery_rate = 0;
+	tcp->tcp_rs_start = 0;
+	tcp->tcp_rs_delivered = 0;
+	tcp->tcp_rs_end_seq = 0;
+	tcp->tcp_rs_app_limited = B_FALSE;
+
+	tcp->tcp_pacing_rate = 0;
+	tcp->tcp_pacing_next = 0;
+	ASSERT(tcp->tcp_pacing_tid == 0);
 
 	DONTCARE(tcp->tcp_swl1); /* Init in case TCPS_LISTEN/TCPS_SYN_SENT */
 	DONTCARE(tcp->tcp_swl2); /* Init in case TCPS_LISTEN/TCPS_SYN_SENT */
@@ -3311,6 +3337,31 @@ tcp_zcopy_backoff(tcp_t *tcp, mblk_t *bp, boolean_t fix_xmitlist)
 	return (head);
 }
 
+/*
+ * Stop taking loaned pages and copy those the transmit list still holds,
+ * so that their owner gets them back without waiting for the peer to
+ * acknowledge them.
+ */
+void
+tcp_zcopy_stop(tcp_t *tcp)
+{
+	conn_t		*connp = tcp->tcp_connp;
+	tcp_stack_t	*tcps = tcp->tcp_tcps;
+
+	if (tcp->tcp_snd_zcopy_on) {
+		tcp->tcp_snd_zcopy_on = B_FALSE;
+		if (!TCP_IS_DETACHED(tcp)) {
+			(void) proto_set_tx_copyopt(connp->conn_rq, connp,
+			    ZCVMUNSAFE);
+			TCP_STAT(tcps, tcp_zcopy_off);
+		}
+	}
+	if (tcp->tcp_snd_zcopy_aware && tcp->tcp_xmit_head != NULL) {
+		tcp->tcp_xmit_head = tcp_zcopy_backoff(tcp,
+		    tcp->tcp_xmit_head, B_TRUE);
+	}
+}
+
 void
 tcp_zcopy_notify(tcp_t *tcp)
 {
@@ -3737,6 +3788,9 @@ tcp_ddi_g_init(void)
 	tcp_notsack_blk_cache = kmem_cache_create("tcp_notsack_blk_cache",
 	    sizeof (notsack_blk_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 
+	tcp_tw_cache = kmem_cache_create("tcp_tw_cache",
+	    sizeof (tcp_tw_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+
 	mutex_init(&tcp_random_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	/* Initialize the random number generator */
@@ -3890,6 +3944,7 @@ tcp_ddi_g_destroy(void)
 
 	kmem_cache_destroy(tcp_timercache);
 	kmem_cache_destroy(tcp_notsack_blk_cache);
+	kmem_cache_destroy(tcp_tw_cache);
 
 	netstack_unregister(NS_TCP);
 }
@@ -3958,6 +4013,8 @@ tcp_stack_fini(netstackid_t stackid, void *arg)
 	tcp_kstat_fini(stackid, tcps->tcps_mibkp);
 	tcps->tcps_mibkp = NULL;
 
+	tcp_time_wait_compact_fini(tcps);
+
 	ldi_ident_release(tcps->tcps_ldi_ident);
 	kmem_free(tcps, sizeof (*tcps));
 }
@@ -170,6 +170,55 @@ static void	tcp_rsrv_input(void *, mblk_t *, void *, ip_recv_attr_t *);
 static void	tcp_set_rto(tcp_t *, hrtime_t);
 static void	tcp_setcred_data(mblk_t *, ip_recv_attr_t *);
 
+/*
+ * Delivery rate estimation.
+ *
+ * The rate at which data is delivered to the peer is sampled over intervals
+ * of roughly one round trip: a sample starts at an ACK and ends when the data
+ * that was outstanding at that point (up to tcp_snxt) has been acknowledged.
+ * The delivery rate is then the number of bytes delivered during the sample
+ * divided by its duration.  A sample taken while the application did not keep
+ * the congestion window full is flagged as application limited since it only
+ * provides a lower bound of what the path can deliver.
+ *
+ * The result is left in tcp_delivery_rate for use by congestion control
+ * algorithms which are based on a bandwidth estimate.
+ */
+static void
+tcp_rate_sample(tcp_t *tcp, uint32_t seg_ack, int32_t bytes_acked)
+{
+	hrtime_t now, interval;
+
+	tcp->tcp_delivered += bytes_acked;
+	now = gethrtime();
+
+	if (tcp->tcp_rs_start == 0) {
+		tcp->tcp_rs_start = now;
+		tcp->tcp_rs_delivered = tcp->tcp_delivered;
+		tcp->tcp_rs_end_seq = tcp->tcp_snxt;
+		return;
+	}
+	if (SEQ_LT(seg_ack, tcp->tcp_rs_end_seq))
+		return;
+
+	interval = now - tcp->tcp_rs_start;
+	if (interval > 0) {
+		tcp->tcp_delivery_rate = (tcp->tcp_delivered -
+		    tcp->tcp_rs_delivered) * NANOSEC / interval;
+		tcp->tcp_rs_app_limited = tcp->tcp_unsent == 0 &&
+		    tcp->tcp_snxt - tcp->tcp_suna < tcp->tcp_cwnd;
+		TCP_STAT(tcp->tcp_tcps, tcp_rate_samples);
+		if (tcp->tcp_rs_app_limited)
+			TCP_STAT(tcp->tcp_tcps, tcp_rate_app_limited);
+		DTRACE_PROBE3(tcp__rate__sample, tcp_t *, tcp, uint64_t,
+		    tcp->tcp_delivery_rate, boolean_t, tcp->tcp_rs_app_limited);
+	}
+
+	tcp->tcp_rs_start = now;
+	tcp->tcp_rs_delivered = tcp->tcp_delivered;
+	tcp->tcp_rs_end_seq = tcp->tcp_snxt;
+}
+
 /*
  * CC wrapper hook functions
  */
@@ -179,6 +228,9 @@ cc_ack_received(tcp_t *tcp, uint32_t seg_ack, int32_t bytes_acked,
 {
 	uint32_t old_cwnd = tcp->tcp_cwnd;
 
+	if (type == CC_ACK)
+		tcp_rate_sample(tcp, seg_ack, bytes_acked);
+
 	tcp->tcp_ccv.bytes_this_ack = bytes_acked;
 	if (tcp->tcp_cwnd <= tcp->tcp_swnd)
 		tcp->tcp_ccv.flags |= CCF_CWND_LIMITED;
@@ -1432,6 +1484,15 @@ tcp_input_listener(void *arg, mblk_t *mp, void *arg2, ip_recv_attr_t *ira)
 		return;
 	}
 
+	/*
+	 * A SYN for a 4-tuple which still has a compact TIME_WAIT record is
+	 * only accepted if it could have been by the old connection.
+	 */
+	if (tcps->tcps_tw_table != NULL &&
+	    tcp_time_wait_compact_input(mp, ira, tcps)) {
+		return;
+	}
+
 	if (listener->tcp_state != TCPS_LISTEN)
 		goto error2;
 
@@ -4738,7 +4799,15 @@ est:
 	}
 update_ack:
 	tcpha = tcp->tcp_tcpha;
-	tcp->tcp_rack_cnt++;
+	/*
+	 * A segment larger than the MSS has been merged from several by
+	 * receive offload (in the NIC or in mac) and counts as that many
+	 * segments towards the delayed ACK limit.
+	 */
+	if (seg_len > mss)
+		tcp->tcp_rack_cnt += howmany(seg_len, mss);
+	else
+		tcp->tcp_rack_cnt++;
 	{
 		uint32_t cur_max;
 
@@ -5373,6 +5442,7 @@ tcp_set_rto(tcp_t *tcp, hrtime_t rtt)
 
 	TCPS_BUMP_MIB(tcps, tcpRttUpdate);
 	tcp->tcp_rtt_update++;
+	tcp->tcp_rtt_last = rtt;
 	tcp->tcp_rtt_sum += m;
 	tcp->tcp_rtt_cnt++;
 
@@ -68,6 +68,8 @@ opdes_t	tcp_opt_arr[] = {
 { SO_BROADCAST,	SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
 { SO_REUSEADDR,	SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
 { SO_REUSEPORT,	SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
+{ SO_MAX_PACING_RATE, SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int),
+	0 },
 { SO_OOBINLINE, SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
 { SO_TYPE,	SOL_SOCKET, OA_R, OA_R, OP_NP, 0, sizeof (int), 0 },
 { SO_SNDBUF,	SOL_SOCKET, OA_RW, OA_RW, OP_NP, 0, sizeof (int), 0 },
@@ -757,7 +759,9 @@ tcp_opt_set(conn_t *connp, uint_t optset_context, int level, int name,
 			*outlenp = inlen;
 			return (0);
 		case SO_SND_COPYAVOID:
-			if (!checkonly) {
+			if (!checkonly && onoff == 0) {
+				tcp_zcopy_stop(tcp);
+			} else if (!checkonly) {
 				if (tcp->tcp_loopback ||
 				    (onoff != 1) || !tcp_zcopy_check(tcp)) {
 					*outlenp = 0;
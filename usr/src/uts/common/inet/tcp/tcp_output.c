@@ -65,6 +65,9 @@ static void	tcp_xmit_early_reset(char *, mblk_t *, uint32_t, uint32_t,
 static boolean_t	tcp_send_rst_chk(tcp_stack_t *);
 static void	tcp_process_shrunk_swnd(tcp_t *, uint32_t);
 static void	tcp_fill_header(tcp_t *, uchar_t *, int);
+static uint64_t	tcp_pacing_rate(tcp_t *);
+static boolean_t	tcp_pacing_check(tcp_t *, uint64_t, int *, int32_t);
+static void	tcp_pacing_update(tcp_t *, uint64_t, uint32_t);
 
 /*
  * Functions called directly via squeue having a prototype of edesc_t.
@@ -81,6 +84,15 @@ static void	tcp_wput_proto(void *, mblk_t *, void *, ip_recv_attr_t *);
  */
 static int tcp_tx_pull_len = 16;
 
+/*
+ * When a connection is paced, this is the longest burst, expressed as the
+ * time it takes to send it at the pacing rate, which is sent back-to-back
+ * before waiting for the pacing timer.  Larger values reduce the number of
+ * timer events at the cost of burstier transmissions.  At least two segments
+ * are always allowed so that LSO remains effective at low rates.
+ */
+uint_t tcp_pacing_quantum_usec = 1000;
+
 static void
 cc_after_idle(tcp_t *tcp)
 {
@@ -233,6 +245,7 @@ tcp_wput_data(tcp_t *tcp, mblk_t *mp, boolean_t urgent)
 	int		rc;
 	conn_t		*connp = tcp->tcp_connp;
 	clock_t		now = LBOLT_FASTPATH;
+	uint64_t	pacing_rate = tcp_pacing_rate(tcp);
 
 	tcpstate = tcp->tcp_state;
 	if (mp == NULL) {
@@ -511,6 +524,18 @@ data_null:
 		usable = (usable / mss) * mss;
 	}
 
+	/*
+	 * If the congestion control algorithm or SO_MAX_PACING_RATE has set
+	 * a pacing rate, only send a burst's worth of data now and leave the
+	 * rest for the pacing timer. The rate is also passed on to IP so
+	 * that the MAC layer can pace the flow if it does fair queueing.
+	 */
+	if (pacing_rate != 0 && !tcp->tcp_zero_win_probe &&
+	    !tcp_pacing_check(tcp, pacing_rate, &usable, mss)) {
+		goto done;
+	}
+	connp->conn_ixa->ixa_pacing_rate = pacing_rate;
+
 	/* Update the latest receive window size in TCP header. */
 	tcp->tcp_tcpha->tha_win = htons(tcp->tcp_rwnd >> tcp->tcp_rcv_ws);
 
@@ -555,6 +580,8 @@ done:;
 		if ((snxt + len) == tcp->tcp_suna) {
 			TCP_TIMER_RESTART(tcp, tcp->tcp_rto);
 		}
+		if (pacing_rate != 0)
+			tcp_pacing_update(tcp, pacing_rate, -len);
 	} else if (snxt == tcp->tcp_suna && tcp->tcp_swnd == 0) {
 		/*
 		 * Didn't send anything. Make sure the timer is running
@@ -576,6 +603,70 @@ done:;
 	mutex_exit(&tcp->tcp_non_sq_lock);
 }
 
+/*
+ * The rate at which to pace the connection: that set by the congestion
+ * control algorithm, capped by SO_MAX_PACING_RATE, or 0 if neither is set.
+ */
+static uint64_t
+tcp_pacing_rate(tcp_t *tcp)
+{
+	uint64_t rate = tcp->tcp_pacing_rate;
+	uint_t max = tcp->tcp_connp->conn_max_pacing_rate;
+
+	if (max != 0 && (rate == 0 || rate > max))
+		rate = max;
+	return (rate);
+}
+
+/*
+ * Called from tcp_wput_data() when the connection is paced.  Returns B_FALSE
+ * if the previous burst has not yet drained at the pacing rate, in which case
+ * the pacing timer is armed to resume transmission.  Otherwise *usable is
+ * clipped to one burst and B_TRUE is returned.
+ */
+static boolean_t
+tcp_pacing_check(tcp_t *tcp, uint64_t rate, int *usable, int32_t mss)
+{
+	hrtime_t now = gethrtime();
+	uint64_t quantum;
+
+	if (now < tcp->tcp_pacing_next) {
+		TCP_STAT(tcp->tcp_tcps, tcp_pacing_delayed);
+		if (tcp->tcp_pacing_tid == 0) {
+			tcp->tcp_pacing_tid = TCP_TIMER_HIRES(tcp,
+			    tcp_pacing_timer, tcp->tcp_pacing_next - now);
+		}
+		return (B_FALSE);
+	}
+
+	quantum = rate * tcp_pacing_quantum_usec / MICROSEC;
+	quantum = MAX(quantum, 2 * mss);
+	if ((uint64_t)*usable > quantum)
+		*usable = (int)(quantum / mss) * mss;
+	return (B_TRUE);
+}
+
+/*
+ * Account for the bytes just sent by a paced connection and, if there is
+ * more data waiting, arrange for the pacing timer to send it once those bytes
+ * have drained at the pacing rate.
+ */
+static void
+tcp_pacing_update(tcp_t *tcp, uint64_t rate, uint32_t sent)
+{
+	hrtime_t now = gethrtime();
+
+	/* Don't let an idle period accumulate credit for a later burst. */
+	if (tcp->tcp_pacing_next < now)
+		tcp->tcp_pacing_next = now;
+	tcp->tcp_pacing_next += (hrtime_t)sent * NANOSEC / rate;
+
+	if (tcp->tcp_unsent > sent && tcp->tcp_pacing_tid == 0) {
+		tcp->tcp_pacing_tid = TCP_TIMER_HIRES(tcp, tcp_pacing_timer,
+		    tcp->tcp_pacing_next - now);
+	}
+}
+
 /*
  * Initial STREAMS write side put() procedure for sockets. It tries to
  * handle the T_CAPABILITY_REQ which sockfs sends down while setting
@@ -2704,6 +2795,110 @@ done:
 	}
 }
 
+/*
+ * Send an ACK or RST on behalf of a compact TIME_WAIT record.  There is no
+ * conn_t left to take the headers from, so they are built from the record.
+ */
+void
+tcp_xmit_tw_ctl(const tcp_tw_t *tw, uint32_t seq, uint32_t ack, int ctl,
+    ip_recv_attr_t *ira, tcp_stack_t *tcps)
+{
+	ip_stack_t	*ipst = tcps->tcps_netstack->netstack_ip;
+	ip_xmit_attr_t	ixas;
+	tcpha_t		*tcpha;
+	mblk_t		*mp;
+	uint_t		ip_hdr_len, tcp_hdr_len;
+	boolean_t	ts = (tw->tw_flags & TW_TS_OK) && !(ctl & TH_RST);
+
+	if ((ctl & TH_RST) && !tcp_send_rst_chk(tcps)) {
+		TCP_STAT(tcps, tcp_rst_unsent);
+		return;
+	}
+
+	ip_hdr_len = (tw->tw_flags & TW_IPV4) ? IP_SIMPLE_HDR_LENGTH :
+	    IPV6_HDR_LEN;
+	tcp_hdr_len = TCP_MIN_HEADER_LENGTH + (ts ? TCPOPT_REAL_TS_LEN : 0);
+	mp = allocb(tcps->tcps_wroff_xtra + ip_hdr_len + tcp_hdr_len,
+	    BPRI_MED);
+	if (mp == NULL)
+		return;
+	mp->b_rptr += tcps->tcps_wroff_xtra;
+	mp->b_wptr = mp->b_rptr + ip_hdr_len + tcp_hdr_len;
+	bzero(mp->b_rptr, ip_hdr_len + tcp_hdr_len);
+
+	bzero(&ixas, sizeof (ixas));
+	ixas.ixa_flags = IXAF_SET_ULP_CKSUM | IXAF_VERIFY_SOURCE |
+	    IXAF_NO_IPSEC;
+	ixas.ixa_protocol = IPPROTO_TCP;
+	ixas.ixa_zoneid = tw->tw_zoneid;
+	ixas.ixa_ipst = ipst;
+	ixas.ixa_cred = kcred;
+	ixas.ixa_cpid = NOPID;
+	ixas.ixa_pktlen = ip_hdr_len + tcp_hdr_len;
+	ixas.ixa_ip_hdr_length = ip_hdr_len;
+
+	if (tw->tw_flags & TW_IPV4) {
+		ipha_t *ipha = (ipha_t *)mp->b_rptr;
+
+		ipha->ipha_version_and_hdr_length = IP_SIMPLE_HDR_VERSION;
+		ipha->ipha_type_of_service = tw->tw_tos;
+		ipha->ipha_length = htons(ip_hdr_len + tcp_hdr_len);
+		ipha->ipha_ttl = tw->tw_ttl;
+		ipha->ipha_protocol = IPPROTO_TCP;
+		IN6_V4MAPPED_TO_IPADDR(&tw->tw_laddr, ipha->ipha_src);
+		IN6_V4MAPPED_TO_IPADDR(&tw->tw_faddr, ipha->ipha_dst);
+		ixas.ixa_flags |= IXAF_IS_IPV4;
+	} else {
+		ip6_t *ip6h = (ip6_t *)mp->b_rptr;
+
+		ip6h->ip6_vcf = tw->tw_vcf;
+		ip6h->ip6_plen = htons(tcp_hdr_len);
+		ip6h->ip6_nxt = IPPROTO_TCP;
+		ip6h->ip6_hops = tw->tw_ttl;
+		ip6h->ip6_src = tw->tw_laddr;
+		ip6h->ip6_dst = tw->tw_faddr;
+		if (IN6_IS_ADDR_LINKSCOPE(&ip6h->ip6_dst)) {
+			ixas.ixa_flags |= IXAF_SCOPEID_SET;
+			ixas.ixa_scopeid = ira->ira_ruifindex;
+		}
+	}
+
+	/* tw_ports is laid out as conn_ports, remote port first */
+	tcpha = (tcpha_t *)&mp->b_rptr[ip_hdr_len];
+	tcpha->tha_lport = ((in_port_t *)&tw->tw_ports)[1];
+	tcpha->tha_fport = ((in_port_t *)&tw->tw_ports)[0];
+	tcpha->tha_seq = htonl(seq);
+	tcpha->tha_ack = htonl(ack);
+	tcpha->tha_offset_and_reserved = (tcp_hdr_len >> 2) << 4;
+	tcpha->tha_flags = (uint8_t)ctl;
+	tcpha->tha_sum = htons(tcp_hdr_len);
+	if (ts) {
+		uint8_t *opt = (uint8_t *)tcpha + TCP_MIN_HEADER_LENGTH;
+
+		opt[0] = TCPOPT_NOP;
+		opt[1] = TCPOPT_NOP;
+		opt[2] = TCPOPT_TSTAMP;
+		opt[3] = TCPOPT_TSTAMP_LEN;
+		U32_TO_BE32((uint32_t)LBOLT_FASTPATH, opt + 4);
+		U32_TO_BE32(tw->tw_ts_recent, opt + 8);
+	}
+	if (ctl & TH_RST) {
+		TCPS_BUMP_MIB(tcps, tcpOutRsts);
+		TCPS_BUMP_MIB(tcps, tcpOutControl);
+	} else {
+		tcpha->tha_win = htons(tw->tw_rwnd >> tw->tw_rcv_ws);
+		TCPS_BUMP_MIB(tcps, tcpOutAck);
+	}
+	TCPS_BUMP_MIB(tcps, tcpHCOutSegs);
+
+	DTRACE_TCP5(send, mblk_t *, NULL, ip_xmit_attr_t *, &ixas,
+	    __dtrace_tcp_void_ip_t *, mp->b_rptr, tcp_t *, NULL,
+	    __dtrace_tcp_tcph_t *, tcpha);
+
+	(void) ip_output_simple(mp, &ixas);
+	ixa_cleanup(&ixas);
+}
+
 /*
  * Generate a "no listener here" RST in response to an "unknown" segment.
  * connp is set by caller when RST is in response to an unexpected
@@ -2768,6 +2963,15 @@ tcp_xmit_listeners_reset(mblk_t *mp, ip_recv_attr_t *ira, ip_stack_t *ipst,
 		return;
 	}
 
+	/*
+	 * The segment may be for a connection which only left a compact
+	 * TIME_WAIT record behind.
+	 */
+	if (tcps->tcps_tw_table != NULL &&
+	    tcp_time_wait_compact_input(mp, ira, tcps)) {
+		return;
+	}
+
 	rptr = mp->b_rptr;
 
 	tcpha = (tcpha_t *)&rptr[ip_hdr_len];
@@ -70,6 +70,7 @@ static void	tcp_clr_flowctrl(sock_lower_handle_t);
 static int	tcp_ioctl(sock_lower_handle_t, int, intptr_t, int, int32_t *,
 		    cred_t *);
 static int	tcp_close(sock_lower_handle_t, int, cred_t *);
+static boolean_t tcp_busy_poll(sock_lower_handle_t);
 
 sock_downcalls_t sock_tcp_downcalls = {
 	tcp_activate,
@@ -89,6 +90,7 @@ sock_downcalls_t sock_tcp_downcalls = {
 	tcp_clr_flowctrl,
 	tcp_ioctl,
 	tcp_close,
+	tcp_busy_poll,
 };
 
 /* ARGSUSED */
@@ -756,6 +758,20 @@ tcp_close(sock_lower_handle_t proto_handle, int flags, cred_t *cr)
 	return (EINPROGRESS);
 }
 
+/*
+ * SO_BUSY_POLL: process whatever is waiting on the receive ring of the
+ * connection's squeue.  Fused loopback connections have nothing to poll.
+ */
+static boolean_t
+tcp_busy_poll(sock_lower_handle_t proto_handle)
+{
+	conn_t *connp = (conn_t *)proto_handle;
+
+	if (connp->conn_tcp->tcp_fused)
+		return (B_FALSE);
+	return (squeue_busy_poll(connp->conn_sqp));
+}
+
 /* ARGSUSED */
 sock_lower_handle_t
 tcp_create(int family, int type, int proto, sock_downcalls_t **sock_downcalls,
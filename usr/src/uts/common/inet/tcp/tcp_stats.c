@@ -789,6 +789,16 @@ tcp_kstat2_init(netstackid_t stackid)
 		{ "tcp_rst_unsent",		KSTAT_DATA_UINT64, 0 },
 		{ "tcp_reclaim_cnt",		KSTAT_DATA_UINT64, 0 },
 		{ "tcp_reass_timeout",		KSTAT_DATA_UINT64, 0 },
+		{ "tcp_rate_samples",		KSTAT_DATA_UINT64, 0 },
+		{ "tcp_rate_app_limited",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_pacing_delayed",		KSTAT_DATA_UINT64, 0 },
+		{ "tcp_pacing_timer_cnt",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_compact",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_compact_fail",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_compact_input",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_compact_syn",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_compact_cnt",	KSTAT_DATA_UINT64, 0 },
+		{ "tcp_time_wait_compact_saved",	KSTAT_DATA_UINT64, 0 },
 #ifdef TCP_DEBUG_COUNTER
 		{ "tcp_time_wait",		KSTAT_DATA_UINT64, 0 },
 		{ "tcp_rput_time_wait",		KSTAT_DATA_UINT64, 0 },
@@ -870,6 +880,18 @@ tcp_kstat2_update(kstat_t *kp, int rw)
 	for (i = 0; i < cnt; i++)
 		tcp_add_stats(&tcps->tcps_sc[i]->tcp_sc_stats, stats);
 
+	/*
+	 * Each compact TIME_WAIT record stands in for a conn_t and tcp_t
+	 * which would otherwise still be allocated.
+	 */
+	if (tcps->tcps_tw_table != NULL) {
+		uint64_t tw_cnt = tcps->tcps_tw_table->twt_cnt;
+
+		stats->tcp_time_wait_compact_cnt.value.ui64 = tw_cnt;
+		stats->tcp_time_wait_compact_saved.value.ui64 = tw_cnt *
+		    (sizeof (conn_t) + sizeof (tcp_t) - sizeof (tcp_tw_t));
+	}
+
 	netstack_rele(ns);
 	return (0);
 }
@@ -996,6 +1018,16 @@ tcp_clr_stats(tcp_stat_t *stats)
 	stats->tcp_rst_unsent.value.ui64 = 0;
 	stats->tcp_reclaim_cnt.value.ui64 = 0;
 	stats->tcp_reass_timeout.value.ui64 = 0;
+	stats->tcp_rate_samples.value.ui64 = 0;
+	stats->tcp_rate_app_limited.value.ui64 = 0;
+	stats->tcp_pacing_delayed.value.ui64 = 0;
+	stats->tcp_pacing_timer_cnt.value.ui64 = 0;
+	stats->tcp_time_wait_compact.value.ui64 = 0;
+	stats->tcp_time_wait_compact_fail.value.ui64 = 0;
+	stats->tcp_time_wait_compact_input.value.ui64 = 0;
+	stats->tcp_time_wait_compact_syn.value.ui64 = 0;
+	stats->tcp_time_wait_compact_cnt.value.ui64 = 0;
+	stats->tcp_time_wait_compact_saved.value.ui64 = 0;
 
 #ifdef TCP_DEBUG_COUNTER
 	stats->tcp_time_wait.value.ui64 = 0;
@@ -1092,6 +1124,22 @@ tcp_add_stats(tcp_stat_counter_t *from, tcp_stat_t *to)
 	    from->tcp_reclaim_cnt;
 	to->tcp_reass_timeout.value.ui64 +=
 	    from->tcp_reass_timeout;
+	to->tcp_rate_samples.value.ui64 +=
+	    from->tcp_rate_samples;
+	to->tcp_rate_app_limited.value.ui64 +=
+	    from->tcp_rate_app_limited;
+	to->tcp_pacing_delayed.value.ui64 +=
+	    from->tcp_pacing_delayed;
+	to->tcp_pacing_timer_cnt.value.ui64 +=
+	    from->tcp_pacing_timer_cnt;
+	to->tcp_time_wait_compact.value.ui64 +=
+	    from->tcp_time_wait_compact;
+	to->tcp_time_wait_compact_fail.value.ui64 +=
+	    from->tcp_time_wait_compact_fail;
+	to->tcp_time_wait_compact_input.value.ui64 +=
+	    from->tcp_time_wait_compact_input;
+	to->tcp_time_wait_compact_syn.value.ui64 +=
+	    from->tcp_time_wait_compact_syn;
 
 #ifdef TCP_DEBUG_COUNTER
 	to->tcp_time_wait.value.ui64 +=
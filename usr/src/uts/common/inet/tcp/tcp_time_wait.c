@@ -43,6 +43,9 @@
 #include <inet/tcp_cluster.h>
 
 static void tcp_time_wait_purge(tcp_t *, tcp_squeue_priv_t *);
+static boolean_t tcp_time_wait_compact_add(tcp_t *);
+static void tcp_time_wait_iss_adjust(tcp_stack_t *, uint32_t, uint32_t,
+    const in6_addr_t *, const in6_addr_t *);
 
 #define	TW_BUCKET(t)					\
 	(((t) / MSEC_TO_TICK(TCP_TIME_WAIT_DELAY)) % TCP_TIME_WAIT_BUCKETS)
@@ -170,6 +173,16 @@ tcp_time_wait_append(tcp_t *tcp)
 		return;
 	}
 
+	/*
+	 * If it can be summed up in a compact record, the connection need not
+	 * hang around for the TIME_WAIT interval.
+	 */
+	if (tcp_time_wait_compact && tcp_time_wait_compact_add(tcp)) {
+		tcp_time_wait_purge(tcp, tsp);
+		mutex_exit(&tsp->tcp_time_wait_lock);
+		return;
+	}
+
 	/*
 	 * In order to reap TIME_WAITs reliably, we should use a source of time
 	 * that is not adjustable by the user.  While it would be more accurate
@@ -587,6 +600,587 @@ retry:
 	mutex_exit(&tsp->tcp_time_wait_lock);
 }
 
+/*
+ * Compact TIME_WAIT records.  See the comment above tcp_tw_t in tcp_impl.h.
+ * The shard and hash sizes are rounded up to powers of 2 and read when a
+ * stack creates its table, on the first use.
+ */
+boolean_t	tcp_time_wait_compact = B_FALSE;
+uint_t		tcp_time_wait_compact_shards = 16;
+uint_t		tcp_time_wait_compact_hash_size = 1024;
+
+kmem_cache_t	*tcp_tw_cache;
+
+static void	tcp_time_wait_compact_expire(void *);
+
+static uint32_t
+tcp_tw_hash(const in6_addr_t *faddr, uint32_t ports)
+{
+	uint32_t h;
+
+	h = (faddr->s6_addr32[3] ^ faddr->s6_addr32[2] ^ ports) * 0x9e3779b1U;
+	return (h ^ (h >> 16));
+}
+
+static void
+tcp_tw_table_free(tcp_tw_table_t *twt)
+{
+	uint_t i;
+
+	for (i = 0; i < twt->twt_nshards; i++) {
+		tcp_tw_shard_t *tws = &twt->twt_shards[i];
+
+		if (tws->tws_hash == NULL)
+			continue;
+		ASSERT0(tws->tws_cnt);
+		mutex_destroy(&tws->tws_lock);
+		kmem_free(tws->tws_hash,
+		    twt->twt_hash_size * sizeof (tcp_tw_t *));
+	}
+	kmem_free(twt->twt_shards, twt->twt_nshards * sizeof (tcp_tw_shard_t));
+	mutex_destroy(&twt->twt_lock);
+	kmem_free(twt, sizeof (*twt));
+}
+
+/*
+ * Return the stack's table of compact records, creating it if needed.  This
+ * is called from the TIME_WAIT path, so it must not sleep.
+ */
+static tcp_tw_table_t *
+tcp_tw_table_get(tcp_stack_t *tcps)
+{
+	tcp_tw_table_t	*twt;
+	uint_t		nshards, hsize, i;
+
+	if ((twt = tcps->tcps_tw_table) != NULL)
+		return (twt);
+
+	nshards = MIN(MAX(tcp_time_wait_compact_shards, 1), 256);
+	if (!ISP2(nshards))
+		nshards = 1 << highbit(nshards);
+	hsize = MIN(MAX(tcp_time_wait_compact_hash_size, 16), 65536);
+	if (!ISP2(hsize))
+		hsize = 1 << highbit(hsize);
+
+	if ((twt = kmem_zalloc(sizeof (*twt), KM_NOSLEEP)) == NULL)
+		return (NULL);
+	mutex_init(&twt->twt_lock, NULL, MUTEX_DEFAULT, NULL);
+	twt->twt_nshards = nshards;
+	twt->twt_shard_shift = highbit(nshards - 1);
+	twt->twt_hash_size = hsize;
+	twt->twt_shards = kmem_zalloc(nshards * sizeof (tcp_tw_shard_t),
+	    KM_NOSLEEP);
+	if (twt->twt_shards == NULL) {
+		mutex_destroy(&twt->twt_lock);
+		kmem_free(twt, sizeof (*twt));
+		return (NULL);
+	}
+	for (i = 0; i < nshards; i++) {
+		tcp_tw_shard_t *tws = &twt->twt_shards[i];
+
+		tws->tws_hash = kmem_zalloc(hsize * sizeof (tcp_tw_t *),
+		    KM_NOSLEEP);
+		if (tws->tws_hash == NULL) {
+			tcp_tw_table_free(twt);
+			return (NULL);
+		}
+		mutex_init(&tws->tws_lock, NULL, MUTEX_DEFAULT, NULL);
+		tws->tws_swept = ddi_get_lbolt64();
+	}
+
+	if (atomic_cas_ptr(&tcps->tcps_tw_table, NULL, twt) != NULL) {
+		tcp_tw_table_free(twt);
+		twt = tcps->tcps_tw_table;
+	}
+	return (twt);
+}
+
+static void
+tcp_tw_wheel_insert(tcp_tw_shard_t *tws, tcp_tw_t *tw)
+{
+	unsigned int bucket = TW_BUCKET(tw->tw_expire);
+
+	ASSERT(MUTEX_HELD(&tws->tws_lock));
+	tw->tw_next = NULL;
+	tw->tw_prev = tws->tws_tail[bucket];
+	if (tw->tw_prev != NULL)
+		tw->tw_prev->tw_next = tw;
+	else
+		tws->tws_head[bucket] = tw;
+	tws->tws_tail[bucket] = tw;
+}
+
+static void
+tcp_tw_wheel_remove(tcp_tw_shard_t *tws, tcp_tw_t *tw)
+{
+	unsigned int bucket = TW_BUCKET(tw->tw_expire);
+
+	ASSERT(MUTEX_HELD(&tws->tws_lock));
+	if (tw->tw_next != NULL)
+		tw->tw_next->tw_prev = tw->tw_prev;
+	else
+		tws->tws_tail[bucket] = tw->tw_prev;
+	if (tw->tw_prev != NULL)
+		tw->tw_prev->tw_next = tw->tw_next;
+	else
+		tws->tws_head[bucket] = tw->tw_next;
+}
+
+static void
+tcp_tw_free(tcp_tw_table_t *twt, tcp_tw_shard_t *tws, tcp_tw_t *tw)
+{
+	tcp_tw_wheel_remove(tws, tw);
+	if ((*tw->tw_hprevp = tw->tw_hnext) != NULL)
+		tw->tw_hnext->tw_hprevp = tw->tw_hprevp;
+	tws->tws_cnt--;
+	atomic_dec_uint(&twt->twt_cnt);
+	kmem_cache_free(tcp_tw_cache, tw);
+}
+
+/*
+ * Try to replace a detached TIME_WAIT connection by a compact record.  On
+ * success the caller frees the connection.
+ */
+static boolean_t
+tcp_time_wait_compact_add(tcp_t *tcp)
+{
+	tcp_stack_t	*tcps = tcp->tcp_tcps;
+	conn_t		*connp = tcp->tcp_connp;
+	ip_xmit_attr_t	*ixa = connp->conn_ixa;
+	tcp_tw_table_t	*twt;
+	tcp_tw_shard_t	*tws;
+	tcp_tw_t	*tw, **twp;
+	uint32_t	h;
+
+	/*
+	 * Freeing the connection releases its local port.  Only compact
+	 * passive opens, whose port stays with the listener, so that the
+	 * bind hash does not hand the port of an active closer out again
+	 * during the TIME_WAIT interval.  tcp_connect_ipv4/6() still check
+	 * the table, for a connect() from a port that was bound explicitly.
+	 *
+	 * Replies are built from the record alone.  Leave connections which
+	 * need more than a plain IP header, or which depend on IPsec, routing
+	 * or label state kept in the conn_t, to the full TIME_WAIT handling.
+	 */
+	if (tcp->tcp_active_open ||
+	    cl_inet_disconnect != NULL || is_system_labeled() ||
+	    connp->conn_latch != NULL || connp->conn_policy != NULL ||
+	    (ixa->ixa_flags & (IXAF_IPSEC_SECURE | IXAF_NEXTHOP_SET)) ||
+	    ixa->ixa_ifindex != 0 || connp->conn_incoming_ifindex != 0 ||
+	    ixa->ixa_ip_hdr_length != (connp->conn_ipversion == IPV4_VERSION ?
+	    IP_SIMPLE_HDR_LENGTH : IPV6_HDR_LEN)) {
+		return (B_FALSE);
+	}
+
+	if ((twt = tcp_tw_table_get(tcps)) == NULL ||
+	    (tw = kmem_cache_alloc(tcp_tw_cache, KM_NOSLEEP)) == NULL) {
+		TCP_STAT(tcps, tcp_time_wait_compact_fail);
+		return (B_FALSE);
+	}
+
+	tw->tw_laddr = connp->conn_laddr_v6;
+	tw->tw_faddr = connp->conn_faddr_v6;
+	tw->tw_ports = connp->conn_ports;
+	tw->tw_zoneid = connp->conn_zoneid;
+	tw->tw_expire = ddi_get_lbolt64() +
+	    MSEC_TO_TICK(tcps->tcps_time_wait_interval);
+	tw->tw_snxt = tcp->tcp_snxt;
+	tw->tw_rnxt = tcp->tcp_rnxt;
+	tw->tw_rwnd = tcp->tcp_rwnd;
+	tw->tw_ts_recent = tcp->tcp_ts_recent;
+	tw->tw_rcv_ws = tcp->tcp_rcv_ws;
+	tw->tw_flags = tcp->tcp_snd_ts_ok ? TW_TS_OK : 0;
+	if (connp->conn_ipversion == IPV4_VERSION) {
+		ipha_t *ipha = (ipha_t *)connp->conn_ht_iphc;
+
+		tw->tw_flags |= TW_IPV4;
+		tw->tw_ttl = ipha->ipha_ttl;
+		tw->tw_tos = ipha->ipha_type_of_service;
+		tw->tw_vcf = 0;
+	} else {
+		ip6_t *ip6h = (ip6_t *)connp->conn_ht_iphc;
+
+		tw->tw_ttl = ip6h->ip6_hops;
+		tw->tw_tos = 0;
+		tw->tw_vcf = ip6h->ip6_vcf;
+	}
+
+	h = tcp_tw_hash(&tw->tw_faddr, tw->tw_ports);
+	tws = &twt->twt_shards[h & (twt->twt_nshards - 1)];
+	twp = &tws->tws_hash[(h >> twt->twt_shard_shift) &
+	    (twt->twt_hash_size - 1)];
+
+	/* Count the record first so that the sweep can never see it short */
+	atomic_inc_uint(&twt->twt_cnt);
+	mutex_enter(&tws->tws_lock);
+	if ((tw->tw_hnext = *twp) != NULL)
+		tw->tw_hnext->tw_hprevp = &tw->tw_hnext;
+	tw->tw_hprevp = twp;
+	*twp = tw;
+	tcp_tw_wheel_insert(tws, tw);
+	tws->tws_cnt++;
+	mutex_exit(&tws->tws_lock);
+
+	TCP_STAT(tcps, tcp_time_wait_compact);
+
+	mutex_enter(&twt->twt_lock);
+	if (twt->twt_tid == 0 && !twt->twt_condemned) {
+		twt->twt_tid = timeout(tcp_time_wait_compact_expire, tcps,
+		    MSEC_TO_TICK(TCP_TIME_WAIT_DELAY));
+	}
+	mutex_exit(&twt->twt_lock);
+	return (B_TRUE);
+}
+
+/*
+ * Sweep every shard of the wheel up to the current time.  The timer is kept
+ * running for as long as there are records left.
+ */
+static void
+tcp_time_wait_compact_expire(void *arg)
+{
+	tcp_stack_t	*tcps = arg;
+	tcp_tw_table_t	*twt = tcps->tcps_tw_table;
+	int64_t		now = ddi_get_lbolt64();
+	uint_t		i;
+
+	for (i = 0; i < twt->twt_nshards; i++) {
+		tcp_tw_shard_t	*tws = &twt->twt_shards[i];
+		tcp_tw_t	*tw;
+		int64_t		t;
+		uint_t		n;
+
+		mutex_enter(&tws->tws_lock);
+		t = tws->tws_swept;
+		for (n = 0; n < TCP_TIME_WAIT_BUCKETS; n++) {
+			unsigned int bucket = TW_BUCKET(t);
+
+			while ((tw = tws->tws_head[bucket]) != NULL &&
+			    tw->tw_expire <= now) {
+				tcp_tw_free(twt, tws, tw);
+			}
+			if (bucket == TW_BUCKET(now))
+				break;
+			t += MSEC_TO_TICK(TCP_TIME_WAIT_DELAY);
+		}
+		tws->tws_swept = now;
+		mutex_exit(&tws->tws_lock);
+	}
+
+	mutex_enter(&twt->twt_lock);
+	if (twt->twt_cnt != 0 && !twt->twt_condemned) {
+		twt->twt_tid = timeout(tcp_time_wait_compact_expire, tcps,
+		    MSEC_TO_TICK(TCP_TIME_WAIT_DELAY));
+	} else {
+		twt->twt_tid = 0;
+	}
+	mutex_exit(&twt->twt_lock);
+}
+
+/*
+ * Free all compact records of a stack which is going away.
+ */
+void
+tcp_time_wait_compact_fini(tcp_stack_t *tcps)
+{
+	tcp_tw_table_t	*twt = tcps->tcps_tw_table;
+	timeout_id_t	tid;
+	uint_t		i, bucket;
+
+	if (twt == NULL)
+		return;
+
+	mutex_enter(&twt->twt_lock);
+	twt->twt_condemned = B_TRUE;
+	tid = twt->twt_tid;
+	mutex_exit(&twt->twt_lock);
+	if (tid != 0)
+		(void) untimeout(tid);
+
+	for (i = 0; i < twt->twt_nshards; i++) {
+		tcp_tw_shard_t *tws = &twt->twt_shards[i];
+
+		mutex_enter(&tws->tws_lock);
+		for (bucket = 0; bucket < TCP_TIME_WAIT_BUCKETS; bucket++) {
+			while (tws->tws_head[bucket] != NULL) {
+				tcp_tw_free(twt, tws,
+				    tws->tws_head[bucket]);
+			}
+		}
+		mutex_exit(&tws->tws_lock);
+	}
+	tcp_tw_table_free(twt);
+	tcps->tcps_tw_table = NULL;
+}
+
+/*
+ * Find the record for a 4-tuple.  If there is one, it is returned with its
+ * shard locked.
+ */
+static tcp_tw_t *
+tcp_tw_lookup(tcp_tw_table_t *twt, const in6_addr_t *laddr,
+    const in6_addr_t *faddr, uint32_t ports, zoneid_t zoneid,
+    tcp_tw_shard_t **twsp)
+{
+	tcp_tw_shard_t	*tws;
+	tcp_tw_t	*tw;
+	uint32_t	h;
+
+	h = tcp_tw_hash(faddr, ports);
+	tws = &twt->twt_shards[h & (twt->twt_nshards - 1)];
+	mutex_enter(&tws->tws_lock);
+	for (tw = tws->tws_hash[(h >> twt->twt_shard_shift) &
+	    (twt->twt_hash_size - 1)]; tw != NULL; tw = tw->tw_hnext) {
+		if (tw->tw_ports == ports &&
+		    IN6_ARE_ADDR_EQUAL(&tw->tw_faddr, faddr) &&
+		    IN6_ARE_ADDR_EQUAL(&tw->tw_laddr, laddr) &&
+		    (zoneid == ALL_ZONES || tw->tw_zoneid == zoneid)) {
+			*twsp = tws;
+			return (tw);
+		}
+	}
+	mutex_exit(&tws->tws_lock);
+	return (NULL);
+}
+
+/*
+ * Return B_TRUE if a connecting tcp's 4-tuple is still in TIME_WAIT in a
+ * compact record.  A full TIME_WAIT connection would have made
+ * ipcl_conn_insert() fail the connect with EADDRINUSE.
+ */
+boolean_t
+tcp_time_wait_compact_inuse(tcp_t *tcp)
+{
+	conn_t		*connp = tcp->tcp_connp;
+	tcp_tw_table_t	*twt = tcp->tcp_tcps->tcps_tw_table;
+	tcp_tw_shard_t	*tws;
+
+	if (twt == NULL || twt->twt_cnt == 0)
+		return (B_FALSE);
+	if (tcp_tw_lookup(twt, &connp->conn_laddr_v6, &connp->conn_faddr_v6,
+	    connp->conn_ports, connp->conn_zoneid, &tws) == NULL) {
+		return (B_FALSE);
+	}
+	mutex_exit(&tws->tws_lock);
+	return (B_TRUE);
+}
+
+/*
+ * Handle a segment which did not classify to a connection, or which
+ * classified to a listener, if it belongs to a connection which left a
+ * compact record behind.  This follows tcp_time_wait_processing().  Returns
+ * B_TRUE if the segment was consumed.  A SYN which may start a new
+ * incarnation of the connection retires the record and is left to the
+ * caller.
+ */
+boolean_t
+tcp_time_wait_compact_input(mblk_t *mp, ip_recv_attr_t *ira,
+    tcp_stack_t *tcps)
+{
+	tcp_tw_table_t	*twt = tcps->tcps_tw_table;
+	tcp_tw_shard_t	*tws;
+	tcp_tw_t	*tw, twc;
+	in6_addr_t	laddr, faddr;
+	tcpha_t		*tcpha;
+	tcp_opt_t	tcpopt;
+	uint32_t	ports, seg_seq, seg_ack, seq, ack;
+	int32_t		gap, rgap;
+	int		seg_len;
+	int		ctl = 0;
+	uint_t		flags;
+	uint_t		ip_hdr_len = ira->ira_ip_hdr_length;
+	zoneid_t	zoneid = ira->ira_zoneid;
+	boolean_t	ts = B_FALSE;
+
+	if (twt == NULL || twt->twt_cnt == 0 ||
+	    (ira->ira_flags & IRAF_IPSEC_SECURE)) {
+		return (B_FALSE);
+	}
+
+	if (IPH_HDR_VERSION(mp->b_rptr) == IPV4_VERSION) {
+		ipha_t *ipha = (ipha_t *)mp->b_rptr;
+
+		IN6_IPADDR_TO_V4MAPPED(ipha->ipha_dst, &laddr);
+		IN6_IPADDR_TO_V4MAPPED(ipha->ipha_src, &faddr);
+	} else {
+		ip6_t *ip6h = (ip6_t *)mp->b_rptr;
+
+		laddr = ip6h->ip6_dst;
+		faddr = ip6h->ip6_src;
+	}
+	tcpha = (tcpha_t *)&mp->b_rptr[ip_hdr_len];
+	ports = *(uint32_t *)tcpha;
+
+	if ((tw = tcp_tw_lookup(twt, &laddr, &faddr, ports, zoneid,
+	    &tws)) == NULL) {
+		return (B_FALSE);
+	}
+
+	TCP_STAT(tcps, tcp_time_wait_compact_input);
+	TCPS_BUMP_MIB(tcps, tcpHCInSegs);
+
+	seg_seq = ntohl(tcpha->tha_seq);
+	seg_ack = ntohl(tcpha->tha_ack);
+	flags = (unsigned int)tcpha->tha_flags & 0xFF;
+	seg_len = msgdsize(mp) - (TCP_HDR_LENGTH(tcpha) + ip_hdr_len);
+	seq = tw->tw_snxt;
+	ack = tw->tw_rnxt;
+
+	if ((tw->tw_flags & TW_TS_OK) && !(flags & TH_RST) &&
+	    !((seg_len == 0 || seg_len == 1) && seg_seq + 1 == tw->tw_rnxt)) {
+		tcpopt.tcp = NULL;
+		if (!(tcp_parse_options(tcpha, &tcpopt) &
+		    TCP_OPT_TSTAMP_PRESENT)) {
+			goto done;
+		}
+		if (TSTMP_LT(tcpopt.tcp_opt_ts_val, tw->tw_ts_recent)) {
+			ctl = TH_ACK;
+			goto done;
+		}
+		ts = B_TRUE;
+	}
+
+	gap = seg_seq - tw->tw_rnxt;
+	rgap = tw->tw_rwnd - (gap + seg_len);
+	if (gap < 0) {
+		seg_len += gap;
+		if (seg_len < 0 || (seg_len == 0 && !(flags & TH_FIN))) {
+			if (flags & TH_RST)
+				goto done;
+			if ((flags & TH_FIN) && seg_len == -1) {
+				/* A retransmitted FIN restarts the wait */
+				tcp_tw_wheel_remove(tws, tw);
+				tw->tw_expire = ddi_get_lbolt64() +
+				    MSEC_TO_TICK(tcps->tcps_time_wait_interval);
+				tcp_tw_wheel_insert(tws, tw);
+			}
+			ctl = TH_ACK;
+			goto done;
+		}
+		seg_seq = tw->tw_rnxt;
+	}
+
+	if ((flags & TH_SYN) && gap > 0 && rgap < 0) {
+		uint32_t snxt = tw->tw_snxt;
+
+		/*
+		 * The peer is starting a new incarnation of the connection.
+		 * Retire the record and let the caller handle the SYN as if
+		 * it had never been there.
+		 */
+		tcp_tw_free(twt, tws, tw);
+		mutex_exit(&tws->tws_lock);
+		tcp_time_wait_iss_adjust(tcps, snxt, ports, &laddr, &faddr);
+		TCP_STAT(tcps, tcp_time_wait_compact_syn);
+		return (B_FALSE);
+	}
+
+	if (rgap < 0) {
+		seg_len += rgap;
+		if (seg_len <= 0) {
+			if (!(flags & TH_RST))
+				ctl = TH_ACK;
+			goto done;
+		}
+	}
+	if (ts && TSTMP_GEQ(tcpopt.tcp_opt_ts_val, tw->tw_ts_recent) &&
+	    SEQ_LEQ(seg_seq, tw->tw_rnxt)) {
+		tw->tw_ts_recent = tcpopt.tcp_opt_ts_val;
+	}
+
+	if (flags & TH_RST) {
+		tcp_tw_free(twt, tws, tw);
+		goto done;
+	}
+	if (flags & TH_SYN) {
+		/* Refer to RFC 1122, 4.2.2.13 */
+		seq = seg_ack;
+		ack = seg_seq + 1;
+		ctl = TH_RST | TH_ACK;
+	} else if (seg_seq != tw->tw_rnxt && seg_len > 0) {
+		ctl = TH_ACK;
+	} else if ((flags & TH_ACK) && (int32_t)(seg_ack - tw->tw_snxt) > 0) {
+		/* Acks something not sent */
+		ctl = TH_ACK;
+	}
+
+done:
+	if (ctl != 0)
+		twc = *tw;
+	mutex_exit(&tws->tws_lock);
+	if (ctl != 0)
+		tcp_xmit_tw_ctl(&twc, seq, ack, ctl, ira, tcps);
+	freemsg(mp);
+	return (B_TRUE);
+}
+
+/*
+ * Make sure that when we accept a new incarnation of a connection in
+ * TIME_WAIT, we pick an ISS greater than (snxt + tcp_iss_incr/2) for the
+ * old connection.
+ *
+ * The next ISS generated is equal to tcp_iss_incr_extra
+ * + tcp_iss_incr/2 + other components depending on the
+ * value of tcp_strong_iss.  We pre-calculate the new
+ * ISS here and compare with tcp_snxt to determine if
+ * we need to make adjustment to tcp_iss_incr_extra.
+ *
+ * The above calculation is ugly and is a
+ * waste of CPU cycles...
+ */
+static void
+tcp_time_wait_iss_adjust(tcp_stack_t *tcps, uint32_t snxt, uint32_t ports,
+    const in6_addr_t *laddr, const in6_addr_t *faddr)
+{
+	uint32_t new_iss = tcps->tcps_iss_incr_extra;
+	int32_t adj;
+
+	switch (tcps->tcps_strong_iss) {
+	case 2: {
+		/* Add time and MD5 components. */
+		uint32_t answer[4];
+		struct {
+			uint32_t ports;
+			in6_addr_t src;
+			in6_addr_t dst;
+		} arg;
+		MD5_CTX context;
+
+		mutex_enter(&tcps->tcps_iss_key_lock);
+		context = tcps->tcps_iss_key;
+		mutex_exit(&tcps->tcps_iss_key_lock);
+		arg.ports = ports;
+		/* We use MAPPED addresses in tcp_iss_init */
+		arg.src = *laddr;
+		arg.dst = *faddr;
+		MD5Update(&context, (uchar_t *)&arg,
+		    sizeof (arg));
+		MD5Final((uchar_t *)answer, &context);
+		answer[0] ^= answer[1] ^ answer[2] ^ answer[3];
+		new_iss += (gethrtime() >> ISS_NSEC_SHT) + answer[0];
+		break;
+	}
+	case 1:
+		/* Add time component and min random (i.e. 1). */
+		new_iss += (gethrtime() >> ISS_NSEC_SHT) + 1;
+		break;
+	default:
+		/* Add only time component. */
+		new_iss += (uint32_t)gethrestime_sec() *
+		    tcps->tcps_iss_incr;
+		break;
+	}
+	if ((adj = (int32_t)(snxt - new_iss)) > 0) {
+		/*
+		 * New ISS not guaranteed to be tcp_iss_incr/2
+		 * ahead of the current tcp_snxt, so add the
+		 * difference to tcp_iss_incr_extra.
+		 */
+		tcps->tcps_iss_incr_extra += adj;
+	}
+}
+
 /*
  * tcp_time_wait_processing() handles processing of incoming packets when
  * the tcp_t is in the TIME_WAIT state.
@@ -678,67 +1272,11 @@ tcp_time_wait_processing(tcp_t *tcp, mblk_t *mp, uint32_t seg_seq,
 	}
 
 	if ((flags & TH_SYN) && gap > 0 && rgap < 0) {
-		/*
-		 * Make sure that when we accept the connection, pick
-		 * an ISS greater than (tcp_snxt + tcp_iss_incr/2) for the
-		 * old connection.
-		 *
-		 * The next ISS generated is equal to tcp_iss_incr_extra
-		 * + tcp_iss_incr/2 + other components depending on the
-		 * value of tcp_strong_iss.  We pre-calculate the new
-		 * ISS here and compare with tcp_snxt to determine if
-		 * we need to make adjustment to tcp_iss_incr_extra.
-		 *
-		 * The above calculation is ugly and is a
-		 * waste of CPU cycles...
-		 */
-		uint32_t new_iss = tcps->tcps_iss_incr_extra;
-		int32_t adj;
 		ip_stack_t *ipst = tcps->tcps_netstack->netstack_ip;
 
-		switch (tcps->tcps_strong_iss) {
-		case 2: {
-			/* Add time and MD5 components. */
-			uint32_t answer[4];
-			struct {
-				uint32_t ports;
-				in6_addr_t src;
-				in6_addr_t dst;
-			} arg;
-			MD5_CTX context;
-
-			mutex_enter(&tcps->tcps_iss_key_lock);
-			context = tcps->tcps_iss_key;
-			mutex_exit(&tcps->tcps_iss_key_lock);
-			arg.ports = connp->conn_ports;
-			/* We use MAPPED addresses in tcp_iss_init */
-			arg.src = connp->conn_laddr_v6;
-			arg.dst = connp->conn_faddr_v6;
-			MD5Update(&context, (uchar_t *)&arg,
-			    sizeof (arg));
-			MD5Final((uchar_t *)answer, &context);
-			answer[0] ^= answer[1] ^ answer[2] ^ answer[3];
-			new_iss += (gethrtime() >> ISS_NSEC_SHT) + answer[0];
-			break;
-		}
-		case 1:
-			/* Add time component and min random (i.e. 1). */
-			new_iss += (gethrtime() >> ISS_NSEC_SHT) + 1;
-			break;
-		default:
-			/* Add only time component. */
-			new_iss += (uint32_t)gethrestime_sec() *
-			    tcps->tcps_iss_incr;
-			break;
-		}
-		if ((adj = (int32_t)(tcp->tcp_snxt - new_iss)) > 0) {
-			/*
-			 * New ISS not guaranteed to be tcp_iss_incr/2
-			 * ahead of the current tcp_snxt, so add the
-			 * difference to tcp_iss_incr_extra.
-			 */
-			tcps->tcps_iss_incr_extra += adj;
-		}
+		tcp_time_wait_iss_adjust(tcps, tcp->tcp_snxt, connp->conn_ports,
+		    &connp->conn_laddr_v6, &connp->conn_faddr_v6);
+
 		/*
 		 * If tcp_clean_death() can not perform the task now,
 		 * drop the SYN packet and let the other side re-xmit.
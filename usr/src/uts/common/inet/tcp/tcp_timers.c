@@ -130,10 +130,14 @@ static void	tcp_timer_free(tcp_t *, mblk_t *);
 static void	tcp_timer_handler(void *, mblk_t *, void *, ip_recv_attr_t *);
 
 /*
- * tim is in millisec.
+ * Resolution of the timers used to pace transmissions, see
+ * tcp_timeout_hires().
  */
-timeout_id_t
-tcp_timeout(conn_t *connp, void (*f)(void *), hrtime_t tim)
+#define	TCP_PACING_RESOLUTION	(10 * (NANOSEC / MICROSEC))
+
+static timeout_id_t
+tcp_timeout_common(conn_t *connp, void (*f)(void *), hrtime_t nsec,
+    hrtime_t resolution, int flags)
 {
 	mblk_t *mp;
 	tcp_timer_t *tcpt;
@@ -157,6 +161,19 @@ tcp_timeout(conn_t *connp, void (*f)(void *), hrtime_t tim)
 	tcpt = (tcp_timer_t *)mp->b_rptr;
 	tcpt->connp = connp;
 	tcpt->tcpt_proc = f;
+	tcpt->tcpt_tid = timeout_generic(CALLOUT_NORMAL, tcp_timer_callback, mp,
+	    nsec, resolution, flags);
+	VERIFY(!(tcpt->tcpt_tid & CALLOUT_ID_FREE));
+
+	return ((timeout_id_t)mp);
+}
+
+/*
+ * tim is in millisec.
+ */
+timeout_id_t
+tcp_timeout(conn_t *connp, void (*f)(void *), hrtime_t tim)
+{
 	/*
 	 * TCP timers are normal timeouts. Plus, they do not require more than
 	 * a 10 millisecond resolution. By choosing a coarser resolution and by
@@ -165,11 +182,19 @@ tcp_timeout(conn_t *connp, void (*f)(void *), hrtime_t tim)
 	 * efficient. The roundup also protects short timers from expiring too
 	 * early before they have a chance to be cancelled.
 	 */
-	tcpt->tcpt_tid = timeout_generic(CALLOUT_NORMAL, tcp_timer_callback, mp,
-	    tim * MICROSEC, CALLOUT_TCP_RESOLUTION, CALLOUT_FLAG_ROUNDUP);
-	VERIFY(!(tcpt->tcpt_tid & CALLOUT_ID_FREE));
+	return (tcp_timeout_common(connp, f, tim * MICROSEC,
+	    CALLOUT_TCP_RESOLUTION, CALLOUT_FLAG_ROUNDUP));
+}
 
-	return ((timeout_id_t)mp);
+/*
+ * Like tcp_timeout() but nsec is in nanoseconds and the timer is not rounded
+ * up to the coarse TCP resolution.  This is used to pace transmissions, where
+ * the gap between bursts is typically well below a millisecond.
+ */
+timeout_id_t
+tcp_timeout_hires(conn_t *connp, void (*f)(void *), hrtime_t nsec)
+{
+	return (tcp_timeout_common(connp, f, nsec, TCP_PACING_RESOLUTION, 0));
 }
 
 static void
@@ -395,6 +420,10 @@ tcp_timers_stop(tcp_t *tcp)
 		(void) TCP_TIMER_CANCEL(tcp, tcp->tcp_reass_tid);
 		tcp->tcp_reass_tid = 0;
 	}
+	if (tcp->tcp_pacing_tid != 0) {
+		(void) TCP_TIMER_CANCEL(tcp, tcp->tcp_pacing_tid);
+		tcp->tcp_pacing_tid = 0;
+	}
 }
 
 /*
@@ -551,6 +580,26 @@ tcp_push_timer(void *arg)
 		tcp_xmit_ctl(NULL, tcp, tcp->tcp_snxt, tcp->tcp_rnxt, TH_ACK);
 }
 
+/*
+ * This function handles the pacing timeout: the pacing budget used up by the
+ * last burst has been replenished, so try to send more of the unsent data.
+ */
+void
+tcp_pacing_timer(void *arg)
+{
+	conn_t	*connp = (conn_t *)arg;
+	tcp_t *tcp = connp->conn_tcp;
+
+	TCP_STAT(tcp->tcp_tcps, tcp_pacing_timer_cnt);
+
+	tcp->tcp_pacing_tid = 0;
+
+	if (tcp->tcp_fused || tcp->tcp_unsent == 0)
+		return;
+
+	tcp_wput_data(tcp, NULL, B_FALSE);
+}
+
 /*
  * This function handles delayed ACK timeout.
  */
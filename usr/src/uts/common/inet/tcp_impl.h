@@ -123,6 +123,13 @@ extern kmem_cache_t *tcp_timercache;
 #define	TCP_TIMER_CANCEL(tcp, id)	\
 	tcp_timeout_cancel(tcp->tcp_connp, id)
 
+/*
+ * Macro for starting a high resolution timer.  nsec is in nanoseconds.  The
+ * timer is cancelled with TCP_TIMER_CANCEL().
+ */
+#define	TCP_TIMER_HIRES(tcp, f, nsec)	\
+	tcp_timeout_hires(tcp->tcp_connp, f, nsec)
+
 /*
  * To restart the TCP retransmission timer.  intvl is in millisec.
  */
@@ -207,6 +214,82 @@ typedef struct tcp_squeue_priv_s {
 	uint_t		tcp_free_list_cnt;
 } tcp_squeue_priv_t;
 
+/*
+ * Compact TIME_WAIT state.
+ *
+ * A detached connection spends its whole TIME_WAIT interval holding a full
+ * conn_t and tcp_t, although all it does in that time is to answer stray
+ * segments from the peer.  When tcp_time_wait_compact is set,
+ * tcp_time_wait_append() instead records the 4-tuple and the few sequence
+ * space values needed to answer those segments in a tcp_tw_t and frees the
+ * connection right away.
+ *
+ * The tcp_tw_t records live in a per tcp_stack_t table which is split into
+ * shards by the hash of the 4-tuple, each with its own lock, hash chains
+ * and timing wheel.  The wheel has the same geometry as the per-squeue one
+ * above.  All records in a table share the stack's tcp_time_wait_interval,
+ * so records are appended to their bucket and the sweep stops at the first
+ * one which has yet to expire.  A single timer per stack sweeps the shards
+ * every TCP_TIME_WAIT_DELAY while there are records.
+ *
+ * Since the connection is gone from the classifier, a segment for it is
+ * either classified to a listener or to no one at all.  tcp_input_listener()
+ * and tcp_xmit_listeners_reset() look up the record before doing anything
+ * else, so that the segment is handled as tcp_time_wait_processing() would
+ * have done, including the reuse of the 4-tuple by a new SYN.
+ *
+ * Freeing the connection also gives up its place in the bind hash, so only
+ * passive opens are compacted: their local port stays bound by the
+ * listener.  A connect() to a 4-tuple with a record fails with EADDRINUSE,
+ * as ipcl_conn_insert() would fail it for a full TIME_WAIT connection.
+ */
+typedef struct tcp_tw_s {
+	struct tcp_tw_s	*tw_hnext;	/* Hash chain */
+	struct tcp_tw_s	**tw_hprevp;
+	struct tcp_tw_s	*tw_next;	/* Wheel bucket, oldest first */
+	struct tcp_tw_s	*tw_prev;
+	in6_addr_t	tw_laddr;	/* IPv4 mapped for IPv4 */
+	in6_addr_t	tw_faddr;
+	uint32_t	tw_ports;	/* As conn_ports */
+	zoneid_t	tw_zoneid;
+	int64_t		tw_expire;	/* lbolt64 */
+	uint32_t	tw_snxt;
+	uint32_t	tw_rnxt;
+	uint32_t	tw_rwnd;
+	uint32_t	tw_ts_recent;
+	uint32_t	tw_vcf;		/* IPv6 version, class and flow */
+	uint8_t		tw_ttl;		/* TTL or hop limit */
+	uint8_t		tw_tos;
+	uint8_t		tw_rcv_ws;
+	uint8_t		tw_flags;
+} tcp_tw_t;
+
+#define	TW_IPV4		0x01	/* IPv4 connection */
+#define	TW_TS_OK	0x02	/* Timestamps were negotiated */
+
+typedef struct tcp_tw_shard_s {
+	kmutex_t	tws_lock;
+	tcp_tw_t	**tws_hash;
+	tcp_tw_t	*tws_head[TCP_TIME_WAIT_BUCKETS];
+	tcp_tw_t	*tws_tail[TCP_TIME_WAIT_BUCKETS];
+	int64_t		tws_swept;	/* Wheel swept up to this time */
+	uint_t		tws_cnt;
+} tcp_tw_shard_t;
+
+typedef struct tcp_tw_table_s {
+	kmutex_t	twt_lock;	/* Protects the timer fields */
+	timeout_id_t	twt_tid;
+	boolean_t	twt_condemned;
+	uint_t		twt_cnt;	/* Records in all shards */
+	uint_t		twt_nshards;
+	uint_t		twt_shard_shift;
+	uint_t		twt_hash_size;
+	tcp_tw_shard_t	*twt_shards;
+} tcp_tw_table_t;
+
+extern kmem_cache_t *tcp_tw_cache;
+extern boolean_t tcp_time_wait_compact;
+
 /*
  * Parameters for TCP Initial Send Sequence number (ISS) generation.  When
  * tcp_strong_iss is set to 1, which is the default, the ISS is calculated
@@ -697,6 +780,7 @@ extern void	tcp_stop_lingering(tcp_t *);
 extern void	tcp_update_pmtu(tcp_t *, boolean_t);
 extern mblk_t	*tcp_zcopy_backoff(tcp_t *, mblk_t *, boolean_t);
 extern boolean_t	tcp_zcopy_check(tcp_t *);
+extern void	tcp_zcopy_stop(tcp_t *);
 extern void	tcp_zcopy_notify(tcp_t *);
 extern void	tcp_get_proto_props(tcp_t *, struct sock_proto_props *);
 
@@ -751,6 +835,8 @@ extern void	tcp_xmit_listeners_reset(mblk_t *, ip_recv_attr_t *,
 		    ip_stack_t *i, conn_t *);
 extern mblk_t	*tcp_xmit_mp(tcp_t *, mblk_t *, int32_t, int32_t *,
 		    mblk_t **, uint32_t, boolean_t, uint32_t *, boolean_t);
+extern void	tcp_xmit_tw_ctl(const tcp_tw_t *, uint32_t, uint32_t, int,
+		    ip_recv_attr_t *, tcp_stack_t *);
 
 /*
  * Input related functions in tcp_input.c.
@@ -780,11 +866,13 @@ extern boolean_t tcp_newconn_notify(tcp_t *, ip_recv_attr_t *);
 extern void	tcp_ack_timer(void *);
 extern void	tcp_close_linger_timeout(void *);
 extern void	tcp_keepalive_timer(void *);
+extern void	tcp_pacing_timer(void *);
 extern void	tcp_push_timer(void *);
 extern void	tcp_reass_timer(void *);
 extern mblk_t	*tcp_timermp_alloc(int);
 extern void	tcp_timermp_free(tcp_t *);
 extern timeout_id_t tcp_timeout(conn_t *, void (*)(void *), hrtime_t);
+extern timeout_id_t tcp_timeout_hires(conn_t *, void (*)(void *), hrtime_t);
 extern clock_t	tcp_timeout_cancel(conn_t *, timeout_id_t);
 extern void	tcp_timer(void *arg);
 extern void	tcp_timers_stop(tcp_t *);
@@ -830,6 +918,10 @@ extern void		tcp_time_wait_collector(void *);
 extern boolean_t	tcp_time_wait_remove(tcp_t *, tcp_squeue_priv_t *);
 extern void		tcp_time_wait_processing(tcp_t *, mblk_t *, uint32_t,
 			    uint32_t, int, tcpha_t *, ip_recv_attr_t *);
+extern boolean_t	tcp_time_wait_compact_input(mblk_t *, ip_recv_attr_t *,
+			    tcp_stack_t *);
+extern boolean_t	tcp_time_wait_compact_inuse(tcp_t *);
+extern void		tcp_time_wait_compact_fini(tcp_stack_t *);
 
 /*
  * Misc functions in tcp_misc.c.
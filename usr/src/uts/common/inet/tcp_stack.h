@@ -117,6 +117,9 @@ struct tcp_stack {
 
 	struct cc_algo	*tcps_default_cc_algo;
 
+	/* Compact TIME_WAIT records, created on first use */
+	struct tcp_tw_table_s	*tcps_tw_table;
+
 	/*
 	 * Per CPU stats
 	 *
@@ -122,6 +122,17 @@ typedef struct tcp_stat {
 	kstat_named_t	tcp_rst_unsent;
 	kstat_named_t	tcp_reclaim_cnt;
 	kstat_named_t	tcp_reass_timeout;
+	kstat_named_t	tcp_rate_samples;
+	kstat_named_t	tcp_rate_app_limited;
+	kstat_named_t	tcp_pacing_delayed;
+	kstat_named_t	tcp_pacing_timer_cnt;
+	kstat_named_t	tcp_time_wait_compact;
+	kstat_named_t	tcp_time_wait_compact_fail;
+	kstat_named_t	tcp_time_wait_compact_input;
+	kstat_named_t	tcp_time_wait_compact_syn;
+	/* Gauges, set in tcp_kstat2_update() */
+	kstat_named_t	tcp_time_wait_compact_cnt;
+	kstat_named_t	tcp_time_wait_compact_saved;
 #ifdef TCP_DEBUG_COUNTER
 	kstat_named_t	tcp_time_wait;
 	kstat_named_t	tcp_rput_time_wait;
@@ -178,6 +189,14 @@ typedef struct tcp_stat_counter_s {
 	uint64_t	tcp_rst_unsent;
 	uint64_t	tcp_reclaim_cnt;
 	uint64_t	tcp_reass_timeout;
+	uint64_t	tcp_rate_samples;
+	uint64_t	tcp_rate_app_limited;
+	uint64_t	tcp_pacing_delayed;
+	uint64_t	tcp_pacing_timer_cnt;
+	uint64_t	tcp_time_wait_compact;
+	uint64_t	tcp_time_wait_compact_fail;
+	uint64_t	tcp_time_wait_compact_input;
+	uint64_t	tcp_time_wait_compact_syn;
 #ifdef TCP_DEBUG_COUNTER
 	uint64_t	tcp_time_wait;
 	uint64_t	tcp_rput_time_wait;
@@ -174,6 +174,10 @@ static mblk_t	*udp_prepend_hdr(conn_t *, ip_xmit_attr_t *, const ip_pkt_t *,
     int *);
 static mblk_t	*udp_prepend_header_template(conn_t *, ip_xmit_attr_t *,
     mblk_t *, const in6_addr_t *, in_port_t, uint32_t, int *);
+static mblk_t	*udp_prepend_headers(conn_t *, ip_xmit_attr_t *,
+    mblk_t *, const in6_addr_t *, in_port_t, uint32_t, int *);
+static mblk_t	*udp_segment(mblk_t *, uint_t);
+static int	udp_output_chain(conn_t *, mblk_t *, ip_xmit_attr_t *);
 static void	udp_ud_err(queue_t *q, mblk_t *mp, t_scalar_t err);
 static void	udp_ud_err_connected(conn_t *, t_scalar_t);
 static void	udp_tpi_unbind(queue_t *q, mblk_t *mp);
@@ -310,6 +314,9 @@ static struct T_info_ack udp_g_t_info_ack_ipv4 = {
 
 #define	UDP_MAXPACKET_IPV6 (IP_MAXPACKET - UDPH_SIZE - IPV6_HDR_LEN)
 
+/* Maximum number of datagrams a single UDP_SEGMENT send may produce */
+#define	UDP_MAX_SEGMENTS	64
+
 static	struct T_info_ack udp_g_t_info_ack_ipv6 = {
 	T_INFO_ACK,
 	UDP_MAXPACKET_IPV6,	/* TSDU_size.  Excl. headers */
@@ -1676,6 +1683,11 @@ udp_opt_get(conn_t *connp, t_scalar_t level, t_scalar_t name,
 			*i1 = udp->udp_vxlanhash;
 			mutex_exit(&connp->conn_lock);
 			return (sizeof (int));
+		case UDP_SEGMENT:
+			mutex_enter(&connp->conn_lock);
+			*i1 = udp->udp_segsize;
+			mutex_exit(&connp->conn_lock);
+			return (sizeof (int));
 		}
 	}
 	mutex_enter(&connp->conn_lock);
@@ -1732,6 +1744,18 @@ udp_do_opt_set(conn_opt_arg_t *coa, int level, int name,
 				return (ENOBUFS);
 			}
 			break;
+		case SO_REUSEPORT:
+			/*
+			 * Group membership is decided at bind time; clearing
+			 * the option later only stops this endpoint from
+			 * being selected by ipcl_udp_reuseport_select().
+			 */
+			if (!checkonly) {
+				mutex_enter(&connp->conn_lock);
+				connp->conn_reuseport = onoff;
+				mutex_exit(&connp->conn_lock);
+			}
+			return (0);
 
 		case SCM_UCRED: {
 			struct ucred_s *ucr;
@@ -1836,6 +1860,20 @@ udp_do_opt_set(conn_opt_arg_t *coa, int level, int name,
 			udp->udp_snd_to_conn = onoff;
 			mutex_exit(&connp->conn_lock);
 			return (0);
+		case UDP_SEGMENT:
+			/*
+			 * Zero disables segmentation; anything else is the
+			 * payload size of each datagram sent.
+			 */
+			if (*i1 < 0 || *i1 > UDP_MAXPACKET_IPV4)
+				return (EINVAL);
+
+			if (!checkonly) {
+				mutex_enter(&connp->conn_lock);
+				udp->udp_segsize = *i1;
+				mutex_exit(&connp->conn_lock);
+			}
+			return (0);
 		}
 		break;
 	}
@@ -3060,7 +3098,7 @@ udp_output_connected(conn_t *connp, mblk_t *mp, cred_t *cr, pid_t pid)
 	ixa->ixa_cpid = pid;
 
 	mutex_enter(&connp->conn_lock);
-	mp = udp_prepend_header_template(connp, ixa, mp, &connp->conn_saddr_v6,
+	mp = udp_prepend_headers(connp, ixa, mp, &connp->conn_saddr_v6,
 	    connp->conn_fport, connp->conn_flowinfo, &error);
 
 	if (mp == NULL) {
@@ -3128,7 +3166,7 @@ udp_output_connected(conn_t *connp, mblk_t *mp, cred_t *cr, pid_t pid)
 			ixa->ixa_cred = connp->conn_cred;	/* Restore */
 			ixa->ixa_cpid = connp->conn_cpid;
 			ixa_refrele(ixa);
-			freemsg(mp);
+			freemsgchain(mp);
 			UDPS_BUMP_MIB(us, udpOutErrors);
 			return (error);
 		}
@@ -3138,14 +3176,8 @@ udp_output_connected(conn_t *connp, mblk_t *mp, cred_t *cr, pid_t pid)
 	}
 	ASSERT(ixa->ixa_ire != NULL);
 
-	/* We're done.  Pass the packet to ip. */
-	UDPS_BUMP_MIB(us, udpHCOutDatagrams);
-
-	DTRACE_UDP5(send, mblk_t *, NULL, ip_xmit_attr_t *, ixa,
-	    void_ip_t *, mp->b_rptr, udp_t *, udp, udpha_t *,
-	    &mp->b_rptr[ixa->ixa_ip_hdr_length]);
-
-	error = conn_ip_output(mp, ixa);
+	/* We're done.  Pass the packet(s) to ip. */
+	error = udp_output_chain(connp, mp, ixa);
 	/* No udpOutErrors if an error since IP increases its error counter */
 	switch (error) {
 	case 0:
@@ -3191,7 +3223,7 @@ udp_output_lastdst(conn_t *connp, mblk_t *mp, cred_t *cr, pid_t pid,
 	ixa->ixa_cred = cr;
 	ixa->ixa_cpid = pid;
 
-	mp = udp_prepend_header_template(connp, ixa, mp, &connp->conn_v6lastsrc,
+	mp = udp_prepend_headers(connp, ixa, mp, &connp->conn_v6lastsrc,
 	    connp->conn_lastdstport, connp->conn_lastflowinfo, &error);
 
 	if (mp == NULL) {
@@ -3259,7 +3291,7 @@ udp_output_lastdst(conn_t *connp, mblk_t *mp, cred_t *cr, pid_t pid,
 			ixa->ixa_cred = connp->conn_cred;	/* Restore */
 			ixa->ixa_cpid = connp->conn_cpid;
 			ixa_refrele(ixa);
-			freemsg(mp);
+			freemsgchain(mp);
 			UDPS_BUMP_MIB(us, udpOutErrors);
 			return (error);
 		}
@@ -3268,14 +3300,8 @@ udp_output_lastdst(conn_t *connp, mblk_t *mp, cred_t *cr, pid_t pid,
 		mutex_exit(&connp->conn_lock);
 	}
 
-	/* We're done.  Pass the packet to ip. */
-	UDPS_BUMP_MIB(us, udpHCOutDatagrams);
-
-	DTRACE_UDP5(send, mblk_t *, NULL, ip_xmit_attr_t *, ixa,
-	    void_ip_t *, mp->b_rptr, udp_t *, udp, udpha_t *,
-	    &mp->b_rptr[ixa->ixa_ip_hdr_length]);
-
-	error = conn_ip_output(mp, ixa);
+	/* We're done.  Pass the packet(s) to ip. */
+	error = udp_output_chain(connp, mp, ixa);
 	/* No udpOutErrors if an error since IP increases its error counter */
 	switch (error) {
 	case 0:
@@ -3313,6 +3339,143 @@ udp_output_lastdst(conn_t *connp, mblk_t *mp, cred_t *cr, pid_t pid,
 }
 
 
+/*
+ * Split the payload in mp into a b_next chain of messages carrying at most
+ * segsz bytes each.  The segments reference the original data blocks
+ * through dupb() so no payload is copied.  Consumes mp; returns NULL if
+ * an allocation failed.
+ */
+static mblk_t *
+udp_segment(mblk_t *mp, uint_t segsz)
+{
+	mblk_t	*head = NULL;
+	mblk_t	**segp = &head;
+	mblk_t	**tailp;
+	mblk_t	*bp = mp;
+	uchar_t	*rptr = mp->b_rptr;
+	uint_t	resid, len;
+
+	while (bp != NULL) {
+		resid = segsz;
+		tailp = segp;
+		while (resid != 0 && bp != NULL) {
+			mblk_t	*nbp;
+
+			len = MIN(resid, (uint_t)(bp->b_wptr - rptr));
+			if (len != 0) {
+				if ((nbp = dupb(bp)) == NULL) {
+					freemsgchain(head);
+					freemsg(mp);
+					return (NULL);
+				}
+				nbp->b_rptr = rptr;
+				nbp->b_wptr = rptr + len;
+				*tailp = nbp;
+				tailp = &nbp->b_cont;
+				rptr += len;
+				resid -= len;
+			}
+			if (rptr == bp->b_wptr && (bp = bp->b_cont) != NULL)
+				rptr = bp->b_rptr;
+		}
+		if (*segp != NULL)
+			segp = &(*segp)->b_next;
+	}
+	freemsg(mp);
+	return (head);
+}
+
+/*
+ * Wrapper around udp_prepend_header_template() which implements
+ * UDP_SEGMENT.  If a segment size is set and the payload exceeds it, the
+ * payload is split and a header is prepended to each piece, returning a
+ * b_next chain of complete datagrams for udp_output_chain().  Otherwise
+ * this is the same as udp_prepend_header_template().
+ */
+static mblk_t *
+udp_prepend_headers(conn_t *connp, ip_xmit_attr_t *ixa, mblk_t *mp,
+    const in6_addr_t *v6src, in_port_t dstport, uint32_t flowinfo, int *errorp)
+{
+	uint_t	segsz = connp->conn_udp->udp_segsize;
+	mblk_t	*head;
+	mblk_t	**mpp;
+	size_t	len;
+
+	ASSERT(MUTEX_HELD(&connp->conn_lock));
+
+	if (segsz == 0 || (len = msgdsize(mp)) <= segsz) {
+		return (udp_prepend_header_template(connp, ixa, mp, v6src,
+		    dstport, flowinfo, errorp));
+	}
+
+	if (len > (size_t)segsz * UDP_MAX_SEGMENTS) {
+		freemsg(mp);
+		*errorp = EINVAL;
+		return (NULL);
+	}
+	if ((head = udp_segment(mp, segsz)) == NULL) {
+		*errorp = ENOMEM;
+		return (NULL);
+	}
+
+	for (mpp = &head; *mpp != NULL; mpp = &(*mpp)->b_next) {
+		mblk_t	*next = (*mpp)->b_next;
+
+		(*mpp)->b_next = NULL;
+		*mpp = udp_prepend_header_template(connp, ixa, *mpp, v6src,
+		    dstport, flowinfo, errorp);
+		if (*mpp == NULL) {
+			freemsgchain(head);
+			freemsgchain(next);
+			return (NULL);
+		}
+		(*mpp)->b_next = next;
+	}
+	return (head);
+}
+
+/*
+ * Pass a datagram, or a b_next chain of them from udp_prepend_headers(),
+ * to IP.  All datagrams in a chain share ixa and hence one route lookup.
+ * Flow control does not stop the chain since the data has already been
+ * accepted from the application; EWOULDBLOCK is returned once the chain
+ * has been sent.  Any other error drops the rest of the chain.
+ */
+static int
+udp_output_chain(conn_t *connp, mblk_t *mp, ip_xmit_attr_t *ixa)
+{
+	udp_t		*udp = connp->conn_udp;
+	udp_stack_t	*us = udp->udp_us;
+	boolean_t	chain = (mp->b_next != NULL);
+	mblk_t		*next;
+	int		error = 0;
+	int		ret;
+
+	for (; mp != NULL; mp = next) {
+		next = mp->b_next;
+		mp->b_next = NULL;
+
+		/* udp_prepend_header_template() set it for the last one */
+		if (chain)
+			ixa->ixa_pktlen = msgdsize(mp);
+
+		UDPS_BUMP_MIB(us, udpHCOutDatagrams);
+
+		DTRACE_UDP5(send, mblk_t *, NULL, ip_xmit_attr_t *, ixa,
+		    void_ip_t *, mp->b_rptr, udp_t *, udp, udpha_t *,
+		    &mp->b_rptr[ixa->ixa_ip_hdr_length]);
+
+		ret = conn_ip_output(mp, ixa);
+		if (ret == EWOULDBLOCK) {
+			error = ret;
+		} else if (ret != 0) {
+			freemsgchain(next);
+			return (ret);
+		}
+	}
+	return (error);
+}
+
 /*
  * Prepend the header template and then fill in the source and
  * flowinfo. The caller needs to handle the destination address since
@@ -4081,7 +4244,7 @@ udp_output_newdst(conn_t *connp, mblk_t *data_mp, sin_t *sin, sin6_t *sin6,
 	/* Also remember a source to use together with lastdst */
 	connp->conn_v6lastsrc = v6src;
 
-	data_mp = udp_prepend_header_template(connp, ixa, data_mp, &v6src,
+	data_mp = udp_prepend_headers(connp, ixa, data_mp, &v6src,
 	    dstport, flowinfo, &error);
 
 	/* Done with conn_t */
@@ -4093,14 +4256,8 @@ udp_output_newdst(conn_t *connp, mblk_t *data_mp, sin_t *sin, sin6_t *sin6,
 		goto ud_error;
 	}
 
-	/* We're done.  Pass the packet to ip. */
-	UDPS_BUMP_MIB(us, udpHCOutDatagrams);
-
-	DTRACE_UDP5(send, mblk_t *, NULL, ip_xmit_attr_t *, ixa,
-	    void_ip_t *, data_mp->b_rptr, udp_t *, udp, udpha_t *,
-	    &data_mp->b_rptr[ixa->ixa_ip_hdr_length]);
-
-	error = conn_ip_output(data_mp, ixa);
+	/* We're done.  Pass the packet(s) to ip. */
+	error = udp_output_chain(connp, data_mp, ixa);
 	/* No udpOutErrors if an error since IP increases its error counter */
 	switch (error) {
 	case 0:
@@ -5251,6 +5408,19 @@ udp_do_bind(conn_t *connp, struct sockaddr *sa, socklen_t len, cred_t *cr,
 					continue;
 			}
 
+			/*
+			 * Endpoints with SO_REUSEPORT set may share an
+			 * address and port when owned by the same user.
+			 * Inbound datagrams are then spread across them by
+			 * the classifier.
+			 */
+			if (connp->conn_reuseport && connp1->conn_reuseport &&
+			    requested_port != 0 &&
+			    crgetuid(connp1->conn_cred) ==
+			    crgetuid(connp->conn_cred)) {
+				continue;
+			}
+
 			/*
 			 * No difference depending on SO_REUSEADDR.
 			 *
@@ -186,6 +186,8 @@ typedef	struct udp_s {
 
 		udp_pad_to_bit_31 : 27;
 
+	uint16_t	udp_segsize;	/* UDP_SEGMENT option */
+
 	/* Following 2 fields protected by the uf_lock */
 	struct udp_s	*udp_bind_hash; /* Bind hash chain */
 	struct udp_s	**udp_ptpbhn; /* Pointer to previous bind hash next. */
@@ -120,10 +120,32 @@
  * will remove the I/O request from the runq and pass I/O completion
  * status up the stack.
  *
+ * The waitq is really two lists: reads, which somebody is usually waiting
+ * for, and transfers submitted in polled mode go on the sync waitq, all
+ * other requests go on the async waitq. Sync requests are submitted first,
+ * but after bd_sync_burst of them in a row an async request gets a turn if
+ * one is waiting, so that writes cannot be starved. Async requests may
+ * only fill bd_async_pct percent of the runq; the rest is kept for sync
+ * requests, which therefore never queue behind a runq full of large writes.
+ *
+ * Merging
+ * -------
+ * When bd_merge_max is set, a read or write taken off the waitq is merged
+ * with the requests waiting behind it that continue it on disk, in the
+ * same direction, up to bd_merge_max bytes or the maximum transfer size of
+ * the device, whichever is smaller. The merged request is a single
+ * transfer through a bounce buffer, from which the data are copied to or
+ * into the original requests, which complete together. Requests only wait
+ * long enough to be merged when the runq is full anyway, so merging adds
+ * no latency, but it costs a copy, and is off by default. Only requests of
+ * a single window whose buffers are mapped in the kernel are merged.
+ * The waitq is searched for the pieces while q_iomutex is held, so no
+ * more than bd_merge_scan requests are looked at for each merge.
+ *
  * Locks
  * -----
- * There are 4 instance global locks d_ocmutex, d_ksmutex, d_errmutex and
- * d_statemutex. As well a q_iomutex per waitq/runq pair.
+ * There are 5 instance global locks d_ocmutex, d_ksmutex, d_errmutex,
+ * d_schedmutex and d_statemutex. As well a q_iomutex per waitq/runq pair.
  *
  * Lock Hierarchy
  * --------------
@@ -139,6 +161,19 @@ typedef struct bd bd_t;
 typedef struct bd_xfer_impl bd_xfer_impl_t;
 typedef struct bd_queue bd_queue_t;
 
+/*
+ * Scheduling statistics, see "Queues" and "Merging" above.
+ */
+struct bd_schedstats {
+	kstat_named_t	bd_sync;
+	kstat_named_t	bd_async;
+	kstat_named_t	bd_async_held;
+	kstat_named_t	bd_merges;
+	kstat_named_t	bd_merged;
+	kstat_named_t	bd_merged_bytes;
+	kstat_named_t	bd_merge_fails;
+};
+
 struct bd {
 	void		*d_private;
 	dev_info_t	*d_dip;
@@ -173,6 +208,9 @@ struct bd {
 	kstat_io_t	*d_kiop;
 	kstat_t		*d_errstats;
 	struct bd_errstats *d_kerr;
+	kmutex_t	d_schedmutex;
+	kstat_t		*d_schedstats;
+	struct bd_schedstats *d_ksched;
 
 	boolean_t	d_rdonly;
 	boolean_t	d_ssd;
@@ -209,14 +247,20 @@ struct bd_xfer_impl {
 	uint32_t	i_blkshift;
 	size_t		i_len;
 	size_t		i_resid;
+	boolean_t	i_sync;
+	bd_xfer_impl_t	*i_mnext;	/* next request merged with this one */
 };
 
 struct bd_queue {
 	kmutex_t	q_iomutex;
 	uint32_t	q_qsize;
 	uint32_t	q_qactive;
+	uint32_t	q_async_max;	/* async requests allowed in the runq */
+	uint32_t	q_async_active;
+	uint32_t	q_sync_burst;	/* sync requests submitted in a row */
 	list_t		q_runq;
-	list_t		q_waitq;
+	list_t		q_waitq;	/* sync requests */
+	list_t		q_async_waitq;
 };
 
 #define	i_dmah		i_public.x_dmah
@@ -243,6 +287,8 @@ static void bd_destroy_errstats(bd_t *);
 static void bd_errstats_setstr(kstat_named_t *, char *, size_t, char *);
 static void bd_init_errstats(bd_t *, bd_drive_t *);
 static void bd_fini_errstats(bd_t *);
+static void bd_create_schedstats(bd_t *, int);
+static void bd_destroy_schedstats(bd_t *);
 
 static int bd_getinfo(dev_info_t *, ddi_info_cmd_t, void *, void **);
 static int bd_attach(dev_info_t *, ddi_attach_cmd_t);
@@ -329,6 +375,15 @@ static struct modlinkage modlinkage = {
 static void *bd_state;
 static krwlock_t bd_lock;
 
+/*
+ * Tunables for the scheduling of requests, see "Queues" and "Merging"
+ * above. bd_async_pct is applied when a device attaches.
+ */
+uint32_t bd_merge_max = 0;
+uint_t bd_merge_scan = 64;
+uint_t bd_async_pct = 75;
+uint_t bd_sync_burst = 8;
+
 int
 _init(void)
 {
@@ -595,6 +650,59 @@ bd_fini_errstats(bd_t *bd)
 	mutex_exit(&bd->d_errmutex);
 }
 
+static void
+bd_create_schedstats(bd_t *bd, int inst)
+{
+	char	ks_name[KSTAT_STRLEN];
+	int	ndata = sizeof (struct bd_schedstats) / sizeof (kstat_named_t);
+
+	(void) snprintf(ks_name, sizeof (ks_name), "%s%d,sched",
+	    ddi_driver_name(bd->d_dip), inst);
+
+	bd->d_schedstats = kstat_create(ddi_driver_name(bd->d_dip), inst,
+	    ks_name, "misc", KSTAT_TYPE_NAMED, ndata, KSTAT_FLAG_PERSISTENT);
+
+	mutex_init(&bd->d_schedmutex, NULL, MUTEX_DRIVER, NULL);
+	if (bd->d_schedstats == NULL) {
+		/* As for the errstats, fall back to a scratch kstat. */
+		bd->d_ksched = kmem_zalloc(sizeof (struct bd_schedstats),
+		    KM_SLEEP);
+		return;
+	}
+	bd->d_schedstats->ks_lock = &bd->d_schedmutex;
+	bd->d_ksched = (struct bd_schedstats *)bd->d_schedstats->ks_data;
+
+	kstat_named_init(&bd->d_ksched->bd_sync, "sync_requests",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&bd->d_ksched->bd_async, "async_requests",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&bd->d_ksched->bd_async_held, "async_held",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&bd->d_ksched->bd_merges, "merges",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&bd->d_ksched->bd_merged, "merged_requests",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&bd->d_ksched->bd_merged_bytes, "merged_bytes",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&bd->d_ksched->bd_merge_fails, "merge_failures",
+	    KSTAT_DATA_UINT64);
+
+	kstat_install(bd->d_schedstats);
+}
+
+static void
+bd_destroy_schedstats(bd_t *bd)
+{
+	if (bd->d_schedstats != NULL) {
+		kstat_delete(bd->d_schedstats);
+		bd->d_schedstats = NULL;
+	} else {
+		kmem_free(bd->d_ksched, sizeof (struct bd_schedstats));
+	}
+	bd->d_ksched = NULL;
+	mutex_destroy(&bd->d_schedmutex);
+}
+
 static void
 bd_queues_free(bd_t *bd)
 {
@@ -605,6 +713,7 @@ bd_queues_free(bd_t *bd)
 
 		mutex_destroy(&bq->q_iomutex);
 		list_destroy(&bq->q_waitq);
+		list_destroy(&bq->q_async_waitq);
 		list_destroy(&bq->q_runq);
 	}
 
@@ -776,6 +885,7 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 
 	bd_create_inquiry_props(dip, &drive);
 	bd_create_errstats(bd, inst, &drive);
+	bd_create_schedstats(bd, inst);
 	bd_update_state(bd);
 
 	bd->d_queues = kmem_alloc(sizeof (*bd->d_queues) * bd->d_qcount,
@@ -785,10 +895,16 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 
 		bq->q_qsize = drive.d_qsize;
 		bq->q_qactive = 0;
+		bq->q_async_max = MAX(1,
+		    (uint64_t)drive.d_qsize * MIN(bd_async_pct, 100) / 100);
+		bq->q_async_active = 0;
+		bq->q_sync_burst = 0;
 		mutex_init(&bq->q_iomutex, NULL, MUTEX_DRIVER, NULL);
 
 		list_create(&bq->q_waitq, sizeof (bd_xfer_impl_t),
 		    offsetof(struct bd_xfer_impl, i_linkage));
+		list_create(&bq->q_async_waitq, sizeof (bd_xfer_impl_t),
+		    offsetof(struct bd_xfer_impl, i_linkage));
 		list_create(&bq->q_runq, sizeof (bd_xfer_impl_t),
 		    offsetof(struct bd_xfer_impl, i_linkage));
 	}
@@ -836,6 +952,7 @@ bd_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 
 fail_cmlb_attach:
 	bd_queues_free(bd);
+	bd_destroy_schedstats(bd);
 	bd_destroy_errstats(bd);
 
 fail_drive_info:
@@ -881,6 +998,7 @@ bd_detach(dev_info_t *dip, ddi_detach_cmd_t cmd)
 		kmem_free(bd->d_kiop, sizeof (kstat_io_t));
 	}
 
+	bd_destroy_schedstats(bd);
 	bd_destroy_errstats(bd);
 	cmlb_detach(bd->d_cmlbh, 0);
 	cmlb_free_handle(&bd->d_cmlbh);
@@ -964,6 +1082,7 @@ bd_xfer_alloc(bd_t *bd, struct buf *bp, int (*func)(void *, bd_xfer_t *),
 	xi->i_bp = bp;
 	xi->i_func = func;
 	xi->i_blkno = bp->b_lblkno >> (bd->d_blkshift - DEV_BSHIFT);
+	xi->i_mnext = NULL;
 
 	if (bp->b_bcount == 0) {
 		xi->i_len = 0;
@@ -1784,23 +1903,264 @@ bd_tg_getinfo(dev_info_t *dip, int cmd, void *arg, void *tg_cookie)
 }
 
 
+/*
+ * Take the next request to submit off the waitqs of a queue, see "Queues"
+ * above. Returns NULL if there is none, or only async ones and the async
+ * share of the runq is used up.
+ */
+static bd_xfer_impl_t *
+bd_waitq_remove(bd_t *bd, bd_queue_t *bq)
+{
+	bd_xfer_impl_t	*xi;
+	boolean_t	async_ok;
+
+	ASSERT(MUTEX_HELD(&bq->q_iomutex));
+
+	async_ok = bq->q_async_active < bq->q_async_max;
+
+	if (!list_is_empty(&bq->q_waitq) && (!async_ok ||
+	    bq->q_sync_burst < bd_sync_burst ||
+	    list_is_empty(&bq->q_async_waitq))) {
+		bq->q_sync_burst++;
+		atomic_inc_64(&bd->d_ksched->bd_sync.value.ui64);
+		return (list_remove_head(&bq->q_waitq));
+	}
+
+	if (!async_ok) {
+		if (!list_is_empty(&bq->q_async_waitq))
+			atomic_inc_64(&bd->d_ksched->bd_async_held.value.ui64);
+		return (NULL);
+	}
+
+	if ((xi = list_remove_head(&bq->q_async_waitq)) != NULL) {
+		bq->q_sync_burst = 0;
+		bq->q_async_active++;
+		atomic_inc_64(&bd->d_ksched->bd_async.value.ui64);
+	}
+	return (xi);
+}
+
+/*
+ * Can this request be part of a merged one? See "Merging" above.
+ */
+static boolean_t
+bd_mergeable(bd_t *bd, bd_xfer_impl_t *xi)
+{
+	buf_t	*bp = xi->i_bp;
+
+	if (xi->i_flags & BD_XFER_POLL || xi->i_dfl != NULL ||
+	    xi->i_num_win != 1 || xi->i_len != bp->b_bcount ||
+	    xi->i_len == 0)
+		return (B_FALSE);
+	if (xi->i_func != bd->d_ops.o_read && xi->i_func != bd->d_ops.o_write)
+		return (B_FALSE);
+	return ((bp->b_flags & (B_PAGEIO | B_PHYS)) == 0 ||
+	    (bp->b_flags & B_REMAPPED) != 0);
+}
+
+/*
+ * Gather the waiting requests which continue xi on disk into its i_mnext
+ * chain, taking them off the waitq. Returns the number gathered.
+ */
+static uint_t
+bd_merge_gather(bd_t *bd, bd_queue_t *bq, bd_xfer_impl_t *xi)
+{
+	list_t		*waitq = xi->i_sync ? &bq->q_waitq : &bq->q_async_waitq;
+	bd_xfer_impl_t	*last = xi, *cur, *next, *first;
+	size_t		max, len = xi->i_len;
+	uint_t		scan = bd_merge_scan;
+	uint_t		n = 0;
+
+	ASSERT(MUTEX_HELD(&bq->q_iomutex));
+
+	max = MIN(bd_merge_max, bd->d_maxxfer);
+	if (len >= max || !bd_mergeable(bd, xi))
+		return (0);
+
+	/*
+	 * Requests issued in order are spread over all queues and may have
+	 * been submitted in any order, so the waitq is walked round as a
+	 * ring. Each piece is looked for from just after the last one found,
+	 * which for pieces waiting in order makes one pass, and the walk
+	 * ends after a whole round without a piece.
+	 */
+	cur = first = list_head(waitq);
+	while (cur != NULL && scan-- != 0) {
+		if ((next = list_next(waitq, cur)) == NULL)
+			next = list_head(waitq);
+
+		if (cur->i_blkno != last->i_blkno + last->i_nblks ||
+		    cur->i_func != xi->i_func || len + cur->i_len > max ||
+		    !bd_mergeable(bd, cur)) {
+			if (next == first)
+				break;
+			cur = next;
+			continue;
+		}
+
+		list_remove(waitq, cur);
+		mutex_enter(&bd->d_ksmutex);
+		kstat_waitq_exit(bd->d_kiop);
+		mutex_exit(&bd->d_ksmutex);
+
+		last->i_mnext = cur;
+		last = cur;
+		len += cur->i_len;
+		n++;
+		if (len >= max)
+			break;
+
+		/* The ring is empty if cur was all that was left on it. */
+		cur = first = (next != cur) ? next : NULL;
+	}
+
+	return (n);
+}
+
+/*
+ * Completion of a merged request: complete the requests it was made of.
+ */
+static int
+bd_merge_done(struct buf *mbp)
+{
+	bd_xfer_impl_t	*xi, *next;
+	buf_t		*bp;
+	caddr_t		addr = mbp->b_un.b_addr;
+	int		err = geterror(mbp);
+
+	for (xi = mbp->b_private; xi != NULL; xi = next) {
+		next = xi->i_mnext;
+		bp = xi->i_bp;
+
+		/* Unbind first, lest the unbind sync over the copied data. */
+		bd_xfer_free(xi);
+
+		if (err != 0) {
+			bp->b_resid = bp->b_bcount;
+			bioerror(bp, err);
+		} else {
+			if (bp->b_flags & B_READ)
+				bcopy(addr, bp->b_un.b_addr, bp->b_bcount);
+			bp->b_resid = 0;
+		}
+		addr += bp->b_bcount;
+
+		biodone(bp);
+	}
+
+	kmem_free(mbp->b_un.b_addr, mbp->b_bcount);
+	freerbuf(mbp);
+	return (0);
+}
+
+/*
+ * Build a single request out of xi and the requests chained to it by
+ * bd_merge_gather(), and put it on the runq in place of xi. If that fails
+ * the chained requests go back to the head of the waitq, and xi is
+ * submitted on its own.
+ */
+static bd_xfer_impl_t *
+bd_merge(bd_t *bd, bd_queue_t *bq, bd_xfer_impl_t *xi)
+{
+	bd_xfer_impl_t	*mxi = NULL, *cxi, *next, *prev;
+	buf_t		*mbp;
+	caddr_t		addr = NULL;
+	size_t		len = 0;
+	list_t		*waitq;
+	uint_t		n = 0;
+
+	for (cxi = xi; cxi != NULL; cxi = cxi->i_mnext) {
+		len += cxi->i_len;
+		n++;
+	}
+
+	if ((mbp = getrbuf(KM_NOSLEEP)) != NULL &&
+	    (addr = kmem_alloc(len, KM_NOSLEEP)) != NULL) {
+		mbp->b_flags = B_BUSY | (xi->i_bp->b_flags & B_READ ?
+		    B_READ : B_WRITE);
+		mbp->b_un.b_addr = addr;
+		mbp->b_bcount = len;
+		mbp->b_private = xi;
+		mbp->b_iodone = bd_merge_done;
+
+		if ((mbp->b_flags & B_READ) == 0) {
+			for (cxi = xi; cxi != NULL; cxi = cxi->i_mnext) {
+				bcopy(cxi->i_bp->b_un.b_addr, addr,
+				    cxi->i_len);
+				addr += cxi->i_len;
+			}
+			addr = mbp->b_un.b_addr;
+		}
+
+		mxi = bd_xfer_alloc(bd, mbp, xi->i_func, KM_NOSLEEP);
+	}
+
+	mutex_enter(&bq->q_iomutex);
+
+	if (mxi == NULL) {
+		if (addr != NULL)
+			kmem_free(addr, len);
+		if (mbp != NULL)
+			freerbuf(mbp);
+
+		/* Put the others back in the order they were taken. */
+		waitq = xi->i_sync ? &bq->q_waitq : &bq->q_async_waitq;
+		mutex_enter(&bd->d_ksmutex);
+		for (cxi = xi->i_mnext, prev = NULL; cxi != NULL; cxi = next) {
+			next = cxi->i_mnext;
+			cxi->i_mnext = NULL;
+			if (prev == NULL)
+				list_insert_head(waitq, cxi);
+			else
+				list_insert_after(waitq, prev, cxi);
+			prev = cxi;
+			kstat_waitq_enter(bd->d_kiop);
+		}
+		mutex_exit(&bd->d_ksmutex);
+		xi->i_mnext = NULL;
+
+		list_insert_tail(&bq->q_runq, xi);
+		mutex_exit(&bq->q_iomutex);
+
+		atomic_inc_64(&bd->d_ksched->bd_merge_fails.value.ui64);
+		return (xi);
+	}
+
+	mxi->i_blkno = xi->i_blkno;
+	mxi->i_bq = bq;
+	mxi->i_qnum = xi->i_qnum;
+	mxi->i_sync = xi->i_sync;
+	mxi->i_flags = 0;
+	list_insert_tail(&bq->q_runq, mxi);
+	mutex_exit(&bq->q_iomutex);
+
+	atomic_inc_64(&bd->d_ksched->bd_merges.value.ui64);
+	atomic_add_64(&bd->d_ksched->bd_merged.value.ui64, n);
+	atomic_add_64(&bd->d_ksched->bd_merged_bytes.value.ui64, len);
+	return (mxi);
+}
+
 static void
 bd_sched(bd_t *bd, bd_queue_t *bq)
 {
 	bd_xfer_impl_t	*xi;
 	struct buf	*bp;
+	uint_t		merged;
 	int		rv;
 
 	mutex_enter(&bq->q_iomutex);
 
 	while ((bq->q_qactive < bq->q_qsize) &&
-	    ((xi = list_remove_head(&bq->q_waitq)) != NULL)) {
+	    ((xi = bd_waitq_remove(bd, bq)) != NULL)) {
+		merged = bd_merge_max != 0 ? bd_merge_gather(bd, bq, xi) : 0;
+
 		mutex_enter(&bd->d_ksmutex);
 		kstat_waitq_to_runq(bd->d_kiop);
 		mutex_exit(&bd->d_ksmutex);
 
 		bq->q_qactive++;
-		list_insert_tail(&bq->q_runq, xi);
+		if (merged == 0)
+			list_insert_tail(&bq->q_runq, xi);
 
 		/*
 		 * Submit the job to the driver.  We drop the I/O mutex
@@ -1810,11 +2170,12 @@ bd_sched(bd_t *bd, bd_queue_t *bq)
 
 		mutex_exit(&bq->q_iomutex);
 
+		if (merged != 0)
+			xi = bd_merge(bd, bq, xi);
+
 		rv = xi->i_func(bd->d_private, &xi->i_public);
 		if (rv != 0) {
 			bp = xi->i_bp;
-			bioerror(bp, rv);
-			biodone(bp);
 
 			atomic_inc_32(&bd->d_kerr->bd_transerrs.value.ui32);
 
@@ -1825,11 +2186,21 @@ bd_sched(bd_t *bd, bd_queue_t *bq)
 			mutex_exit(&bd->d_ksmutex);
 
 			bq->q_qactive--;
+			if (!xi->i_sync)
+				bq->q_async_active--;
 			list_remove(&bq->q_runq, xi);
+			mutex_exit(&bq->q_iomutex);
+
+			/*
+			 * Free the transfer before completing the buf, as
+			 * for a merged request the completion frees the
+			 * buffer the transfer is bound to.
+			 */
 			bd_xfer_free(xi);
-		} else {
-			mutex_enter(&bq->q_iomutex);
+			bioerror(bp, rv);
+			biodone(bp);
 		}
+		mutex_enter(&bq->q_iomutex);
 	}
 
 	mutex_exit(&bq->q_iomutex);
@@ -1844,10 +2215,12 @@ bd_submit(bd_t *bd, bd_xfer_impl_t *xi)
 
 	xi->i_bq = bq;
 	xi->i_qnum = q;
+	xi->i_sync = (xi->i_bp->b_flags & B_READ) != 0 ||
+	    (xi->i_flags & BD_XFER_POLL) != 0;
 
 	mutex_enter(&bq->q_iomutex);
 
-	list_insert_tail(&bq->q_waitq, xi);
+	list_insert_tail(xi->i_sync ? &bq->q_waitq : &bq->q_async_waitq, xi);
 
 	mutex_enter(&bd->d_ksmutex);
 	kstat_waitq_enter(bd->d_kiop);
@@ -1867,6 +2240,8 @@ bd_runq_exit(bd_xfer_impl_t *xi, int err)
 
 	mutex_enter(&bq->q_iomutex);
 	bq->q_qactive--;
+	if (!xi->i_sync)
+		bq->q_async_active--;
 
 	mutex_enter(&bd->d_ksmutex);
 	kstat_runq_exit(bd->d_kiop);
@@ -1483,6 +1483,8 @@ sbd_populate_and_register_lu(sbd_lu_t *sl, uint32_t *err_ret)
 	lu->lu_info = sbd_info;
 	sl->sl_state = STMF_STATE_OFFLINE;
 
+	sbd_io_queues_create(sl);
+
 	if ((ret = stmf_register_lu(lu)) != STMF_SUCCESS) {
 		stmf_trace(0, "Failed to register with framework, ret=%llx",
 		    ret);
@@ -1738,6 +1740,7 @@ sbd_close_delete_lu(sbd_lu_t *sl, int ret)
 
 	if (sl->sl_flags & SL_LINKED)
 		sbd_unlink_lu(sl);
+	sbd_io_queues_destroy(sl);
 	mutex_destroy(&sl->sl_metadata_lock);
 	mutex_destroy(&sl->sl_lock);
 	rw_destroy(&sl->sl_pgr->pgr_lock);
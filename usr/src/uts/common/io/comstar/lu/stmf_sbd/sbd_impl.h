@@ -213,6 +213,7 @@ typedef struct sbd_cmd {
 	uint8_t		*trans_data;	/* Any transient data */
 	ats_state_t	*ats_state;
 	uint32_t	rsvd;
+	uint32_t	io_gen;		/* I/O queue generation */
 } sbd_cmd_t;
 
 /*
@@ -317,6 +318,7 @@ void sbd_zvol_rele_write_bufs_abort(sbd_lu_t *sl, stmf_data_buf_t *dbuf);
 int sbd_zvol_rele_write_bufs(sbd_lu_t *sl, stmf_data_buf_t *dbuf);
 int sbd_zvol_copy_read(sbd_lu_t *sl, uio_t *uio);
 int sbd_zvol_copy_write(sbd_lu_t *sl, uio_t *uio, int flags);
+void sbd_zvol_prefetch(sbd_lu_t *sl, uint64_t offset, uint64_t len);
 
 stmf_status_t sbd_task_alloc(struct scsi_task *task);
 void sbd_new_task(struct scsi_task *task, struct stmf_data_buf *initial_dbuf);
@@ -40,6 +40,7 @@
 #include <sys/sdt.h>
 #include <sys/dkio.h>
 #include <sys/dkioc_free_util.h>
+#include <sys/taskq_impl.h>
 
 #include <sys/stmf.h>
 #include <sys/lpif.h>
@@ -104,6 +105,27 @@ int stmf_sbd_unmap_max_nblks  = 0x002000;
  */
 int stmf_standby_fail_reads = 0;
 
+/*
+ * An /etc/system tunable for the number of I/O queues, each served by one
+ * thread, which an LU created after it is set gets to service READ and
+ * WRITE commands in. 0 services them in the STMF worker threads.
+ */
+uint_t sbd_lu_nqueues = 8;
+
+/*
+ * A READ or WRITE command, or the completion of a data transfer for one,
+ * waiting for or being serviced by an I/O queue thread.
+ */
+typedef struct sbd_io_req {
+	list_node_t		sir_node;
+	taskq_ent_t		sir_tqent;
+	sbd_lu_t		*sir_sl;
+	scsi_task_t		*sir_task;
+	stmf_data_buf_t		*sir_dbuf;
+	boolean_t		sir_new;	/* new task, else xfer done */
+	uint32_t		sir_gen;	/* command generation */
+} sbd_io_req_t;
+
 stmf_status_t sbd_lu_reset_state(stmf_lu_t *lu);
 static void sbd_handle_sync_cache(struct scsi_task *task,
     struct stmf_data_buf *initial_dbuf);
@@ -135,6 +157,8 @@ static void sbd_do_write_same_xfer(struct scsi_task *task, sbd_cmd_t *scmd,
     struct stmf_data_buf *dbuf, uint8_t dbuf_reusable);
 static void sbd_handle_write_same_xfer_completion(struct scsi_task *task,
     sbd_cmd_t *scmd, struct stmf_data_buf *dbuf, uint8_t dbuf_reusable);
+static void sbd_do_dbuf_xfer_done(struct scsi_task *task,
+    struct stmf_data_buf *dbuf);
 /*
  * IMPORTANT NOTE:
  * =================
@@ -142,6 +166,13 @@ static void sbd_handle_write_same_xfer_completion(struct scsi_task *task,
  * a scsi task executes in a single threaded manner, even the aborts.
  * Dont ever change that. There wont be any performance gain but there
  * will be tons of race conditions.
+ *
+ * READ and WRITE commands are serviced in the I/O queues of their LU rather
+ * than in the STMF worker thread which hands them over, so that the
+ * commands of a busy LU wait for its backing store in parallel. This keeps
+ * to the rule above: all work on a task is done by the thread of the queue
+ * the task hashes to, in the order STMF handed it over, and aborts are
+ * turned away until that thread is done with the task.
  */
 
 void
@@ -1018,6 +1049,13 @@ sbd_handle_read(struct scsi_task *task, struct stmf_data_buf *initial_dbuf)
 		scmd->addr = laddr;
 		scmd->len = len;
 		scmd->current_ro = 0;
+		/*
+		 * A read larger than one transfer is held one transfer at a
+		 * time, and the zfs prefetcher only ramps up over a stream of
+		 * reads: get the whole of it going at once.
+		 */
+		if (len > MIN(task->task_max_xfer_len, sl->sl_max_xfer_len))
+			sbd_zvol_prefetch(sl, laddr, len);
 		/*
 		 * Kick-off the read.
 		 */
@@ -3267,6 +3305,149 @@ sbd_check_reservation_conflict(struct sbd_lu *sl, struct scsi_task *task)
  * task because of us calling stmf_task_poll_lu resulting in a call to
  * sbd_task_poll().
  */
+void
+sbd_io_queues_create(sbd_lu_t *sl)
+{
+	char name[TASKQ_NAMELEN];
+	uint_t i;
+
+	if (sbd_lu_nqueues == 0)
+		return;
+
+	mutex_init(&sl->sl_io_lock, NULL, MUTEX_DRIVER, NULL);
+	list_create(&sl->sl_io_reqs, sizeof (sbd_io_req_t),
+	    offsetof(sbd_io_req_t, sir_node));
+	sl->sl_io_tq = kmem_alloc(sbd_lu_nqueues * sizeof (taskq_t *),
+	    KM_SLEEP);
+	for (i = 0; i < sbd_lu_nqueues; i++) {
+		(void) snprintf(name, sizeof (name), "sbd_io_%p_%u",
+		    (void *)sl, i);
+		sl->sl_io_tq[i] = taskq_create(name, 1, minclsyspri, 1,
+		    INT_MAX, TASKQ_PREPOPULATE);
+	}
+	sl->sl_io_ntq = sbd_lu_nqueues;
+}
+
+void
+sbd_io_queues_destroy(sbd_lu_t *sl)
+{
+	uint_t i;
+
+	if (sl->sl_io_ntq == 0)
+		return;
+
+	for (i = 0; i < sl->sl_io_ntq; i++)
+		taskq_destroy(sl->sl_io_tq[i]);
+	kmem_free(sl->sl_io_tq, sl->sl_io_ntq * sizeof (taskq_t *));
+	ASSERT(list_is_empty(&sl->sl_io_reqs));
+	list_destroy(&sl->sl_io_reqs);
+	mutex_destroy(&sl->sl_io_lock);
+	sl->sl_io_tq = NULL;
+	sl->sl_io_ntq = 0;
+}
+
+/*
+ * Is this task serviced in the I/O queues of its LU?
+ */
+static boolean_t
+sbd_io_queued(sbd_lu_t *sl, scsi_task_t *task)
+{
+	uint8_t cdb0 = task->task_cdb[0] & 0x1F;
+
+	return (sl->sl_io_ntq != 0 &&
+	    (cdb0 == SCMD_READ || cdb0 == SCMD_WRITE));
+}
+
+/*
+ * Does an I/O queue of the LU have work on this task?  STMF reuses a
+ * completed task for a later command before the queue thread that
+ * finished it has let go of its request, so the task pointer alone could
+ * match work on an earlier command; the generation tells them apart.
+ */
+static boolean_t
+sbd_io_busy(sbd_lu_t *sl, scsi_task_t *task)
+{
+	sbd_cmd_t *scmd = (sbd_cmd_t *)task->task_lu_private;
+	sbd_io_req_t *req;
+	boolean_t busy = B_FALSE;
+
+	if (!sbd_io_queued(sl, task) || scmd == NULL)
+		return (B_FALSE);
+
+	mutex_enter(&sl->sl_io_lock);
+	for (req = list_head(&sl->sl_io_reqs); req != NULL;
+	    req = list_next(&sl->sl_io_reqs, req)) {
+		if (req->sir_task == task && req->sir_gen == scmd->io_gen) {
+			busy = B_TRUE;
+			break;
+		}
+	}
+	mutex_exit(&sl->sl_io_lock);
+
+	return (busy);
+}
+
+static void
+sbd_io_worker(void *arg)
+{
+	sbd_io_req_t *req = arg;
+	sbd_lu_t *sl = req->sir_sl;
+	scsi_task_t *task = req->sir_task;
+
+	if (!req->sir_new)
+		sbd_do_dbuf_xfer_done(task, req->sir_dbuf);
+	else if ((task->task_cdb[0] & 0x1F) == SCMD_READ)
+		sbd_handle_read(task, req->sir_dbuf);
+	else
+		sbd_handle_write(task, req->sir_dbuf);
+
+	/* The task may be gone by now, only the request is ours. */
+	mutex_enter(&sl->sl_io_lock);
+	list_remove(&sl->sl_io_reqs, req);
+	mutex_exit(&sl->sl_io_lock);
+	kmem_free(req, sizeof (*req));
+}
+
+/*
+ * Hand a new READ or WRITE task, or the completion of a data transfer for
+ * one, to the I/O queue the task hashes to.
+ */
+static void
+sbd_io_dispatch(sbd_lu_t *sl, scsi_task_t *task, stmf_data_buf_t *dbuf,
+    boolean_t new)
+{
+	sbd_cmd_t *scmd;
+	sbd_io_req_t *req;
+	uint_t q;
+
+	/*
+	 * The generation of a command is kept in its sbd_cmd_t, which the
+	 * READ and WRITE handlers take over without clearing it.
+	 */
+	if (task->task_lu_private == NULL) {
+		task->task_lu_private = kmem_zalloc(sizeof (sbd_cmd_t),
+		    KM_SLEEP);
+	}
+	scmd = (sbd_cmd_t *)task->task_lu_private;
+
+	req = kmem_zalloc(sizeof (*req), KM_SLEEP);
+	req->sir_sl = sl;
+	req->sir_task = task;
+	req->sir_dbuf = dbuf;
+	req->sir_new = new;
+
+	mutex_enter(&sl->sl_io_lock);
+	if (new)
+		scmd->io_gen = ++sl->sl_io_gen;
+	req->sir_gen = scmd->io_gen;
+	list_insert_tail(&sl->sl_io_reqs, req);
+	mutex_exit(&sl->sl_io_lock);
+
+	q = ((uintptr_t)task >> 6) % sl->sl_io_ntq;
+	taskq_dispatch_ent(sl->sl_io_tq[q], sbd_io_worker, req, 0,
+	    &req->sir_tqent);
+}
+
 void
 sbd_new_task(struct scsi_task *task, struct stmf_data_buf *initial_dbuf)
 {
@@ -3495,6 +3676,10 @@ sbd_new_task(struct scsi_task *task, struct stmf_data_buf *initial_dbuf)
 			stmf_scsilib_send_status(task, STATUS_QFULL, 0);
 			return;
 		}
+		if (sbd_io_queued(sl, task)) {
+			sbd_io_dispatch(sl, task, initial_dbuf, B_TRUE);
+			return;
+		}
 		if (cdb0 == SCMD_READ) {
 			sbd_handle_read(task, initial_dbuf);
 			return;
@@ -3729,6 +3914,18 @@ sbd_new_task(struct scsi_task *task, struct stmf_data_buf *initial_dbuf)
 
 void
 sbd_dbuf_xfer_done(struct scsi_task *task, struct stmf_data_buf *dbuf)
+{
+	sbd_lu_t *sl = (sbd_lu_t *)task->task_lu->lu_provider_private;
+
+	if (sbd_io_queued(sl, task)) {
+		sbd_io_dispatch(sl, task, dbuf, B_FALSE);
+		return;
+	}
+	sbd_do_dbuf_xfer_done(task, dbuf);
+}
+
+static void
+sbd_do_dbuf_xfer_done(struct scsi_task *task, struct stmf_data_buf *dbuf)
 {
 	sbd_cmd_t *scmd = (sbd_cmd_t *)task->task_lu_private;
 
@@ -3819,7 +4016,8 @@ sbd_task_free(struct scsi_task *task)
  * Everything within a task is single threaded.
  *   IT MEANS
  * If this function is called, we are doing nothing with this task
- * inside of sbd module.
+ * inside of sbd module, unless an I/O queue still has work on it, in
+ * which case the abort is tried again later.
  */
 /* ARGSUSED */
 stmf_status_t
@@ -3840,6 +4038,8 @@ sbd_abort(struct stmf_lu *lu, int abort_cmd, void *arg, uint32_t flags)
 
 	ASSERT(abort_cmd == STMF_LU_ABORT_TASK);
 	task = (scsi_task_t *)arg;
+	if (sbd_io_busy(sl, task))
+		return (STMF_BUSY);
 	sbd_ats_remove_by_task(task);
 	if (task->task_lu_private) {
 		sbd_cmd_t *scmd = (sbd_cmd_t *)task->task_lu_private;
@@ -413,6 +413,18 @@ sbd_zvol_copy_read(sbd_lu_t *sl, uio_t *uio)
 	return (error);
 }
 
+/*
+ * Start reading in a range which the caller is about to hold piecemeal,
+ * so that the pieces are read from disk in parallel, rather than each
+ * one only once the previous one has been sent.
+ */
+void
+sbd_zvol_prefetch(sbd_lu_t *sl, uint64_t offset, uint64_t len)
+{
+	dmu_prefetch(sl->sl_zvol_objset_hdl, ZVOL_OBJ, 0, offset, len,
+	    ZIO_PRIORITY_SYNC_READ);
+}
+
 /*
  * Copy interface for callers using direct zvol access.
  * Very similar to zvol_write but the uio may have multiple iovec entries.
@@ -28,6 +28,7 @@
 #define	_STMF_SBD_H
 
 #include <sys/dkio.h>
+#include <sys/taskq.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -249,6 +250,13 @@ typedef struct sbd_lu {
 	struct sbd_pgr		*sl_pgr;
 	uint64_t	sl_rs_owner_session_id;
 	list_t		sl_ats_io_list;
+
+	/* I/O queues, see sbd_io_dispatch() */
+	uint_t		sl_io_ntq;
+	taskq_t		**sl_io_tq;
+	kmutex_t	sl_io_lock;
+	list_t		sl_io_reqs;		/* requests queued or running */
+	uint32_t	sl_io_gen;		/* last command generation */
 } sbd_lu_t;
 
 /*
@@ -309,6 +317,8 @@ int sbd_unmap(sbd_lu_t *sl, dkioc_free_list_t *dfl);
 
 void sbd_handle_short_write_transfers(scsi_task_t *, stmf_data_buf_t *,
     uint32_t);
+void sbd_io_queues_create(sbd_lu_t *);
+void sbd_io_queues_destroy(sbd_lu_t *);
 void sbd_handle_short_read_transfers(scsi_task_t *, stmf_data_buf_t *,
     uint8_t *, uint32_t, uint32_t);
 
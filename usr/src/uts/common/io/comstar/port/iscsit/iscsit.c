@@ -164,7 +164,11 @@ iscsit_pdu_op_text_cmd(iscsit_conn_t *ict, idm_pdu_t *rx_pdu);
 static void
 iscsit_pdu_op_logout_cmd(iscsit_conn_t *ict, idm_pdu_t *rx_pdu);
 
-int iscsit_cmd_window();
+static uint32_t
+iscsit_conn_window(int nconn);
+
+static uint32_t
+iscsit_cmd_window(iscsit_sess_t *ist);
 
 static  int
 iscsit_sna_lt(uint32_t sn1, uint32_t sn2);
@@ -258,6 +262,14 @@ static void iscsit_send_task_mgmt_resp(idm_pdu_t *tm_resp_pdu,
  */
 volatile int rxpdu_queue_threshold = ISCSIT_RXPDU_QUEUE_THRESHOLD;
 
+/*
+ * MC/S: Each full-feature connection in a session contributes this many
+ * CmdSNs to the session's command window, up to ISCSIT_MAX_WINDOW.  An
+ * initiator striping commands across several connections would otherwise
+ * be held to the queue depth of a single connection.
+ */
+volatile uint32_t iscsit_conn_cmd_window = ISCSIT_CONN_WINDOW;
+
 static kmutex_t		iscsit_rxpdu_queue_monitor_mutex;
 kthread_t		*iscsit_rxpdu_queue_monitor_thr_id;
 static kt_did_t		iscsit_rxpdu_queue_monitor_thr_did;
@@ -1304,6 +1316,10 @@ iscsit_ffp_enabled(idm_conn_t *ic)
 {
 	iscsit_conn_t *ict = ic->ic_handle;
 
+	/* Make room for the larger window before it can be offered */
+	iscsit_rxpdu_queue_grow(ict->ict_sess,
+	    ict->ict_sess->ist_ffp_conn_count + 1);
+
 	/* Generate session state machine event */
 	iscsit_sess_sm_event(ict->ict_sess, SE_CONN_LOGGED_IN, ict);
 
@@ -1351,7 +1367,7 @@ iscsit_conn_lost(idm_conn_t *ic)
 	if (ist != NULL) {
 		mutex_enter(&ist->ist_sn_mutex);
 		for (cbuf = ist->ist_rxpdu_queue, i = 0;
-		    ((cbuf->cb_num_elems > 0) && (i < ISCSIT_RXPDU_QUEUE_LEN));
+		    ((cbuf->cb_num_elems > 0) && (i < cbuf->cb_size));
 		    i++) {
 			if (((rx_pdu = cbuf->cb_buffer[i]) != NULL) &&
 			    (rx_pdu->isp_ic == ic)) {
@@ -2650,17 +2666,74 @@ iscsit_pdu_op_logout_cmd(iscsit_conn_t	*ict, idm_pdu_t *rx_pdu)
 }
 
 /*
- * Calculate the number of outstanding commands we can process
+ * Calculate the number of outstanding commands we can process.  With
+ * MC/S the window scales with the number of connections in full feature
+ * phase so that each one can keep the same queue depth a single
+ * connection session gets.
  */
-int
-iscsit_cmd_window()
+static uint32_t
+iscsit_conn_window(int nconn)
 {
-	/*
-	 * Instead of using a pre-defined constant for the command window,
-	 * it should be made confiurable and dynamic. With MC/S, sequence
-	 * numbers will be used up at a much faster rate than with SC/S.
-	 */
-	return	(ISCSIT_MAX_WINDOW);
+	uint32_t	window;
+
+	nconn = MAX(nconn, 1);
+	window = MAX(iscsit_conn_cmd_window, 1);
+	if (window > ISCSIT_MAX_WINDOW / nconn)
+		return (ISCSIT_MAX_WINDOW);
+
+	return (window * nconn);
+}
+
+/*
+ * The window is never more than half the staging queue, so that queued
+ * CmdSNs cannot collide even if the queue has yet to grow.
+ */
+static uint32_t
+iscsit_cmd_window(iscsit_sess_t *ist)
+{
+	return (MIN(iscsit_conn_window(ist->ist_ffp_conn_count),
+	    ist->ist_rxpdu_queue->cb_size / 2));
+}
+
+/*
+ * Grow the staging queue of the session to twice the command window of
+ * nconn connections.  It never shrinks: MaxCmdSN does not go back when a
+ * connection leaves, so the CmdSNs already offered must still fit.
+ */
+void
+iscsit_rxpdu_queue_grow(iscsit_sess_t *ist, int nconn)
+{
+	iscsit_cbuf_t	*cbuf = ist->ist_rxpdu_queue;
+	idm_pdu_t	**nbuf, **obuf, *pdu;
+	uint32_t	nsize, osize, cmdsn, i;
+
+	nsize = 2 * iscsit_conn_window(nconn);
+	if (nsize <= cbuf->cb_size)
+		return;
+
+	nbuf = kmem_zalloc(nsize * sizeof (idm_pdu_t *), KM_SLEEP);
+
+	mutex_enter(&ist->ist_sn_mutex);
+	if (nsize <= cbuf->cb_size) {
+		mutex_exit(&ist->ist_sn_mutex);
+		kmem_free(nbuf, nsize * sizeof (idm_pdu_t *));
+		return;
+	}
+	for (i = 0; i < cbuf->cb_size; i++) {
+		if ((pdu = cbuf->cb_buffer[i]) != NULL) {
+			cmdsn = ntohl(((iscsi_scsi_cmd_hdr_t *)
+			    pdu->isp_hdr)->cmdsn);
+			nbuf[cmdsn % nsize] = pdu;
+		}
+	}
+	obuf = cbuf->cb_buffer;
+	osize = cbuf->cb_size;
+	cbuf->cb_buffer = nbuf;
+	cbuf->cb_size = nsize;
+	mutex_exit(&ist->ist_sn_mutex);
+
+	if (obuf != NULL)
+		kmem_free(obuf, osize * sizeof (idm_pdu_t *));
 }
 
 /*
@@ -2671,6 +2744,7 @@ iscsit_set_cmdsn(iscsit_conn_t *ict, idm_pdu_t *rx_pdu)
 {
 	iscsit_sess_t *ist;
 	iscsi_scsi_cmd_hdr_t *req;
+	uint32_t maxcmdsn;
 
 	ist = ict->ict_sess;
 
@@ -2680,10 +2754,16 @@ iscsit_set_cmdsn(iscsit_conn_t *ict, idm_pdu_t *rx_pdu)
 		return;
 	}
 
-	/* Ensure that the ExpCmdSN advances in an orderly manner */
+	/*
+	 * Ensure that the ExpCmdSN advances in an orderly manner.  The window
+	 * shrinks when an MC/S connection goes away, but MaxCmdSN must never
+	 * move backwards (RFC 3720 3.2.2.1), so it only advances here.
+	 */
 	mutex_enter(&ist->ist_sn_mutex);
 	ist->ist_expcmdsn = ntohl(req->cmdsn) + 1;
-	ist->ist_maxcmdsn = ntohl(req->cmdsn) + iscsit_cmd_window();
+	maxcmdsn = ntohl(req->cmdsn) + iscsit_cmd_window(ist);
+	if (iscsit_sna_lt(ist->ist_maxcmdsn, maxcmdsn))
+		ist->ist_maxcmdsn = maxcmdsn;
 	mutex_exit(&ist->ist_sn_mutex);
 }
 
@@ -3114,7 +3194,8 @@ iscsit_cmdsn_in_window(iscsit_conn_t *ict, uint32_t cmdsn)
 	 * greater than ist_expcmdsn, it's not in the window.
 	 */
 
-	if (iscsit_sna_lt(cmdsn, (ist->ist_expcmdsn - iscsit_cmd_window())) ||
+	if (iscsit_sna_lt(cmdsn,
+	    (ist->ist_expcmdsn - iscsit_cmd_window(ist))) ||
 	    !iscsit_sna_lte(cmdsn, ist->ist_expcmdsn)) {
 		rval = B_FALSE;
 	}
@@ -3193,11 +3274,11 @@ iscsit_check_cmdsn_and_queue(idm_pdu_t *rx_pdu)
 
 /*
  * iscsit_add_pdu_to_queue() adds PDUs into the array indexed by
- * their cmdsn value. The length of the array is kept above the
- * maximum window size. The window keeps the cmdsn within a range
- * such that there are no collisons. e.g. the assumption is that
- * the windowing checks make it impossible to receive PDUs that
- * index into the same location in the array.
+ * their cmdsn value. The length of the array is kept at twice the
+ * largest window offered, see iscsit_rxpdu_queue_grow(). The window
+ * keeps the cmdsn within a range such that there are no collisons.
+ * e.g. the assumption is that the windowing checks make it impossible
+ * to receive PDUs that index into the same location in the array.
  */
 static void
 iscsit_add_pdu_to_queue(iscsit_sess_t *ist, idm_pdu_t *rx_pdu)
@@ -3222,7 +3303,7 @@ iscsit_add_pdu_to_queue(iscsit_sess_t *ist, idm_pdu_t *rx_pdu)
 	iscsit_conn_dispatch_hold(ict);
 	mutex_exit(&ict->ict_mutex);
 
-	index = ntohl(cmdsn) % ISCSIT_RXPDU_QUEUE_LEN;
+	index = ntohl(cmdsn) % cbuf->cb_size;
 	/*
 	 * In the normal case, assuming that the Initiator is not
 	 * buggy and that we don't have packet duplication occuring,
@@ -3248,7 +3329,7 @@ iscsit_remove_pdu_from_queue(iscsit_sess_t *ist, uint32_t cmdsn)
 	uint32_t	index;
 
 	ASSERT(MUTEX_HELD(&ist->ist_sn_mutex));
-	index = cmdsn % ISCSIT_RXPDU_QUEUE_LEN;
+	index = cmdsn % cbuf->cb_size;
 	if ((pdu = cbuf->cb_buffer[index]) != NULL) {
 		ASSERT(cmdsn ==
 		    ntohl(((iscsi_scsi_cmd_hdr_t *)pdu->isp_hdr)->cmdsn));
@@ -3439,7 +3520,7 @@ iscsit_rxpdu_queue_monitor_session(iscsit_sess_t *ist)
 	}
 	for (next_pdu = NULL, i = 0; ; i++) {
 		next_cmdsn = ist->ist_expcmdsn + i; /* start at expcmdsn */
-		index = next_cmdsn % ISCSIT_RXPDU_QUEUE_LEN;
+		index = next_cmdsn % cbuf->cb_size;
 		if ((next_pdu = cbuf->cb_buffer[index]) != NULL) {
 			/*
 			 * If the PDU wait time has not exceeded threshold
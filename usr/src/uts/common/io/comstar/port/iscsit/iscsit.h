@@ -56,8 +56,8 @@
 #define	ISCSI_MAX_TSIH		0xffff
 #define	ISCSI_UNSPEC_TSIH	0
 
-#define	ISCSIT_MAX_WINDOW	1024
-#define	ISCSIT_RXPDU_QUEUE_LEN	2048
+#define	ISCSIT_CONN_WINDOW	1024	/* per-connection share, see MC/S */
+#define	ISCSIT_MAX_WINDOW	4096
 
 /*
  * MC/S: A timeout is maintained to recover from lost CmdSN (holes in the
@@ -75,9 +75,13 @@
 #define	ISCSIT_GLOBAL_LOCK(rw) rw_enter(&iscsit_global.global_rwlock, (rw))
 #define	ISCSIT_GLOBAL_UNLOCK() rw_exit(&iscsit_global.global_rwlock)
 
-/* Circular buffer to hold the out-of-order PDUs in MC/S */
+/*
+ * Circular buffer to hold the out-of-order PDUs in MC/S.  It holds twice
+ * the command window of the session, and grows as connections join it.
+ */
 typedef struct {
-	idm_pdu_t	*cb_buffer[ISCSIT_RXPDU_QUEUE_LEN];
+	idm_pdu_t	**cb_buffer;
+	uint32_t	cb_size;
 	int		cb_num_elems;
 } iscsit_cbuf_t;
 
@@ -713,6 +717,9 @@ iscsit_sess_unbind_conn(iscsit_sess_t *ist, iscsit_conn_t *ict);
 void
 iscsit_sess_close(iscsit_sess_t *ist);
 
+void
+iscsit_rxpdu_queue_grow(iscsit_sess_t *ist, int nconn);
+
 iscsit_sess_t *
 iscsit_sess_reinstate(iscsit_tgt_t *tgt, iscsit_sess_t *ist, iscsit_conn_t *ict,
     uint8_t *error_class, uint8_t *error_detail);
@@ -2899,6 +2899,7 @@ stmf_create_kstat_lu(stmf_i_lu_t *ilu)
 {
 	char				ks_nm[KSTAT_STRLEN];
 	stmf_kstat_lu_info_t		*ks_lu;
+	stmf_kstat_lu_lat_t		*ks_lat;
 
 	/* create kstat lun info */
 	ks_lu = (stmf_kstat_lu_info_t *)kmem_zalloc(STMF_KSTAT_LU_SZ,
@@ -2951,6 +2952,51 @@ stmf_create_kstat_lu(stmf_i_lu_t *ilu)
 	mutex_init(&ilu->ilu_kstat_lock, NULL, MUTEX_DRIVER, 0);
 	ilu->ilu_kstat_io->ks_lock = &ilu->ilu_kstat_lock;
 	kstat_install(ilu->ilu_kstat_io);
+
+	/* create kstat lun latency histogram */
+	bzero(ks_nm, sizeof (ks_nm));
+	(void) sprintf(ks_nm, "stmf_lu_lat_%"PRIxPTR"", (uintptr_t)ilu);
+	if ((ilu->ilu_kstat_lat = kstat_create(STMF_MODULE_NAME, 0,
+	    ks_nm, "misc", KSTAT_TYPE_NAMED,
+	    sizeof (stmf_kstat_lu_lat_t) / sizeof (kstat_named_t), 0)) ==
+	    NULL) {
+		cmn_err(CE_WARN, "STMF: kstat_create lu_lat failed");
+		return;
+	}
+	ks_lat = ilu->ilu_kstat_lat->ks_data;
+	for (i = 0; i < STMF_LAT_BUCKETS; i++) {
+		uint_t us = i == 0 ? 0 : 1U << (i + 3);
+
+		(void) snprintf(ks_nm, sizeof (ks_nm), "read_us_%u", us);
+		kstat_named_init(&ks_lat->i_read_lat[i], ks_nm,
+		    KSTAT_DATA_UINT64);
+		(void) snprintf(ks_nm, sizeof (ks_nm), "write_us_%u", us);
+		kstat_named_init(&ks_lat->i_write_lat[i], ks_nm,
+		    KSTAT_DATA_UINT64);
+	}
+	kstat_install(ilu->ilu_kstat_lat);
+}
+
+/*
+ * Count a READ or WRITE command in the latency histogram of its LU.
+ */
+static void
+stmf_update_kstat_lu_lat(stmf_i_lu_t *ilu, scsi_task_t *task, hrtime_t lat)
+{
+	stmf_kstat_lu_lat_t	*ks_lat;
+	uint64_t		us = NSEC2USEC(lat);
+	int			b;
+
+	if (ilu->ilu_kstat_lat == NULL ||
+	    (task->task_flags & (TF_READ_DATA | TF_WRITE_DATA)) == 0)
+		return;
+
+	b = us < 16 ? 0 : MIN(highbit64(us) - 4, STMF_LAT_BUCKETS - 1);
+	ks_lat = ilu->ilu_kstat_lat->ks_data;
+	if (task->task_flags & TF_READ_DATA)
+		atomic_inc_64(&ks_lat->i_read_lat[b].value.ui64);
+	else
+		atomic_inc_64(&ks_lat->i_write_lat[b].value.ui64);
 }
 
 static void
@@ -3282,6 +3328,8 @@ stmf_deregister_lu(stmf_lu_t *lu)
 		kstat_delete(ilu->ilu_kstat_io);
 		mutex_destroy(&ilu->ilu_kstat_lock);
 	}
+	if (ilu->ilu_kstat_lat)
+		kstat_delete(ilu->ilu_kstat_lat);
 	cv_destroy(&ilu->ilu_offline_pending_cv);
 	mutex_exit(&stmf_state.stmf_lock);
 	return (STMF_SUCCESS);
@@ -7498,6 +7546,8 @@ stmf_itl_task_done(stmf_i_scsi_task_t *itask)
 		return;
 
 	stmf_update_kstat_rport_estat(task);
+	stmf_update_kstat_lu_lat(ilu, task,
+	    itask->itask_done_timestamp - itask->itask_start_timestamp);
 
 	mutex_enter(ilu->ilu_kstat_io->ks_lock);
 
@@ -99,6 +99,7 @@ typedef struct stmf_i_lu {
 	struct stmf_itl_data	*ilu_itl_list;
 	kstat_t		*ilu_kstat_info;
 	kstat_t		*ilu_kstat_io;
+	kstat_t		*ilu_kstat_lat;
 	kmutex_t	ilu_kstat_lock;
 	kcondvar_t	ilu_offline_pending_cv;
 
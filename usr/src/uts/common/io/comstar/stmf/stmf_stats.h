@@ -54,6 +54,19 @@ typedef struct stmf_kstat_lu_info {
 	kstat_named_t		i_lun_alias;
 } stmf_kstat_lu_info_t;
 
+/*
+ * Histogram of the time from arrival to completion of the READ and WRITE
+ * commands of an LU. Bucket 0 counts commands done in less than 16us,
+ * bucket n those done in [2^(n+3), 2^(n+4))us, and the last one all the
+ * slower ones.
+ */
+#define	STMF_LAT_BUCKETS	16
+
+typedef struct stmf_kstat_lu_lat {
+	kstat_named_t		i_read_lat[STMF_LAT_BUCKETS];
+	kstat_named_t		i_write_lat[STMF_LAT_BUCKETS];
+} stmf_kstat_lu_lat_t;
+
 typedef struct stmf_kstat_tgt_info {
 	kstat_named_t		i_tgt_name;
 	kstat_named_t		i_tgt_alias;
@@ -1382,6 +1382,8 @@ dld_capab_direct(dld_str_t *dsp, void *data, uint_t flags)
 		direct->di_tx_cb_dh = dsp->ds_mch;
 		direct->di_tx_fctl_df = (uintptr_t)mac_tx_is_flow_blocked;
 		direct->di_tx_fctl_dh = dsp->ds_mch;
+		direct->di_tx_pace_df = (uintptr_t)mac_tx_pace;
+		direct->di_tx_pace_dh = dsp->ds_mch;
 
 		dsp->ds_direct = B_TRUE;
 
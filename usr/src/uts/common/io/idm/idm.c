@@ -37,6 +37,8 @@
 #include <sys/socketvar.h>
 #include <netinet/in.h>
 
+#include <inet/sctp_crc32.h>
+
 #include <sys/idm/idm.h>
 #include <sys/idm/idm_so.h>
 
@@ -2403,6 +2405,9 @@ _idm_init(void)
 	list_create(&idm.idm_ini_conn_list, sizeof (idm_conn_t),
 	    offsetof(idm_conn_t, ic_list_node));
 
+	/* Build the CRC-32C tables and probe for the crc32 instruction */
+	sctp_crc32_init();
+
 	/* Initialize the native sockets transport */
 	idm_so_init(&idm_transport_list[IDM_TRANSPORT_TYPE_SOCKETS]);
 
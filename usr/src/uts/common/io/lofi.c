@@ -131,6 +131,11 @@
  *
  *	Each block has its own IV, that is calculated in lofi_blk_mech(), based
  *	on the "master" key held in the lsp and the block number of the buffer.
+ *
+ * Block cache:
+ *	A device can be given a second file or device to use as a read/write
+ *	cache in front of the mapped file (lofiadm -w).  It is write-back and
+ *	its contents do not survive an unmap; see "Block cache tier" below.
  */
 
 #include <sys/types.h>
@@ -247,6 +252,8 @@ lofi_compress_info_t lofi_compress_table[LOFI_COMPRESS_FUNCTIONS] = {
 };
 
 static void lofi_strategy_task(void *);
+static int file_to_lofi_nocheck(char *, boolean_t, struct lofi_state **);
+static void lofi_bc_fini(struct lofi_state *, cred_t *);
 static int lofi_tg_rdwr(dev_info_t *, uchar_t, void *, diskaddr_t,
     size_t, void *);
 static int lofi_tg_getinfo(dev_info_t *, int, void *, void *);
@@ -557,6 +564,9 @@ lofi_destroy(struct lofi_state *lsp, cred_t *credp)
 		lsp->ls_taskq = NULL;
 	}
 
+	/* Write back the block cache while the mapped file is still open. */
+	lofi_bc_fini(lsp, credp);
+
 	list_remove(&lofi_list, lsp);
 
 	lofi_free_crypto(lsp);
@@ -608,6 +618,8 @@ lofi_destroy(struct lofi_state *lsp, cred_t *credp)
 	mutex_destroy(&lsp->ls_kstat_lock);
 	mutex_destroy(&lsp->ls_vp_lock);
 	cv_destroy(&lsp->ls_vp_cv);
+	mutex_destroy(&lsp->ls_bc_lock);
+	cv_destroy(&lsp->ls_bc_cv);
 	lsp->ls_vp_ready = B_FALSE;
 	lsp->ls_vp_closereq = B_FALSE;
 
@@ -1311,6 +1323,714 @@ lzma_decompress(void *src, size_t srclen, void *dst,
 	return (0);
 }
 
+/*
+ * Block cache tier
+ *
+ * A mapping can be given a second file or device (li_cachefile) to use
+ * as a read/write cache in front of the mapped file.  This helps when the
+ * image lives on slow or remote storage.  The cache file is cut into
+ * slots of lofi_bcache_blksz bytes, and each slot holds one aligned block
+ * of the mapped file.  The block a slot holds is only recorded in memory,
+ * so cache contents do not survive an unmap.  Dirty blocks are written
+ * back to the mapped file when they are evicted, on DKIOCFLUSHWRITECACHE,
+ * and when the mapping is torn down.  With a cache attached, lofi behaves
+ * like a disk with its write cache enabled.  Writes are not stable until
+ * they are flushed, so consumers that care, such as ZFS, must flush.
+ *
+ * Replacement is a segmented LRU, the scan-resistant half of ARC.  Blocks
+ * enter on the probation list and move to the protected list when they
+ * are hit again.  The protected list is held to lofi_bcache_prot_pct of
+ * the slots, and victims come from the cold end of probation first, so a
+ * single pass over the image does not push out the working set.
+ *
+ * Long sequential runs are not worth caching.  Once back-to-back requests
+ * add up to more than lofi_bcache_seq_bypass bytes, blocks that miss are
+ * read from or written to the mapped file directly.  Blocks that are
+ * already cached are always served from the cache, so it never goes
+ * stale.  Writes that miss and cover a whole block are allocated in the
+ * cache.  Partial writes that miss go straight to the mapped file rather
+ * than pay for a read-modify-write.  A read fill waits for any such write
+ * to its block that is in flight (ls_bc_arounds).
+ *
+ * be_busy serializes I/O to a slot.  Everything else is protected by
+ * ls_bc_lock.
+ */
+uint32_t lofi_bcache_blksz = 32 * 1024;		/* slot size, power of 2 */
+uint32_t lofi_bcache_max_slots = 1024 * 1024;
+uint32_t lofi_bcache_prot_pct = 75;
+uint64_t lofi_bcache_seq_bypass = 4 * 1024 * 1024;	/* 0 disables */
+
+#define	LOFI_BC_BLKSZ(lsp)	(1ULL << (lsp)->ls_bc_blkshift)
+#define	LOFI_BC_BLKOFF(lsp, blkno)	\
+	((offset_t)(blkno) << (lsp)->ls_bc_blkshift)
+#define	LOFI_BC_SLOTOFF(lsp, e)	\
+	((offset_t)(e)->be_slot << (lsp)->ls_bc_blkshift)
+
+static list_t *
+lofi_bc_list(struct lofi_state *lsp, lofi_bc_list_t which)
+{
+	switch (which) {
+	case LOFI_BC_PROBATION:
+		return (&lsp->ls_bc_probation);
+	case LOFI_BC_PROTECTED:
+		return (&lsp->ls_bc_protected);
+	default:
+		return (&lsp->ls_bc_free);
+	}
+}
+
+static void
+lofi_bc_move(struct lofi_state *lsp, struct lofi_bc_ent *e,
+    lofi_bc_list_t to)
+{
+	lofi_bc_kstat_t *ks = &lsp->ls_bc_stats;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+
+	list_remove(lofi_bc_list(lsp, e->be_list), e);
+	if (e->be_list == LOFI_BC_PROTECTED)
+		lsp->ls_bc_nprot--;
+	else if (e->be_list == LOFI_BC_FREE)
+		ks->lbk_blocks.value.ui64++;
+
+	e->be_list = to;
+	list_insert_tail(lofi_bc_list(lsp, to), e);
+	if (to == LOFI_BC_PROTECTED)
+		lsp->ls_bc_nprot++;
+	else if (to == LOFI_BC_FREE)
+		ks->lbk_blocks.value.ui64--;
+}
+
+static struct lofi_bc_ent **
+lofi_bc_bucket(struct lofi_state *lsp, uint64_t blkno)
+{
+	return (&lsp->ls_bc_hash[blkno & lsp->ls_bc_hashmask]);
+}
+
+static struct lofi_bc_ent *
+lofi_bc_lookup(struct lofi_state *lsp, uint64_t blkno)
+{
+	struct lofi_bc_ent *e;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+
+	for (e = *lofi_bc_bucket(lsp, blkno); e != NULL; e = e->be_hnext) {
+		if (e->be_blkno == blkno)
+			return (e);
+	}
+	return (NULL);
+}
+
+static void
+lofi_bc_hash_insert(struct lofi_state *lsp, struct lofi_bc_ent *e)
+{
+	struct lofi_bc_ent **bucket = lofi_bc_bucket(lsp, e->be_blkno);
+
+	e->be_hnext = *bucket;
+	*bucket = e;
+}
+
+static void
+lofi_bc_hash_remove(struct lofi_state *lsp, struct lofi_bc_ent *e)
+{
+	struct lofi_bc_ent **ep;
+
+	for (ep = lofi_bc_bucket(lsp, e->be_blkno); *ep != e;
+	    ep = &(*ep)->be_hnext)
+		ASSERT(*ep != NULL);
+	*ep = e->be_hnext;
+	e->be_hnext = NULL;
+}
+
+/*
+ * A cached block was referenced again: promote it to the MRU end of the
+ * protected list, demoting the coldest protected blocks back to probation
+ * to keep the protected list within lofi_bcache_prot_pct of the slots.
+ */
+static void
+lofi_bc_touch(struct lofi_state *lsp, struct lofi_bc_ent *e)
+{
+	uint32_t maxprot;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+
+	lofi_bc_move(lsp, e, LOFI_BC_PROTECTED);
+
+	maxprot = (uint64_t)lsp->ls_bc_nslots *
+	    MIN(lofi_bcache_prot_pct, 100) / 100;
+	while (lsp->ls_bc_nprot > maxprot) {
+		lofi_bc_move(lsp, list_head(&lsp->ls_bc_protected),
+		    LOFI_BC_PROBATION);
+	}
+}
+
+static void
+lofi_bc_rele(struct lofi_state *lsp, struct lofi_bc_ent *e)
+{
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+	ASSERT(e->be_busy);
+
+	e->be_busy = B_FALSE;
+	cv_broadcast(&lsp->ls_bc_cv);
+}
+
+/*
+ * Forget the block a busy, clean entry holds and return its slot to the
+ * free list.
+ */
+static void
+lofi_bc_drop(struct lofi_state *lsp, struct lofi_bc_ent *e)
+{
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+	ASSERT(!e->be_dirty);
+
+	lofi_bc_hash_remove(lsp, e);
+	lofi_bc_move(lsp, e, LOFI_BC_FREE);
+	lofi_bc_rele(lsp, e);
+}
+
+static void
+lofi_bc_set_dirty(struct lofi_state *lsp, struct lofi_bc_ent *e,
+    boolean_t dirty)
+{
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+
+	if (e->be_dirty == dirty)
+		return;
+	e->be_dirty = dirty;
+	if (dirty)
+		lsp->ls_bc_stats.lbk_dirty.value.ui64++;
+	else
+		lsp->ls_bc_stats.lbk_dirty.value.ui64--;
+}
+
+static int
+lofi_bc_io(vnode_t *vp, enum uio_rw rw, caddr_t buf, size_t len,
+    offset_t offset)
+{
+	ssize_t resid;
+	int error;
+
+	error = vn_rdwr(rw, vp, buf, len, offset, UIO_SYSSPACE, 0,
+	    RLIM64_INFINITY, kcred, &resid);
+	if (error == 0 && resid != 0)
+		error = EIO;
+	return (error);
+}
+
+/* The last block of the mapped file may be short. */
+static size_t
+lofi_bc_blklen(struct lofi_state *lsp, uint64_t blkno)
+{
+	return (MIN(LOFI_BC_BLKSZ(lsp),
+	    lsp->ls_vp_size - LOFI_BC_BLKOFF(lsp, blkno)));
+}
+
+/*
+ * Copy the block held by a busy entry from the cache to the mapped file.
+ */
+static int
+lofi_bc_writeback(struct lofi_state *lsp, struct lofi_bc_ent *e)
+{
+	size_t len = lofi_bc_blklen(lsp, e->be_blkno);
+	caddr_t buf;
+	int error;
+
+	ASSERT(e->be_busy);
+
+	buf = kmem_alloc(len, KM_SLEEP);
+	error = lofi_bc_io(lsp->ls_bc_vp, UIO_READ, buf, len,
+	    LOFI_BC_SLOTOFF(lsp, e));
+	if (error == 0) {
+		error = lofi_bc_io(lsp->ls_vp, UIO_WRITE, buf, len,
+		    LOFI_BC_BLKOFF(lsp, e->be_blkno));
+	}
+	kmem_free(buf, len);
+	return (error);
+}
+
+/*
+ * Find a slot for blkno, which the caller has just looked up and missed.
+ * On success *ep is a busy, clean entry hashed under blkno on the
+ * probation list, or NULL if every slot is busy.  EAGAIN means a dirty
+ * victim had to be written back with ls_bc_lock dropped, and the caller
+ * has to look blkno up again.  Any other error means the victim could
+ * not be written back.
+ */
+static int
+lofi_bc_alloc(struct lofi_state *lsp, uint64_t blkno, struct lofi_bc_ent **ep)
+{
+	lofi_bc_kstat_t *ks = &lsp->ls_bc_stats;
+	struct lofi_bc_ent *e;
+	int error;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+
+	*ep = NULL;
+	if ((e = list_head(&lsp->ls_bc_free)) == NULL) {
+		for (e = list_head(&lsp->ls_bc_probation);
+		    e != NULL && e->be_busy;
+		    e = list_next(&lsp->ls_bc_probation, e))
+			;
+		if (e == NULL) {
+			for (e = list_head(&lsp->ls_bc_protected);
+			    e != NULL && e->be_busy;
+			    e = list_next(&lsp->ls_bc_protected, e))
+				;
+		}
+		if (e == NULL)
+			return (0);
+
+		if (e->be_dirty) {
+			e->be_busy = B_TRUE;
+			mutex_exit(&lsp->ls_bc_lock);
+			error = lofi_bc_writeback(lsp, e);
+			mutex_enter(&lsp->ls_bc_lock);
+			if (error == 0) {
+				lofi_bc_set_dirty(lsp, e, B_FALSE);
+				ks->lbk_writebacks.value.ui64++;
+			} else {
+				ks->lbk_errors.value.ui64++;
+			}
+			lofi_bc_rele(lsp, e);
+			return (error == 0 ? EAGAIN : error);
+		}
+
+		lofi_bc_hash_remove(lsp, e);
+		ks->lbk_evictions.value.ui64++;
+	}
+
+	e->be_blkno = blkno;
+	e->be_busy = B_TRUE;
+	lofi_bc_hash_insert(lsp, e);
+	lofi_bc_move(lsp, e, LOFI_BC_PROBATION);
+	*ep = e;
+	return (0);
+}
+
+static boolean_t
+lofi_bc_around_busy(struct lofi_state *lsp, uint64_t blkno)
+{
+	struct lofi_bc_around *ba;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+
+	for (ba = list_head(&lsp->ls_bc_arounds); ba != NULL;
+	    ba = list_next(&lsp->ls_bc_arounds, ba)) {
+		if (ba->ba_blkno == blkno)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+/*
+ * Transfer len bytes at byte off of block blkno through the cache.  Called
+ * and returns with ls_bc_lock held.
+ */
+static int
+lofi_bc_chunk(struct lofi_state *lsp, boolean_t isread, caddr_t buf,
+    uint64_t blkno, size_t off, size_t len, boolean_t bypass)
+{
+	lofi_bc_kstat_t *ks = &lsp->ls_bc_stats;
+	size_t blen = lofi_bc_blklen(lsp, blkno);
+	offset_t boff = LOFI_BC_BLKOFF(lsp, blkno);
+	struct lofi_bc_around around;
+	struct lofi_bc_ent *e;
+	caddr_t fill;
+	int error, cerror;
+
+	ASSERT(MUTEX_HELD(&lsp->ls_bc_lock));
+
+again:
+	while ((e = lofi_bc_lookup(lsp, blkno)) != NULL && e->be_busy)
+		cv_wait(&lsp->ls_bc_cv, &lsp->ls_bc_lock);
+
+	if (e != NULL) {
+		if (isread)
+			ks->lbk_read_hits.value.ui64++;
+		else
+			ks->lbk_write_hits.value.ui64++;
+		e->be_busy = B_TRUE;
+		lofi_bc_touch(lsp, e);
+		mutex_exit(&lsp->ls_bc_lock);
+
+		error = lofi_bc_io(lsp->ls_bc_vp, isread ? UIO_READ : UIO_WRITE,
+		    buf, len, LOFI_BC_SLOTOFF(lsp, e) + off);
+
+		mutex_enter(&lsp->ls_bc_lock);
+		if (error == 0) {
+			if (!isread)
+				lofi_bc_set_dirty(lsp, e, B_TRUE);
+			lofi_bc_rele(lsp, e);
+			return (0);
+		}
+		ks->lbk_errors.value.ui64++;
+		if (e->be_dirty) {
+			/* The cache holds the only current copy. */
+			lofi_bc_rele(lsp, e);
+			return (error);
+		}
+		/* A clean copy is simply dropped; use the mapped file. */
+		lofi_bc_drop(lsp, e);
+		goto around;
+	}
+
+	if (isread)
+		ks->lbk_read_misses.value.ui64++;
+	else
+		ks->lbk_write_misses.value.ui64++;
+	if (bypass || (!isread && len != blen))
+		goto around;
+
+	error = lofi_bc_alloc(lsp, blkno, &e);
+	if (error == EAGAIN)
+		goto again;
+	if (e == NULL)
+		goto around;
+
+	if (!isread) {
+		ks->lbk_write_allocs.value.ui64++;
+		mutex_exit(&lsp->ls_bc_lock);
+		error = lofi_bc_io(lsp->ls_bc_vp, UIO_WRITE, buf, len,
+		    LOFI_BC_SLOTOFF(lsp, e));
+		mutex_enter(&lsp->ls_bc_lock);
+		if (error == 0) {
+			lofi_bc_set_dirty(lsp, e, B_TRUE);
+			lofi_bc_rele(lsp, e);
+			return (0);
+		}
+		ks->lbk_errors.value.ui64++;
+		lofi_bc_drop(lsp, e);
+		goto around;
+	}
+
+	/*
+	 * Read fill.  Our entry keeps new writes to this block from going
+	 * around the cache, but one that started before we allocated it
+	 * must land first or we would cache stale data.
+	 */
+	while (lofi_bc_around_busy(lsp, blkno))
+		cv_wait(&lsp->ls_bc_cv, &lsp->ls_bc_lock);
+	ks->lbk_fills.value.ui64++;
+	mutex_exit(&lsp->ls_bc_lock);
+
+	fill = (len == blen) ? buf : kmem_alloc(blen, KM_SLEEP);
+	cerror = 0;
+	error = lofi_bc_io(lsp->ls_vp, UIO_READ, fill, blen, boff);
+	if (error == 0) {
+		cerror = lofi_bc_io(lsp->ls_bc_vp, UIO_WRITE, fill, blen,
+		    LOFI_BC_SLOTOFF(lsp, e));
+		if (fill != buf)
+			bcopy(fill + off, buf, len);
+	}
+	if (fill != buf)
+		kmem_free(fill, blen);
+
+	mutex_enter(&lsp->ls_bc_lock);
+	if (error == 0 && cerror == 0) {
+		lofi_bc_rele(lsp, e);
+	} else {
+		ks->lbk_errors.value.ui64++;
+		lofi_bc_drop(lsp, e);
+	}
+	return (error);
+
+around:
+	if (!isread) {
+		ks->lbk_write_arounds.value.ui64++;
+		around.ba_blkno = blkno;
+		list_insert_tail(&lsp->ls_bc_arounds, &around);
+	}
+	mutex_exit(&lsp->ls_bc_lock);
+
+	error = lofi_bc_io(lsp->ls_vp, isread ? UIO_READ : UIO_WRITE, buf, len,
+	    boff + off);
+
+	mutex_enter(&lsp->ls_bc_lock);
+	if (!isread) {
+		list_remove(&lsp->ls_bc_arounds, &around);
+		cv_broadcast(&lsp->ls_bc_cv);
+	}
+	return (error);
+}
+
+static int
+lofi_bc_rdwr(struct lofi_state *lsp, struct buf *bp, caddr_t bufaddr,
+    offset_t offset, size_t len)
+{
+	boolean_t isread = (bp->b_flags & B_READ) != 0;
+	boolean_t bypass = B_FALSE;
+	uint64_t blkno;
+	size_t off, xfer;
+	int error = 0;
+
+	bp->b_resid = len;
+
+	mutex_enter(&lsp->ls_bc_lock);
+	if (offset == lsp->ls_bc_seq_next)
+		lsp->ls_bc_seq_len += len;
+	else
+		lsp->ls_bc_seq_len = len;
+	lsp->ls_bc_seq_next = offset + len;
+	if (lofi_bcache_seq_bypass != 0 &&
+	    lsp->ls_bc_seq_len > lofi_bcache_seq_bypass) {
+		lsp->ls_bc_stats.lbk_seq_bypass.value.ui64++;
+		bypass = B_TRUE;
+	}
+
+	while (len > 0) {
+		blkno = offset >> lsp->ls_bc_blkshift;
+		off = offset & (LOFI_BC_BLKSZ(lsp) - 1);
+		xfer = MIN(len, LOFI_BC_BLKSZ(lsp) - off);
+		error = lofi_bc_chunk(lsp, isread, bufaddr, blkno, off, xfer,
+		    bypass);
+		if (error != 0)
+			break;
+		bufaddr += xfer;
+		offset += xfer;
+		len -= xfer;
+		bp->b_resid -= xfer;
+	}
+	mutex_exit(&lsp->ls_bc_lock);
+
+	return (error);
+}
+
+/*
+ * Write every dirty block back to the mapped file and make it stable.
+ * This walks all the slots, so a flush does not have to chase blocks
+ * that are redirtied while it runs.
+ */
+static int
+lofi_bc_flush(struct lofi_state *lsp)
+{
+	lofi_bc_kstat_t *ks = &lsp->ls_bc_stats;
+	struct lofi_bc_ent *e;
+	uint32_t i;
+	int error, rv = 0;
+
+	mutex_enter(&lsp->ls_bc_lock);
+	ks->lbk_flushes.value.ui64++;
+	for (i = 0; i < lsp->ls_bc_nslots; i++) {
+		e = &lsp->ls_bc_ents[i];
+		while (e->be_busy)
+			cv_wait(&lsp->ls_bc_cv, &lsp->ls_bc_lock);
+		if (!e->be_dirty)
+			continue;
+
+		e->be_busy = B_TRUE;
+		mutex_exit(&lsp->ls_bc_lock);
+		error = lofi_bc_writeback(lsp, e);
+		mutex_enter(&lsp->ls_bc_lock);
+		if (error == 0) {
+			lofi_bc_set_dirty(lsp, e, B_FALSE);
+			ks->lbk_writebacks.value.ui64++;
+		} else {
+			ks->lbk_errors.value.ui64++;
+			if (rv == 0)
+				rv = error;
+		}
+		lofi_bc_rele(lsp, e);
+	}
+	mutex_exit(&lsp->ls_bc_lock);
+
+	if (rv == 0)
+		rv = VOP_FSYNC(lsp->ls_vp, FSYNC, kcred, NULL);
+	return (rv);
+}
+
+static vnode_t *
+lofi_bc_realvp(vnode_t *vp)
+{
+	vnode_t *realvp;
+
+	if (vp->v_type == VREG && VOP_REALVP(vp, &realvp, NULL) == 0)
+		return (realvp);
+	return (vp);
+}
+
+/*
+ * Is vp in use as a cache by any lofi device?
+ */
+static boolean_t
+lofi_bc_vp_in_use(vnode_t *vp)
+{
+	struct lofi_state *lsp;
+
+	ASSERT(MUTEX_HELD(&lofi_lock));
+
+	vp = lofi_bc_realvp(vp);
+	for (lsp = list_head(&lofi_list); lsp != NULL;
+	    lsp = list_next(&lofi_list, lsp)) {
+		if (lsp->ls_bc_vp != NULL &&
+		    lofi_bc_realvp(lsp->ls_bc_vp) == vp)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+static int
+lofi_bc_init(struct lofi_state *lsp, struct lofi_ioctl *klip, cred_t *credp)
+{
+	lofi_bc_kstat_t *ks = &lsp->ls_bc_stats;
+	vnode_t *vp;
+	vattr_t vattr;
+	uint64_t nslots;
+	uint32_t i, shift, nbuckets;
+	int flag, error;
+
+	ASSERT(MUTEX_HELD(&lofi_lock));
+
+	if (klip->li_cachefile[0] == '\0')
+		return (0);
+
+	/* The cache holds plain blocks of the mapped file. */
+	if (lsp->ls_crypto_enabled || lsp->ls_uncomp_seg_sz != 0)
+		return (ENOTSUP);
+
+	if (!ISP2(lofi_bcache_blksz) || lofi_bcache_blksz < DEV_BSIZE)
+		return (EINVAL);
+	shift = highbit(lofi_bcache_blksz) - 1;
+
+	flag = FREAD | FWRITE | FOFFMAX | FEXCL;
+	error = vn_open(klip->li_cachefile, UIO_SYSSPACE, flag, 0, &vp, 0, 0);
+	if (error != 0)
+		return (error);
+
+	if (!V_ISLOFIABLE(vp->v_type)) {
+		error = EINVAL;
+		goto err;
+	}
+
+	/*
+	 * The cache may not be mapped by any lofi device, including this
+	 * one, nor be another device's cache.
+	 */
+	if (file_to_lofi_nocheck(klip->li_cachefile, B_FALSE, NULL) == 0 ||
+	    lofi_bc_vp_in_use(vp)) {
+		error = EBUSY;
+		goto err;
+	}
+
+	vattr.va_mask = AT_SIZE;
+	if ((error = VOP_GETATTR(vp, &vattr, 0, credp, NULL)) != 0)
+		goto err;
+	nslots = MIN(vattr.va_size >> shift, lofi_bcache_max_slots);
+	if (nslots == 0) {
+		error = EINVAL;
+		goto err;
+	}
+
+	lsp->ls_bc_vp = vp;
+	lsp->ls_bc_openflag = flag;
+	lsp->ls_bc_path = kmem_alloc(strlen(klip->li_cachefile) + 1,
+	    KM_SLEEP);
+	(void) strcpy(lsp->ls_bc_path, klip->li_cachefile);
+	lsp->ls_bc_blkshift = shift;
+	lsp->ls_bc_nslots = (uint32_t)nslots;
+
+	nbuckets = ISP2(nslots) ? nslots : 1U << highbit(nslots);
+	lsp->ls_bc_hashmask = nbuckets - 1;
+	lsp->ls_bc_hash = kmem_zalloc(nbuckets * sizeof (struct lofi_bc_ent *),
+	    KM_SLEEP);
+
+	list_create(&lsp->ls_bc_free, sizeof (struct lofi_bc_ent),
+	    offsetof(struct lofi_bc_ent, be_node));
+	list_create(&lsp->ls_bc_probation, sizeof (struct lofi_bc_ent),
+	    offsetof(struct lofi_bc_ent, be_node));
+	list_create(&lsp->ls_bc_protected, sizeof (struct lofi_bc_ent),
+	    offsetof(struct lofi_bc_ent, be_node));
+	list_create(&lsp->ls_bc_arounds, sizeof (struct lofi_bc_around),
+	    offsetof(struct lofi_bc_around, ba_node));
+
+	lsp->ls_bc_ents = kmem_zalloc(nslots * sizeof (struct lofi_bc_ent),
+	    KM_SLEEP);
+	for (i = 0; i < nslots; i++) {
+		lsp->ls_bc_ents[i].be_slot = i;
+		lsp->ls_bc_ents[i].be_list = LOFI_BC_FREE;
+		list_insert_tail(&lsp->ls_bc_free, &lsp->ls_bc_ents[i]);
+	}
+
+	kstat_named_init(&ks->lbk_read_hits, "read_hits", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_read_misses, "read_misses",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_write_hits, "write_hits", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_write_misses, "write_misses",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_fills, "fills", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_write_allocs, "write_allocs",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_write_arounds, "write_arounds",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_seq_bypass, "seq_bypass", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_evictions, "evictions", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_writebacks, "writebacks", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_flushes, "flushes", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_errors, "errors", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_blocks, "blocks", KSTAT_DATA_UINT64);
+	kstat_named_init(&ks->lbk_dirty, "dirty", KSTAT_DATA_UINT64);
+
+	lsp->ls_bc_kstat = kstat_create_zone(LOFI_DRIVER_NAME,
+	    ddi_get_instance(lsp->ls_dip), "bcache", "misc", KSTAT_TYPE_NAMED,
+	    sizeof (lofi_bc_kstat_t) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL, getzoneid());
+	if (lsp->ls_bc_kstat != NULL) {
+		lsp->ls_bc_kstat->ks_data = ks;
+		lsp->ls_bc_kstat->ks_lock = &lsp->ls_bc_lock;
+		kstat_zone_add(lsp->ls_bc_kstat, GLOBAL_ZONEID);
+		kstat_install(lsp->ls_bc_kstat);
+	}
+	return (0);
+
+err:
+	(void) VOP_CLOSE(vp, flag, 1, 0, credp, NULL);
+	VN_RELE(vp);
+	return (error);
+}
+
+/*
+ * Called from lofi_destroy() once no more I/O can arrive.  Dirty blocks
+ * are written back while the mapped file is still open.
+ */
+static void
+lofi_bc_fini(struct lofi_state *lsp, cred_t *credp)
+{
+	if (lsp->ls_bc_kstat != NULL) {
+		kstat_delete(lsp->ls_bc_kstat);
+		lsp->ls_bc_kstat = NULL;
+	}
+
+	if (lsp->ls_bc_ents != NULL) {
+		if (lsp->ls_vp != NULL && lofi_bc_flush(lsp) != 0) {
+			cmn_err(CE_WARN, "lofi%d: could not write back "
+			    "cached blocks from %s",
+			    ddi_get_instance(lsp->ls_dip), lsp->ls_bc_path);
+		}
+		kmem_free(lsp->ls_bc_ents,
+		    lsp->ls_bc_nslots * sizeof (struct lofi_bc_ent));
+		kmem_free(lsp->ls_bc_hash,
+		    (lsp->ls_bc_hashmask + 1) * sizeof (struct lofi_bc_ent *));
+		list_destroy(&lsp->ls_bc_free);
+		list_destroy(&lsp->ls_bc_probation);
+		list_destroy(&lsp->ls_bc_protected);
+		list_destroy(&lsp->ls_bc_arounds);
+		lsp->ls_bc_ents = NULL;
+		lsp->ls_bc_hash = NULL;
+	}
+
+	if (lsp->ls_bc_vp != NULL) {
+		(void) VOP_PUTPAGE(lsp->ls_bc_vp, 0, 0, B_FREE, credp, NULL);
+		(void) VOP_CLOSE(lsp->ls_bc_vp, lsp->ls_bc_openflag,
+		    1, 0, credp, NULL);
+		VN_RELE(lsp->ls_bc_vp);
+		lsp->ls_bc_vp = NULL;
+	}
+	if (lsp->ls_bc_path != NULL) {
+		kmem_free(lsp->ls_bc_path, strlen(lsp->ls_bc_path) + 1);
+		lsp->ls_bc_path = NULL;
+	}
+}
+
 /*
  * This is basically what strategy used to be before we found we
  * needed task queues.
@@ -1375,9 +2095,17 @@ lofi_strategy_task(void *arg)
 	 * file during this call, which would be a deadlock because
 	 * we have the rw_lock. So instead we page, unless it's not
 	 * mapable or it's a character device or it's an encrypted lofi.
+	 *
+	 * With a block cache attached, a completed write is only as stable
+	 * as one in a disk's volatile write cache, and DKIOCFLUSHWRITECACHE
+	 * makes it durable.  Syncing the mapped file here would cost the
+	 * round trip to slow storage that the cache is there to hide.
 	 */
-	if ((lsp->ls_vp->v_flag & VNOMAP) || (lsp->ls_vp->v_type == VCHR) ||
-	    lsp->ls_crypto_enabled) {
+	if (lsp->ls_bc_vp != NULL) {
+		syncflag = 0;
+		error = lofi_bc_rdwr(lsp, bp, bufaddr, offset, len);
+	} else if ((lsp->ls_vp->v_flag & VNOMAP) ||
+	    (lsp->ls_vp->v_type == VCHR) || lsp->ls_crypto_enabled) {
 		error = lofi_rdwr(bufaddr, offset, bp, lsp, len, RDWR_RAW,
 		    NULL);
 	} else if (lsp->ls_uncomp_seg_sz == 0) {
@@ -1968,6 +2696,8 @@ lofi_online_dev(dev_info_t *dip)
 	mutex_init(&lsp->ls_comp_bufs_lock, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&lsp->ls_kstat_lock, NULL, MUTEX_DRIVER, NULL);
 	mutex_init(&lsp->ls_vp_lock, NULL, MUTEX_DRIVER, NULL);
+	mutex_init(&lsp->ls_bc_lock, NULL, MUTEX_DRIVER, NULL);
+	cv_init(&lsp->ls_bc_cv, NULL, CV_DRIVER, NULL);
 
 	if ((error = lofi_create_minor_nodes(lsp, labeled)) != 0) {
 		lofi_zone_unbind(lsp);
@@ -2007,6 +2737,8 @@ lerr:
 	mutex_destroy(&lsp->ls_kstat_lock);
 	mutex_destroy(&lsp->ls_vp_lock);
 	cv_destroy(&lsp->ls_vp_cv);
+	mutex_destroy(&lsp->ls_bc_lock);
+	cv_destroy(&lsp->ls_bc_cv);
 err:
 	ddi_soft_state_free(lofi_statep, instance);
 	return (error);
@@ -2135,6 +2867,7 @@ copy_in_lofi_ioctl(const struct lofi_ioctl *ulip, struct lofi_ioctl **klipp,
 	klip->li_algorithm[MAXALGLEN-1] = '\0';
 	klip->li_cipher[CRYPTO_MAX_MECH_NAME-1] = '\0';
 	klip->li_iv_cipher[CRYPTO_MAX_MECH_NAME-1] = '\0';
+	klip->li_cachefile[MAXPATHLEN-1] = '\0';
 
 	if (klip->li_id > L_MAXMIN32) {
 		error = EINVAL;
@@ -2887,6 +3620,12 @@ lofi_map_file(dev_t dev, struct lofi_ioctl *ulip, int pickminor,
 		goto err;
 	}
 
+	/* The file may not already be in use as a block cache. */
+	if (lofi_bc_vp_in_use(vp)) {
+		error = EBUSY;
+		goto err;
+	}
+
 	vattr.va_mask = AT_SIZE;
 	error = VOP_GETATTR(vp, &vattr, 0, credp, NULL);
 	if (error)
@@ -2967,6 +3706,9 @@ lofi_map_file(dev_t dev, struct lofi_ioctl *ulip, int pickminor,
 	if ((error = lofi_init_compress(lsp)) != 0)
 		goto err;
 
+	if ((error = lofi_bc_init(lsp, klip, credp)) != 0)
+		goto err;
+
 	fake_disk_geometry(lsp);
 
 	/* For unlabeled lofi add Nblocks and Size */
@@ -3161,6 +3903,9 @@ lofi_get_info(dev_t dev, struct lofi_ioctl *ulip, int which,
 		(void) strlcpy(klip->li_algorithm, lsp->ls_comp_algorithm,
 		    sizeof (klip->li_algorithm));
 		klip->li_crypto_enabled = lsp->ls_crypto_enabled;
+		(void) strlcpy(klip->li_cachefile,
+		    lsp->ls_bc_path != NULL ? lsp->ls_bc_path : "",
+		    sizeof (klip->li_cachefile));
 		mutex_exit(&lofi_lock);
 
 		lofi_copy_devpath(klip);
@@ -3550,6 +4295,24 @@ lofi_ioctl(dev_t dev, int cmd, intptr_t arg, int flag, cred_t *credp,
 		    user_efi.dki_length, (intptr_t)user_efi.dki_data,
 		    flag, credp));
 
+	case DKIOCFLUSHWRITECACHE: {
+		struct dk_callback *dkc = NULL;
+
+		/* Without a block cache, writes are already stable. */
+		if (lsp->ls_bc_vp == NULL)
+			return (ENOTTY);
+
+		if (flag & FKIOCTL)
+			dkc = (void *)arg;
+
+		error = lofi_bc_flush(lsp);
+		if (dkc != NULL && dkc->dkc_callback != NULL) {
+			(*dkc->dkc_callback)(dkc->dkc_cookie, error);
+			return (0);
+		}
+		return (error);
+	}
+
 	default:
 #ifdef DEBUG
 		cmn_err(CE_WARN, "lofi_ioctl: %d is not implemented\n", cmd);
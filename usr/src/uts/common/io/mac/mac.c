@@ -3337,6 +3337,7 @@ mac_prop_check_size(mac_prop_id_t id, uint_t valsize, boolean_t is_range)
 	case MAC_PROP_MTU:
 	case MAC_PROP_LLIMIT:
 	case MAC_PROP_LDECAY:
+	case MAC_PROP_RX_GRO:
 		minsize = sizeof (uint32_t);
 		break;
 	case MAC_PROP_FLOWCTRL:
@@ -3534,6 +3535,20 @@ mac_set_prop(mac_handle_t mh, mac_prop_id_t id, char *name, void *val,
 		break;
 	}
 
+	case MAC_PROP_RX_GRO: {
+		uint32_t gro;
+
+		if (valsize < sizeof (gro) ||
+		    (mip->mi_state_flags & MIS_IS_VNIC))
+			return (EINVAL);
+		bcopy(val, &gro, sizeof (gro));
+		if (gro > 1)
+			return (EINVAL);
+		mip->mi_rx_gro = gro;
+		err = 0;
+		break;
+	}
+
 	case MAC_PROP_ADV_FEC_CAP:
 	case MAC_PROP_EN_FEC_CAP: {
 		link_fec_t fec;
@@ -3627,6 +3642,13 @@ mac_get_prop(mac_handle_t mh, mac_prop_id_t id, char *name, void *val,
 			bcopy(&mip->mi_ldecay, val, sizeof (mip->mi_ldecay));
 		return (0);
 
+	case MAC_PROP_RX_GRO:
+		ASSERT(valsize >= sizeof (uint32_t));
+		if (mip->mi_state_flags & MIS_IS_VNIC)
+			return (EINVAL);
+		bcopy(&mip->mi_rx_gro, val, sizeof (mip->mi_rx_gro));
+		return (0);
+
 	case MAC_PROP_MTU: {
 		uint32_t sdu;
 
@@ -3731,6 +3753,7 @@ mac_prop_info(mac_handle_t mh, mac_prop_id_t id, char *name,
 	case MAC_PROP_PVID:
 	case MAC_PROP_LLIMIT:
 	case MAC_PROP_LDECAY:
+	case MAC_PROP_RX_GRO:
 		return (0);
 
 	case MAC_PROP_MAX_RX_RINGS_AVAIL:
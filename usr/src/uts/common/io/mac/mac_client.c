@@ -3474,49 +3474,6 @@ mac_promisc_remove(mac_promisc_handle_t mph)
 	i_mac_perim_exit(mip);
 }
 
-/*
- * Reference count the number of active Tx threads. MCI_TX_QUIESCE indicates
- * that a control operation wants to quiesce the Tx data flow in which case
- * we return an error. Holding any of the per cpu locks ensures that the
- * mci_tx_flag won't change.
- *
- * 'CPU' must be accessed just once and used to compute the index into the
- * percpu array, and that index must be used for the entire duration of the
- * packet send operation. Note that the thread may be preempted and run on
- * another cpu any time and so we can't use 'CPU' more than once for the
- * operation.
- */
-#define	MAC_TX_TRY_HOLD(mcip, mytx, error)				\
-{									\
-	(error) = 0;							\
-	(mytx) = &(mcip)->mci_tx_pcpu[CPU->cpu_seqid & mac_tx_percpu_cnt]; \
-	mutex_enter(&(mytx)->pcpu_tx_lock);				\
-	if (!((mcip)->mci_tx_flag & MCI_TX_QUIESCE)) {			\
-		(mytx)->pcpu_tx_refcnt++;				\
-	} else {							\
-		(error) = -1;						\
-	}								\
-	mutex_exit(&(mytx)->pcpu_tx_lock);				\
-}
-
-/*
- * Release the reference. If needed, signal any control operation waiting
- * for Tx quiescence. The wait and signal are always done using the
- * mci_tx_pcpu[0]'s lock
- */
-#define	MAC_TX_RELE(mcip, mytx) {					\
-	mutex_enter(&(mytx)->pcpu_tx_lock);				\
-	if (--(mytx)->pcpu_tx_refcnt == 0 &&				\
-	    (mcip)->mci_tx_flag & MCI_TX_QUIESCE) {			\
-		mutex_exit(&(mytx)->pcpu_tx_lock);			\
-		mutex_enter(&(mcip)->mci_tx_pcpu[0].pcpu_tx_lock);	\
-		cv_signal(&(mcip)->mci_tx_cv);				\
-		mutex_exit(&(mcip)->mci_tx_pcpu[0].pcpu_tx_lock);	\
-	} else {							\
-		mutex_exit(&(mytx)->pcpu_tx_lock);			\
-	}								\
-}
-
 /*
  * Send function invoked by MAC clients.
  */
@@ -3583,7 +3540,7 @@ mac_tx(mac_client_handle_t mch, mblk_t *mp_chain, uintptr_t hint,
 	}
 
 	srs_tx = &srs->srs_tx;
-	if (srs_tx->st_mode == SRS_TX_DEFAULT &&
+	if (srs_tx->st_mode == SRS_TX_DEFAULT && srs_tx->st_fq == NULL &&
 	    (srs->srs_state & SRS_ENQUEUED) == 0 &&
 	    mip->mi_nactiveclients == 1 &&
 	    mp_chain->b_next == NULL &&
@@ -3703,7 +3660,12 @@ mac_tx(mac_client_handle_t mch, mblk_t *mp_chain, uintptr_t hint,
 			goto done;
 		}
 
-		cookie = srs_tx->st_func(srs, new_head, hint, flag, ret_mp);
+		if (srs_tx->st_fq != NULL && !(flag & MAC_TX_NO_ENQUEUE)) {
+			cookie = mac_tx_fq(srs, new_head, hint, flag);
+		} else {
+			cookie = srs_tx->st_func(srs, new_head, hint, flag,
+			    ret_mp);
+		}
 	}
 
 done:
@@ -3789,6 +3751,29 @@ mac_tx_is_flow_blocked(mac_client_handle_t mch, mac_tx_cookie_t cookie)
 	return (blocked);
 }
 
+/*
+ * Set the pacing rate, in bytes per second, of the flow that the client
+ * sends with the given fanout hint. This has an effect only when Tx fair
+ * queueing is enabled (mac_tx_fq_enable); a rate of 0 removes the limit.
+ */
+void
+mac_tx_pace(mac_client_handle_t mch, uintptr_t hint, uint64_t rate)
+{
+	mac_client_impl_t *mcip = (mac_client_impl_t *)mch;
+	mac_soft_ring_set_t *mac_srs;
+	mac_tx_percpu_t *mytx;
+	int err;
+
+	MAC_TX_TRY_HOLD(mcip, mytx, err);
+	if (err != 0)
+		return;
+
+	mac_srs = MCIP_TX_SRS(mcip);
+	if (mac_srs != NULL && mac_srs->srs_tx.st_fq != NULL)
+		mac_tx_fq_pace(mac_srs->srs_tx.st_fq, hint, rate);
+	MAC_TX_RELE(mcip, mytx);
+}
+
 /*
  * Check if the MAC client is the primary MAC client.
  */
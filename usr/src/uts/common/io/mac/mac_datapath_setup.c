@@ -3493,6 +3493,10 @@ mac_srs_free(mac_soft_ring_set_t *mac_srs)
 	ASSERT((mac_srs->srs_state & (SRS_CONDEMNED | SRS_CONDEMNED_DONE |
 	    SRS_PROC | SRS_PROC_FAST)) == (SRS_CONDEMNED | SRS_CONDEMNED_DONE));
 
+	if (mac_srs->srs_tx.st_fq != NULL) {
+		mac_tx_fq_destroy(mac_srs->srs_tx.st_fq);
+		mac_srs->srs_tx.st_fq = NULL;
+	}
 	mac_drop_chain(mac_srs->srs_first, "SRS free");
 	mac_srs_ring_free(mac_srs);
 	mac_srs_soft_rings_free(mac_srs);
@@ -4005,6 +4009,8 @@ no_group:
 			break;
 	}
 	tx->st_func = mac_tx_get_func(tx->st_mode);
+	if (mac_tx_fq_enable && tx->st_fq == NULL)
+		tx->st_fq = mac_tx_fq_create(tx_srs);
 	if (is_aggr) {
 		VERIFY(i_mac_capab_get((mac_handle_t)mip,
 		    MAC_CAPAB_AGGR, &tx->st_capab_aggr));
@@ -968,6 +968,7 @@
 
 #include <sys/types.h>
 #include <sys/callb.h>
+#include <sys/callo.h>
 #include <sys/pattr.h>
 #include <sys/sdt.h>
 #include <sys/strsubr.h>
@@ -981,6 +982,7 @@
 #include <inet/ipsecesp.h>
 #include <inet/ipsecah.h>
 #include <inet/ip6.h>
+#include <inet/tcp.h>
 
 #include <sys/mac_impl.h>
 #include <sys/mac_client_impl.h>
@@ -1474,6 +1476,216 @@ enum pkt_type {
  */
 #define	PORTS_SIZE 4
 
+/*
+ * Software receive offload (GRO)
+ *
+ * When enabled on a link (the rx_gro link property), consecutive TCP
+ * segments of the same flow in a chain headed for a TCP soft ring are
+ * merged into a single large packet before they are handed to the soft
+ * ring, so that IP and TCP process one packet (and send one ACK) instead of
+ * several. Only plain in-order data segments are merged:
+ *
+ *	o IPv4 without options or fragmentation,
+ *	o TCP checksum verified by the hardware (HCK_FULLCKSUM_OK),
+ *	o no flags other than ACK, and PSH on the last segment only,
+ *	o same TOS, TTL, ACK, window and TCP options as the first segment,
+ *	o sequence number following on from the previous segment,
+ *	o no larger than the first segment, and smaller only when last.
+ *
+ * The headers of each appended segment are stripped and its payload is
+ * linked to the end of the first segment, whose IP length and header
+ * checksum are updated. Any other packet of a flow ends the merged packet,
+ * so that segments are never reordered. Since the merged packet is larger
+ * than the MTU, GRO must not be enabled on links that forward packets.
+ */
+#define	MAC_GRO_FLOWS	8
+
+typedef struct mac_gro_flow_s {
+	mblk_t		*mgf_head;	/* packet the flow is merged into */
+	mblk_t		*mgf_tail;	/* last mblk of mgf_head */
+	uint32_t	mgf_nxtseq;	/* sequence number of next segment */
+	int		mgf_mss;	/* payload length of first segment */
+	boolean_t	mgf_merged;	/* at least one segment appended */
+} mac_gro_flow_t;
+
+/*
+ * Return the TCP payload length of mp, with the length of its headers in
+ * *hlenp, if it is a candidate for merging; or -1 if it is not.
+ */
+static int
+mac_rx_gro_seglen(mblk_t *mp, uint_t *hlenp)
+{
+	ipha_t		*ipha = (ipha_t *)mp->b_rptr;
+	tcpha_t		*tcpha;
+	uint_t		hlen, iplen;
+
+	if (ipha->ipha_version_and_hdr_length != IP_SIMPLE_HDR_VERSION ||
+	    (ntohs(ipha->ipha_fragment_offset_and_flags) &
+	    (IPH_MF | IPH_OFFSET)) != 0 ||
+	    (DB_CKSUMFLAGS(mp) & HCK_FULLCKSUM_OK) == 0 ||
+	    mp->b_rptr + IP_SIMPLE_HDR_LENGTH + TCP_MIN_HEADER_LENGTH >
+	    mp->b_wptr)
+		return (-1);
+
+	tcpha = (tcpha_t *)&mp->b_rptr[IP_SIMPLE_HDR_LENGTH];
+	hlen = IP_SIMPLE_HDR_LENGTH + TCP_HDR_LENGTH(tcpha);
+	if (hlen < IP_SIMPLE_HDR_LENGTH + TCP_MIN_HEADER_LENGTH ||
+	    mp->b_rptr + hlen > mp->b_wptr ||
+	    (tcpha->tha_flags & ~TH_PUSH) != TH_ACK)
+		return (-1);
+
+	/* Anything beyond the IP length, like padding, would be merged too */
+	iplen = ntohs(ipha->ipha_length);
+	if (iplen <= hlen || iplen != msgdsize(mp))
+		return (-1);
+
+	*hlenp = hlen;
+	return (iplen - hlen);
+}
+
+/*
+ * Append the segment mp, which has been checked by mac_rx_gro_seglen(), to
+ * the packet being built for flow f if it follows on from it.
+ */
+static boolean_t
+mac_rx_gro_merge(mac_gro_flow_t *f, mblk_t *mp, int seglen, uint_t hlen)
+{
+	ipha_t		*hipha = (ipha_t *)f->mgf_head->b_rptr;
+	tcpha_t		*htcpha = (tcpha_t *)&hipha[1];
+	ipha_t		*ipha = (ipha_t *)mp->b_rptr;
+	tcpha_t		*tcpha = (tcpha_t *)&ipha[1];
+	uint_t		len = ntohs(hipha->ipha_length);
+	mblk_t		*cont;
+
+	if (ntohl(tcpha->tha_seq) != f->mgf_nxtseq ||
+	    seglen > f->mgf_mss || len + seglen > IP_MAXPACKET ||
+	    ipha->ipha_type_of_service != hipha->ipha_type_of_service ||
+	    ipha->ipha_ttl != hipha->ipha_ttl ||
+	    ipha->ipha_fragment_offset_and_flags !=
+	    hipha->ipha_fragment_offset_and_flags ||
+	    tcpha->tha_ack != htcpha->tha_ack ||
+	    tcpha->tha_win != htcpha->tha_win ||
+	    tcpha->tha_offset_and_reserved !=
+	    htcpha->tha_offset_and_reserved ||
+	    bcmp(&tcpha[1], &htcpha[1],
+	    hlen - IP_SIMPLE_HDR_LENGTH - sizeof (tcpha_t)) != 0)
+		return (B_FALSE);
+
+	htcpha->tha_flags |= tcpha->tha_flags;
+	hipha->ipha_length = htons(len + seglen);
+	hipha->ipha_hdr_checksum = 0;
+	hipha->ipha_hdr_checksum = (uint16_t)ip_csum_hdr(hipha);
+	f->mgf_nxtseq += seglen;
+
+	mp->b_rptr += hlen;
+	if (mp->b_rptr == mp->b_wptr) {
+		cont = mp->b_cont;
+		freeb(mp);
+		mp = cont;
+	}
+	f->mgf_tail->b_cont = mp;
+	while (mp->b_cont != NULL)
+		mp = mp->b_cont;
+	f->mgf_tail = mp;
+
+	return (B_TRUE);
+}
+
+/*
+ * Merge the segments of the chain headed for a TCP soft ring, as described
+ * above. Returns the number of packets left in the chain and updates the
+ * tail, adjusting the SRS packet count for the segments merged.
+ */
+static int
+mac_rx_srs_gro(mac_soft_ring_set_t *mac_srs, mblk_t *head, mblk_t **tailp,
+    int cnt)
+{
+	mac_gro_flow_t	flows[MAC_GRO_FLOWS];
+	mac_gro_flow_t	*f;
+	mac_rx_stats_t	*stat = &mac_srs->srs_rx.sr_stat;
+	mblk_t		*mp, *next, *prev = NULL;
+	ipha_t		*ipha, *hipha;
+	tcpha_t		*tcpha;
+	uint_t		nflows = 0, evict = 0, hlen, i;
+	int		seglen, segs = 0;
+	boolean_t	push;
+
+	for (mp = head; mp != NULL; mp = next) {
+		next = mp->b_next;
+		ipha = (ipha_t *)mp->b_rptr;
+		tcpha = (tcpha_t *)&ipha[1];
+		seglen = mac_rx_gro_seglen(mp, &hlen);
+
+		/*
+		 * Look for the flow. A packet which cannot be merged ends
+		 * the flow of any packet it may belong to.
+		 */
+		f = NULL;
+		for (i = 0; i < nflows; i++) {
+			hipha = (ipha_t *)flows[i].mgf_head->b_rptr;
+			if (hipha->ipha_src != ipha->ipha_src ||
+			    hipha->ipha_dst != ipha->ipha_dst)
+				continue;
+			if (seglen <= 0) {
+				flows[i--] = flows[--nflows];
+				continue;
+			}
+			if (*(uint32_t *)&hipha[1] == *(uint32_t *)tcpha) {
+				f = &flows[i];
+				break;
+			}
+		}
+		if (seglen <= 0) {
+			prev = mp;
+			continue;
+		}
+
+		push = (tcpha->tha_flags & TH_PUSH) != 0;
+		if (f != NULL && mac_rx_gro_merge(f, mp, seglen, hlen)) {
+			ASSERT(prev != NULL);
+			prev->b_next = next;
+			segs++;
+			if (!f->mgf_merged) {
+				f->mgf_merged = B_TRUE;
+				stat->mrs_gro_merged++;
+			}
+			if (push || seglen < f->mgf_mss)
+				*f = flows[--nflows];
+			continue;
+		}
+
+		/* Start a new merged packet with this segment */
+		if (push) {
+			if (f != NULL)
+				*f = flows[--nflows];
+		} else {
+			if (f == NULL && nflows < MAC_GRO_FLOWS)
+				f = &flows[nflows++];
+			else if (f == NULL)
+				f = &flows[evict++ % MAC_GRO_FLOWS];
+			f->mgf_head = mp;
+			for (f->mgf_tail = mp; f->mgf_tail->b_cont != NULL;
+			    f->mgf_tail = f->mgf_tail->b_cont)
+				;
+			f->mgf_nxtseq = ntohl(tcpha->tha_seq) + seglen;
+			f->mgf_mss = seglen;
+			f->mgf_merged = B_FALSE;
+		}
+		prev = mp;
+	}
+
+	if (segs == 0)
+		return (cnt);
+
+	*tailp = prev;
+	mutex_enter(&mac_srs->srs_lock);
+	MAC_UPDATE_SRS_COUNT_LOCKED(mac_srs, segs);
+	mutex_exit(&mac_srs->srs_lock);
+	stat->mrs_gro_segs += segs;
+
+	return (cnt - segs);
+}
+
 /*
  * This routine delivers packets destined for an SRS into one of the
  * protocol soft rings.
@@ -1505,11 +1717,13 @@ mac_rx_srs_proto_fanout(mac_soft_ring_set_t *mac_srs, mblk_t *head)
 	boolean_t			dls_bypass;
 	boolean_t			is_ether;
 	boolean_t			is_unicast;
+	boolean_t			gro;
 	enum pkt_type			type;
 	mac_client_impl_t		*mcip = mac_srs->srs_mcip;
 
 	is_ether = (mcip->mci_mip->mi_info.mi_nativemedia == DL_ETHER);
 	bw_ctl = ((mac_srs->srs_type & SRST_BW_CONTROL) != 0);
+	gro = (mcip->mci_mip->mi_rx_gro != 0 && !bw_ctl);
 
 	/*
 	 * If we don't have a Rx ring, S/W classification would have done
@@ -1685,6 +1899,11 @@ mac_rx_srs_proto_fanout(mac_soft_ring_set_t *mac_srs, mblk_t *head)
 			switch (type) {
 			case V4_TCP:
 				softring = mac_srs->srs_tcp_soft_rings[0];
+				if (gro) {
+					cnt[type] = mac_rx_srs_gro(mac_srs,
+					    headmp[type], &tailmp[type],
+					    cnt[type]);
+				}
 				break;
 			case V4_UDP:
 				softring = mac_srs->srs_udp_soft_rings[0];
@@ -1921,12 +2140,14 @@ mac_rx_srs_fanout(mac_soft_ring_set_t *mac_srs, mblk_t *head)
 	boolean_t			dls_bypass;
 	boolean_t			is_ether;
 	boolean_t			is_unicast;
+	boolean_t			gro;
 	int				fanout_cnt;
 	enum pkt_type			type;
 	mac_client_impl_t		*mcip = mac_srs->srs_mcip;
 
 	is_ether = (mcip->mci_mip->mi_info.mi_nativemedia == DL_ETHER);
 	bw_ctl = ((mac_srs->srs_type & SRST_BW_CONTROL) != 0);
+	gro = (mcip->mci_mip->mi_rx_gro != 0 && !bw_ctl);
 
 	/*
 	 * If we don't have a Rx ring, S/W classification would have done
@@ -2181,6 +2402,12 @@ mac_rx_srs_fanout(mac_soft_ring_set_t *mac_srs, mblk_t *head)
 				case V4_TCP:
 					softring =
 					    mac_srs->srs_tcp_soft_rings[i];
+					if (gro) {
+						cnt[type][i] = mac_rx_srs_gro(
+						    mac_srs, headmp[type][i],
+						    &tailmp[type][i],
+						    cnt[type][i]);
+					}
 					break;
 				case V4_UDP:
 					softring =
@@ -4016,6 +4243,509 @@ mac_tx_aggr_mode(mac_soft_ring_set_t *mac_srs, mblk_t *mp_chain,
 	return (mac_tx_soft_ring_process(sringp, mp_chain, flag, ret_mp));
 }
 
+/*
+ * Tx fair queueing
+ *
+ * The Tx modes above are FIFO: a burst from one sender is handed to the
+ * ring (or queued in the SRS) ahead of everybody else's traffic, and the
+ * only rate control is the aggregate bandwidth limit of SRS_TX_BW. When
+ * mac_tx_fq_enable is set, mac_tx() instead passes packets through a fair
+ * queueing stage that sits in front of st_func:
+ *
+ * - Each flow, identified by the fanout hint (or a hash of the headers
+ *   when the caller passes no hint), gets its own queue of at most
+ *   mac_tx_fq_flow_limit packets. Packets beyond that are dropped.
+ *
+ * - Active flows are serviced in deficit round robin order, each getting
+ *   mac_tx_fq_quantum bytes per round, so that a bursty sender cannot
+ *   push a long train of packets ahead of the others.
+ *
+ * - A flow may carry a pacing rate, set through mac_tx_pace() (which IP
+ *   calls on behalf of sockets with SO_MAX_PACING_RATE, or TCP's own
+ *   pacing rate). After each packet the flow's next release time is
+ *   advanced by the packet's transmit time at that rate. A flow whose
+ *   release time is in the future is parked on a timer wheel with slots
+ *   of mac_tx_fq_tick nanoseconds, and goes back on the round robin list
+ *   when its slot comes up.
+ *
+ * Only one thread drains the stage at a time (fq_draining), which keeps
+ * the packets of a flow in order; other senders just enqueue and leave
+ * the work to the thread that is draining. The wheel is serviced by
+ * every drain and by a single high resolution callout, which never
+ * sleeps longer than mac_tx_fq_timer_max so that a flow that was parked
+ * while the callout was armed for a later slot is never held up for
+ * long. The callout sends from its own context and so takes a Tx hold
+ * on the client like mac_tx() does; if the client is quiesced, it simply
+ * tries again later. A drain also stops after mac_tx_fq_drain_max
+ * batches, leaving the rest to the callout, so that one sender does not
+ * end up transmitting everybody's traffic for an unbounded time.
+ *
+ * Callers that ask for unsent packets back (MAC_TX_NO_ENQUEUE) bypass
+ * the stage, as the packets handed back could belong to other flows.
+ */
+boolean_t mac_tx_fq_enable = B_FALSE;
+uint32_t mac_tx_fq_flow_limit = 100;
+uint32_t mac_tx_fq_quantum = 2 * 1514;
+uint32_t mac_tx_fq_hash_size = 1024;
+uint32_t mac_tx_fq_max_flows = 8192;
+uint32_t mac_tx_fq_wheel_size = 1024;
+uint32_t mac_tx_fq_drain_max = 64;
+hrtime_t mac_tx_fq_tick = 100 * (NANOSEC / MICROSEC);
+hrtime_t mac_tx_fq_timer_max = NANOSEC / MILLISEC;
+hrtime_t mac_tx_fq_idle = 3 * NANOSEC;
+
+static void mac_tx_fq_timer(void *);
+
+#define	FQ_HASH(fq, key)						\
+	((uint_t)(((key) >> 4) ^ ((key) >> 16)) & ((fq)->fq_hash_size - 1))
+
+mac_tx_fq_t *
+mac_tx_fq_create(mac_soft_ring_set_t *mac_srs)
+{
+	mac_tx_fq_t	*fq;
+
+	fq = kmem_zalloc(sizeof (mac_tx_fq_t), KM_SLEEP);
+	mutex_init(&fq->fq_lock, NULL, MUTEX_DEFAULT, NULL);
+	fq->fq_srs = mac_srs;
+	fq->fq_hash_size = 1 << highbit(mac_tx_fq_hash_size - 1);
+	fq->fq_hash = kmem_zalloc(fq->fq_hash_size * sizeof (mac_fq_flow_t *),
+	    KM_SLEEP);
+	fq->fq_wheel_size = 1 << highbit(mac_tx_fq_wheel_size - 1);
+	fq->fq_wheel = kmem_zalloc(fq->fq_wheel_size *
+	    sizeof (mac_fq_flow_t *), KM_SLEEP);
+	fq->fq_wheel_tick = gethrtime() / mac_tx_fq_tick;
+	return (fq);
+}
+
+void
+mac_tx_fq_destroy(mac_tx_fq_t *fq)
+{
+	mac_fq_flow_t	*fl;
+	callout_id_t	tid;
+	uint_t		i;
+
+	mutex_enter(&fq->fq_lock);
+	fq->fq_condemned = B_TRUE;
+	tid = fq->fq_tid;
+	fq->fq_tid = 0;
+	mutex_exit(&fq->fq_lock);
+	if (tid != 0)
+		(void) untimeout_generic(tid, 0);
+
+	for (i = 0; i < fq->fq_hash_size; i++) {
+		while ((fl = fq->fq_hash[i]) != NULL) {
+			fq->fq_hash[i] = fl->fl_hnext;
+			mac_drop_chain(fl->fl_head, "Tx fq destroy");
+			kmem_free(fl, sizeof (mac_fq_flow_t));
+		}
+	}
+	kmem_free(fq->fq_hash, fq->fq_hash_size * sizeof (mac_fq_flow_t *));
+	kmem_free(fq->fq_wheel, fq->fq_wheel_size * sizeof (mac_fq_flow_t *));
+	mutex_destroy(&fq->fq_lock);
+	kmem_free(fq, sizeof (mac_tx_fq_t));
+}
+
+/*
+ * Free the flows that have been idle for mac_tx_fq_idle; this runs at most
+ * that often. A flow's pacing rate goes with it, but IP refreshes the rate
+ * of a paced connection more often than that, so only flows that really
+ * went away lose theirs.
+ */
+static void
+mac_tx_fq_reclaim(mac_tx_fq_t *fq, hrtime_t now)
+{
+	mac_fq_flow_t	*fl, **flp;
+	uint_t		i;
+
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+
+	fq->fq_gc_time = now;
+	for (i = 0; i < fq->fq_hash_size; i++) {
+		flp = &fq->fq_hash[i];
+		while ((fl = *flp) != NULL) {
+			if (fl->fl_state == FQ_FLOW_IDLE &&
+			    now - fl->fl_last > mac_tx_fq_idle) {
+				ASSERT(fl->fl_head == NULL);
+				*flp = fl->fl_hnext;
+				kmem_free(fl, sizeof (mac_fq_flow_t));
+				fq->fq_nflows--;
+			} else {
+				flp = &fl->fl_hnext;
+			}
+		}
+	}
+}
+
+static mac_fq_flow_t *
+mac_tx_fq_lookup(mac_tx_fq_t *fq, uintptr_t key, uintptr_t hint, hrtime_t now)
+{
+	mac_fq_flow_t	*fl;
+	uint_t		idx = FQ_HASH(fq, key);
+
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+
+	for (fl = fq->fq_hash[idx]; fl != NULL; fl = fl->fl_hnext) {
+		if (fl->fl_key == key)
+			return (fl);
+	}
+
+	if (fq->fq_nflows >= mac_tx_fq_max_flows)
+		return (NULL);
+	if ((fl = kmem_zalloc(sizeof (mac_fq_flow_t), KM_NOSLEEP)) == NULL)
+		return (NULL);
+	fl->fl_key = key;
+	fl->fl_hint = hint;
+	fl->fl_last = now;
+	fl->fl_hnext = fq->fq_hash[idx];
+	fq->fq_hash[idx] = fl;
+	fq->fq_nflows++;
+	return (fl);
+}
+
+static void
+mac_tx_fq_activate(mac_tx_fq_t *fq, mac_fq_flow_t *fl)
+{
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+	ASSERT(fl->fl_state != FQ_FLOW_ACTIVE);
+
+	fl->fl_state = FQ_FLOW_ACTIVE;
+	fl->fl_next = NULL;
+	if (fq->fq_active_tail == NULL)
+		fq->fq_active = fl;
+	else
+		fq->fq_active_tail->fl_next = fl;
+	fq->fq_active_tail = fl;
+}
+
+/*
+ * Park a flow on the wheel until fl_time. Times beyond the end of the
+ * wheel go in its last slot and are simply parked again when it comes up.
+ */
+static void
+mac_tx_fq_throttle(mac_tx_fq_t *fq, mac_fq_flow_t *fl, hrtime_t now)
+{
+	int64_t		tick;
+
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+
+	if (fq->fq_throttled == 0)
+		fq->fq_wheel_tick = now / mac_tx_fq_tick;
+	tick = fl->fl_time / mac_tx_fq_tick;
+	if (tick < fq->fq_wheel_tick)
+		tick = fq->fq_wheel_tick;
+	else if (tick >= fq->fq_wheel_tick + fq->fq_wheel_size)
+		tick = fq->fq_wheel_tick + fq->fq_wheel_size - 1;
+
+	fl->fl_state = FQ_FLOW_THROTTLED;
+	fl->fl_next = fq->fq_wheel[tick & (fq->fq_wheel_size - 1)];
+	fq->fq_wheel[tick & (fq->fq_wheel_size - 1)] = fl;
+	fq->fq_throttled++;
+	SRS_TX_STAT_UPDATE(fq->fq_srs, fq_throttled, 1);
+}
+
+/*
+ * Move the flows whose release time has come from the wheel back to the
+ * round robin list. At most one revolution is serviced per call; flows in
+ * slots skipped over are found on the next revolution, and are never
+ * released early since fl_time is checked again.
+ */
+static void
+mac_tx_fq_wheel_advance(mac_tx_fq_t *fq, hrtime_t now)
+{
+	int64_t		nowtick = now / mac_tx_fq_tick;
+	mac_fq_flow_t	*fl, *next;
+	uint_t		n;
+
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+
+	for (n = 0; n < fq->fq_wheel_size && fq->fq_throttled != 0 &&
+	    fq->fq_wheel_tick <= nowtick; n++) {
+		uint_t slot = fq->fq_wheel_tick & (fq->fq_wheel_size - 1);
+
+		fl = fq->fq_wheel[slot];
+		fq->fq_wheel[slot] = NULL;
+		fq->fq_wheel_tick++;
+		for (; fl != NULL; fl = next) {
+			next = fl->fl_next;
+			fq->fq_throttled--;
+			if (fl->fl_time <= now) {
+				fl->fl_state = FQ_FLOW_IDLE;
+				mac_tx_fq_activate(fq, fl);
+			} else {
+				mac_tx_fq_throttle(fq, fl, now);
+			}
+		}
+	}
+	if (fq->fq_wheel_tick <= nowtick)
+		fq->fq_wheel_tick = nowtick + 1;
+}
+
+/*
+ * Take the next batch of packets off the round robin list: up to the
+ * deficit of the flow at its head, and only as far as its pacing rate
+ * allows. Returns NULL once no flow has anything to send.
+ */
+static mblk_t *
+mac_tx_fq_dequeue(mac_tx_fq_t *fq, hrtime_t now, uintptr_t *hintp)
+{
+	mac_fq_flow_t	*fl;
+	mblk_t		*head = NULL, *tail = NULL, *mp;
+	size_t		sz;
+
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+
+	while ((fl = fq->fq_active) != NULL) {
+		if (fl->fl_deficit <= 0) {
+			/* Next round for this flow */
+			fl->fl_deficit += mac_tx_fq_quantum;
+			if (fl->fl_next != NULL) {
+				fq->fq_active = fl->fl_next;
+				fl->fl_next = NULL;
+				fq->fq_active_tail->fl_next = fl;
+				fq->fq_active_tail = fl;
+			}
+			continue;
+		}
+
+		while ((mp = fl->fl_head) != NULL && fl->fl_deficit > 0) {
+			if (fl->fl_rate != 0 && fl->fl_time > now)
+				break;
+			if ((fl->fl_head = mp->b_next) == NULL)
+				fl->fl_tail = NULL;
+			mp->b_next = NULL;
+			mp->b_prev = NULL;
+			fl->fl_cnt--;
+
+			sz = msgdsize(mp);
+			fl->fl_deficit -= sz;
+			if (fl->fl_rate != 0) {
+				fl->fl_time = MAX(fl->fl_time, now) +
+				    (hrtime_t)(sz * NANOSEC / fl->fl_rate);
+			}
+			if (tail == NULL)
+				head = mp;
+			else
+				tail->b_next = mp;
+			tail = mp;
+		}
+
+		if (fl->fl_head == NULL || fl->fl_deficit <= 0 ||
+		    (fl->fl_rate != 0 && fl->fl_time > now)) {
+			fq->fq_active = fl->fl_next;
+			if (fq->fq_active == NULL)
+				fq->fq_active_tail = NULL;
+			fl->fl_next = NULL;
+			if (fl->fl_head == NULL) {
+				fl->fl_state = FQ_FLOW_IDLE;
+				fl->fl_deficit = 0;
+			} else if (fl->fl_deficit > 0) {
+				mac_tx_fq_throttle(fq, fl, now);
+			} else {
+				/* Quantum used up, back of the line */
+				fl->fl_state = FQ_FLOW_IDLE;
+				mac_tx_fq_activate(fq, fl);
+			}
+		}
+		if (head != NULL) {
+			*hintp = fl->fl_hint;
+			return (head);
+		}
+	}
+	return (NULL);
+}
+
+/*
+ * Arm the release callout for the first occupied wheel slot, looking no
+ * further than mac_tx_fq_timer_max ahead.
+ */
+static void
+mac_tx_fq_arm(mac_tx_fq_t *fq, hrtime_t now)
+{
+	hrtime_t	delta;
+	int64_t		tick;
+
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+
+	if (fq->fq_tid != 0 || fq->fq_condemned)
+		return;
+
+	if (fq->fq_active != NULL) {
+		delta = mac_tx_fq_tick;
+	} else if (fq->fq_throttled != 0) {
+		delta = mac_tx_fq_timer_max;
+		for (tick = fq->fq_wheel_tick;
+		    (tick - fq->fq_wheel_tick) * mac_tx_fq_tick <
+		    mac_tx_fq_timer_max; tick++) {
+			if (fq->fq_wheel[tick & (fq->fq_wheel_size - 1)] !=
+			    NULL) {
+				delta = MAX(tick * mac_tx_fq_tick - now,
+				    mac_tx_fq_tick);
+				break;
+			}
+		}
+	} else {
+		return;
+	}
+	fq->fq_tid = timeout_generic(CALLOUT_NORMAL, mac_tx_fq_timer, fq,
+	    delta, mac_tx_fq_tick, 0);
+}
+
+/*
+ * Hand everything that is eligible down to st_func. Called, and returns,
+ * with fq_lock held, which is dropped around the calls to st_func.
+ */
+static mac_tx_cookie_t
+mac_tx_fq_drain(mac_soft_ring_set_t *mac_srs, mac_tx_fq_t *fq, uint16_t flag)
+{
+	mac_srs_tx_t	*srs_tx = &mac_srs->srs_tx;
+	mac_tx_cookie_t	cookie = 0, ck;
+	mblk_t		*chain;
+	uintptr_t	hint;
+	hrtime_t	now;
+	uint_t		n;
+
+	ASSERT(MUTEX_HELD(&fq->fq_lock));
+
+	if (fq->fq_draining)
+		return (0);
+	fq->fq_draining = B_TRUE;
+	for (n = 0; n < mac_tx_fq_drain_max; n++) {
+		now = gethrtime();
+		mac_tx_fq_wheel_advance(fq, now);
+		if ((chain = mac_tx_fq_dequeue(fq, now, &hint)) == NULL)
+			break;
+		mutex_exit(&fq->fq_lock);
+		ck = srs_tx->st_func(mac_srs, chain, hint, flag, NULL);
+		if (ck != 0)
+			cookie = ck;
+		mutex_enter(&fq->fq_lock);
+	}
+	fq->fq_draining = B_FALSE;
+	return (cookie);
+}
+
+/*
+ * The release callout. fq_tid stays set while it runs, so that nobody
+ * else arms another one and mac_tx_fq_destroy() waits for it to finish.
+ */
+static void
+mac_tx_fq_timer(void *arg)
+{
+	mac_tx_fq_t		*fq = arg;
+	mac_soft_ring_set_t	*mac_srs = fq->fq_srs;
+	mac_client_impl_t	*mcip = mac_srs->srs_mcip;
+	mac_tx_percpu_t		*mytx;
+	int			error;
+
+	mutex_enter(&fq->fq_lock);
+	if (fq->fq_condemned) {
+		mutex_exit(&fq->fq_lock);
+		return;
+	}
+	SRS_TX_STAT_UPDATE(mac_srs, fq_timer, 1);
+	mutex_exit(&fq->fq_lock);
+
+	/* If Tx is quiesced, just come back later */
+	MAC_TX_TRY_HOLD(mcip, mytx, error);
+
+	mutex_enter(&fq->fq_lock);
+	if (error == 0)
+		(void) mac_tx_fq_drain(mac_srs, fq, 0);
+	fq->fq_tid = 0;
+	mac_tx_fq_arm(fq, gethrtime());
+	mutex_exit(&fq->fq_lock);
+
+	if (error == 0)
+		MAC_TX_RELE(mcip, mytx);
+}
+
+/*
+ * Entry point from mac_tx(). Queue each packet on its flow and drain
+ * whatever is eligible, unless another thread is already draining.
+ */
+mac_tx_cookie_t
+mac_tx_fq(mac_soft_ring_set_t *mac_srs, mblk_t *mp_chain,
+    uintptr_t fanout_hint, uint16_t flag)
+{
+	mac_tx_fq_t	*fq = mac_srs->srs_tx.st_fq;
+	mac_fq_flow_t	*fl = NULL;
+	mac_tx_cookie_t	cookie;
+	mblk_t		*mp, *next;
+	uintptr_t	key;
+	uint_t		media;
+	hrtime_t	now;
+
+	if (fanout_hint == 0) {
+		/*
+		 * Compute the flow of each packet before taking the lock;
+		 * the key is kept in b_prev until the packet is queued.
+		 */
+		media = mac_srs->srs_mcip->mci_mip->mi_info.mi_media;
+		for (mp = mp_chain; mp != NULL; mp = mp->b_next) {
+			mp->b_prev = (mblk_t *)(uintptr_t)mac_pkt_hash(media,
+			    mp, MAC_PKT_HASH_L4, B_TRUE);
+		}
+	}
+
+	now = gethrtime();
+	mutex_enter(&fq->fq_lock);
+	if (now - fq->fq_gc_time > mac_tx_fq_idle)
+		mac_tx_fq_reclaim(fq, now);
+	for (mp = mp_chain; mp != NULL; mp = next) {
+		next = mp->b_next;
+		mp->b_next = NULL;
+		key = fanout_hint != 0 ? fanout_hint : (uintptr_t)mp->b_prev;
+		mp->b_prev = NULL;
+
+		if (fl == NULL || fl->fl_key != key)
+			fl = mac_tx_fq_lookup(fq, key, fanout_hint, now);
+		if (fl == NULL || fl->fl_cnt >= mac_tx_fq_flow_limit) {
+			SRS_TX_STAT_UPDATE(mac_srs, fq_drops, 1);
+			mac_drop_pkt(mp, "Tx fq flow limit");
+			continue;
+		}
+
+		if (fl->fl_tail == NULL)
+			fl->fl_head = mp;
+		else
+			fl->fl_tail->b_next = mp;
+		fl->fl_tail = mp;
+		fl->fl_cnt++;
+		fl->fl_last = now;
+		if (fl->fl_state == FQ_FLOW_IDLE) {
+			fl->fl_deficit = mac_tx_fq_quantum;
+			mac_tx_fq_activate(fq, fl);
+		}
+	}
+	cookie = 0;
+	if (!fq->fq_draining) {
+		cookie = mac_tx_fq_drain(mac_srs, fq, flag);
+		mac_tx_fq_arm(fq, gethrtime());
+	}
+	mutex_exit(&fq->fq_lock);
+	return (cookie);
+}
+
+/*
+ * Set the pacing rate, in bytes per second, of the flow with the given
+ * fanout hint. A rate of 0 removes any pacing.
+ */
+void
+mac_tx_fq_pace(mac_tx_fq_t *fq, uintptr_t fanout_hint, uint64_t rate)
+{
+	mac_fq_flow_t	*fl;
+
+	if (fanout_hint == 0)
+		return;
+
+	mutex_enter(&fq->fq_lock);
+	if ((fl = mac_tx_fq_lookup(fq, fanout_hint, fanout_hint,
+	    gethrtime())) != NULL) {
+		fl->fl_rate = rate;
+	}
+	mutex_exit(&fq->fq_lock);
+}
+
 void
 mac_tx_invoke_callbacks(mac_client_impl_t *mcip, mac_tx_cookie_t cookie)
 {
@@ -65,7 +65,12 @@ enum mac_stat {
 	MAC_STAT_MULTIRCVBYTES,
 	MAC_STAT_BRDCSTRCVBYTES,
 	MAC_STAT_MULTIXMTBYTES,
-	MAC_STAT_BRDCSTXMTBYTES
+	MAC_STAT_BRDCSTXMTBYTES,
+	MAC_STAT_GRO_SEGS,
+	MAC_STAT_GRO_MERGED,
+	MAC_STAT_FQ_DROPS,
+	MAC_STAT_FQ_THROTTLED,
+	MAC_STAT_FQ_TIMER
 };
 
 static mac_stat_info_t	i_mac_si[] = {
@@ -138,7 +143,10 @@ static mac_stat_info_t  i_mac_tx_swlane_si[] = {
 	{ MAC_STAT_OERRORS,	"oerrors",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_BLOCK,	"blockcnt",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_UNBLOCK,	"unblockcnt",	KSTAT_DATA_UINT64,	0},
-	{ MAC_STAT_TXSDROPS,	"txsdrops",	KSTAT_DATA_UINT64,	0}
+	{ MAC_STAT_TXSDROPS,	"txsdrops",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_FQ_DROPS,	"fq_drops",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_FQ_THROTTLED, "fq_throttled", KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_FQ_TIMER,	"fq_timer",	KSTAT_DATA_UINT64,	0}
 };
 #define	MAC_TX_SWLANE_NKSTAT \
 	(sizeof (i_mac_tx_swlane_si) / sizeof (mac_stat_info_t))
@@ -153,7 +161,9 @@ static mac_stat_info_t  i_mac_rx_swlane_si[] = {
 	{ MAC_STAT_LCLBYTES,	"localbytes",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_INTRS,	"intrs",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_INTRBYTES,	"intrbytes",	KSTAT_DATA_UINT64,	0},
-	{ MAC_STAT_RXSDROPS,	"rxsdrops",	KSTAT_DATA_UINT64,	0}
+	{ MAC_STAT_RXSDROPS,	"rxsdrops",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_GRO_SEGS,	"gro_segs",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_GRO_MERGED,	"gro_merged",	KSTAT_DATA_UINT64,	0}
 };
 #define	MAC_RX_SWLANE_NKSTAT \
 	(sizeof (i_mac_rx_swlane_si) / sizeof (mac_stat_info_t))
@@ -171,7 +181,9 @@ static mac_stat_info_t  i_mac_rx_hwlane_si[] = {
 	{ MAC_STAT_RXSDROPS,	"rxsdrops",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_CHU10,	"chainunder10",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_CH10T50,	"chain10to50",	KSTAT_DATA_UINT64,	0},
-	{ MAC_STAT_CHO50,	"chainover50",	KSTAT_DATA_UINT64,	0}
+	{ MAC_STAT_CHO50,	"chainover50",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_GRO_SEGS,	"gro_segs",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_GRO_MERGED,	"gro_merged",	KSTAT_DATA_UINT64,	0}
 };
 #define	MAC_RX_HWLANE_NKSTAT \
 	(sizeof (i_mac_rx_hwlane_si) / sizeof (mac_stat_info_t))
@@ -206,6 +218,8 @@ static mac_stat_info_t  i_mac_misc_si[] = {
 	{ MAC_STAT_CHU10,	"chainunder10",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_CH10T50,	"chain10to50",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_CHO50,	"chainover50",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_GRO_SEGS,	"gro_segs",	KSTAT_DATA_UINT64,	0},
+	{ MAC_STAT_GRO_MERGED,	"gro_merged",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_OBYTES,	"obytes",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_OPACKETS,	"opackets",	KSTAT_DATA_UINT64,	0},
 	{ MAC_STAT_OERRORS,	"oerrors",	KSTAT_DATA_UINT64,	0},
@@ -260,7 +274,9 @@ static stat_info_t rx_srs_stats_list[] = {
 	{RX_SRS_STAT_OFF(mrs_chaincntundr10)},
 	{RX_SRS_STAT_OFF(mrs_chaincnt10to50)},
 	{RX_SRS_STAT_OFF(mrs_chaincntover50)},
-	{RX_SRS_STAT_OFF(mrs_ierrors)}
+	{RX_SRS_STAT_OFF(mrs_ierrors)},
+	{RX_SRS_STAT_OFF(mrs_gro_segs)},
+	{RX_SRS_STAT_OFF(mrs_gro_merged)}
 };
 #define	RX_SRS_STAT_SIZE		\
 	(sizeof (rx_srs_stats_list) / sizeof (stat_info_t))
@@ -273,6 +289,9 @@ static stat_info_t tx_softring_stats_list[] = {
 	{TX_SOFTRING_STAT_OFF(mts_blockcnt)},
 	{TX_SOFTRING_STAT_OFF(mts_unblockcnt)},
 	{TX_SOFTRING_STAT_OFF(mts_sdrops)},
+	{TX_SOFTRING_STAT_OFF(mts_fq_drops)},
+	{TX_SOFTRING_STAT_OFF(mts_fq_throttled)},
+	{TX_SOFTRING_STAT_OFF(mts_fq_timer)},
 };
 #define	TX_SOFTRING_STAT_SIZE		\
 	(sizeof (tx_softring_stats_list) / sizeof (stat_info_t))
@@ -517,6 +536,15 @@ i_mac_tx_swlane_stat_get(void *handle, uint_t stat)
 	case MAC_STAT_TXSDROPS:
 		return (mac_tx_stat->mts_sdrops);
 
+	case MAC_STAT_FQ_DROPS:
+		return (mac_tx_stat->mts_fq_drops);
+
+	case MAC_STAT_FQ_THROTTLED:
+		return (mac_tx_stat->mts_fq_throttled);
+
+	case MAC_STAT_FQ_TIMER:
+		return (mac_tx_stat->mts_fq_timer);
+
 	default:
 		return (0);
 	}
@@ -575,6 +603,12 @@ i_mac_rx_swlane_stat_get(void *handle, uint_t stat)
 	case MAC_STAT_RXSDROPS:
 		return (mac_rx_stat->mrs_sdrops);
 
+	case MAC_STAT_GRO_SEGS:
+		return (mac_rx_stat->mrs_gro_segs);
+
+	case MAC_STAT_GRO_MERGED:
+		return (mac_rx_stat->mrs_gro_merged);
+
 	default:
 		return (0);
 	}
@@ -643,6 +677,12 @@ i_mac_rx_hwlane_stat_get(void *handle, uint_t stat)
 	case MAC_STAT_CHO50:
 		return (mac_rx_stat->mrs_chaincntover50);
 
+	case MAC_STAT_GRO_SEGS:
+		return (mac_rx_stat->mrs_gro_segs);
+
+	case MAC_STAT_GRO_MERGED:
+		return (mac_rx_stat->mrs_gro_merged);
+
 	default:
 		return (0);
 	}
@@ -769,6 +809,12 @@ i_mac_misc_stat_get(void *handle, uint_t stat)
 	case MAC_STAT_CHO50:
 		return (mac_rx_stat->mrs_chaincntover50);
 
+	case MAC_STAT_GRO_SEGS:
+		return (mac_rx_stat->mrs_gro_segs);
+
+	case MAC_STAT_GRO_MERGED:
+		return (mac_rx_stat->mrs_gro_merged);
+
 	case MAC_STAT_OBYTES:
 		return (mac_tx_stat->mts_obytes);
 
@@ -80,6 +80,23 @@
  * command back.
  *
  *
+ * Hybrid Polling:
+ *
+ * With the io-poll-usec property set, a thread submitting a read or write
+ * spins on the completion queue for a while before leaving the command to
+ * the interrupt, which saves the interrupt and taskq wakeup latency on fast
+ * devices. Completions of other commands found while spinning are handed to
+ * the command taskq as usual, but the poller's own command is completed
+ * right away in its context. The time spent spinning adapts to the device:
+ * each completion queue keeps a moving average of the latency of its reads
+ * and writes, and a poller gives up after twice that, or after io-poll-usec,
+ * whichever comes first. A queue whose average latency exceeds io-poll-usec
+ * is not polled until it comes down again. Only one thread polls a queue at
+ * a time, and commands submitted from interrupt context, from the command
+ * taskq or from within a poller's own completion are never polled. Hits and
+ * misses and the average latency are exported in a kstat per queue.
+ *
+ *
  * Namespace Support:
  *
  * NVMe devices can have multiple namespaces, each being a independent data
@@ -185,11 +202,11 @@
  *
  * If both nq_mutex and ncq_mutex need to be held, ncq_mutex must be
  * acquired first. More than one nq_mutex is never held by a single thread.
- * The ncq_mutex is only held by nvme_retrieve_cmd() and
- * nvme_process_iocq(). nvme_process_iocq() is only called from the
- * interrupt thread and nvme_retrieve_cmd() during polled I/O, so the
- * mutex is non-contentious but is required for implementation completeness
- * and safety.
+ * The ncq_mutex is only held by nvme_retrieve_cmd(), nvme_process_iocq() and
+ * nvme_poll_iocq(). nvme_process_iocq() is only called from the interrupt
+ * thread, nvme_retrieve_cmd() during polled I/O, and nvme_poll_iocq() by
+ * threads doing hybrid polling, of which there is at most one per queue, so
+ * the mutex is only lightly contended.
  *
  * Each minor node has its own nm_mutex, which protects the open count nm_ocnt
  * and exclusive-open flag nm_oexcl.
@@ -248,6 +265,8 @@
  * - max-completion-queues: the maximum number of I/O completion queues,
  *   can be less than max-submission-queues, in which case the completion
  *   queues are shared.
+ * - io-poll-usec: the longest time in microseconds a thread submitting a read
+ *   or write spins waiting for it to complete (0-1000), 0 disables polling
  *
  *
  * TODO:
@@ -290,6 +309,8 @@
 #include <sys/policy.h>
 #include <sys/list.h>
 #include <sys/dkio.h>
+#include <sys/kstat.h>
+#include <sys/cpu.h>
 
 #include <sys/nvme.h>
 
@@ -358,6 +379,7 @@ static int nvme_submit_io_cmd(nvme_qpair_t *, nvme_cmd_t *);
 static void nvme_submit_cmd_common(nvme_qpair_t *, nvme_cmd_t *);
 static nvme_cmd_t *nvme_unqueue_cmd(nvme_t *, nvme_qpair_t *, int);
 static nvme_cmd_t *nvme_retrieve_cmd(nvme_t *, nvme_qpair_t *);
+static void nvme_poll_iocq(nvme_t *, nvme_cq_t *, nvme_cmd_t *);
 static void nvme_wait_cmd(nvme_cmd_t *, uint_t);
 static void nvme_wakeup_cmd(void *);
 static void nvme_async_event_task(void *);
@@ -852,6 +874,9 @@ fail:
 static void
 nvme_free_cq(nvme_cq_t *cq)
 {
+	if (cq->ncq_ksp != NULL)
+		kstat_delete(cq->ncq_ksp);
+
 	mutex_destroy(&cq->ncq_mutex);
 
 	if (cq->ncq_cmd_taskq != NULL)
@@ -901,6 +926,59 @@ nvme_destroy_cq_array(nvme_t *nvme, uint_t start)
 	kmem_free(nvme->n_cq, sizeof (*nvme->n_cq) * nvme->n_cq_count);
 }
 
+static int
+nvme_cq_kstat_update(kstat_t *ksp, int rw)
+{
+	nvme_cq_t *cq = ksp->ks_private;
+	nvme_cq_kstat_t *ck = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	ck->nck_poll_hits.value.ui64 = cq->ncq_poll_hits;
+	ck->nck_poll_misses.value.ui64 = cq->ncq_poll_misses;
+	ck->nck_poll_skips.value.ui64 = cq->ncq_poll_skips;
+	ck->nck_polled.value.ui64 = cq->ncq_polled;
+	ck->nck_intr.value.ui64 = cq->ncq_intr;
+	ck->nck_latency.value.ui64 = cq->ncq_lat;
+
+	return (0);
+}
+
+/*
+ * Create the hybrid polling kstat of an I/O completion queue.
+ */
+static void
+nvme_cq_kstat_create(nvme_t *nvme, nvme_cq_t *cq)
+{
+	nvme_cq_kstat_t *ck;
+	char name[KSTAT_STRLEN];
+
+	(void) snprintf(name, sizeof (name), "cq%u", cq->ncq_id);
+	cq->ncq_ksp = kstat_create(ddi_driver_name(nvme->n_dip),
+	    ddi_get_instance(nvme->n_dip), name, "misc", KSTAT_TYPE_NAMED,
+	    sizeof (nvme_cq_kstat_t) / sizeof (kstat_named_t), 0);
+	if (cq->ncq_ksp == NULL) {
+		dev_err(nvme->n_dip, CE_WARN, "!failed to create kstat for "
+		    "cq %u", cq->ncq_id);
+		return;
+	}
+
+	ck = cq->ncq_ksp->ks_data;
+	kstat_named_init(&ck->nck_poll_hits, "poll_hits", KSTAT_DATA_UINT64);
+	kstat_named_init(&ck->nck_poll_misses, "poll_misses",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ck->nck_poll_skips, "poll_skips", KSTAT_DATA_UINT64);
+	kstat_named_init(&ck->nck_polled, "polled_completions",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&ck->nck_intr, "intr_completions", KSTAT_DATA_UINT64);
+	kstat_named_init(&ck->nck_latency, "avg_latency_ns", KSTAT_DATA_UINT64);
+
+	cq->ncq_ksp->ks_private = cq;
+	cq->ncq_ksp->ks_update = nvme_cq_kstat_update;
+	kstat_install(cq->ncq_ksp);
+}
+
 static int
 nvme_alloc_cq(nvme_t *nvme, uint32_t nentry, nvme_cq_t **cqp, uint16_t idx,
     uint_t nthr)
@@ -935,6 +1013,9 @@ nvme_alloc_cq(nvme_t *nvme, uint32_t nentry, nvme_cq_t **cqp, uint16_t idx,
 		goto fail;
 	}
 
+	if (idx > 0)
+		nvme_cq_kstat_create(nvme, cq);
+
 	*cqp = cq;
 	return (DDI_SUCCESS);
 
@@ -1194,6 +1275,14 @@ nvme_get_completed(nvme_t *nvme, nvme_cq_t *cq)
 
 	qp->nq_sqhead = cqe->cqe_sqhd;
 
+	/* Feed the moving average latency used for hybrid polling. */
+	if (cmd->nc_submit != 0) {
+		hrtime_t lat = gethrtime() - cmd->nc_submit;
+
+		cq->ncq_lat = cq->ncq_lat == 0 ? lat :
+		    cq->ncq_lat + (lat - cq->ncq_lat) / NVME_POLL_LAT_WEIGHT;
+	}
+
 	cq->ncq_head = (cq->ncq_head + 1) % cq->ncq_nentry;
 
 	/* Toggle phase on wrap-around. */
@@ -1233,6 +1322,7 @@ nvme_process_iocq(nvme_t *nvme, nvme_cq_t *cq)
 		 */
 		head.b.cqhdbl_cqh = cq->ncq_head;
 		nvme_put32(nvme, cq->ncq_hdbl, head.r);
+		cq->ncq_intr += completed;
 	}
 
 	mutex_exit(&cq->ncq_mutex);
@@ -1240,6 +1330,83 @@ nvme_process_iocq(nvme_t *nvme, nvme_cq_t *cq)
 	return (completed);
 }
 
+/*
+ * Spin on the completion queue of a just submitted I/O command until it
+ * completes, or until the polling budget is used up, in which case the
+ * command is left to the interrupt. See "Hybrid Polling" above.
+ */
+static void
+nvme_poll_iocq(nvme_t *nvme, nvme_cq_t *cq, nvme_cmd_t *mine)
+{
+	nvme_reg_cqhdbl_t head = { 0 };
+	hrtime_t limit, deadline;
+	nvme_cmd_t *cmd;
+	uint_t completed;
+	boolean_t hit = B_FALSE;
+
+	limit = USEC2NSEC(nvme->n_io_poll_usec);
+
+	mutex_enter(&cq->ncq_mutex);
+	if (cq->ncq_lat > limit || cq->ncq_poller != NULL) {
+		cq->ncq_poll_skips++;
+		mutex_exit(&cq->ncq_mutex);
+		return;
+	}
+	cq->ncq_poller = curthread;
+	deadline = gethrtime() +
+	    (cq->ncq_lat == 0 ? limit : MIN(cq->ncq_lat * 2, limit));
+	mutex_exit(&cq->ncq_mutex);
+
+	/*
+	 * The command may already have completed and been freed, so it is
+	 * only ever compared against, never looked at, until we find it.
+	 */
+	for (;;) {
+		if (ddi_dma_sync(cq->ncq_dma->nd_dmah, 0, 0,
+		    DDI_DMA_SYNC_FORKERNEL) != DDI_SUCCESS)
+			dev_err(nvme->n_dip, CE_WARN,
+			    "!ddi_dma_sync() failed in %s", __func__);
+
+		completed = 0;
+		mutex_enter(&cq->ncq_mutex);
+		while ((cmd = nvme_get_completed(nvme, cq)) != NULL) {
+			completed++;
+			if (cmd == mine) {
+				hit = B_TRUE;
+				continue;
+			}
+			taskq_dispatch_ent(cq->ncq_cmd_taskq, cmd->nc_callback,
+			    cmd, TQ_NOSLEEP, &cmd->nc_tqent);
+		}
+		if (completed > 0) {
+			head.b.cqhdbl_cqh = cq->ncq_head;
+			nvme_put32(nvme, cq->ncq_hdbl, head.r);
+			cq->ncq_polled += completed;
+		}
+		mutex_exit(&cq->ncq_mutex);
+
+		if (hit || nvme->n_dead || gethrtime() >= deadline)
+			break;
+		SMT_PAUSE();
+	}
+
+	/*
+	 * ncq_poller stays set while our command completes: its completion
+	 * may submit the next transfer from this thread, and that must not
+	 * poll in turn, or the stack would grow with every I/O.
+	 */
+	if (hit)
+		mine->nc_callback(mine);
+
+	mutex_enter(&cq->ncq_mutex);
+	cq->ncq_poller = NULL;
+	if (hit)
+		cq->ncq_poll_hits++;
+	else
+		cq->ncq_poll_misses++;
+	mutex_exit(&cq->ncq_mutex);
+}
+
 static nvme_cmd_t *
 nvme_retrieve_cmd(nvme_t *nvme, nvme_qpair_t *qp)
 {
@@ -3167,6 +3334,15 @@ nvme_intr(caddr_t arg1, caddr_t arg2)
 		ccnt += nvme_process_iocq(nvme, nvme->n_cq[qnum]);
 	}
 
+	/*
+	 * With hybrid polling, a poller may have reaped the completions this
+	 * interrupt was raised for. MSI and MSI-X vectors are never shared,
+	 * so the interrupt was ours all the same.
+	 */
+	if (ccnt == 0 && nvme->n_io_poll_usec != 0 &&
+	    nvme->n_intr_type != DDI_INTR_TYPE_FIXED)
+		return (DDI_INTR_CLAIMED);
+
 	return (ccnt > 0 ? DDI_INTR_CLAIMED : DDI_INTR_UNCLAIMED);
 }
 
@@ -3409,6 +3585,8 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 	    DDI_PROP_DONTPASS, "max-submission-queues", -1);
 	nvme->n_completion_queues = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
 	    DDI_PROP_DONTPASS, "max-completion-queues", -1);
+	nvme->n_io_poll_usec = ddi_prop_get_int(DDI_DEV_T_ANY, dip,
+	    DDI_PROP_DONTPASS, "io-poll-usec", 0);
 
 	if (!ISP2(nvme->n_min_block_size) ||
 	    (nvme->n_min_block_size < NVME_DEFAULT_MIN_BLOCK_SIZE)) {
@@ -3437,6 +3615,13 @@ nvme_attach(dev_info_t *dip, ddi_attach_cmd_t cmd)
 		nvme->n_completion_queues = -1;
 	}
 
+	if (nvme->n_io_poll_usec > NVME_MAX_IO_POLL_USEC) {
+		dev_err(dip, CE_WARN, "!\"io-poll-usec\"=%u is not valid. "
+		    "Must be [0..%d]", nvme->n_io_poll_usec,
+		    NVME_MAX_IO_POLL_USEC);
+		nvme->n_io_poll_usec = NVME_MAX_IO_POLL_USEC;
+	}
+
 	if (nvme->n_admin_queue_len < NVME_MIN_ADMIN_QUEUE_LEN)
 		nvme->n_admin_queue_len = NVME_MIN_ADMIN_QUEUE_LEN;
 	else if (nvme->n_admin_queue_len > NVME_MAX_ADMIN_QUEUE_LEN)
@@ -4008,7 +4193,7 @@ nvme_bd_cmd(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc)
 	nvme_t *nvme = ns->ns_nvme;
 	nvme_cmd_t *cmd;
 	nvme_qpair_t *ioq;
-	boolean_t poll;
+	boolean_t poll, hybrid;
 	int ret;
 
 	if (nvme->n_dead) {
@@ -4029,12 +4214,20 @@ nvme_bd_cmd(nvme_namespace_t *ns, bd_xfer_t *xfer, uint8_t opc)
 	 * treat both cmd and xfer as if they have been freed already.
 	 */
 	poll = (xfer->x_flags & BD_XFER_POLL) != 0;
+	hybrid = !poll && nvme->n_io_poll_usec != 0 &&
+	    (opc == NVME_OPC_NVM_READ || opc == NVME_OPC_NVM_WRITE);
+	if (hybrid)
+		cmd->nc_submit = gethrtime();
 
 	ret = nvme_submit_io_cmd(ioq, cmd);
 
 	if (ret != 0)
 		return (ret);
 
+	if (hybrid && !servicing_interrupt() &&
+	    !taskq_member(ioq->nq_cq->ncq_cmd_taskq, curthread))
+		nvme_poll_iocq(nvme, ioq->nq_cq, cmd);
+
 	if (!poll)
 		return (0);
 
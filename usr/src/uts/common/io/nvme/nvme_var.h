@@ -47,6 +47,8 @@ extern "C" {
 #define	NVME_DEFAULT_ASYNC_EVENT_LIMIT	10
 #define	NVME_MIN_ASYNC_EVENT_LIMIT	1
 #define	NVME_DEFAULT_MIN_BLOCK_SIZE	512
+#define	NVME_MAX_IO_POLL_USEC		1000
+#define	NVME_POLL_LAT_WEIGHT		8	/* 1/8 per sample */
 
 
 typedef struct nvme nvme_t;
@@ -93,6 +95,8 @@ struct nvme_cmd {
 
 	taskq_ent_t nc_tqent;
 	nvme_t *nc_nvme;
+
+	hrtime_t nc_submit;	/* submission time, if hybrid polled */
 };
 
 struct nvme_cq {
@@ -109,8 +113,27 @@ struct nvme_cq {
 	taskq_t *ncq_cmd_taskq;
 
 	kmutex_t ncq_mutex;
+
+	/* hybrid polling state, protected by ncq_mutex */
+	kthread_t *ncq_poller;		/* thread polling this queue */
+	hrtime_t ncq_lat;		/* moving average I/O latency */
+	uint64_t ncq_poll_hits;		/* poller found its command */
+	uint64_t ncq_poll_misses;	/* poller gave up */
+	uint64_t ncq_poll_skips;	/* queue too slow or busy to poll */
+	uint64_t ncq_polled;		/* completions reaped by pollers */
+	uint64_t ncq_intr;		/* completions reaped by interrupt */
+	kstat_t *ncq_ksp;
 };
 
+typedef struct nvme_cq_kstat {
+	kstat_named_t nck_poll_hits;
+	kstat_named_t nck_poll_misses;
+	kstat_named_t nck_poll_skips;
+	kstat_named_t nck_polled;
+	kstat_named_t nck_intr;
+	kstat_named_t nck_latency;
+} nvme_cq_kstat_t;
+
 struct nvme_qpair {
 	size_t nq_nentry;
 
@@ -174,6 +197,7 @@ struct nvme {
 	boolean_t n_progress_supported;
 	int n_submission_queues;
 	int n_completion_queues;
+	uint_t n_io_poll_usec;
 
 	int n_nssr_supported;
 	int n_doorbell_stride;
@@ -1052,6 +1052,10 @@ overlay_m_tx(void *arg, mblk_t *mp_chain)
 	int ret;
 	ovep_encap_info_t einfo;
 	struct msghdr hdr;
+	struct sockaddr_storage storage;
+	socklen_t slen;
+	uint8_t lastdst[ETHERADDRL];
+	boolean_t havelast = B_FALSE;
 
 	mutex_enter(&odd->odd_lock);
 	if ((odd->odd_flags & OVERLAY_F_MDDROP) ||
@@ -1069,20 +1073,29 @@ overlay_m_tx(void *arg, mblk_t *mp_chain)
 	einfo.ovdi_id = odd->odd_vid;
 	mp = mp_chain;
 	while (mp != NULL) {
-		socklen_t slen;
-		struct sockaddr_storage storage;
-
 		mp_chain = mp->b_next;
 		mp->b_next = NULL;
 		ep = NULL;
 
-		ret = overlay_target_lookup(odd, mp,
-		    (struct sockaddr *)&storage, &slen);
-		if (ret != OVERLAY_TARGET_OK) {
-			if (ret == OVERLAY_TARGET_DROP)
-				freemsg(mp);
-			mp = mp_chain;
-			continue;
+		/*
+		 * Runs of packets to the same destination are common in a
+		 * chain; they only need the one target lookup.
+		 */
+		if (!havelast || MBLKL(mp) < ETHERADDRL ||
+		    bcmp(mp->b_rptr, lastdst, ETHERADDRL) != 0) {
+			havelast = B_FALSE;
+			ret = overlay_target_lookup(odd, mp,
+			    (struct sockaddr *)&storage, &slen);
+			if (ret != OVERLAY_TARGET_OK) {
+				if (ret == OVERLAY_TARGET_DROP)
+					freemsg(mp);
+				mp = mp_chain;
+				continue;
+			}
+			if (MBLKL(mp) >= ETHERADDRL) {
+				bcopy(mp->b_rptr, lastdst, ETHERADDRL);
+				havelast = B_TRUE;
+			}
 		}
 
 		hdr.msg_name = &storage;
@@ -31,6 +31,13 @@
 #include <sys/strsubr.h>
 #include <sys/strsun.h>
 #include <sys/tihdr.h>
+#include <sys/callb.h>
+#include <sys/cpuvar.h>
+#include <sys/disp.h>
+#include <sys/proc.h>
+#include <sys/mac.h>
+#include <sys/dlpi.h>
+#include <netinet/in.h>
 
 #include <sys/overlay_impl.h>
 
@@ -42,17 +49,206 @@
 static list_t overlay_mux_list;
 static kmutex_t overlay_mux_lock;
 
+/*
+ * Receive fanout.  All of the encapsulated traffic of a mux arrives through
+ * its one socket, and passing each packet up through mac_rx() on the thread
+ * that received it ties the whole receive side to one CPU.  Instead, once a
+ * packet has been decapsulated and its device found, it is handed to one of
+ * a set of worker threads, picked by a hash of the inner frame's addresses
+ * and ports.  The outer header cannot be used for this: a peer that sends
+ * everything from one bound port, as this driver does itself, would put all
+ * of its traffic on one worker.  Hashing the inner flow spreads flows across
+ * the workers and keeps each one in order.
+ *
+ * overlay_rx_nworkers of zero means one worker per CPU, but no more than
+ * overlay_rx_maxworkers; with a single worker, packets are delivered inline
+ * as before.  A worker with overlay_rx_qlen packets queued drops the rest.
+ */
+uint_t overlay_rx_nworkers = 0;
+uint_t overlay_rx_maxworkers = 16;
+uint_t overlay_rx_qlen = 4096;
+
+#define	OVERLAY_RX_ALIGN	64
+
+typedef union overlay_rx_worker {
+	struct {
+		kmutex_t	orw_lock;
+		kcondvar_t	orw_cv;
+		kt_did_t	orw_tid;
+		mblk_t		*orw_head;	/* b_prev is the device */
+		mblk_t		*orw_tail;
+		uint_t		orw_count;
+		boolean_t	orw_exit;
+	} orw_s;
+	char	orw_pad[OVERLAY_RX_ALIGN];
+} overlay_rx_worker_t;
+
+#define	orw_lock	orw_s.orw_lock
+#define	orw_cv		orw_s.orw_cv
+#define	orw_tid		orw_s.orw_tid
+#define	orw_head	orw_s.orw_head
+#define	orw_tail	orw_s.orw_tail
+#define	orw_count	orw_s.orw_count
+#define	orw_exit	orw_s.orw_exit
+
+static overlay_rx_worker_t *overlay_rx_workers;
+static uint_t overlay_rx_nworker;
+
+/*
+ * Pass a chain of received packets up to their devices, each run of packets
+ * for the same device in one call, and drop the rx references taken by
+ * overlay_mux_recv().
+ */
+static void
+overlay_rx_deliver(mblk_t *mp)
+{
+	overlay_dev_t *odd;
+	mblk_t *head, **tailp;
+	uint_t cnt;
+
+	while (mp != NULL) {
+		odd = (overlay_dev_t *)mp->b_prev;
+		head = NULL;
+		tailp = &head;
+		cnt = 0;
+		while (mp != NULL && (overlay_dev_t *)mp->b_prev == odd) {
+			mp->b_prev = NULL;
+			*tailp = mp;
+			tailp = &mp->b_next;
+			mp = mp->b_next;
+			cnt++;
+		}
+		*tailp = NULL;
+
+		mac_rx(odd->odd_mh, NULL, head);
+
+		mutex_enter(&odd->odd_lock);
+		while (cnt-- != 0)
+			overlay_io_done(odd, OVERLAY_F_IN_RX);
+		mutex_exit(&odd->odd_lock);
+	}
+}
+
+static void
+overlay_rx_worker(void *arg)
+{
+	overlay_rx_worker_t *orw = arg;
+	callb_cpr_t cprinfo;
+	mblk_t *mp;
+
+	CALLB_CPR_INIT(&cprinfo, &orw->orw_lock, callb_generic_cpr,
+	    "overlay_rx");
+	mutex_enter(&orw->orw_lock);
+	for (;;) {
+		while (orw->orw_head == NULL && !orw->orw_exit) {
+			CALLB_CPR_SAFE_BEGIN(&cprinfo);
+			cv_wait(&orw->orw_cv, &orw->orw_lock);
+			CALLB_CPR_SAFE_END(&cprinfo, &orw->orw_lock);
+		}
+		if ((mp = orw->orw_head) == NULL)
+			break;
+		orw->orw_head = orw->orw_tail = NULL;
+		orw->orw_count = 0;
+		mutex_exit(&orw->orw_lock);
+
+		overlay_rx_deliver(mp);
+
+		mutex_enter(&orw->orw_lock);
+	}
+	CALLB_CPR_EXIT(&cprinfo);
+	thread_exit();
+}
+
+/*
+ * Queue a packet for its worker.  The caller has done overlay_io_start() on
+ * the device; the worker undoes it.
+ */
+static void
+overlay_rx_enqueue(overlay_dev_t *odd, mblk_t *mp)
+{
+	overlay_rx_worker_t *orw;
+	uint64_t hash;
+
+	hash = mac_pkt_hash(DL_ETHER, mp, MAC_PKT_HASH_L3 | MAC_PKT_HASH_L4,
+	    B_FALSE);
+	orw = &overlay_rx_workers[hash % overlay_rx_nworker];
+	mp->b_prev = (mblk_t *)odd;
+
+	mutex_enter(&orw->orw_lock);
+	if (orw->orw_count >= overlay_rx_qlen) {
+		mutex_exit(&orw->orw_lock);
+		mp->b_prev = NULL;
+		OVERLAY_FREEMSG(mp, "rx worker queue full");
+		freemsg(mp);
+		mutex_enter(&odd->odd_lock);
+		overlay_io_done(odd, OVERLAY_F_IN_RX);
+		mutex_exit(&odd->odd_lock);
+		return;
+	}
+	if (orw->orw_tail != NULL)
+		orw->orw_tail->b_next = mp;
+	else
+		orw->orw_head = mp;
+	orw->orw_tail = mp;
+	if (orw->orw_count++ == 0)
+		cv_signal(&orw->orw_cv);
+	mutex_exit(&orw->orw_lock);
+}
+
 void
 overlay_mux_init(void)
 {
+	overlay_rx_worker_t *orw;
+	kthread_t *t;
+	uint_t i, n;
+
 	list_create(&overlay_mux_list, sizeof (overlay_mux_t),
 	    offsetof(overlay_mux_t, omux_lnode));
 	mutex_init(&overlay_mux_lock, NULL, MUTEX_DRIVER, NULL);
+
+	n = overlay_rx_nworkers;
+	if (n == 0)
+		n = MIN(ncpus, overlay_rx_maxworkers);
+	if (n <= 1)
+		return;
+
+	overlay_rx_workers = kmem_zalloc(n * sizeof (overlay_rx_worker_t),
+	    KM_SLEEP);
+	overlay_rx_nworker = n;
+	for (i = 0; i < n; i++) {
+		orw = &overlay_rx_workers[i];
+		mutex_init(&orw->orw_lock, NULL, MUTEX_DRIVER, NULL);
+		cv_init(&orw->orw_cv, NULL, CV_DRIVER, NULL);
+		t = thread_create(NULL, 0, overlay_rx_worker, orw, 0, &p0,
+		    TS_RUN, minclsyspri);
+		orw->orw_tid = t->t_did;
+	}
 }
 
 void
 overlay_mux_fini(void)
 {
+	overlay_rx_worker_t *orw;
+	uint_t i;
+
+	for (i = 0; i < overlay_rx_nworker; i++) {
+		orw = &overlay_rx_workers[i];
+		mutex_enter(&orw->orw_lock);
+		orw->orw_exit = B_TRUE;
+		cv_signal(&orw->orw_cv);
+		mutex_exit(&orw->orw_lock);
+		thread_join(orw->orw_tid);
+		ASSERT(orw->orw_head == NULL);
+		cv_destroy(&orw->orw_cv);
+		mutex_destroy(&orw->orw_lock);
+	}
+	if (overlay_rx_workers != NULL) {
+		kmem_free(overlay_rx_workers,
+		    overlay_rx_nworker * sizeof (overlay_rx_worker_t));
+		overlay_rx_workers = NULL;
+		overlay_rx_nworker = 0;
+	}
+
 	mutex_destroy(&overlay_mux_lock);
 	list_destroy(&overlay_mux_list);
 }
@@ -196,6 +392,11 @@ overlay_mux_recv(ksocket_t ks, mblk_t *mpchain, size_t msgsize, int oob,
 		mutex_exit(&odd->odd_lock);
 		mutex_exit(&mux->omux_lock);
 
+		if (overlay_rx_workers != NULL) {
+			overlay_rx_enqueue(odd, mp);
+			continue;
+		}
+
 		mac_rx(odd->odd_mh, NULL, mp);
 
 		mutex_enter(&odd->odd_lock);
@@ -38,6 +38,8 @@
 #include <sys/errno.h>
 #include <sys/ddi.h>
 #include <sys/sunddi.h>
+#include <sys/atomic.h>
+#include <sys/cpuvar.h>
 
 #include <sys/overlay_impl.h>
 #include <sys/sdt.h>
@@ -100,6 +102,11 @@ static boolean_t overlay_target_excl;
  */
 static int overlay_ent_size = 128 * 1024;
 
+/*
+ * Whether to keep the per-CPU lookup caches of dynamic targets.
+ */
+boolean_t overlay_target_pcpu_enable = B_TRUE;
+
 /* ARGSUSED */
 static int
 overlay_target_cache_constructor(void *buf, void *arg, int kmflgs)
@@ -226,6 +233,119 @@ overlay_target_fini(void)
 	ddi_soft_state_fini(&overlay_thdl_state);
 }
 
+static void
+overlay_target_pcpu_free(overlay_target_t *ott)
+{
+	overlay_target_pcpu_t *otpc;
+	int i;
+
+	if (ott->ott_pcpu == NULL)
+		return;
+
+	for (i = 0; i < max_ncpus; i++) {
+		if ((otpc = ott->ott_pcpu[i]) == NULL)
+			continue;
+		mutex_destroy(&otpc->otpc_lock);
+		kmem_free(otpc, sizeof (overlay_target_pcpu_t));
+	}
+	kmem_free(ott->ott_pcpu, max_ncpus * sizeof (overlay_target_pcpu_t *));
+	ott->ott_pcpu = NULL;
+}
+
+/*
+ * Called after any change to an entry of a dynamic target, to throw away
+ * everything in the per-CPU caches.
+ */
+static void
+overlay_target_invalidate(overlay_target_t *ott)
+{
+	membar_producer();
+	atomic_inc_64(&ott->ott_gen);
+}
+
+static overlay_target_pcpu_ent_t *
+overlay_target_pcpu_slot(overlay_target_pcpu_t *otpc, const uint8_t *addr)
+{
+	uint_t h = addr[3] ^ addr[4] ^ addr[5];
+
+	return (&otpc->otpc_ents[h & (OVERLAY_TCACHE_SIZE - 1)]);
+}
+
+/*
+ * Return this CPU's lookup cache, allocating it if need be.  The thread may
+ * well migrate before it is done with it, so it is locked all the same,
+ * but the lock is normally only ever taken from the one CPU.
+ */
+static overlay_target_pcpu_t *
+overlay_target_pcpu_get(overlay_target_t *ott)
+{
+	overlay_target_pcpu_t *otpc, **slot;
+
+	if (ott->ott_pcpu == NULL)
+		return (NULL);
+
+	slot = &ott->ott_pcpu[CPU->cpu_seqid];
+	if ((otpc = *slot) != NULL)
+		return (otpc);
+
+	otpc = kmem_zalloc(sizeof (overlay_target_pcpu_t),
+	    KM_NOSLEEP | KM_NORMALPRI);
+	if (otpc == NULL)
+		return (NULL);
+	mutex_init(&otpc->otpc_lock, NULL, MUTEX_DRIVER, NULL);
+	if (atomic_cas_ptr(slot, NULL, otpc) != NULL) {
+		mutex_destroy(&otpc->otpc_lock);
+		kmem_free(otpc, sizeof (overlay_target_pcpu_t));
+		otpc = *slot;
+	}
+	return (otpc);
+}
+
+static boolean_t
+overlay_target_pcpu_lookup(overlay_target_t *ott, const uint8_t *addr,
+    overlay_target_point_t *otp)
+{
+	overlay_target_pcpu_t *otpc;
+	overlay_target_pcpu_ent_t *otpe;
+	boolean_t hit = B_FALSE;
+
+	if ((otpc = overlay_target_pcpu_get(ott)) == NULL)
+		return (B_FALSE);
+
+	otpe = overlay_target_pcpu_slot(otpc, addr);
+	mutex_enter(&otpc->otpc_lock);
+	if (otpe->otpe_gen == ott->ott_gen &&
+	    bcmp(otpe->otpe_addr, addr, ETHERADDRL) == 0) {
+		bcopy(&otpe->otpe_dest, otp, sizeof (overlay_target_point_t));
+		hit = B_TRUE;
+	}
+	mutex_exit(&otpc->otpc_lock);
+
+	return (hit);
+}
+
+/*
+ * Remember a destination that was valid as of generation gen, which must
+ * have been read before the entry was.
+ */
+static void
+overlay_target_pcpu_fill(overlay_target_t *ott, const uint8_t *addr,
+    const overlay_target_point_t *otp, uint64_t gen)
+{
+	overlay_target_pcpu_t *otpc;
+	overlay_target_pcpu_ent_t *otpe;
+
+	if ((otpc = overlay_target_pcpu_get(ott)) == NULL)
+		return;
+
+	otpe = overlay_target_pcpu_slot(otpc, addr);
+	mutex_enter(&otpc->otpc_lock);
+	otpe->otpe_gen = gen;
+	bcopy(addr, otpe->otpe_addr, ETHERADDRL);
+	bcopy(otp, &otpe->otpe_dest, sizeof (overlay_target_point_t));
+	mutex_exit(&otpc->otpc_lock);
+}
+
 void
 overlay_target_free(overlay_dev_t *odd)
 {
@@ -254,6 +374,7 @@ overlay_target_free(overlay_dev_t *odd)
 		refhash_destroy(rp);
 	}
 
+	overlay_target_pcpu_free(odd->odd_target);
 	ASSERT(odd->odd_target->ott_ocount == 0);
 	kmem_cache_free(overlay_target_cache, odd->odd_target);
 }
@@ -313,6 +434,8 @@ overlay_target_lookup(overlay_dev_t *odd, mblk_t *mp, struct sockaddr *sock,
 	overlay_target_t *ott;
 	mac_header_info_t mhi;
 	overlay_target_entry_t *entry;
+	overlay_target_point_t dest;
+	uint64_t gen;
 
 	ASSERT(odd->odd_target != NULL);
 
@@ -350,6 +473,16 @@ overlay_target_lookup(overlay_dev_t *odd, mblk_t *mp, struct sockaddr *sock,
 	 */
 	if (mac_header_info(odd->odd_mh, mp, &mhi) != 0)
 		return (OVERLAY_TARGET_DROP);
+
+	if (overlay_target_pcpu_lookup(ott, mhi.mhi_daddr, &dest)) {
+		bcopy(&dest.otp_ip, &v6->sin6_addr, sizeof (struct in6_addr));
+		v6->sin6_port = htons(dest.otp_port);
+		*slenp = sizeof (struct sockaddr_in6);
+		return (OVERLAY_TARGET_OK);
+	}
+
+	gen = ott->ott_gen;
+	membar_consumer();
 	mutex_enter(&ott->ott_lock);
 	entry = refhash_lookup(ott->ott_u.ott_dyn.ott_dhash,
 	    mhi.mhi_daddr);
@@ -379,9 +512,9 @@ overlay_target_lookup(overlay_dev_t *odd, mblk_t *mp, struct sockaddr *sock,
 	if (entry->ote_flags & OVERLAY_ENTRY_F_DROP) {
 		ret = OVERLAY_TARGET_DROP;
 	} else if (entry->ote_flags & OVERLAY_ENTRY_F_VALID) {
-		bcopy(&entry->ote_dest.otp_ip, &v6->sin6_addr,
-		    sizeof (struct in6_addr));
-		v6->sin6_port = htons(entry->ote_dest.otp_port);
+		bcopy(&entry->ote_dest, &dest, sizeof (overlay_target_point_t));
+		bcopy(&dest.otp_ip, &v6->sin6_addr, sizeof (struct in6_addr));
+		v6->sin6_port = htons(dest.otp_port);
 		*slenp = sizeof (struct sockaddr_in6);
 		ret = OVERLAY_TARGET_OK;
 	} else {
@@ -415,6 +548,9 @@ overlay_target_lookup(overlay_dev_t *odd, mblk_t *mp, struct sockaddr *sock,
 	refhash_rele(ott->ott_u.ott_dyn.ott_dhash, entry);
 	mutex_exit(&ott->ott_lock);
 
+	if (ret == OVERLAY_TARGET_OK)
+		overlay_target_pcpu_fill(ott, mhi.mhi_daddr, &dest, gen);
+
 	return (ret);
 }
 
@@ -494,6 +630,8 @@ overlay_target_associate(overlay_target_hdl_t *thdl, void *arg)
 	ott->ott_mode = ota->ota_mode;
 	ott->ott_dest = ota->ota_provides;
 	ott->ott_id = ota->ota_id;
+	ott->ott_gen = 1;
+	ott->ott_pcpu = NULL;
 
 	if (ott->ott_mode == OVERLAY_TARGET_POINT) {
 		bcopy(&ota->ota_point, &ott->ott_u.ott_point,
@@ -507,10 +645,15 @@ overlay_target_associate(overlay_target_hdl_t *thdl, void *arg)
 		avl_create(&ott->ott_u.ott_dyn.ott_tree, overlay_mac_avl,
 		    sizeof (overlay_target_entry_t),
 		    offsetof(overlay_target_entry_t, ote_avllink));
+		if (overlay_target_pcpu_enable) {
+			ott->ott_pcpu = kmem_zalloc(max_ncpus *
+			    sizeof (overlay_target_pcpu_t *), KM_SLEEP);
+		}
 	}
 	mutex_enter(&odd->odd_lock);
 	if (odd->odd_flags & OVERLAY_F_VARPD) {
 		mutex_exit(&odd->odd_lock);
+		overlay_target_pcpu_free(ott);
 		kmem_cache_free(overlay_target_cache, ott);
 		overlay_hold_rele(odd);
 		return (EEXIST);
@@ -683,6 +826,7 @@ overlay_target_lookup_respond(overlay_target_hdl_t *thdl, void *arg)
 	entry->ote_mbsize = 0;
 	entry->ote_vtime = gethrtime();
 	mutex_exit(&entry->ote_lock);
+	overlay_target_invalidate(entry->ote_ott);
 
 	/*
 	 * For now do an in-situ drain.
@@ -1176,6 +1320,7 @@ overlay_target_cache_set(overlay_target_hdl_t *thdl, void *arg)
 	}
 
 	mutex_exit(&ote->ote_lock);
+	overlay_target_invalidate(ott);
 	mutex_exit(&ott->ott_lock);
 
 	if (mp != NULL) {
@@ -1223,6 +1368,7 @@ overlay_target_cache_remove(overlay_target_hdl_t *thdl, void *arg)
 		mutex_enter(&ote->ote_lock);
 		ote->ote_flags &= ~OVERLAY_ENTRY_F_VALID_MASK;
 		mutex_exit(&ote->ote_lock);
+		overlay_target_invalidate(ott);
 		ret = 0;
 	} else {
 		ret = ENOENT;
@@ -1269,6 +1415,7 @@ overlay_target_cache_flush(overlay_target_hdl_t *thdl, void *arg)
 		ote->ote_flags &= ~OVERLAY_ENTRY_F_VALID_MASK;
 		mutex_exit(&ote->ote_lock);
 	}
+	overlay_target_invalidate(ott);
 	ote = refhash_lookup(ott->ott_u.ott_dyn.ott_dhash,
 	    otc->otc_entry.otce_mac);
 
@@ -120,6 +120,7 @@ typedef struct nfs_globals {
 
 	/* statistic: nfs_stat.c, etc. */
 	kstat_named_t		*svstat[NFS_VERSMAX + 1];
+	kstat_named_t		*svzcstat[NFS_VERSMAX + 1];	/* v3, v4 */
 	kstat_named_t		*rfsproccnt[NFS_VERSMAX + 1];
 	kstat_named_t		*aclproccnt[NFS_VERSMAX + 1];
 } nfs_globals_t;
@@ -935,6 +936,10 @@ extern void	rfs_srv_zone_fini(nfs_globals_t *);
 /* index for svstat_ptr */
 enum nfs_svccounts {NFS_CALLS, NFS_BADCALLS, NFS_REFERRALS, NFS_REFERLINKS};
 
+/* index for svzcstat */
+enum nfs_svzccounts {NFS_READ_ZCOPY, NFS_READ_COPIED, NFS_WRITE_LOANED,
+	NFS_WRITE_COPIED};
+
 #define	NFS_V2	NFS_VERSION
 
 /*	function defs for NFS kernel */
@@ -2399,6 +2404,10 @@ extern mblk_t	*uio_to_mblk(uio_t *);
 extern mblk_t	*rfs_read_alloc(uint_t, struct iovec **, int *);
 extern void	rfs_rndup_mblks(mblk_t *, uint_t, int);
 extern void	rfs_free_xuio(void *);
+extern boolean_t rfs_zcopy_aligned(vattr_t *, offset_t, size_t);
+extern uio_t	*rfs_write_xuio(vnode_t *, uio_t *, cred_t *,
+    caller_context_t *);
+extern void	rfs_zcopy_count(int, enum nfs_svzccounts, size_t);
 
 #endif	/* _KERNEL */
 
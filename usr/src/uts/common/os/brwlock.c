@@ -0,0 +1,261 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+#include <sys/brwlock.h>
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/cpuvar.h>
+#include <sys/debug.h>
+#include <sys/kmem.h>
+#include <sys/atomic.h>
+#include <sys/lockstat.h>
+#include <sys/sysmacros.h>
+
+/*
+ * Read-mostly readers/writer lock.
+ *
+ * A regular rwlock keeps its state in a single word, so every reader does
+ * an atomic operation on the same cache line. For locks that are taken for
+ * read on every CPU, but only rarely for write, that cache line bounces
+ * between CPUs (and sockets) all the time.
+ *
+ * A brwlock instead keeps one reader count per CPU, each on its own cache
+ * line. A reader increments the count of the CPU it is running on and then
+ * checks brw_writer. If no writer is around, it has the lock. A reader may
+ * drop the lock on a different CPU than it acquired it on; only the sum of
+ * all the counts is meaningful.
+ *
+ * A writer first acquires brw_lock as writer. This serializes writers and
+ * gives us priority inheritance and blocking for readers that come in while
+ * a writer is active. It then sets brw_writer and waits for the sum of the
+ * per-CPU reader counts to drop to zero.
+ *
+ * A reader that finds brw_writer set backs out its count, wakes up the
+ * draining writer, and acquires brw_lock as reader. This blocks until the
+ * writer is gone. It then accounts itself in a per-CPU count again and
+ * drops brw_lock. A blocked reader therefore ends up in exactly the same
+ * state as a reader that went through the fast path.
+ *
+ * The writer sets brw_writer and then reads the counts, while a reader
+ * increments a count and then reads brw_writer. Both issue a membar in
+ * between, so at least one of them sees the other.
+ *
+ * The lock is not recursive for readers while a writer is waiting, just
+ * like a regular rwlock. Read acquisition does not track the owner, so
+ * brw_read_held() only tells whether the lock is held for read by anyone.
+ */
+
+#define	BRW_CPU(l)	(&(l)->brw_cpu[CPU->cpu_seqid])
+
+static int64_t
+brw_readers(brwlock_t *l)
+{
+	int64_t readers = 0;
+	uint_t i;
+
+	for (i = 0; i < l->brw_ncpu; i++)
+		readers += l->brw_cpu[i].brc_readers;
+
+	return (readers);
+}
+
+/*
+ * Drop a per-CPU read count and wake a draining writer, if any.
+ */
+static void
+brw_read_exit_cpu(brwlock_t *l)
+{
+	atomic_dec_64((uint64_t *)&BRW_CPU(l)->brc_readers);
+	membar_enter();
+
+	if (l->brw_writer != 0) {
+		mutex_enter(&l->brw_wlock);
+		cv_broadcast(&l->brw_wcv);
+		mutex_exit(&l->brw_wlock);
+	}
+}
+
+static int
+brw_enter_read(brwlock_t *l, int tryenter)
+{
+	atomic_inc_64((uint64_t *)&BRW_CPU(l)->brc_readers);
+	membar_enter();
+
+	if (l->brw_writer == 0)
+		return (1);
+
+	/*
+	 * There is a writer around. Back out and wait for it on brw_lock.
+	 */
+	brw_read_exit_cpu(l);
+
+	if (tryenter) {
+		if (!rw_tryenter(&l->brw_lock, RW_READER))
+			return (0);
+	} else {
+		rw_enter(&l->brw_lock, RW_READER);
+	}
+	ASSERT(l->brw_writer == 0 || panicstr != NULL);
+	atomic_inc_64((uint64_t *)&BRW_CPU(l)->brc_readers);
+	rw_exit(&l->brw_lock);
+
+	return (1);
+}
+
+static int
+brw_enter_write(brwlock_t *l, int tryenter)
+{
+	hrtime_t sleep_time = 0;
+	int64_t readers;
+
+	if (tryenter) {
+		if (!rw_tryenter(&l->brw_lock, RW_WRITER))
+			return (0);
+	} else {
+		rw_enter(&l->brw_lock, RW_WRITER);
+	}
+
+	l->brw_writer = 1;
+	membar_enter();
+
+	mutex_enter(&l->brw_wlock);
+	while ((readers = brw_readers(l)) != 0) {
+		if (tryenter) {
+			mutex_exit(&l->brw_wlock);
+			l->brw_writer = 0;
+			rw_exit(&l->brw_lock);
+			return (0);
+		}
+		/*
+		 * Once the system has panicked, no reader is going to run
+		 * again to drop its hold. Like rw_enter(), let the writer
+		 * through; it still becomes the owner, so that brw_exit()
+		 * undoes this rather than a read hold.
+		 */
+		if (panicstr != NULL)
+			break;
+		if (sleep_time == 0)
+			sleep_time = -gethrtime();
+		cv_wait(&l->brw_wcv, &l->brw_wlock);
+	}
+	mutex_exit(&l->brw_wlock);
+
+	if (sleep_time != 0) {
+		sleep_time += gethrtime();
+		LOCKSTAT_RECORD4(LS_RW_ENTER_BLOCK, l, sleep_time, RW_WRITER,
+		    0, readers);
+	}
+
+	l->brw_owner = curthread;
+	membar_enter();
+
+	return (1);
+}
+
+void
+brw_enter(brwlock_t *l, krw_t rw)
+{
+	if (rw == RW_WRITER) {
+		(void) brw_enter_write(l, 0);
+	} else {
+		(void) brw_enter_read(l, 0);
+	}
+	LOCKSTAT_RECORD(LS_RW_ENTER_ACQUIRE, l, rw);
+}
+
+int
+brw_tryenter(brwlock_t *l, krw_t rw)
+{
+	int rv;
+
+	if (rw == RW_WRITER) {
+		rv = brw_enter_write(l, 1);
+	} else {
+		rv = brw_enter_read(l, 1);
+	}
+	if (rv != 0)
+		LOCKSTAT_RECORD(LS_RW_TRYENTER_ACQUIRE, l, rw);
+
+	return (rv);
+}
+
+void
+brw_exit(brwlock_t *l)
+{
+	if (l->brw_owner == curthread) {
+		LOCKSTAT_RECORD(LS_RW_EXIT_RELEASE, l, RW_WRITER);
+		l->brw_owner = NULL;
+		membar_exit();
+		l->brw_writer = 0;
+		rw_exit(&l->brw_lock);
+	} else {
+		LOCKSTAT_RECORD(LS_RW_EXIT_RELEASE, l, RW_READER);
+		membar_exit();
+		brw_read_exit_cpu(l);
+	}
+}
+
+int
+brw_read_held(brwlock_t *l)
+{
+	return (brw_readers(l) > 0);
+}
+
+int
+brw_write_held(brwlock_t *l)
+{
+	return (l->brw_owner == curthread);
+}
+
+int
+brw_lock_held(brwlock_t *l)
+{
+	return (brw_write_held(l) || brw_read_held(l));
+}
+
+struct _kthread *
+brw_owner(brwlock_t *l)
+{
+	return (l->brw_owner);
+}
+
+/*ARGSUSED*/
+void
+brw_init(brwlock_t *l, char *name, krw_type_t type, void *arg)
+{
+	l->brw_ncpu = max_ncpus;
+	l->brw_size = l->brw_ncpu * sizeof (brw_cpu_t) + sizeof (brw_cpu_t);
+	l->brw_base = kmem_zalloc(l->brw_size, KM_SLEEP);
+	l->brw_cpu = (brw_cpu_t *)P2ROUNDUP((uintptr_t)l->brw_base,
+	    sizeof (brw_cpu_t));
+	l->brw_writer = 0;
+	l->brw_owner = NULL;
+	rw_init(&l->brw_lock, name, type, arg);
+	mutex_init(&l->brw_wlock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&l->brw_wcv, NULL, CV_DEFAULT, NULL);
+}
+
+void
+brw_destroy(brwlock_t *l)
+{
+	ASSERT(l->brw_owner == NULL);
+	ASSERT(brw_readers(l) == 0);
+	rw_destroy(&l->brw_lock);
+	mutex_destroy(&l->brw_wlock);
+	cv_destroy(&l->brw_wcv);
+	kmem_free(l->brw_base, l->brw_size);
+	l->brw_base = NULL;
+	l->brw_cpu = NULL;
+}
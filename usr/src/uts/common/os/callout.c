@@ -54,6 +54,8 @@ static ulong_t callout_counter_low;		/* callout ID increment */
 static ulong_t callout_table_bits;		/* number of table bits in ID */
 static ulong_t callout_table_mask;		/* mask for the table bits */
 static callout_cache_t *callout_caches;		/* linked list of caches */
+static int callout_wheel_enable;		/* wheel for low-res callouts */
+static hrtime_t callout_wheel_resolution;	/* wheel tick in nanoseconds */
 #pragma align 64(callout_table)
 static callout_table_t *callout_table;		/* global callout table array */
 
@@ -75,10 +77,33 @@ static char *callout_kstat_names[] = {
 	"callout_expirations",
 	"callout_allocations",
 	"callout_cleanups",
+	"callout_heap_inserts",
+	"callout_heap_cancels",
+	"callout_wheel_inserts",
+	"callout_wheel_cancels",
+	"callout_wheel_cascades",
 };
 
 static hrtime_t	callout_heap_process(callout_table_t *, hrtime_t, int);
 
+/*
+ * Convert an expiration to a wheel tick, rounding up so that a callout list
+ * never fires early.
+ */
+#define	CALLOUT_WHEEL_TICK(exp)					\
+	(((exp) / callout_wheel_resolution) +			\
+	    (((exp) % callout_wheel_resolution) != 0))
+
+/*
+ * A callout list goes into the timing wheel if the table has one and the
+ * resolution is a multiple of the wheel resolution. The latter guarantees
+ * that the expiration falls on a wheel tick, so it is not delayed.
+ */
+#define	CALLOUT_WHEEL_ELIGIBLE(ct, resolution)			\
+	(((ct)->ct_wheel != NULL) &&				\
+	    ((resolution) >= callout_wheel_resolution) &&	\
+	    (((resolution) % callout_wheel_resolution) == 0))
+
 #define	CALLOUT_HASH_INSERT(hash, cp, cnext, cprev)	\
 {							\
 	callout_hash_t *hashp = &(hash);		\
@@ -967,6 +992,308 @@ callout_heap_process(callout_table_t *ct, hrtime_t delta, int timechange)
 	return (heap->ch_expiration);
 }
 
+/*
+ * Initialize a callout table's timing wheel.
+ */
+static void
+callout_wheel_init(callout_table_t *ct)
+{
+	callout_wheel_t *cw;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+	ASSERT(ct->ct_wheel == NULL);
+
+	cw = kmem_zalloc(sizeof (callout_wheel_t), KM_SLEEP);
+	cw->cw_tick = gethrtime() / callout_wheel_resolution;
+	cw->cw_next = CY_INFINITY;
+	cw->cw_cyclic = CYCLIC_NONE;
+	ct->ct_wheel = cw;
+}
+
+/*
+ * Queue a callout list in the wheel slot that corresponds to its expiration
+ * relative to the current wheel tick.
+ */
+static void
+callout_wheel_link(callout_wheel_t *cw, callout_list_t *cl)
+{
+	hrtime_t tick, delta;
+	int level;
+
+	tick = CALLOUT_WHEEL_TICK(cl->cl_expiration);
+	if (tick < cw->cw_tick)
+		tick = cw->cw_tick;
+
+	delta = tick - cw->cw_tick;
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS - 1; level++) {
+		if (delta < CALLOUT_WHEEL_SPAN(level))
+			break;
+	}
+
+	/*
+	 * If the expiration is beyond the span of the wheel, park the callout
+	 * list in the last slot of the top level. It will be re-examined when
+	 * that slot is cascaded.
+	 */
+	if (delta >= CALLOUT_WHEEL_SPAN(level))
+		tick = cw->cw_tick + CALLOUT_WHEEL_SPAN(level) - 1;
+
+	cl->cl_wslot = &cw->cw_slots[level][CALLOUT_WHEEL_INDEX(tick, level)];
+	CALLOUT_HASH_APPEND(*cl->cl_wslot, cl, cl_wnext, cl_wprev);
+}
+
+/*
+ * Remove a callout list from its wheel slot.
+ */
+static void
+callout_wheel_unlink(callout_wheel_t *cw, callout_list_t *cl)
+{
+	CALLOUT_HASH_DELETE(*cl->cl_wslot, cl, cl_wnext, cl_wprev);
+	cl->cl_wslot = NULL;
+	cl->cl_flags &= ~CALLOUT_LIST_FLAG_WHEELED;
+	cw->cw_num--;
+}
+
+/*
+ * Compute the expiration that the wheel cyclic should be programmed to.
+ * This is the next non-empty level 0 slot in the current rotation or, if
+ * there is none, the start of the next rotation where a cascade is due.
+ * So, an idle wheel does not fire every tick.
+ */
+static hrtime_t
+callout_wheel_next(callout_wheel_t *cw)
+{
+	hrtime_t tick;
+
+	if (cw->cw_num == 0)
+		return (CY_INFINITY);
+
+	for (tick = cw->cw_tick; (tick & CALLOUT_WHEEL_MASK) != 0; tick++) {
+		if (cw->cw_slots[0][tick & CALLOUT_WHEEL_MASK].ch_head != NULL)
+			break;
+	}
+
+	return (tick * callout_wheel_resolution);
+}
+
+/*
+ * Insert a callout list into a callout table's wheel and reprogram the
+ * wheel cyclic if needed.
+ */
+static void
+callout_wheel_insert(callout_table_t *ct, callout_list_t *cl)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	hrtime_t now, expiration;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	/*
+	 * If the wheel is empty, it may not have been turned in a while.
+	 * Bring it up to date so that the callout list lands in the right
+	 * slot.
+	 */
+	if (cw->cw_num == 0) {
+		now = gethrtime() / callout_wheel_resolution;
+		if (now > cw->cw_tick)
+			cw->cw_tick = now;
+	}
+
+	cl->cl_flags |= CALLOUT_LIST_FLAG_WHEELED;
+	callout_wheel_link(cw, cl);
+	cw->cw_num++;
+	ct->ct_wheel_inserts++;
+
+	/*
+	 * If this expiration is earlier than the one the wheel cyclic is
+	 * programmed to, reprogram the cyclic. A callout list that went into
+	 * a higher level only comes due when its slot is cascaded, so the
+	 * cyclic is programmed to where the wheel next has to be turned, as
+	 * callout_wheel_delete() does, rather than to the expiration. As with
+	 * the heap, do not reprogram it during the CPR suspend phase.
+	 */
+	expiration = MAX(CALLOUT_WHEEL_TICK(cl->cl_expiration), cw->cw_tick) *
+	    callout_wheel_resolution;
+	if (expiration < cw->cw_next) {
+		expiration = callout_wheel_next(cw);
+		if (expiration < cw->cw_next) {
+			cw->cw_next = expiration;
+			if (ct->ct_suspend == 0)
+				(void) cyclic_reprogram(cw->cw_cyclic,
+				    expiration);
+		}
+	}
+}
+
+/*
+ * Move all the callout lists in the current slot of a wheel level to the
+ * lower levels.
+ */
+static void
+callout_wheel_cascade(callout_table_t *ct, int level)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	callout_hash_t *slot, temp;
+	callout_list_t *cl;
+
+	slot = &cw->cw_slots[level][CALLOUT_WHEEL_INDEX(cw->cw_tick, level)];
+	temp = *slot;
+	slot->ch_head = NULL;
+	slot->ch_tail = NULL;
+
+	while ((cl = temp.ch_head) != NULL) {
+		CALLOUT_HASH_DELETE(temp, cl, cl_wnext, cl_wprev);
+		callout_wheel_link(cw, cl);
+	}
+	ct->ct_wheel_cascades++;
+}
+
+/*
+ * Turn the wheel up to the current time and move the callout lists in all
+ * the slots that have passed to the list of expired callout lists.
+ */
+static hrtime_t
+callout_wheel_delete(callout_table_t *ct)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	callout_hash_t *slot;
+	callout_list_t *cl;
+	hrtime_t now, expiration, index;
+	int level, hash;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	now = gethrtime() / callout_wheel_resolution;
+	while (cw->cw_tick <= now) {
+		if (cw->cw_num == 0) {
+			cw->cw_tick = now + 1;
+			break;
+		}
+
+		if ((cw->cw_tick & CALLOUT_WHEEL_MASK) == 0) {
+			/*
+			 * The level 0 index has wrapped. Cascade the current
+			 * slot of level 1 and, if its index has wrapped too,
+			 * of the level above and so on.
+			 */
+			for (level = 1; level < CALLOUT_WHEEL_LEVELS; level++) {
+				callout_wheel_cascade(ct, level);
+				index = CALLOUT_WHEEL_INDEX(cw->cw_tick, level);
+				if (index != 0)
+					break;
+			}
+		}
+
+		slot = &cw->cw_slots[0][cw->cw_tick & CALLOUT_WHEEL_MASK];
+		while ((cl = slot->ch_head) != NULL) {
+			callout_wheel_unlink(cw, cl);
+			hash = CALLOUT_CLHASH(cl->cl_expiration);
+			CALLOUT_LIST_DELETE(ct->ct_clhash[hash], cl);
+			CALLOUT_LIST_APPEND(ct->ct_expired, cl);
+		}
+		cw->cw_tick++;
+	}
+
+	/*
+	 * If the wheel is empty or callouts have been suspended, just
+	 * return. The cyclic has already been programmed to infinity by the
+	 * cyclic subsystem.
+	 */
+	if ((cw->cw_num == 0) || (ct->ct_suspend > 0)) {
+		cw->cw_next = CY_INFINITY;
+		return (CY_INFINITY);
+	}
+
+	expiration = callout_wheel_next(cw);
+	cw->cw_next = expiration;
+	(void) cyclic_reprogram(cw->cw_cyclic, expiration);
+
+	return (expiration);
+}
+
+/*
+ * Walk the entire wheel. This is the wheel equivalent of
+ * callout_heap_process() and is called in the same situations.
+ */
+static hrtime_t
+callout_wheel_process(callout_table_t *ct, hrtime_t delta, int timechange)
+{
+	callout_wheel_t *cw = ct->ct_wheel;
+	callout_hash_t temp;
+	callout_list_t *cl;
+	hrtime_t expiration, now;
+	int level, i, hash, clflags;
+
+	ASSERT(MUTEX_HELD(&ct->ct_mutex));
+
+	if ((cw == NULL) || (cw->cw_num == 0))
+		return (CY_INFINITY);
+
+	/*
+	 * Pull all the callout lists out of the wheel. Then, expire or
+	 * adjust each one and queue it back relative to the current time.
+	 */
+	temp.ch_head = NULL;
+	temp.ch_tail = NULL;
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS; level++) {
+		for (i = 0; i < CALLOUT_WHEEL_SLOTS; i++) {
+			while ((cl = cw->cw_slots[level][i].ch_head) != NULL) {
+				callout_wheel_unlink(cw, cl);
+				CALLOUT_HASH_APPEND(temp, cl, cl_wnext,
+				    cl_wprev);
+			}
+		}
+	}
+
+	ASSERT(cw->cw_num == 0);
+	now = gethrtime();
+	if (now / callout_wheel_resolution > cw->cw_tick)
+		cw->cw_tick = now / callout_wheel_resolution;
+
+	clflags = (CALLOUT_LIST_FLAG_HRESTIME | CALLOUT_LIST_FLAG_ABSOLUTE);
+	while ((cl = temp.ch_head) != NULL) {
+		CALLOUT_HASH_DELETE(temp, cl, cl_wnext, cl_wprev);
+		hash = CALLOUT_CLHASH(cl->cl_expiration);
+
+		/*
+		 * Expire the callout list, if one of the following is true:
+		 *	- the callout list has expired
+		 *	- the callout list is an absolute hrestime one and
+		 *	  there has been a system time change
+		 */
+		if ((cl->cl_expiration <= now) ||
+		    (timechange && ((cl->cl_flags & clflags) == clflags))) {
+			CALLOUT_LIST_DELETE(ct->ct_clhash[hash], cl);
+			CALLOUT_LIST_APPEND(ct->ct_expired, cl);
+			continue;
+		}
+
+		/*
+		 * Apply adjustments to relative callout lists, if any.
+		 */
+		if (delta && !(cl->cl_flags & CALLOUT_LIST_FLAG_ABSOLUTE)) {
+			CALLOUT_LIST_DELETE(ct->ct_clhash[hash], cl);
+			expiration = cl->cl_expiration + delta;
+			if (expiration <= 0)
+				expiration = CY_INFINITY;
+			cl->cl_expiration = expiration;
+			hash = CALLOUT_CLHASH(cl->cl_expiration);
+			CALLOUT_LIST_INSERT(ct->ct_clhash[hash], cl);
+		}
+
+		cl->cl_flags |= CALLOUT_LIST_FLAG_WHEELED;
+		callout_wheel_link(cw, cl);
+		cw->cw_num++;
+	}
+
+	if (ct->ct_expired.ch_head != NULL)
+		cw->cw_next = gethrtime();
+	else
+		cw->cw_next = callout_wheel_next(cw);
+
+	return (cw->cw_next);
+}
+
 /*
  * Common function used to create normal and realtime callouts.
  *
@@ -1128,6 +1455,17 @@ again:
 		cl->cl_expiration = expiration;
 		cl->cl_flags = clflags;
 
+		/*
+		 * Low resolution callout lists go into the timing wheel,
+		 * if there is one. Insertion there is O(1) and it never
+		 * needs to be expanded.
+		 */
+		if (CALLOUT_WHEEL_ELIGIBLE(ct, resolution)) {
+			CALLOUT_LIST_INSERT(ct->ct_clhash[hash], cl);
+			callout_wheel_insert(ct, cl);
+			goto out;
+		}
+
 		/*
 		 * Check if we have enough space in the heap to insert one
 		 * expiration. If not, expand the heap.
@@ -1164,6 +1502,7 @@ again:
 		 * propagated to the root of the heap.
 		 */
 		callout_heap_insert(ct, cl);
+		ct->ct_heap_inserts++;
 	} else {
 		/*
 		 * If the callout list was empty, untimeout_generic() would
@@ -1323,10 +1662,11 @@ untimeout_generic(callout_id_t id, int nowait)
 			ct->ct_timeouts_pending--;
 
 			/*
-			 * If the callout list has become empty, there are 3
+			 * If the callout list has become empty, there are 4
 			 * possibilities. If it is present:
 			 *	- in the heap, it needs to be cleaned along
 			 *	  with its heap entry. Increment a reap count.
+			 *	- in the timing wheel, unlink and free it.
 			 *	- in the callout queue, free it.
 			 *	- in the expired list, free it.
 			 */
@@ -1334,6 +1674,14 @@ untimeout_generic(callout_id_t id, int nowait)
 				flags = cl->cl_flags;
 				if (flags & CALLOUT_LIST_FLAG_HEAPED) {
 					ct->ct_nreap++;
+					ct->ct_heap_cancels++;
+				} else if (flags & CALLOUT_LIST_FLAG_WHEELED) {
+					callout_wheel_unlink(ct->ct_wheel, cl);
+					hash = CALLOUT_CLHASH(expiration);
+					CALLOUT_LIST_DELETE(ct->ct_clhash[hash],
+					    cl);
+					CALLOUT_LIST_FREE(ct, cl);
+					ct->ct_wheel_cancels++;
 				} else if (flags & CALLOUT_LIST_FLAG_QUEUED) {
 					CALLOUT_LIST_DELETE(ct->ct_queue, cl);
 					CALLOUT_LIST_FREE(ct, cl);
@@ -1573,6 +1921,15 @@ callout_queue_realtime(callout_table_t *ct)
 	mutex_exit(&ct->ct_mutex);
 }
 
+void
+callout_wheel_realtime(callout_table_t *ct)
+{
+	mutex_enter(&ct->ct_mutex);
+	(void) callout_wheel_delete(ct);
+	callout_expire(ct);
+	mutex_exit(&ct->ct_mutex);
+}
+
 void
 callout_execute(callout_table_t *ct)
 {
@@ -1620,6 +1977,24 @@ callout_queue_normal(callout_table_t *ct)
 	}
 }
 
+void
+callout_wheel_normal(callout_table_t *ct)
+{
+	int i, exec;
+	hrtime_t exp;
+
+	mutex_enter(&ct->ct_mutex);
+	exp = callout_wheel_delete(ct);
+	CALLOUT_EXEC_COMPUTE(ct, exp, exec);
+	mutex_exit(&ct->ct_mutex);
+
+	for (i = 0; i < exec; i++) {
+		ASSERT(ct->ct_taskq != NULL);
+		(void) taskq_dispatch(ct->ct_taskq,
+		    (task_func_t *)callout_execute, ct, TQ_NOSLEEP);
+	}
+}
+
 /*
  * Suspend callout processing.
  */
@@ -1652,6 +2027,10 @@ callout_suspend(void)
 				    CY_INFINITY);
 				(void) cyclic_reprogram(ct->ct_qcyclic,
 				    CY_INFINITY);
+				if (ct->ct_wheel != NULL)
+					(void) cyclic_reprogram(
+					    ct->ct_wheel->cw_cyclic,
+					    CY_INFINITY);
 			}
 			mutex_exit(&ct->ct_mutex);
 		}
@@ -1664,7 +2043,7 @@ callout_suspend(void)
 static void
 callout_resume(hrtime_t delta, int timechange)
 {
-	hrtime_t hexp, qexp;
+	hrtime_t hexp, qexp, wexp;
 	int t, f;
 	callout_table_t *ct;
 
@@ -1693,11 +2072,15 @@ callout_resume(hrtime_t delta, int timechange)
 			 */
 			hexp = callout_heap_process(ct, delta, timechange);
 			qexp = callout_queue_process(ct, delta, timechange);
+			wexp = callout_wheel_process(ct, delta, timechange);
 
 			ct->ct_suspend--;
 			if (ct->ct_suspend == 0) {
 				(void) cyclic_reprogram(ct->ct_cyclic, hexp);
 				(void) cyclic_reprogram(ct->ct_qcyclic, qexp);
+				if (ct->ct_wheel != NULL)
+					(void) cyclic_reprogram(
+					    ct->ct_wheel->cw_cyclic, wexp);
 			}
 
 			mutex_exit(&ct->ct_mutex);
@@ -1758,7 +2141,7 @@ callout_debug_callb(void *arg, int code)
 static void
 callout_hrestime_one(callout_table_t *ct)
 {
-	hrtime_t hexp, qexp;
+	hrtime_t hexp, qexp, wexp;
 
 	mutex_enter(&ct->ct_mutex);
 	if (ct->ct_cyclic == CYCLIC_NONE) {
@@ -1771,10 +2154,13 @@ callout_hrestime_one(callout_table_t *ct)
 	 */
 	hexp = callout_heap_process(ct, 0, 1);
 	qexp = callout_queue_process(ct, 0, 1);
+	wexp = callout_wheel_process(ct, 0, 1);
 
 	if (ct->ct_suspend == 0) {
 		(void) cyclic_reprogram(ct->ct_cyclic, hexp);
 		(void) cyclic_reprogram(ct->ct_qcyclic, qexp);
+		if (ct->ct_wheel != NULL)
+			(void) cyclic_reprogram(ct->ct_wheel->cw_cyclic, wexp);
 	}
 
 	mutex_exit(&ct->ct_mutex);
@@ -1860,7 +2246,7 @@ callout_cyclic_init(callout_table_t *ct)
 	cyc_time_t when;
 	processorid_t seqid;
 	int t;
-	cyclic_id_t cyclic, qcyclic;
+	cyclic_id_t cyclic, qcyclic, wcyclic;
 
 	ASSERT(MUTEX_HELD(&ct->ct_mutex));
 
@@ -1941,9 +2327,21 @@ callout_cyclic_init(callout_table_t *ct)
 
 	qcyclic = cyclic_add(&hdlr, &when);
 
+	wcyclic = CYCLIC_NONE;
+	if (ct->ct_wheel != NULL) {
+		if (t == CALLOUT_REALTIME)
+			hdlr.cyh_func = (cyc_func_t)callout_wheel_realtime;
+		else
+			hdlr.cyh_func = (cyc_func_t)callout_wheel_normal;
+
+		wcyclic = cyclic_add(&hdlr, &when);
+	}
+
 	mutex_enter(&ct->ct_mutex);
 	ct->ct_cyclic = cyclic;
 	ct->ct_qcyclic = qcyclic;
+	if (ct->ct_wheel != NULL)
+		ct->ct_wheel->cw_cyclic = wcyclic;
 }
 
 void
@@ -2009,6 +2407,8 @@ callout_cpu_online(cpu_t *cp)
 			callout_heap_init(ct);
 			callout_hash_init(ct);
 			callout_kstat_init(ct);
+			if (callout_wheel_enable)
+				callout_wheel_init(ct);
 			callout_cyclic_init(ct);
 		}
 
@@ -2019,6 +2419,8 @@ callout_cpu_online(cpu_t *cp)
 		 */
 		cyclic_bind(ct->ct_cyclic, cp, NULL);
 		cyclic_bind(ct->ct_qcyclic, cp, NULL);
+		if (ct->ct_wheel != NULL)
+			cyclic_bind(ct->ct_wheel->cw_cyclic, cp, NULL);
 	}
 }
 
@@ -2042,6 +2444,8 @@ callout_cpu_offline(cpu_t *cp)
 		 */
 		cyclic_bind(ct->ct_cyclic, NULL, NULL);
 		cyclic_bind(ct->ct_qcyclic, NULL, NULL);
+		if (ct->ct_wheel != NULL)
+			cyclic_bind(ct->ct_wheel->cw_cyclic, NULL, NULL);
 	}
 }
 
@@ -2115,6 +2519,8 @@ callout_init(void)
 		callout_chunk = CALLOUT_CHUNK;
 	else
 		callout_chunk = P2ROUNDUP(callout_chunk, CALLOUT_CHUNK);
+	if (callout_wheel_resolution <= 0)
+		callout_wheel_resolution = nsec_per_tick;
 
 	/*
 	 * Allocate all the callout tables based on max_ncpus. We have chosen
@@ -841,6 +841,7 @@
 #include <sys/id32.h>
 #include <sys/zone.h>
 #include <sys/netstack.h>
+#include <sys/lgrp.h>
 #ifdef	DEBUG
 #include <sys/random.h>
 #endif
@@ -861,6 +862,8 @@ struct kmem_cache_kstat {
 	kstat_named_t	kmc_depot_alloc;
 	kstat_named_t	kmc_depot_free;
 	kstat_named_t	kmc_depot_contention;
+	kstat_named_t	kmc_depot_remote; /* full mags from other lgroups */
+	kstat_named_t	kmc_depot_lock_wait; /* nsec waited for depot locks */
 	kstat_named_t	kmc_slab_alloc;
 	kstat_named_t	kmc_slab_free;
 	kstat_named_t	kmc_buf_constructed;
@@ -900,6 +903,8 @@ struct kmem_cache_kstat {
 	{ "depot_alloc",	KSTAT_DATA_UINT64 },
 	{ "depot_free",		KSTAT_DATA_UINT64 },
 	{ "depot_contention",	KSTAT_DATA_UINT64 },
+	{ "depot_remote",	KSTAT_DATA_UINT64 },
+	{ "depot_lock_wait",	KSTAT_DATA_UINT64 },
 	{ "slab_alloc",		KSTAT_DATA_UINT64 },
 	{ "slab_free",		KSTAT_DATA_UINT64 },
 	{ "buf_constructed",	KSTAT_DATA_UINT64 },
@@ -1004,6 +1009,9 @@ static uint32_t kmem_reaping_idspace;
  */
 clock_t kmem_reap_interval;	/* cache reaping rate [15 * HZ ticks] */
 int kmem_depot_contention = 3;	/* max failed tryenters per real interval */
+int kmem_depot_shrink_intervals = 40; /* quiet intervals before shrinking */
+int kmem_lgrp_depot_enable = 1;	/* per-lgroup depots for full magazines */
+int kmem_lgrp_depot_steal = 1;	/* use remote full magazines before slabs */
 pgcnt_t kmem_reapahead = 0;	/* start reaping N pages before pageout */
 int kmem_panic = 1;		/* whether to panic on error */
 int kmem_logging = 1;		/* kmem_log_enter() override */
@@ -2074,24 +2082,36 @@ kmem_magazine_destroy(kmem_cache_t *cp, kmem_magazine_t *mp, int nrounds)
 }
 
 /*
- * Allocate a magazine from the depot.
+ * Acquire a depot lock.  If we can't get it without contention, update
+ * the contention count and account the time spent waiting.  We use the
+ * depot contention rate to determine whether we need to increase (or may
+ * decrease) the magazine size.
+ */
+static void
+kmem_depot_lock(kmem_cache_t *cp, kmutex_t *lp, uint64_t *contentionp)
+{
+	hrtime_t wait;
+
+	if (mutex_tryenter(lp))
+		return;
+
+	wait = gethrtime();
+	mutex_enter(lp);
+	wait = gethrtime() - wait;
+
+	(*contentionp)++;
+	atomic_add_64(&cp->cache_depot_lock_wait, wait);
+}
+
+/*
+ * Remove a magazine from a depot list.  The caller holds the lock
+ * protecting the list.
  */
 static kmem_magazine_t *
-kmem_depot_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
+kmem_maglist_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
 {
 	kmem_magazine_t *mp;
 
-	/*
-	 * If we can't get the depot lock without contention,
-	 * update our contention count.  We use the depot
-	 * contention rate to determine whether we need to
-	 * increase the magazine size for better scalability.
-	 */
-	if (!mutex_tryenter(&cp->cache_depot_lock)) {
-		mutex_enter(&cp->cache_depot_lock);
-		cp->cache_depot_contention++;
-	}
-
 	if ((mp = mlp->ml_list) != NULL) {
 		ASSERT(KMEM_MAGAZINE_VALID(cp, mp));
 		mlp->ml_list = mp->mag_next;
@@ -2100,6 +2120,32 @@ kmem_depot_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
 		mlp->ml_alloc++;
 	}
 
+	return (mp);
+}
+
+/*
+ * Add a magazine to a depot list.  The caller holds the lock protecting
+ * the list.
+ */
+static void
+kmem_maglist_free(kmem_cache_t *cp, kmem_maglist_t *mlp, kmem_magazine_t *mp)
+{
+	ASSERT(KMEM_MAGAZINE_VALID(cp, mp));
+	mp->mag_next = mlp->ml_list;
+	mlp->ml_list = mp;
+	mlp->ml_total++;
+}
+
+/*
+ * Allocate a magazine from the depot.
+ */
+static kmem_magazine_t *
+kmem_depot_alloc(kmem_cache_t *cp, kmem_maglist_t *mlp)
+{
+	kmem_magazine_t *mp;
+
+	kmem_depot_lock(cp, &cp->cache_depot_lock, &cp->cache_depot_contention);
+	mp = kmem_maglist_alloc(cp, mlp);
 	mutex_exit(&cp->cache_depot_lock);
 
 	return (mp);
@@ -2112,11 +2158,151 @@ static void
 kmem_depot_free(kmem_cache_t *cp, kmem_maglist_t *mlp, kmem_magazine_t *mp)
 {
 	mutex_enter(&cp->cache_depot_lock);
-	ASSERT(KMEM_MAGAZINE_VALID(cp, mp));
-	mp->mag_next = mlp->ml_list;
-	mlp->ml_list = mp;
-	mlp->ml_total++;
+	kmem_maglist_free(cp, mlp, mp);
+	mutex_exit(&cp->cache_depot_lock);
+}
+
+/*
+ * Allocate a full magazine from an lgroup depot.
+ */
+static kmem_magazine_t *
+kmem_lgrp_depot_alloc(kmem_cache_t *cp, kmem_lgrp_depot_t *ldp)
+{
+	kmem_magazine_t *mp;
+
+	kmem_depot_lock(cp, &ldp->kld_lock, &ldp->kld_contention);
+	mp = kmem_maglist_alloc(cp, &ldp->kld_full);
+	mutex_exit(&ldp->kld_lock);
+
+	return (mp);
+}
+
+/*
+ * Return the depot of the lgroup the current CPU belongs to, or NULL if
+ * full magazines go to the global depot.
+ */
+static kmem_lgrp_depot_t *
+kmem_lgrp_depot(kmem_cache_t *cp)
+{
+	lgrp_id_t lgrpid;
+
+	if (cp->cache_lgrp_depot == NULL)
+		return (NULL);
+
+	kpreempt_disable();
+	lgrpid = CPU->cpu_lpl->lpl_lgrpid;
+	kpreempt_enable();
+
+	if (lgrpid < 0 || lgrpid >= cp->cache_lgrp_ndepot)
+		return (NULL);
+
+	return (&cp->cache_lgrp_depot[lgrpid]);
+}
+
+/*
+ * Allocate a full magazine.  We prefer magazines freed on our own lgroup
+ * and then those in the global depot.  Rather than going to the slab
+ * layer while other lgroups are sitting on full magazines, we finally take
+ * one of theirs (unless kmem_lgrp_depot_steal is clear); such remote
+ * allocations are counted in cache_depot_remote.
+ */
+static kmem_magazine_t *
+kmem_depot_alloc_full(kmem_cache_t *cp)
+{
+	kmem_lgrp_depot_t *ldp, *rdp;
+	kmem_magazine_t *mp;
+	int i;
+
+	if ((ldp = kmem_lgrp_depot(cp)) == NULL)
+		return (kmem_depot_alloc(cp, &cp->cache_full));
+
+	if ((mp = kmem_lgrp_depot_alloc(cp, ldp)) != NULL)
+		return (mp);
+
+	if ((mp = kmem_depot_alloc(cp, &cp->cache_full)) != NULL ||
+	    !kmem_lgrp_depot_steal)
+		return (mp);
+
+	for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+		rdp = &cp->cache_lgrp_depot[i];
+
+		/*
+		 * Don't bother with (and bounce the lock of) depots
+		 * that look empty.
+		 */
+		if (rdp == ldp || rdp->kld_full.ml_list == NULL)
+			continue;
+
+		if ((mp = kmem_lgrp_depot_alloc(cp, rdp)) != NULL) {
+			atomic_inc_64(&cp->cache_depot_remote);
+			return (mp);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Free a full magazine to the depot of the current CPU's lgroup.
+ */
+static void
+kmem_depot_free_full(kmem_cache_t *cp, kmem_magazine_t *mp)
+{
+	kmem_lgrp_depot_t *ldp;
+
+	if ((ldp = kmem_lgrp_depot(cp)) == NULL) {
+		kmem_depot_free(cp, &cp->cache_full, mp);
+		return;
+	}
+
+	mutex_enter(&ldp->kld_lock);
+	kmem_maglist_free(cp, &ldp->kld_full, mp);
+	mutex_exit(&ldp->kld_lock);
+}
+
+/*
+ * Return the total depot contention count of a cache.
+ */
+static uint64_t
+kmem_depot_contention_total(kmem_cache_t *cp)
+{
+	uint64_t contention;
+	int i;
+
+	ASSERT(MUTEX_HELD(&cp->cache_depot_lock));
+
+	contention = cp->cache_depot_contention;
+	for (i = 0; i < cp->cache_lgrp_ndepot; i++)
+		contention += cp->cache_lgrp_depot[i].kld_contention;
+
+	return (contention);
+}
+
+/*
+ * Return the number of full magazines that have fallen out of the depot's
+ * working set.
+ */
+static long
+kmem_depot_reapable(kmem_cache_t *cp)
+{
+	kmem_lgrp_depot_t *ldp;
+	long reap, total;
+	int i;
+
+	mutex_enter(&cp->cache_depot_lock);
+	reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
+	total = MIN(reap, cp->cache_full.ml_total);
 	mutex_exit(&cp->cache_depot_lock);
+
+	for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+		ldp = &cp->cache_lgrp_depot[i];
+		mutex_enter(&ldp->kld_lock);
+		reap = MIN(ldp->kld_full.ml_reaplimit, ldp->kld_full.ml_min);
+		total += MIN(reap, ldp->kld_full.ml_total);
+		mutex_exit(&ldp->kld_lock);
+	}
+
+	return (total);
 }
 
 /*
@@ -2125,12 +2311,23 @@ kmem_depot_free(kmem_cache_t *cp, kmem_maglist_t *mlp, kmem_magazine_t *mp)
 static void
 kmem_depot_ws_update(kmem_cache_t *cp)
 {
+	kmem_lgrp_depot_t *ldp;
+	int i;
+
 	mutex_enter(&cp->cache_depot_lock);
 	cp->cache_full.ml_reaplimit = cp->cache_full.ml_min;
 	cp->cache_full.ml_min = cp->cache_full.ml_total;
 	cp->cache_empty.ml_reaplimit = cp->cache_empty.ml_min;
 	cp->cache_empty.ml_min = cp->cache_empty.ml_total;
 	mutex_exit(&cp->cache_depot_lock);
+
+	for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+		ldp = &cp->cache_lgrp_depot[i];
+		mutex_enter(&ldp->kld_lock);
+		ldp->kld_full.ml_reaplimit = ldp->kld_full.ml_min;
+		ldp->kld_full.ml_min = ldp->kld_full.ml_total;
+		mutex_exit(&ldp->kld_lock);
+	}
 }
 
 /*
@@ -2140,12 +2337,23 @@ kmem_depot_ws_update(kmem_cache_t *cp)
 static void
 kmem_depot_ws_zero(kmem_cache_t *cp)
 {
+	kmem_lgrp_depot_t *ldp;
+	int i;
+
 	mutex_enter(&cp->cache_depot_lock);
 	cp->cache_full.ml_reaplimit = cp->cache_full.ml_total;
 	cp->cache_full.ml_min = cp->cache_full.ml_total;
 	cp->cache_empty.ml_reaplimit = cp->cache_empty.ml_total;
 	cp->cache_empty.ml_min = cp->cache_empty.ml_total;
 	mutex_exit(&cp->cache_depot_lock);
+
+	for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+		ldp = &cp->cache_lgrp_depot[i];
+		mutex_enter(&ldp->kld_lock);
+		ldp->kld_full.ml_reaplimit = ldp->kld_full.ml_total;
+		ldp->kld_full.ml_min = ldp->kld_full.ml_total;
+		mutex_exit(&ldp->kld_lock);
+	}
 }
 
 /*
@@ -2164,6 +2372,8 @@ kmem_depot_ws_reap(kmem_cache_t *cp)
 	size_t bytes = 0;
 	long reap;
 	kmem_magazine_t *mp;
+	kmem_lgrp_depot_t *ldp;
+	int i;
 
 	ASSERT(!list_link_active(&cp->cache_link) ||
 	    taskq_member(kmem_taskq, curthread));
@@ -2179,6 +2389,22 @@ kmem_depot_ws_reap(kmem_cache_t *cp)
 		}
 	}
 
+	for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+		ldp = &cp->cache_lgrp_depot[i];
+		reap = MIN(ldp->kld_full.ml_reaplimit, ldp->kld_full.ml_min);
+		while (reap-- &&
+		    (mp = kmem_lgrp_depot_alloc(cp, ldp)) != NULL) {
+			kmem_magazine_destroy(cp, mp,
+			    cp->cache_magtype->mt_magsize);
+			bytes += cp->cache_magtype->mt_magsize *
+			    cp->cache_bufsize;
+			if (bytes > kmem_reap_preempt_bytes) {
+				kpreempt(KPREEMPT_SYNC);
+				bytes = 0;
+			}
+		}
+	}
+
 	reap = MIN(cp->cache_empty.ml_reaplimit, cp->cache_empty.ml_min);
 	while (reap-- &&
 	    (mp = kmem_depot_alloc(cp, &cp->cache_empty)) != NULL) {
@@ -2496,7 +2722,7 @@ kmem_cache_alloc(kmem_cache_t *cp, int kmflag)
 		/*
 		 * Try to get a full magazine from the depot.
 		 */
-		fmp = kmem_depot_alloc(cp, &cp->cache_full);
+		fmp = kmem_depot_alloc_full(cp);
 		if (fmp != NULL) {
 			if (ccp->cc_ploaded != NULL)
 				kmem_depot_free(cp, &cp->cache_empty,
@@ -2606,8 +2832,7 @@ kmem_cpucache_magazine_alloc(kmem_cpu_cache_t *ccp, kmem_cache_t *cp)
 	emp = kmem_depot_alloc(cp, &cp->cache_empty);
 	if (emp != NULL) {
 		if (ccp->cc_ploaded != NULL)
-			kmem_depot_free(cp, &cp->cache_full,
-			    ccp->cc_ploaded);
+			kmem_depot_free_full(cp, ccp->cc_ploaded);
 		kmem_cpu_reload(ccp, emp, 0);
 		return (1);
 	}
@@ -3056,13 +3281,19 @@ kmem_cache_reap(kmem_cache_t *cp)
 	 * callback is just an advisory plea for help.
 	 */
 	if (cp->cache_reclaim != NULL) {
+		kmem_lgrp_depot_t *ldp;
 		long delta;
+		int i;
 
 		/*
 		 * Reclaimed memory should be reapable (not included in the
 		 * depot's working set).
 		 */
 		delta = cp->cache_full.ml_total;
+		for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+			ldp = &cp->cache_lgrp_depot[i];
+			ldp->kld_reclaim = ldp->kld_full.ml_total;
+		}
 		cp->cache_reclaim(cp->cache_private);
 		delta = cp->cache_full.ml_total - delta;
 		if (delta > 0) {
@@ -3071,6 +3302,16 @@ kmem_cache_reap(kmem_cache_t *cp)
 			cp->cache_full.ml_min += delta;
 			mutex_exit(&cp->cache_depot_lock);
 		}
+		for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+			ldp = &cp->cache_lgrp_depot[i];
+			delta = ldp->kld_full.ml_total - ldp->kld_reclaim;
+			if (delta > 0) {
+				mutex_enter(&ldp->kld_lock);
+				ldp->kld_full.ml_reaplimit += delta;
+				ldp->kld_full.ml_min += delta;
+				mutex_exit(&ldp->kld_lock);
+			}
+		}
 	}
 
 	kmem_depot_ws_reap(cp);
@@ -3269,8 +3510,9 @@ kmem_cache_reap_soon(kmem_cache_t *cp)
  *
  * Changes to the magazine size are serialized by the kmem_taskq lock.
  *
- * Note: at present this only grows the magazine size.  It might be useful
- * to allow shrinkage too.
+ * The magazine size is grown when there is a lot of contention in the
+ * depot, and shrunk again (see kmem_cache_magazine_shrink()) once the depot
+ * has seen no contention at all for kmem_depot_shrink_intervals updates.
  */
 static void
 kmem_cache_magazine_resize(kmem_cache_t *cp)
@@ -3284,7 +3526,41 @@ kmem_cache_magazine_resize(kmem_cache_t *cp)
 		mutex_enter(&cp->cache_depot_lock);
 		cp->cache_magtype = ++mtp;
 		cp->cache_depot_contention_prev =
-		    cp->cache_depot_contention + INT_MAX;
+		    kmem_depot_contention_total(cp) + INT_MAX;
+		cp->cache_depot_quiet = 0;
+		mutex_exit(&cp->cache_depot_lock);
+		kmem_cache_magazine_enable(cp);
+	}
+}
+
+/*
+ * A cache's magazine size can be shrunk back down to the size it was
+ * created with, i.e. the first magazine type whose mt_minbuf is less than
+ * the chunk size.
+ */
+static int
+kmem_cache_magazine_shrinkable(kmem_cache_t *cp)
+{
+	kmem_magtype_t *mtp = cp->cache_magtype;
+
+	return (!(cp->cache_flags & KMF_NOMAGAZINE) && mtp > kmem_magtype &&
+	    cp->cache_chunksize > (mtp - 1)->mt_minbuf);
+}
+
+static void
+kmem_cache_magazine_shrink(kmem_cache_t *cp)
+{
+	kmem_magtype_t *mtp = cp->cache_magtype;
+
+	ASSERT(taskq_member(kmem_taskq, curthread));
+
+	if (kmem_cache_magazine_shrinkable(cp)) {
+		kmem_cache_magazine_purge(cp);
+		mutex_enter(&cp->cache_depot_lock);
+		cp->cache_magtype = --mtp;
+		cp->cache_depot_contention_prev =
+		    kmem_depot_contention_total(cp) + INT_MAX;
+		cp->cache_depot_quiet = 0;
 		mutex_exit(&cp->cache_depot_lock);
 		kmem_cache_magazine_enable(cp);
 	}
@@ -3350,6 +3626,9 @@ kmem_cache_update(kmem_cache_t *cp)
 {
 	int need_hash_rescale = 0;
 	int need_magazine_resize = 0;
+	int need_magazine_shrink = 0;
+	uint64_t contention;
+	int delta;
 
 	ASSERT(MUTEX_HELD(&kmem_cache_lock));
 
@@ -3374,16 +3653,26 @@ kmem_cache_update(kmem_cache_t *cp)
 
 	/*
 	 * If there's a lot of contention in the depot,
-	 * increase the magazine size.
+	 * increase the magazine size.  If there has been none
+	 * for a while, decrease it again.
 	 */
 	mutex_enter(&cp->cache_depot_lock);
 
+	contention = kmem_depot_contention_total(cp);
+	delta = (int)(contention - cp->cache_depot_contention_prev);
+
 	if (cp->cache_chunksize < cp->cache_magtype->mt_maxbuf &&
-	    (int)(cp->cache_depot_contention -
-	    cp->cache_depot_contention_prev) > kmem_depot_contention)
+	    delta > kmem_depot_contention)
 		need_magazine_resize = 1;
 
-	cp->cache_depot_contention_prev = cp->cache_depot_contention;
+	if (delta != 0 || kmem_depot_shrink_intervals <= 0) {
+		cp->cache_depot_quiet = 0;
+	} else if (++cp->cache_depot_quiet >= kmem_depot_shrink_intervals) {
+		cp->cache_depot_quiet = 0;
+		need_magazine_shrink = kmem_cache_magazine_shrinkable(cp);
+	}
+
+	cp->cache_depot_contention_prev = contention;
 
 	mutex_exit(&cp->cache_depot_lock);
 
@@ -3394,6 +3683,9 @@ kmem_cache_update(kmem_cache_t *cp)
 	if (need_magazine_resize)
 		(void) taskq_dispatch(kmem_taskq,
 		    (task_func_t *)kmem_cache_magazine_resize, cp, TQ_NOSLEEP);
+	else if (need_magazine_shrink)
+		(void) taskq_dispatch(kmem_taskq,
+		    (task_func_t *)kmem_cache_magazine_shrink, cp, TQ_NOSLEEP);
 
 	if (cp->cache_defrag != NULL)
 		(void) taskq_dispatch(kmem_taskq,
@@ -3430,7 +3722,7 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 	kmem_cache_t *cp = ksp->ks_private;
 	uint64_t cpu_buf_avail;
 	uint64_t buf_avail = 0;
-	int cpu_seqid;
+	int cpu_seqid, i;
 	long reap;
 
 	ASSERT(MUTEX_HELD(&kmem_cache_kstat_lock));
@@ -3479,11 +3771,28 @@ kmem_cache_kstat_update(kstat_t *ksp, int rw)
 	kmcp->kmc_free.value.ui64		+= cp->cache_empty.ml_alloc;
 	buf_avail += cp->cache_full.ml_total * cp->cache_magtype->mt_magsize;
 
-	reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
-	reap = MIN(reap, cp->cache_full.ml_total);
-
 	mutex_exit(&cp->cache_depot_lock);
 
+	for (i = 0; i < cp->cache_lgrp_ndepot; i++) {
+		kmem_lgrp_depot_t *ldp = &cp->cache_lgrp_depot[i];
+
+		mutex_enter(&ldp->kld_lock);
+
+		kmcp->kmc_depot_alloc.value.ui64 += ldp->kld_full.ml_alloc;
+		kmcp->kmc_depot_contention.value.ui64 += ldp->kld_contention;
+		kmcp->kmc_full_magazines.value.ui64 += ldp->kld_full.ml_total;
+		kmcp->kmc_alloc.value.ui64	+= ldp->kld_full.ml_alloc;
+		buf_avail += ldp->kld_full.ml_total *
+		    cp->cache_magtype->mt_magsize;
+
+		mutex_exit(&ldp->kld_lock);
+	}
+
+	kmcp->kmc_depot_remote.value.ui64	= cp->cache_depot_remote;
+	kmcp->kmc_depot_lock_wait.value.ui64	= cp->cache_depot_lock_wait;
+
+	reap = kmem_depot_reapable(cp);
+
 	kmcp->kmc_buf_size.value.ui64	= cp->cache_bufsize;
 	kmcp->kmc_align.value.ui64	= cp->cache_align;
 	kmcp->kmc_chunk_size.value.ui64	= cp->cache_chunksize;
@@ -3692,7 +4001,7 @@ kmem_cache_create(
 	vmem_t *vmp,		/* vmem source for slab allocation */
 	int cflags)		/* cache creation flags */
 {
-	int cpu_seqid;
+	int cpu_seqid, i;
 	size_t chunksize;
 	kmem_cache_t *cp;
 	kmem_magtype_t *mtp;
@@ -3950,6 +4259,23 @@ kmem_cache_create(
 
 	cp->cache_magtype = mtp;
 
+	/*
+	 * Full magazines are kept per lgroup on machines with more than one.
+	 */
+	if (kmem_lgrp_depot_enable && nlgrpsmax > 1 &&
+	    !(cp->cache_flags & KMF_NOMAGAZINE)) {
+		size_t dsize = nlgrpsmax * sizeof (kmem_lgrp_depot_t);
+
+		cp->cache_lgrp_depot = vmem_xalloc(kmem_cache_arena, dsize,
+		    KMEM_LGRP_DEPOT_SIZE, 0, 0, NULL, NULL, VM_SLEEP);
+		bzero(cp->cache_lgrp_depot, dsize);
+		for (i = 0; i < nlgrpsmax; i++) {
+			mutex_init(&cp->cache_lgrp_depot[i].kld_lock, NULL,
+			    MUTEX_DEFAULT, NULL);
+		}
+		cp->cache_lgrp_ndepot = nlgrpsmax;
+	}
+
 	/*
 	 * Initialize the CPU layer.
 	 */
@@ -4084,7 +4410,7 @@ kmem_cache_set_move(kmem_cache_t *cp,
 void
 kmem_cache_destroy(kmem_cache_t *cp)
 {
-	int cpu_seqid;
+	int cpu_seqid, i;
 
 	/*
 	 * Remove the cache from the global cache list so that no one else
@@ -4134,6 +4460,13 @@ kmem_cache_destroy(kmem_cache_t *cp)
 	for (cpu_seqid = 0; cpu_seqid < max_ncpus; cpu_seqid++)
 		mutex_destroy(&cp->cache_cpu[cpu_seqid].cc_lock);
 
+	if (cp->cache_lgrp_depot != NULL) {
+		for (i = 0; i < cp->cache_lgrp_ndepot; i++)
+			mutex_destroy(&cp->cache_lgrp_depot[i].kld_lock);
+		vmem_free(kmem_cache_arena, cp->cache_lgrp_depot,
+		    cp->cache_lgrp_ndepot * sizeof (kmem_lgrp_depot_t));
+	}
+
 	mutex_destroy(&cp->cache_depot_lock);
 	mutex_destroy(&cp->cache_lock);
 
@@ -5328,12 +5661,7 @@ kmem_cache_is_fragmented(kmem_cache_t *cp, boolean_t *doreap)
 	 * have fallen out of the working set.
 	 */
 	if (!fragmented) {
-		long reap;
-
-		mutex_enter(&cp->cache_depot_lock);
-		reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
-		reap = MIN(reap, cp->cache_full.ml_total);
-		mutex_exit(&cp->cache_depot_lock);
+		long reap = kmem_depot_reapable(cp);
 
 		nfree += ((uint64_t)reap * cp->cache_magtype->mt_magsize);
 		if (kmem_cache_frag_threshold(cp, nfree)) {
@@ -24,6 +24,7 @@
  */
 
 #include <sys/types.h>
+#include <hd_crc.h>
 
 /*
  * Fast CRC32 calculation algorithm suggested by Ferenc Rakoczi
@@ -41,6 +42,14 @@
 /* The four CRC tables. */
 static uint32_t crctab[4][256];
 
+/*
+ * Set by sctp_crc32_init() when the CPU has the SSE4.2 crc32 instruction,
+ * in which case sctp_crc32() skips the tables altogether.  The same
+ * routine backs the iSCSI header and data digests in idm, so both get
+ * the hardware path.
+ */
+static boolean_t sctp_crc32_hw = B_FALSE;
+
 static uint32_t
 reflect_32(uint32_t b)
 {
@@ -89,6 +98,12 @@ sctp_crc32_init(void)
 #endif
 		}
 	}
+
+	/*
+	 * hd_crc32_avail() only says yes on x86 and only when our table
+	 * matches the polynomial the instruction implements.
+	 */
+	sctp_crc32_hw = hd_crc32_avail(crctab[0]);
 }
 
 static void
@@ -128,6 +143,15 @@ sctp_crc32(uint32_t crc32, const uint8_t *buf, int len)
 {
 	int rem;
 
+	/*
+	 * HW_CRC32() finalizes (complements) its result; undo that so
+	 * callers keep chaining the raw register across buffers.
+	 */
+	if (sctp_crc32_hw && len > 0) {
+		return (HW_CRC32((uint8_t *)buf, (unsigned long)len,
+		    crc32) ^ 0xFFFFFFFF);
+	}
+
 	rem = 4 - ((uintptr_t)buf) & 3;
 	if (rem != 0) {
 		if (len < rem) {
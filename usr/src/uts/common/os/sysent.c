@@ -320,8 +320,10 @@ int	shutdown(int, int, int);
 ssize_t	recv(int, void *, size_t, int);
 ssize_t	recvfrom(int, void *, size_t, int, struct sockaddr *, socklen_t *);
 ssize_t	recvmsg(int, struct nmsghdr *, int);
+int	recvmmsg(int, struct nmmsghdr *, uint_t, int, timespec_t *);
 ssize_t	send(int, void *, size_t, int);
 ssize_t	sendmsg(int, struct nmsghdr *, int);
+int	sendmmsg(int, struct nmmsghdr *, uint_t, int);
 ssize_t	sendto(int, void *, size_t, int, struct sockaddr *, socklen_t);
 int	getpeername(int, struct sockaddr *, socklen_t *, int);
 int	getsockname(int, struct sockaddr *, socklen_t *, int);
@@ -606,11 +608,11 @@ struct sysent sysent[NSYSCALL] =
 	/* 140 */ SYSENT_LOADABLE(),		/* sharefs */
 	/* 141 */ SYSENT_CI("seteuid",		seteuid,	1),
 	/* 142 */ SYSENT_2CI("forksys",		forksys,	2),
-	/* 143 */ SYSENT_LOADABLE(),			/* (was fork1) */
+	/* 143 */ SYSENT_CI("recvmmsg",	recvmmsg,	5),
 	/* 144 */ SYSENT_CI("sigtimedwait",	sigtimedwait,	3),
 	/* 145 */ SYSENT_CI("lwp_info",		lwp_info,	1),
 	/* 146 */ SYSENT_CI("yield",		yield,		0),
-	/* 147 */ SYSENT_LOADABLE(),		    /* (was lwp_sema_wait) */
+	/* 147 */ SYSENT_CI("sendmmsg",	sendmmsg,	4),
 	/* 148 */ SYSENT_CI("lwp_sema_post",	lwp_sema_post,	1),
 	/* 149 */ SYSENT_CI("lwp_sema_trywait",	lwp_sema_trywait, 1),
 	/* 150 */ SYSENT_CI("lwp_detach",	lwp_detach,	1),
@@ -967,11 +969,11 @@ struct sysent sysent32[NSYSCALL] =
 	/* 140 */ SYSENT_LOADABLE32(),		/* sharefs */
 	/* 141 */ SYSENT_CI("seteuid",		seteuid,	1),
 	/* 142 */ SYSENT_2CI("forksys",		forksys,	2),
-	/* 143 */ SYSENT_LOADABLE32(),			/* (was fork1) */
+	/* 143 */ SYSENT_CI("recvmmsg",	recvmmsg,	5),
 	/* 144 */ SYSENT_CI("sigtimedwait",	sigtimedwait,	3),
 	/* 145 */ SYSENT_CI("lwp_info",		lwp_info,	1),
 	/* 146 */ SYSENT_CI("yield",		yield,		0),
-	/* 147 */ SYSENT_LOADABLE32(),		    /* (was lwp_sema_wait) */
+	/* 147 */ SYSENT_CI("sendmmsg",	sendmmsg,	4),
 	/* 148 */ SYSENT_CI("lwp_sema_post",	lwp_sema_post,	1),
 	/* 149 */ SYSENT_CI("lwp_sema_trywait",	lwp_sema_trywait, 1),
 	/* 150 */ SYSENT_CI("lwp_detach",	lwp_detach,	1),
@@ -2325,6 +2325,9 @@ zone_misc_kstat_update(kstat_t *ksp, int rw)
 	zmp->zm_init_pid.value.ui32 = zone->zone_proc_initpid;
 	zmp->zm_boot_time.value.ui64 = (uint64_t)zone->zone_boot_time;
 
+	zmp->zm_dnlc_entries.value.ui64 = zone->zone_dnlc_entries;
+	zmp->zm_dnlc_bytes.value.ui64 = zone->zone_dnlc_bytes;
+
 	return (0);
 }
 
@@ -2369,6 +2372,9 @@ zone_misc_kstat_create(zone_t *zone)
 	    KSTAT_DATA_UINT32);
 	kstat_named_init(&zmp->zm_init_pid, "init_pid", KSTAT_DATA_UINT32);
 	kstat_named_init(&zmp->zm_boot_time, "boot_time", KSTAT_DATA_UINT64);
+	kstat_named_init(&zmp->zm_dnlc_entries, "dnlc_entries",
+	    KSTAT_DATA_UINT64);
+	kstat_named_init(&zmp->zm_dnlc_bytes, "dnlc_bytes", KSTAT_DATA_UINT64);
 
 	ksp->ks_update = zone_misc_kstat_update;
 	ksp->ks_private = zone;
@@ -377,7 +377,13 @@ typedef struct mir_s {
 		mir_listen_stream : 1,	/* listen end point */
 		mir_unused : 1,	/* no longer used */
 		mir_timer_call : 1,
-		mir_junk_fill_thru_bit_31 : 21;
+		/*
+		 * On server streams, a thread is passing replies
+		 * downstream in mir_svc_wsend(); others add theirs to
+		 * mir_wbatch_head for it to send.
+		 */
+		mir_wsending : 1,
+		mir_junk_fill_thru_bit_31 : 20;
 
 	int	mir_setup_complete;	/* server has initialized everything */
 	timeout_id_t mir_timer_id;	/* Timer for idle checks */
@@ -415,6 +421,15 @@ typedef struct mir_s {
 
 	mblk_t	*mir_svc_pend_mp;	/* Pending T_ORDREL_IND or */
 					/* T_DISCON_IND */
+	mblk_t	*mir_wbatch_head;	/* Replies waiting for mir_wsending */
+	mblk_t	*mir_wbatch_tail;	/* Last mblk in mir_wbatch_head */
+		/*
+		 * The replies are linked into one message through b_cont;
+		 * each carries its own record marking header, so the
+		 * client sees them as consecutive records.
+		 */
+	uint_t	mir_wbatch_cnt;		/* Replies in mir_wbatch_head */
+	size_t	mir_wbatch_bytes;	/* Bytes in mir_wbatch_head */
 
 	/*
 	 * these fields are for both client and server, but for debugging,
@@ -1019,6 +1034,7 @@ static void	mir_clnt_idle_start(queue_t *, mir_t *);
 static void	mir_wput(queue_t *q, mblk_t *mp);
 static void	mir_wput_other(queue_t *q, mblk_t *mp);
 static void	mir_wsrv(queue_t *q);
+static void	mir_svc_wsend(queue_t *, mir_t *, mblk_t *);
 static	void	mir_disconnect(queue_t *, mir_t *ir);
 static	int	mir_check_len(queue_t *, mblk_t *);
 static	void	mir_timer(void *);
@@ -1041,6 +1057,18 @@ uint_t	clnt_max_msg_size = RPC_MAXDATASIZE;
 uint_t	svc_max_msg_size = RPC_MAXDATASIZE;
 uint_t	mir_krpc_cell_null;
 
+/*
+ * Largest message that server replies are coalesced into while another
+ * thread is sending on the same connection; 0 disables coalescing.
+ */
+size_t	rpcmod_reply_coalesce_max = 64 * 1024;
+
+/*
+ * Most batches of coalesced replies one thread sends before it leaves the
+ * rest to mir_wsrv(), so that it is not kept sending for ever under load.
+ */
+uint_t	rpcmod_reply_coalesce_rounds = 16;
+
 static void
 mir_timer_stop(mir_t *mir)
 {
@@ -1150,7 +1178,8 @@ mir_close(queue_t *q)
 		 */
 		mir_svc_start_close(WR(q), mir);
 
-		while ((!MIR_SVC_QUIESCED(mir)) || mir->mir_inwservice == 1) {
+		while ((!MIR_SVC_QUIESCED(mir)) || mir->mir_inwservice == 1 ||
+		    mir->mir_wsending) {
 
 			if (mir->mir_ref_cnt && !mir->mir_inrservice &&
 			    (queue_cleaned == FALSE)) {
@@ -2348,6 +2377,43 @@ mir_wput(queue_t *q, mblk_t *mp)
 		mir->mir_use_timestamp = ddi_get_lbolt();
 	}
 
+	/*
+	 * On the server, many threads reply on the same connection at once.
+	 * Rather than have them all contend in the transport below, the
+	 * first one sends and the others leave their replies to it, to go
+	 * down together as one message once its own has gone.
+	 */
+	if (mir->mir_type == RPC_SERVER && !mir->mir_inwservice &&
+	    rpcmod_reply_coalesce_max != 0) {
+		if (mir->mir_wsending) {
+			mblk_t	*tail;
+			size_t	size = 0;
+
+			for (tail = mp; tail->b_cont != NULL;
+			    tail = tail->b_cont)
+				size += MBLKL(tail);
+			size += MBLKL(tail);
+
+			if (mir->mir_wbatch_bytes + size <=
+			    rpcmod_reply_coalesce_max) {
+				if (mir->mir_wbatch_head == NULL)
+					mir->mir_wbatch_head = mp;
+				else
+					mir->mir_wbatch_tail->b_cont = mp;
+				mir->mir_wbatch_tail = tail;
+				mir->mir_wbatch_cnt++;
+				mir->mir_wbatch_bytes += size;
+				mutex_exit(&mir->mir_mutex);
+				return;
+			}
+		} else if (MIR_WCANPUTNEXT(mir, q)) {
+			mir->mir_wsending = 1;
+			mutex_exit(&mir->mir_mutex);
+			mir_svc_wsend(q, mir, mp);
+			return;
+		}
+	}
+
 	/*
 	 * If we haven't already queued some data and the downstream module
 	 * can accept more data, send it on, otherwise we queue the message
@@ -2557,9 +2623,11 @@ ioc_eperm:
 			 * to go before data. When we had a separate reply
 			 * count, this was not a problem, because the
 			 * reply count was reconciled when mir_wsrv()
-			 * completed.
+			 * completed.  Replies being sent by mir_svc_wsend()
+			 * count as queued data too; it enables the queue
+			 * when it is done.
 			 */
-			if (!MIR_SVC_QUIESCED(mir) ||
+			if (!MIR_SVC_QUIESCED(mir) || mir->mir_wsending ||
 			    mir->mir_inwservice == 1) {
 				mir->mir_inwservice = 1;
 				(void) putq(q, mp);
@@ -2656,6 +2724,75 @@ ioc_eperm:
 	putnext(q, mp);
 }
 
+/*
+ * This is server side only (RPC_SERVER).
+ *
+ * Send a reply, then whatever replies other threads have left in
+ * mir_wbatch_head meanwhile, until there are none or it has sent
+ * rpcmod_reply_coalesce_rounds batches.  Called with mir_wsending set;
+ * clears it on return.  mir_wsrv() and an orderly release wait while it
+ * is set, since the replies in hand belong to threads that have already
+ * called mir_svc_release() and so do not keep the stream from looking
+ * idle.
+ */
+static void
+mir_svc_wsend(queue_t *q, mir_t *mir, mblk_t *mp)
+{
+	uint_t	cnt = 1;
+	uint_t	rounds = 0;
+
+	for (;;) {
+		putnext(q, mp);
+		if (cnt > 1)
+			svc_reply_coalesced(q, cnt);
+
+		mutex_enter(&mir->mir_mutex);
+		ASSERT(mir->mir_wsending);
+		if ((mp = mir->mir_wbatch_head) == NULL)
+			break;
+		cnt = mir->mir_wbatch_cnt;
+		mir->mir_wbatch_head = NULL;
+		mir->mir_wbatch_tail = NULL;
+		mir->mir_wbatch_cnt = 0;
+		mir->mir_wbatch_bytes = 0;
+
+		/*
+		 * A T_ORDREL_REQ cannot have gone down while we were sending,
+		 * so it went before these replies were passed to us.  Drop
+		 * them, as mir_wsrv() would.
+		 */
+		if (mir->mir_ordrel_pending == 1) {
+			freemsg(mp);
+			break;
+		}
+
+		/*
+		 * If the transport has filled up, other messages are already
+		 * queued, or this thread has sent for long enough, leave the
+		 * replies to mir_wsrv().  They were passed to us before
+		 * anything on the queue, so they go in front of it.
+		 */
+		if (mir->mir_inwservice || !MIR_WCANPUTNEXT(mir, q) ||
+		    ++rounds >= rpcmod_reply_coalesce_rounds) {
+			if (!MIR_WCANPUTNEXT(mir, q))
+				mir->mir_hold_inbound = 1;
+			mir->mir_inwservice = 1;
+			(void) putbq(q, mp);
+			if (cnt > 1)
+				svc_reply_coalesced(q, cnt);
+			break;
+		}
+		mutex_exit(&mir->mir_mutex);
+	}
+
+	mir->mir_wsending = 0;
+	if (mir->mir_inwservice)
+		qenable(q);
+	if (mir->mir_closing)
+		cv_signal(&mir->mir_condvar);
+	mutex_exit(&mir->mir_mutex);
+}
+
 static void
 mir_wsrv(queue_t *q)
 {
@@ -2666,6 +2803,15 @@ mir_wsrv(queue_t *q)
 	mir = (mir_t *)q->q_ptr;
 	mutex_enter(&mir->mir_mutex);
 
+	/*
+	 * Replies in mir_svc_wsend() must go before anything queued here.
+	 * It enables the queue again when it is done.
+	 */
+	if (mir->mir_wsending) {
+		mutex_exit(&mir->mir_mutex);
+		return;
+	}
+
 	flushdata = mir->mir_inwflushdata;
 	mir->mir_inwflushdata = 0;
 
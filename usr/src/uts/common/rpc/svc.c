@@ -51,6 +51,8 @@
  *   master structure are protected by locks
  *   - xp_req_lock protects the request queue:
  *	xp_req_head, xp_req_tail, xp_reqs, xp_size, xp_full, xp_enable
+ *	and the statistics xp_reqs_max, xp_served, xp_svc_time and
+ *	xp_svc_time_max, which are exported as unix:<n>:rpc_svc_xprt
  *   - xp_thread_lock protects the thread (clone) counts
  *	xp_threads, xp_detached_threads, xp_wq
  *   Each master transport is registered to exactly one thread pool.
@@ -178,6 +180,13 @@
  *   a reservation, and if the reservation was granted it can detach itself.
  *   If a reservation was granted but the thread does not detach itself
  *   it should cancel the reservation before it returns to svc_run().
+ *
+ * Replies.
+ *   Many threads may be working on the requests of one transport, and
+ *   each of them sends its own reply. On connection oriented transports
+ *   rpcmod coalesces the replies that arrive while another thread is
+ *   passing one downstream into a single message (see mir_wput()), and
+ *   counts them with svc_reply_coalesced().
  */
 
 #include <sys/param.h>
@@ -206,6 +215,8 @@
 #include <sys/callb.h>
 #include <sys/vtrace.h>
 #include <sys/zone.h>
+#include <sys/kstat.h>
+#include <sys/atomic.h>
 #include <nfs/nfs.h>
 #include <sys/tsol/label_macro.h>
 
@@ -252,6 +263,35 @@ int    svc_default_maxthreads = DEFAULT_SVC_MAXTHREADS;
 
 int    svc_default_max_same_xprt = DEFAULT_SVC_MAX_SAME_XPRT;
 
+/*
+ * Per-transport statistics, exported as unix:<n>:rpc_svc_xprt.
+ */
+typedef struct svc_xprt_kstat {
+	kstat_named_t	sx_pool;
+	kstat_named_t	sx_queued;
+	kstat_named_t	sx_queued_max;
+	kstat_named_t	sx_queued_bytes;
+	kstat_named_t	sx_threads;
+	kstat_named_t	sx_served;
+	kstat_named_t	sx_svc_time;
+	kstat_named_t	sx_svc_time_max;
+	kstat_named_t	sx_coalesced;
+} svc_xprt_kstat_t;
+
+static const svc_xprt_kstat_t svc_xprt_kstat_template = {
+	{ "pool",		KSTAT_DATA_INT32 },
+	{ "queued",		KSTAT_DATA_INT32 },
+	{ "queued_max",		KSTAT_DATA_INT32 },
+	{ "queued_bytes",	KSTAT_DATA_UINT64 },
+	{ "threads",		KSTAT_DATA_INT32 },
+	{ "served",		KSTAT_DATA_UINT64 },
+	{ "service_time",	KSTAT_DATA_UINT64 },
+	{ "service_time_max",	KSTAT_DATA_UINT64 },
+	{ "replies_coalesced",	KSTAT_DATA_UINT64 },
+};
+
+static uint32_t svc_xprt_kstat_instance;
+
 
 /*
  * Default `Redline' of non-detached threads.
@@ -748,6 +788,55 @@ svc_pool_control(int id, int cmd, void *arg)
 	}
 }
 
+static int
+svc_xprt_kstat_update(kstat_t *ksp, int rw)
+{
+	SVCMASTERXPRT *xprt = ksp->ks_private;
+	svc_xprt_kstat_t *sx = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	mutex_enter(&xprt->xp_req_lock);
+	sx->sx_pool.value.i32 = xprt->xp_pool->p_id;
+	sx->sx_queued.value.i32 = xprt->xp_reqs;
+	sx->sx_queued_max.value.i32 = xprt->xp_reqs_max;
+	sx->sx_queued_bytes.value.ui64 = xprt->xp_size;
+	sx->sx_threads.value.i32 = xprt->xp_threads;
+	sx->sx_served.value.ui64 = xprt->xp_served;
+	sx->sx_svc_time.value.ui64 = xprt->xp_svc_time;
+	sx->sx_svc_time_max.value.ui64 = xprt->xp_svc_time_max;
+	mutex_exit(&xprt->xp_req_lock);
+	sx->sx_coalesced.value.ui64 = xprt->xp_coalesced;
+
+	return (0);
+}
+
+/*
+ * Create the statistics of a newly registered transport.  They are not
+ * essential, so a failure here is not passed on.
+ */
+static void
+svc_xprt_kstat_create(SVCMASTERXPRT *xprt)
+{
+	kstat_t *ksp;
+
+	ksp = kstat_create_zone("unix",
+	    atomic_inc_32_nv(&svc_xprt_kstat_instance), "rpc_svc_xprt", "rpc",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (svc_xprt_kstat_t) / sizeof (kstat_named_t),
+	    0, getzoneid());
+	if (ksp == NULL)
+		return;
+
+	bcopy(&svc_xprt_kstat_template, ksp->ks_data,
+	    sizeof (svc_xprt_kstat_t));
+	ksp->ks_private = xprt;
+	ksp->ks_update = svc_xprt_kstat_update;
+	kstat_install(ksp);
+	xprt->xp_ksp = ksp;
+}
+
 /*
  * Pool's transport list manipulation routines.
  * - svc_xprt_register()
@@ -816,6 +905,8 @@ svc_xprt_register(SVCMASTERXPRT *xprt, int id)
 	pool->p_lcount++;
 
 	rw_exit(&pool->p_lrwlock);
+
+	svc_xprt_kstat_create(xprt);
 	return (0);
 }
 
@@ -856,6 +947,11 @@ svc_xprt_unregister(SVCMASTERXPRT *xprt)
 	pool->p_lcount--;
 
 	rw_exit(&pool->p_lrwlock);
+
+	if (xprt->xp_ksp != NULL) {
+		kstat_delete(xprt->xp_ksp);
+		xprt->xp_ksp = NULL;
+	}
 }
 
 static void
@@ -2212,6 +2308,7 @@ svc_run(SVCPOOL *pool)
 		mblk_t *mp;
 		bool_t enable;
 		size_t size;
+		hrtime_t start;
 
 		TRACE_0(TR_FAC_KRPC, TR_SVC_RUN, "svc_run");
 
@@ -2344,6 +2441,7 @@ svc_run(SVCPOOL *pool)
 		/*
 		 * Process the request.
 		 */
+		start = gethrtime();
 		svc_getreq(clone_xprt, mp);
 
 		/* If thread had a reservation it should have been canceled */
@@ -2363,7 +2461,12 @@ svc_run(SVCPOOL *pool)
 		 * Release our reference on the rpcmod
 		 * slot attached to xp_wq->q_ptr.
 		 */
+		start = gethrtime() - start;
 		mutex_enter(&xprt->xp_req_lock);
+		xprt->xp_served++;
+		xprt->xp_svc_time += start;
+		if (start > xprt->xp_svc_time_max)
+			xprt->xp_svc_time_max = start;
 		enable = xprt->xp_enable;
 		if (enable)
 			xprt->xp_enable = FALSE;
@@ -2408,6 +2511,18 @@ svc_queueclean(queue_t *q)
 	mutex_exit(&xprt->xp_req_lock);
 }
 
+/*
+ * Called from rpcmod when it has sent `cnt' replies on the queue as one
+ * message.
+ */
+void
+svc_reply_coalesced(queue_t *q, uint_t cnt)
+{
+	SVCMASTERXPRT *xprt = ((void **) q->q_ptr)[0];
+
+	atomic_add_64(&xprt->xp_coalesced, cnt);
+}
+
 /*
  * This routine is called by rpcmod to inform kernel RPC that a
  * queue is closing. It is called after all the requests have been
@@ -2541,6 +2656,8 @@ svc_queuereq(queue_t *q, mblk_t *mp, bool_t flowcontrol)
 	/* Increment counters */
 	pool->p_reqs++;
 	xprt->xp_reqs++;
+	if (xprt->xp_reqs > xprt->xp_reqs_max)
+		xprt->xp_reqs_max = xprt->xp_reqs;
 
 	size = svc_msgsize(mp);
 	xprt->xp_size += size;
@@ -440,6 +440,14 @@ struct __svcmasterxprt {
 	int		xp_enable : 1;	/* xprt needs to be enabled	*/
 	int		xp_reqs;	/* number of requests queued	*/
 	size_t		xp_size;	/* total size of queued msgs	*/
+
+	/* Statistics, protected by xp_req_lock except xp_coalesced */
+	struct kstat	*xp_ksp;	/* unix:<n>:rpc_svc_xprt	*/
+	int		xp_reqs_max;	/* high water mark of xp_reqs	*/
+	uint64_t	xp_served;	/* requests served		*/
+	hrtime_t	xp_svc_time;	/* total service time		*/
+	hrtime_t	xp_svc_time_max; /* longest service time	*/
+	uint64_t	xp_coalesced;	/* replies sent coalesced	*/
 };
 
 /*
@@ -820,6 +828,7 @@ extern int	svc_cots_kcreate(struct file *, uint_t, struct T_info_ack *,
 				SVCMASTERXPRT **);
 extern bool_t	svc_queuereq(queue_t *, mblk_t *, bool_t);
 extern void	svc_queueclean(queue_t *);
+extern void	svc_reply_coalesced(queue_t *, uint_t);
 extern void	svc_queueclose(queue_t *);
 extern int	svc_reserve_thread(SVCXPRT *);
 extern void	svc_unreserve_thread(SVCXPRT *);
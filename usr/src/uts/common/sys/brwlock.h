@@ -0,0 +1,73 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Copyright 2021 OmniOS Community Edition (OmniOSce) Association.
+ */
+
+#ifndef _SYS_BRWLOCK_H
+#define	_SYS_BRWLOCK_H
+
+/*
+ * Read-mostly ("big reader") readers/writer lock. Readers only touch a
+ * per-CPU reader count, so read acquisitions on different CPUs do not
+ * contend. Writers are pessimized: they have to drain the reader counts
+ * of all CPUs. See brwlock.c for details.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <sys/ksynch.h>
+#include <sys/rwlock.h>
+
+typedef struct brw_cpu {
+	volatile int64_t brc_readers;	/* readers accounted on this CPU */
+	char		brc_pad[64 - sizeof (int64_t)];	/* cache line */
+} brw_cpu_t;
+
+typedef struct brwlock {
+	brw_cpu_t	*brw_cpu;	/* per-CPU reader counts */
+	uint_t		brw_ncpu;	/* number of per-CPU reader counts */
+	volatile uint_t	brw_writer;	/* writer draining or holding lock */
+	struct _kthread	*brw_owner;	/* writer holding the lock */
+	void		*brw_base;	/* unaligned per-CPU allocation */
+	size_t		brw_size;	/* size of per-CPU allocation */
+	krwlock_t	brw_lock;	/* writers and blocked readers */
+	kmutex_t	brw_wlock;	/* protects brw_wcv */
+	kcondvar_t	brw_wcv;	/* writer waits for readers to drain */
+} brwlock_t;
+
+/*
+ * The interfaces below are private and might change without notice.
+ */
+
+#define	BRW_READ_HELD(l)	(brw_read_held(l))
+#define	BRW_WRITE_HELD(l)	(brw_write_held(l))
+#define	BRW_LOCK_HELD(l)	(brw_lock_held(l))
+
+extern void brw_init(brwlock_t *, char *, krw_type_t, void *);
+extern void brw_destroy(brwlock_t *);
+extern void brw_enter(brwlock_t *, krw_t);
+extern int brw_tryenter(brwlock_t *, krw_t);
+extern void brw_exit(brwlock_t *);
+extern int brw_read_held(brwlock_t *);
+extern int brw_write_held(brwlock_t *);
+extern int brw_lock_held(brwlock_t *);
+extern struct _kthread *brw_owner(brwlock_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SYS_BRWLOCK_H */
@@ -230,6 +230,8 @@ typedef struct callout_hash {
  *	Callout list is present in the callout heap.
  * CALLOUT_LIST_FLAG_QUEUED
  *	Callout list is present in the callout queue.
+ * CALLOUT_LIST_FLAG_WHEELED
+ *	Callout list is present in the callout timing wheel.
  */
 #define	CALLOUT_LIST_FLAG_FREE			0x1
 #define	CALLOUT_LIST_FLAG_ABSOLUTE		0x2
@@ -237,6 +239,7 @@ typedef struct callout_hash {
 #define	CALLOUT_LIST_FLAG_NANO			0x8
 #define	CALLOUT_LIST_FLAG_HEAPED		0x10
 #define	CALLOUT_LIST_FLAG_QUEUED		0x20
+#define	CALLOUT_LIST_FLAG_WHEELED		0x40
 
 struct callout_list {
 	callout_list_t	*cl_next;	/* next in clhash */
@@ -244,6 +247,9 @@ struct callout_list {
 	hrtime_t	cl_expiration;	/* expiration for callouts in list */
 	callout_hash_t	cl_callouts;	/* list of callouts */
 	int		cl_flags;	/* callout flags */
+	callout_list_t	*cl_wnext;	/* next in wheel slot */
+	callout_list_t	*cl_wprev;	/* prev in wheel slot */
+	callout_hash_t	*cl_wslot;	/* wheel slot the list is queued in */
 };
 
 /*
@@ -265,6 +271,36 @@ typedef struct callout_heap {
 #endif
 } callout_heap_t;
 
+/*
+ * Hierarchical timing wheel. Low resolution callout lists (those whose
+ * resolution is a multiple of callout_wheel_resolution) can optionally be
+ * placed in a timing wheel instead of the heap. This makes the insertion
+ * and cancellation of such callout lists O(1) instead of O(log n).
+ *
+ * The wheel has CALLOUT_WHEEL_LEVELS levels of CALLOUT_WHEEL_SLOTS slots
+ * each. A callout list whose expiration is less than CALLOUT_WHEEL_SPAN(0)
+ * wheel ticks away is queued in a level 0 slot. Otherwise, it is queued in
+ * the lowest level that can represent its expiration. Whenever the level 0
+ * index wraps, the current slot of the next level is cascaded down into the
+ * lower levels. Callout lists that are further away than the span of the
+ * top level are parked in the top level and re-examined on each cascade.
+ */
+#define	CALLOUT_WHEEL_BITS	8
+#define	CALLOUT_WHEEL_SLOTS	(1 << CALLOUT_WHEEL_BITS)
+#define	CALLOUT_WHEEL_MASK	(CALLOUT_WHEEL_SLOTS - 1)
+#define	CALLOUT_WHEEL_LEVELS	4
+#define	CALLOUT_WHEEL_SPAN(l)	(1LL << (CALLOUT_WHEEL_BITS * ((l) + 1)))
+#define	CALLOUT_WHEEL_INDEX(t, l)	\
+	(((t) >> (CALLOUT_WHEEL_BITS * (l))) & CALLOUT_WHEEL_MASK)
+
+typedef struct callout_wheel {
+	hrtime_t	cw_tick;	/* next wheel tick to be processed */
+	hrtime_t	cw_next;	/* wheel cyclic expiration */
+	ulong_t		cw_num;		/* callout lists in the wheel */
+	cyclic_id_t	cw_cyclic;	/* cyclic that turns the wheel */
+	callout_hash_t	cw_slots[CALLOUT_WHEEL_LEVELS][CALLOUT_WHEEL_SLOTS];
+} callout_wheel_t;
+
 /*
  * When the heap contains too many empty callout lists, it needs to be
  * cleaned up. The decision to clean up the heap is a function of the
@@ -296,6 +332,16 @@ typedef struct callout_heap {
  *	Number of callout structures allocated.
  * CALLOUT_CLEANUPS
  *	Number of times a callout table is cleaned up.
+ * CALLOUT_HEAP_INSERTS
+ *	Number of callout lists inserted into the heap.
+ * CALLOUT_HEAP_CANCELS
+ *	Number of heap callout lists emptied by cancellation.
+ * CALLOUT_WHEEL_INSERTS
+ *	Number of callout lists inserted into the timing wheel.
+ * CALLOUT_WHEEL_CANCELS
+ *	Number of wheel callout lists emptied by cancellation.
+ * CALLOUT_WHEEL_CASCADES
+ *	Number of timing wheel slots cascaded to a lower level.
  */
 typedef enum callout_stat_type {
 	CALLOUT_TIMEOUTS,
@@ -306,6 +352,11 @@ typedef enum callout_stat_type {
 	CALLOUT_EXPIRATIONS,
 	CALLOUT_ALLOCATIONS,
 	CALLOUT_CLEANUPS,
+	CALLOUT_HEAP_INSERTS,
+	CALLOUT_HEAP_CANCELS,
+	CALLOUT_WHEEL_INSERTS,
+	CALLOUT_WHEEL_CANCELS,
+	CALLOUT_WHEEL_CASCADES,
 	CALLOUT_NUM_STATS
 } callout_stat_type_t;
 
@@ -375,8 +426,11 @@ typedef struct callout_table {
 	int		ct_nreap;	/* # heap entries that need reaping */
 	cyclic_id_t	ct_qcyclic;	/* cyclic for the callout queue */
 	callout_hash_t	ct_queue;	/* overflow queue of callouts */
-#ifndef _LP64
-	char		ct_pad[12];	/* cache alignment */
+	callout_wheel_t	*ct_wheel;	/* timing wheel for low-res callouts */
+#ifdef _LP64
+	char		ct_pad[56];	/* cache alignment */
+#else
+	char		ct_pad[8];	/* cache alignment */
 #endif
 	/*
 	 * This structure should be aligned to a 64-byte (cache-line)
@@ -404,6 +458,16 @@ typedef struct callout_table {
 		ct_kstat_data[CALLOUT_ALLOCATIONS].value.ui64
 #define	ct_cleanups							\
 		ct_kstat_data[CALLOUT_CLEANUPS].value.ui64
+#define	ct_heap_inserts							\
+		ct_kstat_data[CALLOUT_HEAP_INSERTS].value.ui64
+#define	ct_heap_cancels							\
+		ct_kstat_data[CALLOUT_HEAP_CANCELS].value.ui64
+#define	ct_wheel_inserts						\
+		ct_kstat_data[CALLOUT_WHEEL_INSERTS].value.ui64
+#define	ct_wheel_cancels						\
+		ct_kstat_data[CALLOUT_WHEEL_CANCELS].value.ui64
+#define	ct_wheel_cascades						\
+		ct_kstat_data[CALLOUT_WHEEL_CASCADES].value.ui64
 
 /*
  * CALLOUT_CHUNK is the minimum initial size of each heap, and the amount
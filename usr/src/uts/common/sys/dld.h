@@ -406,6 +406,10 @@ typedef struct dld_capab_direct_s {
 	/* flow control "can I put on a ring" callback */
 	uintptr_t	di_tx_fctl_df; /* canput-like callback */
 	void		*di_tx_fctl_dh;
+
+	/* per-flow transmit pacing rate */
+	uintptr_t	di_tx_pace_df;
+	void		*di_tx_pace_dh;
 } dld_capab_direct_t;
 
 /*
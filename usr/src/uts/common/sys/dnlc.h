@@ -80,18 +80,24 @@ typedef struct ncache {
 	struct ncache *hash_prev;
 	struct vnode *vp;		/* vnode the name refers to */
 	struct vnode *dp;		/* vnode of parent of name */
+	struct zone *zone;		/* zone charged for the entry */
 	int hash;			/* hash signature */
+	uchar_t referenced;		/* looked up since last reduce scan */
 	uchar_t namlen;			/* length of name */
 	char name[1];			/* segment name - null terminated */
 } ncache_t;
 
 /*
  * Hash table bucket structure of name cache entries for fast lookup.
+ * hash_gen is odd while the chain is being changed, and is bumped on
+ * every change, so that lookups walking the chain without hash_lock can
+ * tell whether what they saw is still true.
  */
 typedef struct nc_hash	{
 	ncache_t *hash_next;
 	ncache_t *hash_prev;
 	kmutex_t hash_lock;
+	volatile uint_t hash_gen;
 } nc_hash_t;
 
 /*
@@ -148,6 +154,17 @@ struct nc_stats {
 	kstat_named_t ncs_dir_finipurg;	/* fini purges */
 	kstat_named_t ncs_dir_rec_last;	/* reclaim last */
 	kstat_named_t ncs_dir_recl_any;	/* reclaim any */
+
+	/* name cache sizing and lockless lookup stats */
+
+	kstat_named_t ncs_entries;	/* current # entries */
+	kstat_named_t ncs_neg_entries;	/* current # negative entries */
+	kstat_named_t ncs_size;		/* current ncsize */
+	kstat_named_t ncs_hash_size;	/* current # hash buckets */
+	kstat_named_t ncs_resizes;	/* hash table resizes */
+	kstat_named_t ncs_ll_hits;	/* hits found without hash_lock */
+	kstat_named_t ncs_ll_misses;	/* misses found without hash_lock */
+	kstat_named_t ncs_ll_retries;	/* lockless walks that raced */
 };
 
 /*
@@ -92,6 +92,8 @@ extern size_t	tmpfs_minfree;		/* Anonymous memory in pages */
 extern size_t 	tmp_kmemspace;
 extern size_t	tmpfs_maxkmem;	/* Allocatable kernel memory in bytes */
 
+struct tmp_range;
+
 extern	void	tmpnode_init(struct tmount *, struct tmpnode *,
 	struct vattr *, struct cred *);
 extern	int	tmpnode_trunc(struct tmount *, struct tmpnode *, ulong_t);
@@ -105,11 +107,15 @@ extern	void	tdirtrunc(struct tmpnode *);
 extern	void	*tmp_memalloc(size_t, int);
 extern	void	tmp_memfree(void *, size_t);
 extern	int	tmp_resv(struct tmount *, struct tmpnode *, size_t, int);
+extern	void	tmp_unresv(struct tmount *, struct tmpnode *, size_t);
 extern	int	tmp_taccess(void *, int, struct cred *);
 extern	int	tmp_sticky_remove_access(struct tmpnode *, struct tmpnode *,
 	struct cred *);
 extern	int	tmp_convnum(char *, pgcnt_t *);
 extern	int	tmp_convmode(char *, mode_t *);
+extern	void	tmp_range_enter(struct tmpnode *, struct tmp_range *, offset_t,
+	ssize_t, krw_t);
+extern	void	tmp_range_exit(struct tmpnode *, struct tmp_range *);
 extern	int	tdirenter(struct tmount *, struct tmpnode *, char *,
 	enum de_op, struct tmpnode *, struct tmpnode *, struct vattr *,
 	struct tmpnode **, struct cred *, caller_context_t *);
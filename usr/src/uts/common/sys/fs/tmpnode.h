@@ -27,6 +27,7 @@
 #define	_SYS_FS_TMPNODE_H
 
 #include <sys/t_lock.h>
+#include <sys/list.h>
 #include <vm/seg.h>
 #include <vm/seg_vn.h>
 #include <sys/vfs_opreg.h>
@@ -35,6 +36,16 @@
 extern "C" {
 #endif
 
+/*
+ * A byte range of a file locked by a read or write, see tmp_range_enter().
+ */
+typedef struct tmp_range {
+	list_node_t	tr_link;		/* on tn_ranges */
+	offset_t	tr_off;			/* first byte */
+	offset_t	tr_end;			/* last byte + 1 */
+	krw_t		tr_type;		/* RW_READER or RW_WRITER */
+} tmp_range_t;
+
 /*
  * tmpnode is the file system dependent node for tmpfs.
  *
@@ -58,8 +69,14 @@ extern "C" {
  *	Filling in a slot in the array requires the write lock on tn_contents.
  *	Reading the array requires the read lock on tn_contents.
  *
+ *	Writes to a regular file that do not change its size may run with
+ *	tn_rwlock held only as reader (see tmp_rwlock()).  Such writes, and
+ *	reads, also hold a byte range lock on tn_ranges, which keeps
+ *	overlapping writes from interleaving and reads from seeing part of
+ *	a write.  tn_rlock protects tn_ranges.
+ *
  *	The ordering of the locking is:
- *	tn_rwlock -> tn_contents -> page locks on pages in file
+ *	tn_rwlock -> tn_ranges -> tn_contents -> page locks on pages in file
  *
  *	tn_tlock doesn't require any tmpnode locks
  */
@@ -87,6 +104,9 @@ struct tmpnode {
 	kmutex_t	tn_tlock;		/* time, flag, and nlink lock */
 	struct tmpnode *tn_xattrdp;		/* ext. attribute directory */
 	uint_t		tn_flags;		/* tmpnode specific flags */
+	kmutex_t	tn_rlock;		/* protects tn_ranges */
+	kcondvar_t	tn_rlcv;		/* a range was unlocked */
+	list_t		tn_ranges;		/* locked byte ranges */
 };
 
 #define	tn_dir		un_tmpnode.un_dirstruct.un_dirlist
@@ -49,7 +49,7 @@ extern "C" {
  * Lock order:
  * 1. cache_lock
  * 2. cc_lock in order by CPU ID
- * 3. cache_depot_lock
+ * 3. cache_depot_lock or kld_lock (never held together)
  *
  * Do not call kmem_cache_alloc() or taskq_dispatch() while holding any of the
  * above locks.
@@ -293,6 +293,24 @@ typedef struct kmem_maglist {
 	uint64_t	ml_alloc;	/* allocations from this list */
 } kmem_maglist_t;
 
+/*
+ * Per-lgroup depot of full magazines.  A CPU returns full magazines to the
+ * depot of its own lgroup and takes them from there first, so that freed
+ * buffers are preferably reused on the node that freed them.  Each depot
+ * sits on its own pair of cache lines.
+ */
+#define	KMEM_LGRP_DEPOT_SIZE	128	/* must be power of 2 */
+#define	KMEM_LGRP_DEPOT_PAD	(KMEM_LGRP_DEPOT_SIZE - sizeof (kmutex_t) - \
+	sizeof (kmem_maglist_t) - sizeof (uint64_t) - sizeof (long))
+
+typedef struct kmem_lgrp_depot {
+	kmutex_t	kld_lock;	/* protects kld_full */
+	kmem_maglist_t	kld_full;	/* full magazines */
+	uint64_t	kld_contention;	/* mutex contention count */
+	long		kld_reclaim;	/* ml_total before reclaim callback */
+	char		kld_pad[KMEM_LGRP_DEPOT_PAD]; /* for nice alignment */
+} kmem_lgrp_depot_t;
+
 typedef struct kmem_defrag {
 	/*
 	 * Statistics
@@ -354,6 +372,8 @@ struct kmem_cache {
 	uint64_t	cache_lookup_depth;	/* hash lookup depth */
 	uint64_t	cache_depot_contention;	/* mutex contention count */
 	uint64_t	cache_depot_contention_prev; /* previous snapshot */
+	uint64_t	cache_depot_remote;	/* remote lgroup full mags */
+	uint64_t	cache_depot_lock_wait;	/* depot lock wait time (ns) */
 
 	/*
 	 * Cache properties
@@ -405,6 +425,9 @@ struct kmem_cache {
 	kmem_magtype_t	*cache_magtype;		/* magazine type */
 	kmem_maglist_t	cache_full;		/* full magazines */
 	kmem_maglist_t	cache_empty;		/* empty magazines */
+	kmem_lgrp_depot_t *cache_lgrp_depot;	/* per-lgroup full magazines */
+	int		cache_lgrp_ndepot;	/* number of lgroup depots */
+	uint_t		cache_depot_quiet;	/* updates without contention */
 	kmem_dump_t	cache_dump;		/* used during crash dump */
 
 	/*
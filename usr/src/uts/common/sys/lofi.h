@@ -40,6 +40,7 @@
 #ifdef _KERNEL
 #include <sys/cmlb.h>
 #include <sys/open.h>
+#include <sys/kstat.h>
 #endif	/* _KERNEL */
 
 #ifdef	__cplusplus
@@ -125,6 +126,10 @@ extern "C" {
  *	li.li_minor = 0;
  *	ioctl(ld, LOFI_CHECK_COMPRESSED, &li);
  *
+ * If 'li_cachefile' is set for LOFI_MAP_FILE or LOFI_MAP_FILE_MINOR, the
+ * named file or device is used as a read/write cache in front of the mapped
+ * file (see "Block cache tier" in lofi.c).  LOFI_GET_FILENAME returns it.
+ *
  * If the 'li_force' flag is set for any of the LOFI_UNMAP_* commands, then if
  * the device is busy, the underlying vnode will be closed, and any subsequent
  * operations will fail.  It will behave as if the device had been forcibly
@@ -166,6 +171,9 @@ struct lofi_ioctl {
 	crypto_mech_name_t	li_iv_cipher;	/* for iv derivation */
 	uint32_t	li_iv_len;		/* for iv derivation */
 	iv_method_t	li_iv_type;		/* for iv derivation */
+
+	/* the following field is required for the block cache tier */
+	char	li_cachefile[MAXPATHLEN];
 };
 
 #define	LOFI_IOC_BASE		(('L' << 16) | ('F' << 8))
@@ -245,6 +253,49 @@ struct crypto_meta {
 	/* second header block is not defined at this time */
 };
 
+/*
+ * Block cache tier.  The cache file is cut into slots of 1 << ls_bc_blkshift
+ * bytes, each of which can hold a copy of one block of the mapped file.
+ */
+typedef enum lofi_bc_list {
+	LOFI_BC_FREE,			/* slot holds nothing */
+	LOFI_BC_PROBATION,		/* block referenced once */
+	LOFI_BC_PROTECTED		/* block referenced again since */
+} lofi_bc_list_t;
+
+struct lofi_bc_ent {
+	list_node_t		be_node;	/* on the be_list list */
+	struct lofi_bc_ent	*be_hnext;	/* hash chain */
+	uint64_t		be_blkno;	/* block of the mapped file */
+	uint32_t		be_slot;	/* slot in the cache file */
+	lofi_bc_list_t		be_list;
+	boolean_t		be_busy;	/* slot I/O in progress */
+	boolean_t		be_dirty;	/* newer than the mapped file */
+};
+
+/* A write that bypasses the cache, see lofi_bc_chunk() */
+struct lofi_bc_around {
+	list_node_t		ba_node;
+	uint64_t		ba_blkno;
+};
+
+typedef struct lofi_bc_kstat {
+	kstat_named_t	lbk_read_hits;
+	kstat_named_t	lbk_read_misses;
+	kstat_named_t	lbk_write_hits;
+	kstat_named_t	lbk_write_misses;
+	kstat_named_t	lbk_fills;
+	kstat_named_t	lbk_write_allocs;
+	kstat_named_t	lbk_write_arounds;
+	kstat_named_t	lbk_seq_bypass;
+	kstat_named_t	lbk_evictions;
+	kstat_named_t	lbk_writebacks;
+	kstat_named_t	lbk_flushes;
+	kstat_named_t	lbk_errors;
+	kstat_named_t	lbk_blocks;
+	kstat_named_t	lbk_dirty;
+} lofi_bc_kstat_t;
+
 struct lofi_state {
 	vnode_t		*ls_vp;		/* open real vnode */
 	vnode_t		*ls_stacked_vp;	/* open vnode */
@@ -306,6 +357,27 @@ struct lofi_state {
 	iv_method_t		ls_iv_type;	/* for iv derivation */
 	kmutex_t		ls_crypto_lock;
 	crypto_ctx_template_t	ls_ctx_tmpl;
+
+	/* the following fields are required for the block cache tier */
+	vnode_t			*ls_bc_vp;	/* open cache vnode */
+	int			ls_bc_openflag;
+	char			*ls_bc_path;	/* cache name given at map */
+	uint32_t		ls_bc_blkshift;	/* log2 of slot size */
+	uint32_t		ls_bc_nslots;
+	uint32_t		ls_bc_nprot;	/* # on ls_bc_protected */
+	uint32_t		ls_bc_hashmask;
+	struct lofi_bc_ent	*ls_bc_ents;	/* one per slot */
+	struct lofi_bc_ent	**ls_bc_hash;
+	list_t			ls_bc_free;
+	list_t			ls_bc_probation;
+	list_t			ls_bc_protected;
+	list_t			ls_bc_arounds;	/* writes around the cache */
+	u_offset_t		ls_bc_seq_next;	/* end of the last request */
+	u_offset_t		ls_bc_seq_len;	/* bytes in sequential run */
+	kmutex_t		ls_bc_lock;	/* lists, hash and entries */
+	kcondvar_t		ls_bc_cv;	/* be_busy or arounds changed */
+	kstat_t			*ls_bc_kstat;
+	lofi_bc_kstat_t		ls_bc_stats;
 };
 
 #endif	/* _KERNEL */
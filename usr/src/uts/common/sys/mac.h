@@ -249,7 +249,8 @@ typedef enum {
 	MAC_PROP_ADV_50GFDX_CAP,
 	MAC_PROP_EN_50GFDX_CAP,
 	MAC_PROP_EN_FEC_CAP,
-	MAC_PROP_ADV_FEC_CAP
+	MAC_PROP_ADV_FEC_CAP,
+	MAC_PROP_RX_GRO
 } mac_prop_id_t;
 
 /*
@@ -144,6 +144,7 @@ extern void mac_secondary_cleanup(mac_client_handle_t);
 extern mac_tx_cookie_t mac_tx(mac_client_handle_t, mblk_t *,
     uintptr_t, uint16_t, mblk_t **);
 extern boolean_t mac_tx_is_flow_blocked(mac_client_handle_t, mac_tx_cookie_t);
+extern void mac_tx_pace(mac_client_handle_t, uintptr_t, uint64_t);
 extern uint64_t mac_client_stat_get(mac_client_handle_t, uint_t);
 
 extern int mac_promisc_add(mac_client_handle_t, mac_client_promisc_type_t,
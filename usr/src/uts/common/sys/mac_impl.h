@@ -96,6 +96,7 @@ typedef	struct mac_chain_s {
 #define	MCB_TX_NOTIFY_CB_T	0x4
 
 extern boolean_t	mac_tx_serialize;
+extern boolean_t	mac_tx_fq_enable;
 
 typedef struct mac_cb_s {
 	struct mac_cb_s		*mcb_nextp;	/* Linked list of callbacks */
@@ -525,6 +526,13 @@ struct mac_impl_s {
 	uint32_t		mi_llimit;
 	uint32_t		mi_ldecay;
 
+	/*
+	 * Software receive offload: merge TCP segments of the same flow in
+	 * the receive fanout (see mac_rx_srs_gro()). Read without locks on
+	 * the data path.
+	 */
+	uint32_t		mi_rx_gro;
+
 /* This should be the last block in this structure */
 #ifdef DEBUG
 #define	MAC_PERIM_STACK_DEPTH	15
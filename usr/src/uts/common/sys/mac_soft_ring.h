@@ -126,6 +126,51 @@ struct mac_soft_ring_s {
 
 typedef void (*mac_srs_drain_proc_t)(mac_soft_ring_set_t *, uint_t);
 
+/*
+ * Tx fair queueing. When enabled, each Tx SRS keeps a queue per flow
+ * (keyed by the fanout hint) and releases packets to st_func in deficit
+ * round robin order, holding back flows that have a pacing rate until
+ * their release time. See the block comment above mac_tx_fq() in
+ * mac_sched.c.
+ */
+typedef struct mac_fq_flow_s mac_fq_flow_t;
+struct mac_fq_flow_s {
+	mac_fq_flow_t	*fl_hnext;	/* hash chain */
+	mac_fq_flow_t	*fl_next;	/* active list or wheel slot */
+	uintptr_t	fl_key;
+	uintptr_t	fl_hint;	/* fanout hint for released packets */
+	mblk_t		*fl_head;
+	mblk_t		*fl_tail;
+	uint32_t	fl_cnt;
+	uint32_t	fl_state;
+	int64_t		fl_deficit;
+	uint64_t	fl_rate;	/* bytes per second, 0 if unpaced */
+	hrtime_t	fl_time;	/* earliest release of fl_head */
+	hrtime_t	fl_last;	/* last enqueue, for reclaim */
+};
+
+#define	FQ_FLOW_IDLE		0
+#define	FQ_FLOW_ACTIVE		1
+#define	FQ_FLOW_THROTTLED	2
+
+typedef struct mac_tx_fq_s {
+	kmutex_t	fq_lock;
+	mac_soft_ring_set_t *fq_srs;
+	mac_fq_flow_t	**fq_hash;
+	uint_t		fq_hash_size;	/* power of 2 */
+	uint_t		fq_nflows;
+	mac_fq_flow_t	*fq_active;	/* round robin list */
+	mac_fq_flow_t	*fq_active_tail;
+	mac_fq_flow_t	**fq_wheel;	/* flows waiting for release time */
+	uint_t		fq_wheel_size;	/* power of 2 */
+	int64_t		fq_wheel_tick;	/* next wheel tick to service */
+	uint_t		fq_throttled;	/* flows on the wheel */
+	callout_id_t	fq_tid;
+	hrtime_t	fq_gc_time;
+	boolean_t	fq_draining;
+	boolean_t	fq_condemned;
+} mac_tx_fq_t;
+
 /* Transmit side Soft Ring Set */
 typedef struct mac_srs_tx_s {
 	/* Members for Tx size processing */
@@ -169,6 +214,7 @@ typedef struct mac_srs_tx_s {
 	 * for each ring in a group.
 	 */
 	mac_soft_ring_t **st_soft_rings;
+	mac_tx_fq_t	*st_fq;		/* fair queueing, if enabled */
 } mac_srs_tx_t;
 
 /* Receive side Soft Ring Set */
@@ -681,6 +727,11 @@ extern void mac_tx_srs_add_ring(mac_soft_ring_set_t *, mac_ring_t *);
 extern void mac_tx_srs_del_ring(mac_soft_ring_set_t *, mac_ring_t *);
 extern mac_tx_cookie_t mac_tx_srs_no_desc(mac_soft_ring_set_t *, mblk_t *,
     uint16_t, mblk_t **);
+extern mac_tx_cookie_t mac_tx_fq(mac_soft_ring_set_t *, mblk_t *, uintptr_t,
+    uint16_t);
+extern mac_tx_fq_t *mac_tx_fq_create(mac_soft_ring_set_t *);
+extern void mac_tx_fq_destroy(mac_tx_fq_t *);
+extern void mac_tx_fq_pace(mac_tx_fq_t *, uintptr_t, uint64_t);
 
 /* Subflow specific stuff */
 extern int mac_srs_flow_create(struct mac_client_impl_s *, flow_entry_t *,
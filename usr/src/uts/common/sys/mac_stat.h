@@ -51,6 +51,8 @@ typedef struct mac_rx_stats_s {
 	uint64_t	mrs_chaincnt10to50;
 	uint64_t	mrs_chaincntover50;
 	uint64_t	mrs_ierrors;
+	uint64_t	mrs_gro_segs;	/* segments merged into others */
+	uint64_t	mrs_gro_merged;	/* packets built by merging */
 } mac_rx_stats_t;
 
 typedef struct mac_tx_stats_s {
@@ -68,6 +70,9 @@ typedef struct mac_tx_stats_s {
 	uint64_t	mts_blockcnt;	/* times blocked for Tx descs */
 	uint64_t	mts_unblockcnt;	/* unblock calls from driver */
 	uint64_t	mts_sdrops;
+	uint64_t	mts_fq_drops;	/* fair queueing per-flow drops */
+	uint64_t	mts_fq_throttled; /* flows held until release */
+	uint64_t	mts_fq_timer;	/* release timer expirations */
 } mac_tx_stats_t;
 
 typedef struct mac_misc_stats_s {
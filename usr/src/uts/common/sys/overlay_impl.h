@@ -70,6 +70,25 @@ typedef enum overlay_target_flag {
 	OVERLAY_T_TEARDOWN	= 0x1
 } overlay_target_flag_t;
 
+/*
+ * Per-CPU cache of recent dynamic target lookups, which lets the transmit
+ * path find a destination without ott_lock or the entry's ote_lock.  A
+ * cached destination is only good while otpe_gen matches ott_gen, which is
+ * bumped whenever an entry of the target changes.
+ */
+#define	OVERLAY_TCACHE_SIZE	32	/* must be a power of two */
+
+typedef struct overlay_target_pcpu_ent {
+	uint64_t		otpe_gen;
+	uint8_t			otpe_addr[ETHERADDRL];
+	overlay_target_point_t	otpe_dest;
+} overlay_target_pcpu_ent_t;
+
+typedef struct overlay_target_pcpu {
+	kmutex_t			otpc_lock;
+	overlay_target_pcpu_ent_t	otpc_ents[OVERLAY_TCACHE_SIZE];
+} overlay_target_pcpu_t;
+
 typedef struct overlay_target {
 	kmutex_t		ott_lock;
 	kcondvar_t		ott_cond;
@@ -78,6 +97,8 @@ typedef struct overlay_target {
 	uint64_t		ott_id;		/* RO */
 	overlay_target_flag_t	ott_flags;	/* ott_lock */
 	uint_t			ott_ocount;	/* ott_lock */
+	volatile uint64_t	ott_gen;	/* atomic: entry generation */
+	overlay_target_pcpu_t	**ott_pcpu;	/* RO: max_ncpus, or NULL */
 	union {					/* ott_lock */
 		overlay_target_point_t	ott_point;
 		struct overlay_target_dyn {
@@ -203,12 +203,16 @@ struct so_snd_bufinfo {
 #define	SO_EXCLBIND	0x1015		/* exclusive binding */
 #define	SO_MAC_IMPLICIT	0x1016		/* hide mac labels on wire */
 #define	SO_VRRP		0x1017		/* VRRP control socket */
+#define	SO_REUSEPORT	0x2004		/* allow simultaneous port reuse */
+#define	SO_MAX_PACING_RATE 0x2005	/* max bytes/sec to send, 0 no limit */
+#define	SO_ZEROCOPY	0x2006		/* allow MSG_ZEROCOPY sends */
+#define	SCM_ZEROCOPY	SO_ZEROCOPY	/* MSG_ERRQUEUE completion */
+#define	SO_BUSY_POLL	0x2007		/* usecs to busy poll on receive */
 
 #ifdef	_KERNEL
 #define	SO_SRCADDR	0x2001		/* Internal: AF_UNIX source address */
 #define	SO_FILEP	0x2002		/* Internal: AF_UNIX file pointer */
 #define	SO_UNIX_CLOSE	0x2003		/* Internal: AF_UNIX peer closed */
-#define	SO_REUSEPORT	0x2004		/* allow simultaneous port reuse */
 #endif	/* _KERNEL */
 
 /*
@@ -256,6 +260,20 @@ struct	linger {
 	int	l_linger;		/* linger time */
 };
 
+/*
+ * Completion of MSG_ZEROCOPY sends, returned as an SCM_ZEROCOPY control
+ * message by recvmsg(MSG_ERRQUEUE).  Each zero-copy send on a socket is
+ * numbered, starting from zero; the sends szc_lo to szc_hi inclusive have
+ * completed and their buffers may be reused.
+ */
+struct	so_zc_done {
+	uint32_t	szc_lo;		/* first send completed */
+	uint32_t	szc_hi;		/* last send completed */
+	uint32_t	szc_flags;	/* SO_ZC_COPIED */
+};
+
+#define	SO_ZC_COPIED	0x1		/* sends were copied, not zero-copy */
+
 /*
  * Levels for (get/set)sockopt() that don't apply to a specific protocol.
  */
@@ -378,6 +396,16 @@ struct msghdr {
 #endif	/* defined(_XPG4_2) || defined(_KERNEL) */
 };
 
+#if !defined(_XPG4_2) || defined(__EXTENSIONS__) || defined(_KERNEL)
+/*
+ * Message vector element for recvmmsg and sendmmsg calls.
+ */
+struct mmsghdr {
+	struct msghdr	msg_hdr;		/* message header */
+	unsigned int	msg_len;		/* bytes transferred */
+};
+#endif	/* !defined(_XPG4_2) || defined(__EXTENSIONS__) || defined(_KERNEL) */
+
 #if	defined(_KERNEL) || defined(_FAKE_KERNEL)
 
 /*
@@ -396,6 +424,13 @@ struct omsghdr {
 
 #define	nmsghdr		msghdr
 
+struct ommsghdr {
+	struct omsghdr	msg_hdr;	/* message header */
+	uint_t		msg_len;	/* bytes transferred */
+};
+
+#define	nmmsghdr	mmsghdr
+
 #if defined(_SYSCALL32)
 
 struct omsghdr32 {
@@ -419,6 +454,18 @@ struct msghdr32 {
 
 #define	nmsghdr32	msghdr32
 
+struct ommsghdr32 {
+	struct omsghdr32 msg_hdr;	/* message header */
+	uint32_t	msg_len;	/* bytes transferred */
+};
+
+struct mmsghdr32 {
+	struct msghdr32	msg_hdr;	/* message header */
+	uint32_t	msg_len;	/* bytes transferred */
+};
+
+#define	nmmsghdr32	mmsghdr32
+
 #endif	/* _SYSCALL32 */
 #endif	/* _KERNEL */
 
@@ -434,6 +481,9 @@ struct msghdr32 {
 #define	MSG_NOSIGNAL	0x200		/* Don't generate SIGPIPE */
 #define	MSG_DUPCTRL	0x800		/* Save control message for use with */
 					/* with left over data */
+#define	MSG_WAITFORONE	0x1000		/* recvmmsg: nonblocking after first */
+#define	MSG_ZEROCOPY	0x2000		/* Send without copy (SO_ZEROCOPY) */
+#define	MSG_ERRQUEUE	0x4000		/* Receive zero-copy completions */
 #define	MSG_XPG4_2	0x8000		/* Private: XPG4.2 flag */
 
 /* Obsolete but kept for compilation compatibility. Use IOV_MAX. */
@@ -518,6 +568,8 @@ struct cmsghdr {
 #pragma redefine_extname connect __xnet_connect
 #pragma redefine_extname recvmsg __xnet_recvmsg
 #pragma redefine_extname sendmsg __xnet_sendmsg
+#pragma redefine_extname recvmmsg __xnet_recvmmsg
+#pragma redefine_extname sendmmsg __xnet_sendmmsg
 #pragma redefine_extname sendto __xnet_sendto
 #pragma redefine_extname socket __xnet_socket
 #pragma redefine_extname socketpair __xnet_socketpair
@@ -527,6 +579,8 @@ struct cmsghdr {
 #define	connect	__xnet_connect
 #define	recvmsg	__xnet_recvmsg
 #define	sendmsg	__xnet_sendmsg
+#define	recvmmsg	__xnet_recvmmsg
+#define	sendmmsg	__xnet_sendmmsg
 #define	sendto	__xnet_sendto
 #define	socket	__xnet_socket
 #define	socketpair	__xnet_socketpair
@@ -568,6 +622,13 @@ extern int socket(int, int, int);
 #if !defined(_XPG4_2) || defined(_XPG6) || defined(__EXTENSIONS__)
 extern int sockatmark(int);
 #endif /* !defined(_XPG4_2) || defined(_XPG6) || defined(__EXTENSIONS__) */
+
+#if !defined(_XPG4_2) || defined(__EXTENSIONS__)
+struct timespec;
+extern int recvmmsg(int, struct mmsghdr *, unsigned int, int,
+	struct timespec *);
+extern int sendmmsg(int, struct mmsghdr *, unsigned int, int);
+#endif /* !defined(_XPG4_2) || defined(__EXTENSIONS__) */
 #endif	/* !defined(_KERNEL) || defined(_BOOT) */
 
 #ifdef	__cplusplus
@@ -190,6 +190,7 @@ struct sonode {
 	int	so_xpg_rcvbuf;		/* SO_RCVBUF value for XPG4 socket */
 	clock_t	so_sndtimeo;		/* send timeout */
 	clock_t	so_rcvtimeo;		/* recv timeout */
+	uint_t	so_busy_poll;		/* SO_BUSY_POLL usecs, 0 if off */
 
 	mblk_t	*so_oobmsg;		/* outofline oob data */
 	ssize_t	so_oobmark;		/* offset of the oob data */
@@ -241,6 +242,9 @@ struct sonode {
 	/* != NULL for sodirect enabled socket */
 	struct sodirect_s	*so_direct;
 
+	/* != NULL once SO_ZEROCOPY has been set */
+	struct sod_zc_s		*so_zc;
+
 	/* socket filters */
 	uint_t			so_filter_active;	/* # of active fil */
 	uint_t			so_filter_tx;		/* pending tx ops */
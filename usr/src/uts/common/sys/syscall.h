@@ -322,9 +322,11 @@ extern "C" {
 	 *	forkallx(flags) :: forksys(1, flags)
 	 *	vforkx(flags)   :: forksys(2, flags)
 	 */
+#define	SYS_recvmmsg	143
 #define	SYS_sigtimedwait	144
 #define	SYS_lwp_info	145
 #define	SYS_yield	146
+#define	SYS_sendmmsg	147
 #define	SYS_lwp_sema_post	148
 #define	SYS_lwp_sema_trywait	149
 #define	SYS_lwp_detach	150
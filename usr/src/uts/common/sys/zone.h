@@ -488,6 +488,8 @@ typedef struct {
 	kstat_named_t	zm_nested_intp;
 	kstat_named_t	zm_init_pid;
 	kstat_named_t	zm_boot_time;
+	kstat_named_t	zm_dnlc_entries;
+	kstat_named_t	zm_dnlc_bytes;
 } zone_misc_kstat_t;
 
 typedef struct zone {
@@ -705,6 +707,9 @@ typedef struct zone {
 
 	uint32_t	zone_nested_intp;	/* nested interp. kstat */
 
+	uint64_t	zone_dnlc_entries;	/* name cache entries charged */
+	uint64_t	zone_dnlc_bytes;	/* ... and their size */
+
 	struct loadavg_s zone_loadavg;		/* loadavg for this zone */
 	uint64_t	zone_hp_avenrun[3];	/* high-precision avenrun */
 	int		zone_avenrun[3];	/* FSCALED avg. run queue len */